@@ -0,0 +1,206 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_brk.c: IBM 3705 instruction breakpoints
+
+   The breakpoints are set with the SCP BREAK and NOBREAK commands.  The
+   switch selects what a breakpoint does when the CCU fetches its instr:
+
+        BREAK {-E} addr{[n]}{;action}   stop (default), SCP pass count and actions
+        BREAK -C addr                   count the hit and go on
+        BREAK -L addr                   print the instr and registers and go on
+        SHOW CPU BREAKS                 breakpoints with their hit counts
+        SET CPU BRKZERO                 zero the hit counts
+
+   BREAK is SCP's command followed by a check: an odd address or one
+   whose instr would not fit storage is refused and removed again.
+   brk_sync() copies SCP's breakpoint table into brk_map, one bit per
+   storage halfword, each time sim_instr starts; BREAK and NOBREAK can
+   only be given while it is stopped.  The fetch path tests that bit and
+   calls brk_hit() only for a breakpoint address, so breakpoints cost
+   nothing elsewhere and do not stop the threaded dispatch or the JIT.
+   Hit counts are kept per address while it has a breakpoint when the
+   CCU is started.
+
+   After a stop the instr at the breakpoint must run once before it can
+   stop again.  brk_sync() leaves its bit out of brk_map and schedules
+   brk_svc() one instr later, which puts the bit back and tells SCP that
+   the stop location has been left (sim_brk_clrspc).
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern int32 lvl;
+extern int32 *GRb;
+extern BRKTAB *sim_brk_tab;
+extern int32 sim_brk_ent;
+extern UNIT evt_unit[];
+extern void trc_sym(FILE *st, t_uint64 seq, int32 level, uint32 iar, uint8 *inst);
+
+#define BRK_TYPES       (SWMASK('E') | SWMASK('C') | SWMASK('L'))
+
+struct brkent {
+   int32    addr;
+   int32    typ;                               /* SCP switch mask */
+   t_uint64 hits;
+};
+
+uint8 brk_map[COV_BYTES];                      /* Breakpoint halfwords, 1 bit each */
+static struct brkent *brk_tab = NULL;          /* Ordered by address */
+static int32 brk_n = 0;
+static int32 brk_skip = -1;                    /* Stopped here, run it once first */
+
+#define BRK_BIT(a)      (1 << (((a) >> 1) & 7))
+
+/* BREAK: refuse addresses the fetch path can never stop at */
+
+t_stat brk_set_cmd(int32 flag, char *cptr) {
+   BRKTAB *bp;
+   t_stat r;
+   int32 i = 0, bad = 0;
+
+   r = brk_cmd(SSH_ST, cptr);
+   while (i < sim_brk_ent) {
+      bp = &sim_brk_tab[i];
+      if ((bp->typ & BRK_TYPES) && ((bp->addr & 1) || (bp->addr + 3 >= MEMSIZE))) {
+         printf("BREAK: %05X %s, not set\n", bp->addr,
+                (bp->addr & 1) ? "is odd" : "is beyond the last instr in storage");
+         sim_brk_clr(bp->addr, 0);             /* Moves the rest down */
+         bad++;
+      } else
+         i++;
+   }
+   return bad ? SCPE_ARG : r;
+}
+
+/* Rebuild brk_map and brk_tab from SCP's table, keeping the hit counts.
+   start is set when sim_instr calls it. */
+
+void brk_sync(int32 start) {
+   struct brkent *nt;
+   BRKTAB *bp;
+   int32 i, j = 0, n = 0;
+
+   memset(brk_map, 0, sizeof(brk_map));
+   nt = (struct brkent *) calloc(sim_brk_ent + 1, sizeof(struct brkent));
+   if (nt == NULL)
+      return;
+   for (i = 0; i < sim_brk_ent; i++) {
+      bp = &sim_brk_tab[i];
+      if (((bp->typ & BRK_TYPES) == 0) || (bp->addr & 1) || (bp->addr + 3 >= MEMSIZE))
+         continue;                             /* Storage made smaller since */
+      while ((j < brk_n) && (brk_tab[j].addr < (int32) bp->addr))
+         j++;
+      nt[n].addr = bp->addr;
+      nt[n].typ = bp->typ;
+      if ((j < brk_n) && (brk_tab[j].addr == (int32) bp->addr))
+         nt[n].hits = brk_tab[j].hits;
+      if (!start || (bp->addr != brk_skip))
+         brk_map[bp->addr >> 4] |= BRK_BIT(bp->addr);
+      n++;
+   }
+   free(brk_tab);
+   brk_tab = nt;
+   brk_n = n;
+   if (start && (brk_skip >= 0))
+      sim_activate(&evt_unit[EVT_BRK], 1);     /* After the first instr */
+}
+
+static struct brkent *brk_find(int32 pc) {
+   int32 lo = 0, hi = brk_n - 1, m;
+
+   while (lo <= hi) {
+      m = (lo + hi) / 2;
+      if (brk_tab[m].addr == pc)
+         return &brk_tab[m];
+      if (brk_tab[m].addr < pc)
+         lo = m + 1;
+      else
+         hi = m - 1;
+   }
+   return NULL;
+}
+
+/* One instr has run since sim_instr started after a stop: arm the
+   breakpoint it stopped at again */
+
+t_stat brk_svc(UNIT *uptr) {
+   if ((brk_skip >= 0) && (brk_find(brk_skip) != NULL))
+      brk_map[brk_skip >> 4] |= BRK_BIT(brk_skip);
+   brk_skip = -1;
+   sim_brk_clrspc(0);                          /* SCP may stop there again */
+   return SCPE_OK;
+}
+
+/* The CCU is about to fetch the instr at pc and its brk_map bit is on */
+
+t_stat brk_hit(int32 pc) {
+   struct brkent *b;
+   int32 i;
+
+   if ((b = brk_find(pc)) == NULL)
+      return SCPE_OK;
+   b->hits++;
+   if (b->typ & SWMASK('L')) {
+      trc_sym(stdout, b->hits, lvl, pc, &M[pc]);
+      for (i = 1; i < 8; i++)
+         printf(" R%d=%05X", i, GRb[i]);
+      printf("\n\r");
+   }
+   if (b->typ & SWMASK('E')) {
+      if (sim_brk_test(pc, SWMASK('E'))) {     /* Pass count, actions */
+         brk_skip = pc;
+         return STOP_IBKPT;
+      }
+   }
+   return SCPE_OK;
+}
+
+/* SHOW CPU BREAKS */
+
+t_stat brk_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   int32 i;
+
+   brk_sync(0);
+   if (brk_n == 0)
+      fprintf(st, "no breakpoints\n");
+   for (i = 0; i < brk_n; i++)
+      fprintf(st, "   %05X %s%s%s %10" LL_FMT "u hits\n", brk_tab[i].addr,
+              (brk_tab[i].typ & SWMASK('E')) ? "E" : " ",
+              (brk_tab[i].typ & SWMASK('C')) ? "C" : " ",
+              (brk_tab[i].typ & SWMASK('L')) ? "L" : " ", brk_tab[i].hits);
+   return SCPE_OK;
+}
+
+/* SET CPU BRKZERO */
+
+t_stat brk_zero(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   int32 i;
+
+   if (cptr != NULL)
+      return SCPE_ARG;
+   for (i = 0; i < brk_n; i++)
+      brk_tab[i].hits = 0;
+   return SCPE_OK;
+}
@@ -239,6 +239,7 @@ void *BSC_thread(void *arg)
    struct epoll_event event, events[MAXBSCLINES];
 
    printf("\rBSC: Thread %d started succesfully...\n", syscall(SYS_gettid));
+   ctl_thread(arg, "BSC");
 
    for (int j = 0; j < MAXBSCLINES; j++) {
       bscline[j] =  malloc(sizeof(struct BSCLine));
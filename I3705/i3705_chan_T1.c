@@ -82,8 +82,7 @@
 
 extern int32 Eregs_Inp[];
 extern int32 Eregs_Out[];
-extern int8  CA1_DS_req_L3;  /* Chan Adap Data/Status request flag */
-extern int8  CA1_IS_req_L3;  /* Chan Adap Initial/Sel request flag */
+extern volatile uint32 int_src;  /* Interrupt sources pending */
 char data_buffer[IMAX];
 char response_buffer[RMAX];
 int i;
@@ -288,7 +287,7 @@ void *CA1_ATTN(void *arg) {
          printf("CA1: L3 register 67 %04X \n\r", Eregs_Out[0x67]);
          Eregs_Inp[0x62] |= 0x0100;               // Set Program requested L3 interrupt
          Eregs_Inp[0x77] |= 0x0010;               // Set L3 Data Service Request
-         CA1_DS_req_L3 = ON;                      // Chan Adap Data Service  request flag
+         IRQ_SET(IRQ_CADS_L3);                    // Chan Adap Data Service  request flag
          while (Ireg_bit(0x77, 0x0010) == ON) wait();
          Eregs_Out[0x67] &= ~0x0040;              // Reset L3 DS/ request
          printf("CA1: Sending Return status\n\r");
@@ -366,8 +365,8 @@ void *CA1_thread(void *arg) {
       printf("CA1: Attention thread started succesfully... \n\r");
    }
    Eregs_Inp[0x77] &= ~0x0018;           // Reset inital sel and  data/serv lvl3 interrupt
-   CA1_DS_req_L3 = OFF;                  // Chan Adap Data/Status request flag
-   CA1_IS_req_L3 = OFF;                  // Chan Adap Initial Sel request flag
+   IRQ_CLR(IRQ_CADS_L3);                 // Chan Adap Data/Status request flag
+   IRQ_CLR(IRQ_CAIS_L3);                 // Chan Adap Initial Sel request flag
    Eregs_Inp[0x62] &= ~0x0400;           // Reset channel stop
 
 
@@ -429,7 +428,7 @@ void *CA1_thread(void *arg) {
             Eregs_Inp[0x60] |= 0x8000;                       // Set initial selection
             Eregs_Inp[0x62] |= 0x8000;                       // Set outbound data transfer request
             Eregs_Inp[0x77] |= 0x0008;                       // Set Initial select lvl 3 interrupt
-            CA1_IS_req_L3 = ON;                              // Chan Adap Initial Sel request flag
+            IRQ_SET(IRQ_CAIS_L3);                            // Chan Adap Initial Sel request flag
 
             while (Ireg_bit(0x77, 0x008) == ON) wait();      // Wait for initial selection reset
             i = 0;                                           // Data to be send counter
@@ -462,7 +461,7 @@ void *CA1_thread(void *arg) {
                      break;
                }
                Eregs_Inp[0x77] |= 0x0010;                    // Set L3 Data Service Request
-               CA1_DS_req_L3 = ON;                           // Chan Adap Data Service request flag
+               IRQ_SET(IRQ_CADS_L3);                         // Chan Adap Data Service request flag
                while (Ireg_bit(0x77, 0x0010) == ON) wait();  // Wait for reset of Data/Status interrupt
             }
 
@@ -493,7 +492,7 @@ void *CA1_thread(void *arg) {
             while (Ireg_bit(0x77, 0x0018) == ON) wait();     // Wait for selection reset
             Eregs_Inp[0x60] |= 0x8000;                       // Set initial selection
             Eregs_Inp[0x77] |= 0x0008;                       // Set Initial select lvl 3 interrupt
-            CA1_IS_req_L3 = ON;                              // Chan Adap Initial Sel request flag
+            IRQ_SET(IRQ_CAIS_L3);                            // Chan Adap Initial Sel request flag
             while (Ireg_bit(0x77, 0x0008) == ON) wait();     // Wait for initial selection reset
 
             nobytes = (Eregs_Out[0x62] & 0x0003);            // Get nr of bytes
@@ -531,7 +530,7 @@ void *CA1_thread(void *arg) {
             while (Ireg_bit(0x77, 0x0018) == ON) wait();     // Wait for selection reset
             Eregs_Inp[0x60] |= 0x8000;                       // Set initial selection
             Eregs_Inp[0x77] |= 0x0008;                       // Set Initial select lvl 3 interrupt
-            CA1_IS_req_L3 = ON;                              /* Chan Adap Initial Sel request flag */
+            IRQ_SET(IRQ_CAIS_L3);                            /* Chan Adap Initial Sel request flag */
             while (Ireg_bit(0x77, 0x0008) == ON) wait();     // Wait for initial selection reset
 
             Eregs_Inp[0x62] &= ~0x0400;                      // Reset channel stop
@@ -587,7 +586,7 @@ void *CA1_thread(void *arg) {
                Eregs_Out[0x62] &= ~0x0600;                   // Reset Reg 62 bits
                Eregs_Inp[0X62] = (Eregs_Inp[0X62] & ~0x0007) | tcount;  // Set number of bytes transferred
                Eregs_Inp[0x77] |= 0x0010;                    // Set L3 Data Service Request
-               CA1_DS_req_L3 = ON;                           // Chan Adap Data Service request flag */
+               IRQ_SET(IRQ_CADS_L3);                         // Chan Adap Data Service request flag */
             }
 
             printf("CA1: Data transfer complete...\n\r");
@@ -595,7 +594,7 @@ void *CA1_thread(void *arg) {
             Eregs_Inp[0x62] |= 0x0400;                       // Set channel stop
             Eregs_Inp[0X62] &= ~0x0007;                      // Set number of bytes transferred to 0
             Eregs_Inp[0x77] |= 0x0010;                       // Set data/serv lvl 3 interrupt
-            CA1_DS_req_L3 = ON;                              // Chan Adap Data Service request flag
+            IRQ_SET(IRQ_CADS_L3);                            // Chan Adap Data Service request flag
             printf("CA1: Channel Stop\n\r");
 
             if (Eregs_Out[0x62] & 0x1000) {                  // Present Channel end
@@ -626,7 +625,7 @@ void *CA1_thread(void *arg) {
             while (Ireg_bit(0x77, 0x0018) == ON) wait();     // Wait for selection reset
             Eregs_Inp[0x60] |= 0x8000;                       // Set initial selection
             Eregs_Inp[0x77] |= 0x0008;                       // Set Initial select lvl 3 interrupt
-            CA1_IS_req_L3 = ON;                              // Chan Adap Initial Sel request flag
+            IRQ_SET(IRQ_CAIS_L3);                            // Chan Adap Initial Sel request flag
             while (Ireg_bit(0x77, 0x0008) == ON) wait();     // Wait for initial selection reset
 
             // Send CA return status to host
@@ -72,9 +72,12 @@ typedef enum { false, true } bool;
 extern int32 debug_reg;
 extern int32 Eregs_Inp[];
 extern int32 Eregs_Out[];
-extern uint8 M[];
-extern int8  CA1_DS_req_L3;  // Chan Adap Data/Status request flag
-extern int8  CA1_IS_req_L3;  // Chan Adap Initial/Sel request flag
+extern uint8 *M;
+extern void pdc_post(int32 addr, int32 len);
+extern volatile uint32 int_src;  // Interrupt sources pending
+extern void  ccu_wake(void); // Interrupt request raised
+extern int32 rr_mode;        // Record and replay
+extern int32 rr_store(int32 addr, uint8 *data, int32 len);
 
 // Trace variables
 uint16_t Adbg_reg = 0x00;    // Bit flags for debug/trace
@@ -98,8 +101,8 @@ pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 extern pthread_mutex_t r77_lock;
 
 
-void exec_attn();
-void exec_pci();
+void exec_attn(struct i3705 *ctl);
+void exec_pci(struct i3705 *ctl);
 void exec_ccw(struct IO3705 *iob);
 int reg_bit(int reg, int bit_mask);
 int Ireg_bit(int reg, int bit_mask);
@@ -121,8 +124,6 @@ struct CSW {    /* Channel Status Word */
    uint16_t count;
 } csw;
 
-struct IO3705*  iobs[MAXCHAN];  /* IBM 3705 I/O Block pointer array */
-
 struct pth_args {
    void* arg1;
    void* arg2;
@@ -135,6 +136,20 @@ char abswid[2] = {"AB"};
 int epoll_fd;
 struct epoll_event event, events[MAXCHAN*2];
 
+// Channel adapter state kept by SAVE, see i3705_snap.c.  The TCP
+// connections are not: the host reconnects after a restore.
+#define SNAP_IOB(n, f)  { "CA" #n "." #f, (void *) &ccu_ctl, offsetof(struct i3705, ca[(n) - 1].f), \
+                          sizeof(((struct IO3705 *) 0)->f), 1 }
+
+struct snapent CA_snap[] = {
+   SNAP (ccw), SNAP (csw),
+   SNAP_IOB (1, abswitch), SNAP_IOB (1, devnum), SNAP_IOB (1, buffer), SNAP_IOB (1, bufferl),
+   SNAP_IOB (1, chainbuf), SNAP_IOB (1, chainbl), SNAP_IOB (1, carnstat), SNAP_IOB (1, IPL_exception),
+   SNAP_IOB (2, abswitch), SNAP_IOB (2, devnum), SNAP_IOB (2, buffer), SNAP_IOB (2, bufferl),
+   SNAP_IOB (2, chainbuf), SNAP_IOB (2, chainbl), SNAP_IOB (2, carnstat), SNAP_IOB (2, IPL_exception),
+   { NULL }
+};
+
 // ************************************************************
 // Function to format and display incomming data from host
 // ************************************************************
@@ -412,7 +427,8 @@ void start_listen(struct IO3705 *iob, int abport) {
 // ************************************************************
 // Function for sending Attention interrupts to the host
 // ************************************************************
-void exec_attn() {
+void exec_attn(struct i3705 *ctl) {
+   struct IO3705 **iobs = ctl->iob;
    int rc, j;
    uint8_t carnstat;
    uint8_t ackbuf;
@@ -429,7 +445,8 @@ void exec_attn() {
    pthread_mutex_lock(&r77_lock);
    Eregs_Inp[0x77] |= iobs[j]->CA_mask;              // Set CA1 L3 Interrupt Request
    pthread_mutex_unlock(&r77_lock);
-   CA1_IS_req_L3 = ON;
+   IRQ_SET(IRQ_CAIS_L3);
+   ccu_wake();
    while (Ireg_bit(0x77, iobs[j]->CA_mask) == ON)
       wait();
    Eregs_Out[0x55] &= ~0x0200;                       // Reset attention request
@@ -450,7 +467,8 @@ void exec_attn() {
 // ************************************************************
 // Function for requisting a L3 int from the control program
 // ************************************************************
-void exec_pci() {
+void exec_pci(struct i3705 *ctl) {
+   struct IO3705 **iobs = ctl->iob;
    int j;
       // Determine which CA needs to react
       if (Eregs_Out[0x57] & 0x0008)
@@ -466,7 +484,8 @@ void exec_pci() {
       pthread_mutex_lock(&r77_lock);
       Eregs_Inp[0x77] |= iobs[j]->CA_mask;           // Set CA L3 interrupt request
       pthread_mutex_unlock(&r77_lock);
-      CA1_IS_req_L3 = ON;
+      IRQ_SET(IRQ_CAIS_L3);
+      ccu_wake();
       if ((Adbg_flag == ON) && (Adbg_reg & 0x01))    // Trace channel adapter activities ?
          fprintf(A_trace, "CA%c: Requested L3 interrupt\n\r", iobs[j]->CA_id);
       while (Ireg_bit(0x77, iobs[j]->CA_mask) == ON) wait();
@@ -499,6 +518,8 @@ void exec_diag() {
 // Channel adaptor type 2 thread
 // ********************************************************************
 void *CA_T2_thread(void *arg) {
+   struct i3705 *ctl = arg;                // Controller of these adapters
+   struct IO3705 **iobs = ctl->iob;        // IBM 3705 I/O Block pointer array
    int rc, sig, event_count;
    uint32_t CAx_tid[2];
    struct sockaddr_in address;
@@ -510,6 +531,7 @@ void *CA_T2_thread(void *arg) {
    } epoll_Data_t;
 
    printf("\nCA-T2: Main thread %ld started succesfully...\n", syscall(SYS_gettid));
+   ctl_thread(ctl, "CA");
 
    // ********************************************************************
    //  Channel Adapter debug trace facility
@@ -525,12 +547,8 @@ void *CA_T2_thread(void *arg) {
    pthread_t id1, id2, id3;
    args = malloc(sizeof(struct pth_args) * 1);
    /***************************************/
-   /* Allocate the CA IO Blocks           */
-   /***************************************/
-   for (int i = 0; i < MAXCHAN; i++)
-      iobs[i] = malloc(sizeof(struct IO3705) * 1);
-   /***************************************/
-   /* Initialize the CA IO Blocks         */
+   /* Initialize the CA IO Blocks, they   */
+   /* are in the controller context       */
    /***************************************/
    for (int i = 0; i < MAXCHAN; i++) {
       iobs[i]->CA_id = 0x31 + i;           // First channel id starts with 1
@@ -547,7 +565,7 @@ void *CA_T2_thread(void *arg) {
       return 0;
    }
 
-   rc = pthread_create(&id1, NULL, CAx_thread, NULL);
+   rc = pthread_create(&id1, NULL, CAx_thread, ctl);
    if (rc  != 0) {
       printf("\nCA_T2: Adapter thread creation failed with rc = %d \n\r", rc);
       return 0;
@@ -624,14 +642,16 @@ void *CA_T2_thread(void *arg) {
 /* Function to be run as a thread always must have the same
    signature: it has one void* parameter and returns void    */
 void *CAx_thread(void *arg) {
-
+   struct i3705 *ctl = arg;
+   struct IO3705 **iobs = ctl->iob;
    int  pendingrcv;
 
    printf("\nCA: Adapter thread %d started sucessfully... \n\r", getpid());
+   ctl_thread(ctl, "CAx");
 
    pthread_mutex_lock(&r77_lock);
-   CA1_DS_req_L3 = OFF;                    // Chan Adap Data/Status request flag
-   CA1_IS_req_L3 = OFF;                    // Chan Adap Initial Sel request flag
+   IRQ_CLR(IRQ_CADS_L3);                   // Chan Adap Data/Status request flag
+   IRQ_CLR(IRQ_CAIS_L3);                   // Chan Adap Initial Sel request flag
    Eregs_Inp[0x77] &= ~0x0028;             // Reset CA L3 interrupt
    pthread_mutex_unlock(&r77_lock);
    Eregs_Inp[0x55]  = 0x0000;              // Reset CA control register
@@ -643,6 +663,10 @@ void *CAx_thread(void *arg) {
 
    while(1) {
       // We do this for ever and ever...
+      if (rr_mode == RR_REPLAY) {                        // Channel events come from the log
+         usleep(1000);
+         continue;
+      }
       /***************************************************************/
       /*  Read channel command from host                             */
       /*                                                             */
@@ -653,11 +677,11 @@ void *CAx_thread(void *arg) {
       for (int j = 0; j < MAXCHAN; j++) {
          if (Eregs_Out[0x55] & 0x0200) {                 // ATTN request ?
             // Execute ATTN request
-            exec_attn();
+            exec_attn(ctl);
          }
          if (Eregs_Out[0x57] & 0x0080) {                 // PCI request ?
             // Execute pci request
-            exec_pci();
+            exec_pci(ctl);
          }
          if (iobs[j]->CA_active == TRUE) {
             pendingrcv = 0;
@@ -678,6 +702,7 @@ void exec_ccw(struct IO3705 *iob) {
    int cc = 0;
    int sockfc = -1;
    int bufbase, condition;
+   int direct;                                   // Cycle steal stores into M here
    int pendingrcv;
    pthread_t id;
    char carnstat, ackbuf;
@@ -793,7 +818,8 @@ void exec_ccw(struct IO3705 *iob) {
                      pthread_mutex_lock(&r77_lock);
                      Eregs_Inp[0x77] |= iob->CA_mask;    // Set CA1 L3 interrupt
                      pthread_mutex_unlock(&r77_lock);
-                     CA1_IS_req_L3 = ON;                 // Chan Adap Initial Sel request flag
+                     IRQ_SET(IRQ_CAIS_L3);               // Chan Adap Initial Sel request flag
+                     ccu_wake();                         // Wake CCU if in wait state
                      while (Ireg_bit(0x77, 0x008) == ON)
                         wait();                          // Wait for initial selection reset
                   }
@@ -816,7 +842,8 @@ void exec_ccw(struct IO3705 *iob) {
                pthread_mutex_lock(&r77_lock);
                Eregs_Inp[0x77] |= iob->CA_mask;          // Set CA1  L3 interrupt
                pthread_mutex_unlock(&r77_lock);
-               CA1_IS_req_L3 = ON;                       // Chan Adap Initial Sel request flag
+               IRQ_SET(IRQ_CAIS_L3);                     // Chan Adap Initial Sel request flag
+               ccu_wake();                               // Wake CCU if in wait state
                while (Ireg_bit(0x77, 0x008) == ON)
                   wait();                                // Wait for initial selection reset
             }
@@ -854,7 +881,7 @@ void exec_ccw(struct IO3705 *iob) {
                //pthread_mutex_lock(&r77_lock);
                //Eregs_Inp[0x77] |= iob->CA_mask;        // Set CA1 L3 interrupt request
                //pthread_mutex_unlock(&r77_lock);
-               //CA1_IS_req_L3 = ON;                     // Chan Adap L3 request flag
+               //IRQ_SET(IRQ_CAIS_L3);                   // Chan Adap L3 request flag
                //while (Ireg_bit(0x77, iob->CA_mask) == ON)
                //   wait();                              // Wait for L3 interrupt request reset
                print_regs(iob, "CCW 04 L3");
@@ -893,7 +920,8 @@ void exec_ccw(struct IO3705 *iob) {
                   pthread_mutex_lock(&r77_lock);
                   Eregs_Inp[0x77] |= iob->CA_mask;       // Set CA1 L3 interrupt request
                   pthread_mutex_unlock(&r77_lock);
-                  CA1_IS_req_L3 = ON;
+                  IRQ_SET(IRQ_CAIS_L3);
+                  ccu_wake();
                   break;
                case 0x09:
                   Eregs_Inp[0x55] |= 0x0100;             // Set Channel Active
@@ -976,11 +1004,17 @@ void exec_ccw(struct IO3705 *iob) {
                   if ((Adbg_flag == ON) && (Adbg_reg & 0x01))   // Trace channel adapter activities ?
                      fprintf(A_trace, "(1) wdcnttmp=%d, wdcnt=%d, iob->bufferl=%d\n\r", wdcnttmp, wdcnt, iob->bufferl);
 
+                  direct = (rr_mode != RR_REPLAY);       // Replaying: the data comes from the log
+                  if (rr_mode == RR_RECORD)              // Recording: wait till the CCU stored it
+                     direct = !rr_store(cacw2, &iob->chainbuf[bufbase], wdcnttmp);
                   for (i = 0; i < wdcnttmp; i++) {
-                     M[cacw2 + i] = iob->chainbuf[bufbase + i];  // Load data directly into memory
+                     if (direct)
+                        M[cacw2 + i] = iob->chainbuf[bufbase + i];  // Load data directly into memory
                      Eregs_Inp[0x59] = Eregs_Inp[0x59] + 1;  // Increment cycle steal counter
                      wdcnt = wdcnt - 1;                      // Decrement byte counter
                   }  // End For
+                  if (direct)
+                     pdc_post(cacw2, wdcnttmp);          // CCU drops predecoded instrs in loaded area
                   iob->bufferl = iob->bufferl - wdcnttmp;
                   bufbase = bufbase + i;                 // Buffer base points to start of remaing data
                   if ((cacw1 & 0x8000) && wdcnt == 0) {  // If IN and count zero
@@ -990,7 +1024,8 @@ void exec_ccw(struct IO3705 *iob) {
                         pthread_mutex_lock(&r77_lock);
                         Eregs_Inp[0x77] |= iob->CA_mask; // Set CA1 L3 interrupt request
                         pthread_mutex_unlock(&r77_lock);
-                        CA1_IS_req_L3 = ON;              // Chan Adap L3 request flag
+                        IRQ_SET(IRQ_CAIS_L3);            // Chan Adap L3 request flag
+                        ccu_wake();                      // Wake CCU if in wait state
                         while (Ireg_bit(0x77, iob->CA_mask) == ON)
                            wait();
                      } // End Zero override on
@@ -1039,7 +1074,8 @@ void exec_ccw(struct IO3705 *iob) {
             pthread_mutex_lock(&r77_lock);
             Eregs_Inp[0x77] |= iob->CA_mask;             // Set CA1 L3 interrupt request
             pthread_mutex_unlock(&r77_lock);
-            CA1_IS_req_L3 = ON;
+            IRQ_SET(IRQ_CAIS_L3);
+            ccu_wake();
             while (Ireg_bit(0x77, iob->CA_mask) == ON)
                wait();                                   // Wait for CA1 L3 Request reset
             print_regs(iob, "CCW 05, 09, 01 Post");
@@ -1070,7 +1106,8 @@ void exec_ccw(struct IO3705 *iob) {
             pthread_mutex_lock(&r77_lock);
             Eregs_Inp[0x77] |= iob->CA_mask;             // Set CA1 L3 interrupt request
             pthread_mutex_unlock(&r77_lock);
-            CA1_IS_req_L3 = ON;                          // Chan Adap L3 interrupt request flag
+            IRQ_SET(IRQ_CAIS_L3);                        // Chan Adap L3 interrupt request flag
+            ccu_wake();                                  // Wake CCU if in wait state
             while (Ireg_bit(0x77, iob->CA_mask) == ON)
                wait();                                   // Wait for L3 iterrupt request reset
             print_regs(iob, "CCW's 31, 32, etc");
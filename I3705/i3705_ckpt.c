@@ -0,0 +1,488 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_ckpt.c: IBM 3705 incremental checkpoints
+
+        CKPT START file {sec}   write a base image now and a delta of the
+                                changed storage pages every sec (10)
+        CKPT STOP               write a last delta and close the file
+        CKPT LOAD file {seq}    replay the base and the deltas up to seq
+        CKPT LIST file          list the records in file
+        SHOW CPU CKPT           records, sizes and checkpoint pauses
+
+   PutMem(), deposits, the loader and channel adapter cycle steal mark
+   the 1K storage pages they change in ckpt_dirty[].  A checkpoint is
+   taken by an event on the SCP clock queue, so the CCU is between
+   instrs: it clears the marks of the dirty pages, copies those pages
+   and the state variables of i3705_snap.c into a buffer and hands the
+   buffer to a writer thread.  That copy is the only pause of the CCU,
+   it does no file I/O and no more than MEMSIZE bytes of storage, and
+   its time is reported against a budget of CKPT_BUDGET.  While the
+   writer is still busy a checkpoint is skipped and the pages stay
+   marked for the next one.  A store by an adapter thread during the
+   copy marks its page again.
+
+   Each record is a header, the pages as page number and data, the
+   state and a trailer.  Record 0 is the base image with all pages.
+   LOAD applies the pages of every record in turn and the state of the
+   last one; a record cut short by a crash is ignored.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#define CKPT_MAGIC      "CKPT"
+#define CKPT_TMAGIC     "CEND"
+#define CKPT_PSIZE      (1 << CKPT_PSHIFT)
+#define CKPT_SLICE      100000                 /* Instrs between clock checks */
+#define CKPT_BUDGET     1000000                /* Pause budget, nsec */
+
+struct ckpthdr {
+   char     magic[4];
+   uint32   seq;                               /* 0 is the base image */
+   uint32   npages;
+   uint32   pshift;
+   uint32   memsize;
+   uint32   stlen;                             /* State bytes */
+   uint32   nitems;                            /* State variables */
+   uint32   spare;
+   double   simtime;                           /* sim_gtime() */
+   t_uint64 wall;                              /* Host time, nsec since 1970 */
+};
+
+struct ckpttrl {
+   char     magic[4];
+   uint32   seq;
+};
+
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern uint32 snap_put(uint8 *buf, uint32 *nitems);
+extern int32 snap_get(uint8 *buf, uint32 buflen, uint32 nitems, const char *who);
+extern void snap_fixup(void);
+
+extern UNIT evt_unit[];
+
+uint8 ckpt_dirty[CKPT_PAGES];                  /* Changed since the last checkpoint */
+
+static FILE *ckpt_file = NULL;
+static char ckpt_fname[CBUFSIZE];
+static t_uint64 ckpt_iv, ckpt_tl;              /* Interval, last checkpoint, nsec */
+static uint32 ckpt_seq;
+static uint8 *ckpt_buf = NULL;
+static uint32 ckpt_bufsz = 0;
+
+/* Writer thread, owns ckpt_buf while ckpt_wlen is not 0 */
+static pthread_t ckpt_tid;
+static int32 ckpt_thread = 0;
+static pthread_mutex_t ckpt_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ckpt_go = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ckpt_done = PTHREAD_COND_INITIALIZER;
+static uint32 ckpt_wlen = 0;
+static int32 ckpt_werr = 0;
+
+/* Statistics */
+static uint32 ckpt_base_pg, ckpt_base_len;
+static t_uint64 ckpt_base_ns;
+static t_uint64 ckpt_n, ckpt_skip, ckpt_over, ckpt_pages, ckpt_bytes;
+static t_uint64 ckpt_p_min, ckpt_p_max, ckpt_p_sum, ckpt_p_last;
+static t_uint64 ckpt_w_max, ckpt_w_sum, ckpt_nw;
+
+static void *ckpt_writer(void *arg) {
+   t_uint64 t0, t;
+   uint32 len;
+
+   pthread_mutex_lock(&ckpt_lock);
+   for (;;) {
+      while (ckpt_wlen == 0)
+         pthread_cond_wait(&ckpt_go, &ckpt_lock);
+      len = ckpt_wlen;
+      pthread_mutex_unlock(&ckpt_lock);
+      t0 = ccu_clock_ns(CLOCK_MONOTONIC);
+      if ((fwrite(ckpt_buf, 1, len, ckpt_file) != len) || (fflush(ckpt_file) != 0))
+         ckpt_werr = 1;
+      t = ccu_clock_ns(CLOCK_MONOTONIC) - t0;
+      pthread_mutex_lock(&ckpt_lock);
+      if (t > ckpt_w_max)
+         ckpt_w_max = t;
+      ckpt_w_sum += t;
+      ckpt_nw++;
+      ckpt_bytes += len;
+      ckpt_wlen = 0;
+      pthread_cond_signal(&ckpt_done);
+   }
+   return NULL;
+}
+
+static void ckpt_wait(void) {                  /* Until the writer is idle */
+   pthread_mutex_lock(&ckpt_lock);
+   while (ckpt_wlen != 0)
+      pthread_cond_wait(&ckpt_done, &ckpt_lock);
+   pthread_mutex_unlock(&ckpt_lock);
+}
+
+/* Build record ckpt_seq in ckpt_buf from the dirty pages, or from all
+   pages.  Returns its length, 0 if out of memory. */
+
+static uint32 ckpt_fill(int32 all) {
+   struct ckpthdr h;
+   struct ckpttrl t;
+   uint32 npg = MEMSIZE >> CKPT_PSHIFT, need, len, pg, i;
+   uint8 *p;
+
+   memset(&h, 0, sizeof(h));
+   h.stlen = snap_put(NULL, &h.nitems);
+   need = sizeof(h) + npg * (sizeof(uint32) + CKPT_PSIZE) + h.stlen + sizeof(t);
+   if (need > ckpt_bufsz) {                    /* Only when an adapter starts */
+      if ((p = realloc(ckpt_buf, need)) == NULL)
+         return 0;
+      ckpt_buf = p;
+      ckpt_bufsz = need;
+   }
+   p = ckpt_buf + sizeof(h);
+   for (pg = 0; pg < npg; pg++) {              /* Clear the marks first */
+      if (!all && !ckpt_dirty[pg])
+         continue;
+      ckpt_dirty[pg] = 0;
+      memcpy(p, &pg, sizeof(pg));
+      p += sizeof(pg) + CKPT_PSIZE;
+      h.npages++;
+   }
+   __sync_synchronize();                       /* Then read the pages */
+   p = ckpt_buf + sizeof(h);
+   for (i = 0; i < h.npages; i++) {
+      memcpy(&pg, p, sizeof(pg));
+      memcpy(p + sizeof(pg), &M[pg << CKPT_PSHIFT], CKPT_PSIZE);
+      p += sizeof(pg) + CKPT_PSIZE;
+   }
+   snap_put(p, &h.nitems);
+   p += h.stlen;
+   memcpy(h.magic, CKPT_MAGIC, sizeof(h.magic));
+   h.seq = ckpt_seq;
+   h.pshift = CKPT_PSHIFT;
+   h.memsize = MEMSIZE;
+   h.simtime = sim_gtime();
+   h.wall = ccu_clock_ns(CLOCK_REALTIME);
+   memcpy(ckpt_buf, &h, sizeof(h));
+   memcpy(t.magic, CKPT_TMAGIC, sizeof(t.magic));
+   t.seq = ckpt_seq;
+   memcpy(p, &t, sizeof(t));
+   len = p + sizeof(t) - ckpt_buf;
+   ckpt_pages += h.npages;
+   return len;
+}
+
+/* Take a delta checkpoint, the CCU waits for the copy only */
+
+static void ckpt_take(void) {
+   t_uint64 t0 = ccu_clock_ns(CLOCK_MONOTONIC), t;
+   uint32 len;
+
+   pthread_mutex_lock(&ckpt_lock);
+   len = ckpt_wlen;
+   pthread_mutex_unlock(&ckpt_lock);
+   if (len != 0) {                             /* Writer behind, try again later */
+      ckpt_skip++;
+      return;
+   }
+   if ((len = ckpt_fill(0)) == 0)
+      return;
+   ckpt_seq++;
+   ckpt_n++;
+   ckpt_tl = ccu_clock_ns(CLOCK_MONOTONIC);
+   t = ckpt_tl - t0;
+   if ((ckpt_n == 1) || (t < ckpt_p_min))
+      ckpt_p_min = t;
+   if (t > ckpt_p_max)
+      ckpt_p_max = t;
+   if (t > CKPT_BUDGET)
+      ckpt_over++;
+   ckpt_p_sum += t;
+   ckpt_p_last = t;
+   pthread_mutex_lock(&ckpt_lock);
+   ckpt_wlen = len;
+   pthread_cond_signal(&ckpt_go);
+   pthread_mutex_unlock(&ckpt_lock);
+}
+
+t_stat ckpt_svc(UNIT *uptr) {
+   if (ckpt_file == NULL)
+      return SCPE_OK;
+   if (ccu_clock_ns(CLOCK_MONOTONIC) - ckpt_tl >= ckpt_iv)
+      ckpt_take();
+   sim_activate(uptr, CKPT_SLICE);
+   return SCPE_OK;
+}
+
+/* Called at sim_instr entry */
+
+void ckpt_start(void) {
+   if ((ckpt_file != NULL) && !sim_is_active(&evt_unit[EVT_CKPT]))
+      sim_activate(&evt_unit[EVT_CKPT], CKPT_SLICE);
+}
+
+static t_stat ckpt_stop(void) {
+   uint32 len;
+   t_stat r = SCPE_OK;
+
+   if (ckpt_file == NULL)
+      return SCPE_OK;
+   sim_cancel(&evt_unit[EVT_CKPT]);
+   ckpt_wait();
+   if ((len = ckpt_fill(0)) != 0) {            /* Up to where the CCU stopped */
+      if (fwrite(ckpt_buf, 1, len, ckpt_file) != len)
+         ckpt_werr = 1;
+      ckpt_bytes += len;
+      ckpt_seq++;
+      ckpt_n++;
+   }
+   if ((fclose(ckpt_file) != 0) || ckpt_werr)
+      r = SCPE_IOERR;
+   ckpt_file = NULL;
+   return r;
+}
+
+static void ckpt_atexit(void) {
+   ckpt_stop();
+}
+
+/* Read the rest of the record after h into *buf, 0 if cut short */
+
+static int32 ckpt_read(FILE *f, struct ckpthdr *h, uint8 **buf, uint32 *bufsz) {
+   struct ckpttrl t;
+   uint32 len;
+   uint8 *p;
+
+   if ((h->pshift < 8) || (h->pshift > 16) || (h->npages > (h->memsize >> h->pshift)))
+      return 0;
+   len = h->npages * (sizeof(uint32) + (1 << h->pshift)) + h->stlen;
+   if (len > *bufsz) {
+      if ((p = realloc(*buf, len)) == NULL)
+         return 0;
+      *buf = p;
+      *bufsz = len;
+   }
+   if ((fread(*buf, 1, len, f) != len) || (fread(&t, sizeof(t), 1, f) != 1) ||
+       (memcmp(t.magic, CKPT_TMAGIC, sizeof(t.magic)) != 0) || (t.seq != h->seq))
+      return 0;
+   return 1;
+}
+
+/* CKPT LOAD file {seq} */
+
+static t_stat ckpt_load(char *fname, uint32 last) {
+   struct ckpthdr h, hl;
+   t_uint64 t0 = ccu_clock_ns(CLOCK_MONOTONIC), pages = 0;
+   uint8 *buf = NULL, *st = NULL, *p;
+   uint32 bufsz = 0, stsz = 0, n = 0, i, pg, psz;
+   int32 skip, cut = 0;
+   FILE *f;
+
+   if ((f = fopen(fname, "rb")) == NULL)
+      return SCPE_OPENERR;
+   while (fread(&h, sizeof(h), 1, f) == 1) {
+      if ((memcmp(h.magic, CKPT_MAGIC, sizeof(h.magic)) != 0) || (h.seq != n)) {
+         cut = 1;
+         break;
+      }
+      if (h.memsize != MEMSIZE) {
+         printf("CKPT: checkpoints of %uK storage, CPU has %uK\n",
+                h.memsize / 1024, MEMSIZE / 1024);
+         fclose(f);
+         free(buf);
+         return SCPE_INCOMP;
+      }
+      if (!ckpt_read(f, &h, &buf, &bufsz)) {
+         cut = 1;
+         break;
+      }
+      psz = 1 << h.pshift;
+      for (i = 0, p = buf; i < h.npages; i++, p += sizeof(pg) + psz) {
+         memcpy(&pg, p, sizeof(pg));
+         if ((pg + 1) * psz <= MEMSIZE)
+            memcpy(&M[pg * psz], p + sizeof(pg), psz);
+      }
+      pages += h.npages;
+      p = st;                                  /* Keep the last state */
+      st = buf;
+      buf = p;
+      i = stsz;
+      stsz = bufsz;
+      bufsz = i;
+      hl = h;
+      n++;
+      if (h.seq == last)
+         break;
+   }
+   fclose(f);
+   free(buf);
+   if (n == 0) {
+      printf("CKPT: %s has no base image\n", fname);
+      return SCPE_FMT;
+   }
+   skip = snap_get(st + hl.npages * (sizeof(uint32) + (1 << hl.pshift)), hl.stlen,
+                   hl.nitems, "CKPT");
+   free(st);
+   if (skip < 0)
+      return SCPE_IOERR;
+   snap_fixup();
+   printf("CKPT: base and %u deltas to seq %u, sim time %.0f, %" LL_FMT "u pages in %.1f msec",
+          n - 1, hl.seq, hl.simtime, pages, (ccu_clock_ns(CLOCK_MONOTONIC) - t0) / 1e6);
+   if (skip)
+      printf(", %d items skipped", skip);
+   if (cut && (hl.seq != last))
+      printf(", record %u incomplete", n);
+   printf("\n");
+   return SCPE_OK;
+}
+
+/* CKPT LIST file */
+
+static t_stat ckpt_list(char *fname) {
+   struct ckpthdr h;
+   uint8 *buf = NULL;
+   uint32 bufsz = 0, n = 0;
+   time_t tt;
+   char tbuf[32];
+   FILE *f;
+
+   if ((f = fopen(fname, "rb")) == NULL)
+      return SCPE_OPENERR;
+   printf("  seq  type   pages  state       sim time  written\n");
+   while (fread(&h, sizeof(h), 1, f) == 1) {
+      if ((memcmp(h.magic, CKPT_MAGIC, sizeof(h.magic)) != 0) || (h.seq != n) ||
+          !ckpt_read(f, &h, &buf, &bufsz)) {
+         printf("record %u incomplete\n", n);
+         break;
+      }
+      tt = h.wall / 1000000000;
+      strftime(tbuf, sizeof(tbuf), "%Y-%m-%d %H:%M:%S", localtime(&tt));
+      printf("%5u  %s %7u %6u %14.0f  %s.%03u\n", h.seq, h.seq ? "delta" : "base ",
+             h.npages, h.stlen, h.simtime, tbuf, (uint32) (h.wall / 1000000 % 1000));
+      n++;
+   }
+   fclose(f);
+   free(buf);
+   return SCPE_OK;
+}
+
+/* CKPT START file {sec}, STOP, LOAD file {seq}, LIST file */
+
+t_stat ckpt_cmd(int32 flag, char *cptr) {
+   static int32 registered = 0;
+   char gbuf[CBUFSIZE], fbuf[CBUFSIZE];
+   uint32 len, v = 10;
+   t_stat r;
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "STOP") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      return ckpt_stop();
+   }
+   cptr = get_glyph_nc(cptr, fbuf, 0);
+   if (fbuf[0] == 0)
+      return SCPE_ARG;
+   if (strcmp(gbuf, "LIST") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      return ckpt_list(fbuf);
+   }
+   if (*cptr != 0) {
+      v = (uint32) get_uint(cptr, 10, 0xFFFFFFFF, &r);
+      if (r != SCPE_OK)
+         return SCPE_ARG;
+   }
+   if (strcmp(gbuf, "LOAD") == 0)
+      return ckpt_load(fbuf, (cptr[0] != 0) ? v : 0xFFFFFFFF);
+   if ((strcmp(gbuf, "START") != 0) || (v == 0) || (v > 86400))
+      return SCPE_ARG;
+   ckpt_stop();
+   if ((ckpt_file = fopen(fbuf, "wb")) == NULL)
+      return SCPE_OPENERR;
+   if (!ckpt_thread) {
+      if (pthread_create(&ckpt_tid, NULL, &ckpt_writer, NULL) != 0) {
+         fclose(ckpt_file);
+         ckpt_file = NULL;
+         return SCPE_IERR;
+      }
+      pthread_detach(ckpt_tid);
+      ckpt_thread = 1;
+   }
+   strcpy(ckpt_fname, fbuf);
+   ckpt_iv = (t_uint64) v * 1000000000;
+   ckpt_seq = 0;
+   ckpt_werr = 0;
+   ckpt_n = ckpt_skip = ckpt_over = ckpt_pages = ckpt_bytes = 0;
+   ckpt_p_min = ckpt_p_max = ckpt_p_sum = ckpt_p_last = 0;
+   ckpt_w_max = ckpt_w_sum = ckpt_nw = 0;
+   ckpt_base_ns = ccu_clock_ns(CLOCK_MONOTONIC);
+   if ((len = ckpt_fill(1)) == 0) {            /* Base image, CCU is stopped */
+      fclose(ckpt_file);
+      ckpt_file = NULL;
+      return SCPE_MEM;
+   }
+   if (fwrite(ckpt_buf, 1, len, ckpt_file) != len) {
+      fclose(ckpt_file);
+      ckpt_file = NULL;
+      return SCPE_IOERR;
+   }
+   fflush(ckpt_file);
+   ckpt_base_pg = MEMSIZE >> CKPT_PSHIFT;
+   ckpt_base_len = len;
+   ckpt_tl = ccu_clock_ns(CLOCK_MONOTONIC);
+   ckpt_base_ns = ckpt_tl - ckpt_base_ns;
+   ckpt_pages = 0;
+   ckpt_bytes = len;
+   ckpt_seq = 1;
+   if (!registered)
+      registered = (atexit(&ckpt_atexit) == 0);
+   return SCPE_OK;
+}
+
+/* SHOW CPU CKPT */
+
+t_stat ckpt_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   if (ckpt_file == NULL) {
+      fprintf(st, "checkpoints off\n");
+      return SCPE_OK;
+   }
+   pthread_mutex_lock(&ckpt_lock);
+   fprintf(st, "checkpoints to %s every %" LL_FMT "u sec, next seq %u, %" LL_FMT "u bytes written\n",
+           ckpt_fname, ckpt_iv / 1000000000, ckpt_seq, ckpt_bytes);
+   fprintf(st, "   base %u pages, %u bytes in %.1f msec\n", ckpt_base_pg, ckpt_base_len,
+           ckpt_base_ns / 1e6);
+   fprintf(st, "   %" LL_FMT "u deltas", ckpt_n);
+   if (ckpt_n)
+      fprintf(st, ", %.1f pages avg", (double) ckpt_pages / ckpt_n);
+   fprintf(st, ", %" LL_FMT "u skipped with the writer busy\n", ckpt_skip);
+   if (ckpt_n)
+      fprintf(st, "   pause min %.1f avg %.1f max %.1f last %.1f usec, %" LL_FMT "u over %u usec\n",
+              ckpt_p_min / 1e3, ckpt_p_sum / 1e3 / ckpt_n, ckpt_p_max / 1e3,
+              ckpt_p_last / 1e3, ckpt_over, CKPT_BUDGET / 1000);
+   if (ckpt_nw)
+      fprintf(st, "   writer avg %.2f max %.2f msec%s\n", ckpt_w_sum / 1e6 / ckpt_nw,
+              ckpt_w_max / 1e6, ckpt_werr ? ", write error" : "");
+   pthread_mutex_unlock(&ckpt_lock);
+   return SCPE_OK;
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_cov.c: IBM 3705 CCU instruction coverage
+
+   The coverage bitmap has one bit per storage halfword and is set on
+   every instr fetch, by the interpreter, the threaded dispatch and the
+   block translator alike, with a single OR into a 16 KB array
+   (COV_MARK).  It is cleared only by COVERAGE CLEAR, so it collects
+   over IPLs and runs.
+
+        SHOW CPU COVERAGE       halfwords executed
+        COVERAGE SAVE file      write the bitmap now
+        COVERAGE EXIT file      write the bitmap when the simulator exits
+        COVERAGE CLEAR          clear the bitmap
+
+   A coverage file is "I3705COV", uint32 version 1 and uint32 number of
+   halfwords (host byte order), then the bitmap: bit n (LSB first) of
+   byte b is the halfword at 16 * b + 2 * n.  i3705cov merges files.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+
+extern UNIT cpu_unit;
+
+uint8 cov_map[COV_BYTES];                      /* Executed halfwords, 1 bit each */
+static char cov_exit_file[CBUFSIZE];           /* COVERAGE EXIT file name */
+
+/* Write the coverage bitmap of the current storage size */
+
+static t_stat cov_save(char *fname) {
+   static const char magic[8] = { 'I', '3', '7', '0', '5', 'C', 'O', 'V' };
+   uint32 hdr[2] = { 1, MEMSIZE / 2 };
+   FILE *f;
+
+   if ((f = fopen(fname, "wb")) == NULL)
+      return SCPE_OPENERR;
+   fwrite(magic, 1, sizeof(magic), f);
+   fwrite(hdr, sizeof(uint32), 2, f);
+   fwrite(cov_map, 1, MEMSIZE / 16, f);
+   if (fclose(f) != 0)
+      return SCPE_IOERR;
+   return SCPE_OK;
+}
+
+static void cov_atexit(void) {
+   if (cov_exit_file[0] != 0)
+      cov_save(cov_exit_file);
+}
+
+/* COVERAGE SAVE file | EXIT file | CLEAR */
+
+t_stat cov_cmd(int32 flag, char *cptr) {
+   static int32 registered = 0;
+   char gbuf[CBUFSIZE], fbuf[CBUFSIZE];
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "CLEAR") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      memset(cov_map, 0, sizeof(cov_map));
+      return SCPE_OK;
+   }
+   cptr = get_glyph_nc(cptr, fbuf, 0);
+   if ((fbuf[0] == 0) || (*cptr != 0))
+      return SCPE_ARG;
+   if (strcmp(gbuf, "SAVE") == 0)
+      return cov_save(fbuf);
+   if (strcmp(gbuf, "EXIT") == 0) {
+      strcpy(cov_exit_file, fbuf);
+      if (!registered)
+         registered = (atexit(&cov_atexit) == 0);
+      return SCPE_OK;
+   }
+   return SCPE_ARG;
+}
+
+/* SHOW CPU COVERAGE */
+
+t_stat cov_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   uint32 i, n = 0, hw = MEMSIZE / 2;
+
+   for (i = 0; i < MEMSIZE / 16; i++)
+      n += __builtin_popcount(cov_map[i]);
+   fprintf(st, "coverage: %u of %u halfwords executed (%.2f%%)", n, hw, 100.0 * n / hw);
+   if (cov_exit_file[0] != 0)
+      fprintf(st, ", saved to %s at exit", cov_exit_file);
+   fprintf(st, "\n");
+   return SCPE_OK;
+}
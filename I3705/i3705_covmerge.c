@@ -0,0 +1,101 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_covmerge.c: merge IBM 3705 coverage files (make i3705cov)
+
+        i3705cov [-r] out.cov in.cov ...
+
+   ORs the bitmaps of all input files (written by COVERAGE SAVE or
+   COVERAGE EXIT) into out.cov, which gets the size of the largest
+   input, and prints the number of executed halfwords.  -r also lists
+   the executed address ranges.  The output may be one of the inputs.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define MAXHW   (262144 / 2)                   /* halfwords of 256K storage */
+
+static const char magic[8] = { 'I', '3', '7', '0', '5', 'C', 'O', 'V' };
+static uint8_t map[MAXHW / 8], in[MAXHW / 8];
+
+int main(int argc, char *argv[]) {
+   uint32_t hdr[2], nhw = 0, i, n = 0, lo;
+   int ranges = 0, a = 1;
+   char m[8];
+   FILE *f;
+
+   if ((argc > 1) && (strcmp(argv[1], "-r") == 0)) {
+      ranges = 1;
+      a++;
+   }
+   if (argc - a < 2) {
+      fprintf(stderr, "usage: i3705cov [-r] out.cov in.cov ...\n");
+      return 1;
+   }
+   for (int k = a + 1; k < argc; k++) {
+      if ((f = fopen(argv[k], "rb")) == NULL) {
+         perror(argv[k]);
+         return 1;
+      }
+      if ((fread(m, 1, 8, f) != 8) || (memcmp(m, magic, 8) != 0) ||
+          (fread(hdr, sizeof(uint32_t), 2, f) != 2) || (hdr[0] != 1) ||
+          (hdr[1] > MAXHW) || (hdr[1] % 8) ||
+          (fread(in, 1, hdr[1] / 8, f) != hdr[1] / 8)) {
+         fprintf(stderr, "%s: not a 3705 coverage file\n", argv[k]);
+         fclose(f);
+         return 1;
+      }
+      fclose(f);
+      for (i = 0; i < hdr[1] / 8; i++)
+         map[i] |= in[i];
+      if (hdr[1] > nhw)
+         nhw = hdr[1];
+   }
+
+   if ((f = fopen(argv[a], "wb")) == NULL) {
+      perror(argv[a]);
+      return 1;
+   }
+   hdr[0] = 1;
+   hdr[1] = nhw;
+   fwrite(magic, 1, 8, f);
+   fwrite(hdr, sizeof(uint32_t), 2, f);
+   fwrite(map, 1, nhw / 8, f);
+   if (fclose(f) != 0) {
+      perror(argv[a]);
+      return 1;
+   }
+
+   for (i = 0; i < nhw; i++) {
+      if (!(map[i >> 3] & (1 << (i & 7))))
+         continue;
+      for (lo = i; (i + 1 < nhw) && (map[(i + 1) >> 3] & (1 << ((i + 1) & 7))); i++)
+         ;
+      n += i - lo + 1;
+      if (ranges)
+         printf("%05X-%05X\n", lo * 2, i * 2 + 1);
+   }
+   printf("%u of %u halfwords executed (%.2f%%)\n", n, nhw, nhw ? 100.0 * n / nhw : 0.0);
+   return 0;
+}
@@ -155,33 +155,134 @@
 #include "i3705_defs.h"
 #include "i3705_Eregs.h"                                /* Exernal regs defs */
 #include <pthread.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <signal.h>
 
 #define UNIT_V_MSIZE (UNIT_V_UF+3)                      /* dummy mask */
 #define UNIT_MSIZE   (1 << UNIT_V_MSIZE)
 
-extern void Get_ICW(int abar);                          /* CS2: ICW ===> Inp_Eregs 44, 45, 46, 47 rtn */
-extern int8 icw_scf[];                                  /* CS2: sdf */
-extern int8 icw_pdf[];                                  /* CS2: pdf */
-extern int8 icw_lcd[];                                  /* CS2: lcd */
-extern int8 icw_pcf[];                                  /* CS2: pcf */
-extern int8 icw_sdf[];                                  /* CS2: sdf */
-extern int8 icw_Rflags[];                               /* CS2: Rflags */
-extern int8 icw_pdf_reg[];                              /* CS2: pdf is filled or empty state */
-extern int8 icw_pcf_nxt[];                              /* CS2: new pdf */
 extern int8 shwpanel;                                   /* Show Front Panel */
 extern uint16_t Sdbg_reg;                               /* SCANNER debug flags register */
 extern uint16_t Adbg_reg;                               /* Channel Adapter debug flags register */
-extern struct IO3705*  iobs[MAXCHAN];                   /* IBM 3705 I/O Block pointer array */
-extern int abar;                                        /* Attachment Buffer Addr Reg (020-1FF) to CS2 */
-extern int abar_int;                                    /* ABAR of line interrupt (020-1FF) from CS2   */
+extern struct opdec op_dec[];                           /* Decoded opcode table */
+extern struct pdent pdc[];                              /* Predecode cache */
+extern t_uint64 pdc_hits, pdc_miss;                     /* Predecode cache counters */
+extern void pdc_load(struct pdent *pd, int32 addr);
+extern void pdc_inval(int32 addr, int32 len);
+extern void pdc_sync(void);
+extern volatile int32 pdc_posted;                       /* Cycle steal range to drop */
+extern void pdc_flush(void);
+extern t_stat pdc_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 jit_mode;                                  /* Block translator mode */
+extern int32 jit_logging;                               /* Log stores for JIT check */
+extern uint8 jit_cmap[];                                /* Translated code halfwords */
+extern uint32 jit_pgen[];                               /* Translated code page generations */
+extern int32 jit_step(void);
+extern void jit_flush(void);
+extern void jit_check_pass(void);
+extern void jit_log_store(int32 addr);
+extern t_stat jit_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat jit_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern t_uint64 ereg_nin[], ereg_nout[];                /* IN, OUT count per register */
+extern int32 ereg_in(int32 e);
+extern t_stat ereg_out(int32 e, int32 data);
+extern void ereg_reset(void);
+extern t_stat ereg_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 prof_on;                                   /* Profiler counting */
+extern t_uint64 prof_op[], prof_lvl_n[];                /* Profiler counts */
+extern t_uint64 prof_pc[];
+extern uint8 cov_map[];                                 /* Executed halfwords */
+extern t_stat cov_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern void prof_mark(int32 bucket);
+extern t_uint64 prof_now(void);
+extern uint32 snap_put(uint8 *buf, uint32 *nitems);
+extern int32 snap_get(uint8 *buf, uint32 buflen, uint32 nitems, const char *who);
+extern void snap_fixup(void);
+extern int32 lz_k, lz_v;                               /* Lazy latches */
+extern void cl_latch(void);
+extern t_stat prof_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat prof_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 trc_on;                                    /* Trace recording */
+extern struct trcent *trc_buf;                          /* Trace ring */
+extern uint32 trc_mask;
+extern t_uint64 trc_pos;
+extern int32 trc_trig_iar, trc_trig_lvl;
+extern void trc_fire(struct trcent *e);
+extern t_stat trc_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat trc_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 btr_on;                                    /* Branch trace recording */
+extern int32 btr_next, btr_last, btr_lvl;
+extern uint32 btr_n;
+extern void btr_rec(int32 pc);
+extern t_stat btr_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern void wp_fault(int32 off, void *ctx);
+extern t_stat wp_service(void);
+extern void wp_arm(void);
+extern t_stat wp_disarm(void);
+extern t_stat wp_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern uint8 brk_map[];                                 /* Breakpoint halfwords */
+extern void brk_sync(int32 start);
+extern t_stat brk_hit(int32 pc);
+extern t_stat brk_svc(UNIT *uptr);
+extern t_stat brk_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern t_stat brk_zero(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern int32 tmr_mode;                                  /* Interval timer timebase */
+extern t_stat tmr_svc(UNIT *uptr);
+extern void tmr_reset(void);
+extern t_stat tmr_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat tmr_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 idle_on;                                   /* Idle loop detection */
+extern volatile int32 idle_pend;
+extern void idle_branch(void);
+extern void idle_park(void);
+extern t_stat idle_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat idle_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern void gov_start(void);                            /* Speed throttle */
+extern t_stat gov_svc(UNIT *uptr);
+extern t_stat gov_set(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat gov_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern uint8 cu_cost[];                                 /* Utilisation accounting */
+extern t_uint64 cu_cyc[], cu_ins[], cu_vwait;
+extern void cu_run(int32 on);
+extern pthread_mutex_t cu_lock;
+extern t_stat cu_zero(UNIT *uptr, int32 val, char *cptr, void *desc);
+extern t_stat cu_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern uint8 ckpt_dirty[];                              /* Incremental checkpoints */
+extern void ckpt_start(void);
+extern t_stat snap_dep(t_addr addr, int32 data);
+extern t_stat ckpt_svc(UNIT *uptr);
+extern t_stat ckpt_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+extern int32 rr_mode;                                   /* Record and replay */
+extern t_stat rr_svc(UNIT *uptr);
+extern void rr_sample(void);
+extern t_stat rr_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat run_svc(UNIT *uptr);
+extern t_stat ctl_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat ccu_wait_show(FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat lvl_show(FILE *st, UNIT *uptr, int32 val, void *desc);
 pthread_mutex_t r77_lock;                               /* CA2/CS2: Reg77 update lock */
-pthread_mutex_t r7f_lock;                               /* CCU: Reg7F update lock */
-
-uint8 M[MAXMEMSIZE] = { 0 };                            /* Memory 3705 */
+pthread_mutex_t r7f_lock = PTHREAD_MUTEX_INITIALIZER;   /* CCU: Reg7F update lock */
+
+uint8 *M = NULL;                                        /* Memory 3705, see mem_init */
+volatile int32 mem_fault_addr = -1;                     /* Last addr beyond MEMSIZE, -1 none */
+volatile int32 mem_pend = 0;                            /* Guard or watchpoint fault to service */
+uint32 mem_nchg = 0;                                    /* Stores that changed storage */
+t_uint64 mem_faults = 0;                                /* Accesses caught beyond MEMSIZE */
+static long mem_pgsz;                                   /* Host page size */
+static int32 mem_open_lo, mem_open_hi;                  /* Guard pages opened by mem_fault */
 int32 msize;                                            /* specifed memory size */
 
-int32 GR[8][4] = { 0x00 };                              /* General Registers Group 0-3 */
+int32 GR[4][8] = { 0x00 };                              /* General Registers, bank per Group 0-3 */
+int32 *GRb = GR[0];                                     /* Register bank of active level */
+t_uint64 lvl_sw[1+5][1+5];                              /* Level switches [from][to] */
+static double lvl_sw_t0;                                /* sim_gtime() when cleared */
+#define LVL_SAMPLE      64                              /* Time one level scan in 64 */
+static uint32 lvl_scan_n;                               /* Level scans, for sampling */
+static t_uint64 lvl_sw_ns, lvl_sw_smp;                  /* Timed switches, host nsec */
 int32 opcode;                                           /* Operation Code 16 bits */
 int32 opcode0, opcode1;                                 /* OpCode byte0(H) & Byte1(L) */
 int8  CL_C[4] = { OFF };                                /* Condition Latches 'C' */
@@ -193,17 +294,11 @@ int8  int_lvl_req[1+5]  = {0, OFF, OFF, OFF, OFF, OFF}; /* Requested Program Lev
 int8  int_lvl_ent[1+5]  = {0, OFF, OFF, OFF, OFF, OFF}; /* Entered Program Levels */
 int8  int_lvl_mask[1+5] = {0, ON,  ON,  ON,  ON,  ON }; /* Masked Program Levels */
 
-int8  ipl_req_L1 = OFF;                                 /* IPL L1 request flag */
-int8  diag_req_L2 = OFF;                                /* Diagnostic L2 (in test mode only) */
-int8  svc_req_L2 = OFF;                                 /* SVC L2 request flag */
-int8  pci_req_L3 = OFF;                                 /* PCI L3 request flag */
-int8  timer_req_L3 = OFF;                               /* Interval timer L3 request flag */
-int8  inter_req_L3 = OFF;                               /* Panel interrupt L3 request flag */
-int8  pci_req_L4 = OFF;                                 /* PCI L4 request flag */
-int8  svc_req_L4 = OFF;                                 /* SVC L4 request flag */
+volatile uint32 int_src = 0;                            /* Interrupt sources pending, IRQ_xx */
+volatile uint32 int_src_seen = 0;                       /* int_src as sampled this pass */
+uint8 int_src_lvl[IRQ_ALL + 1];                         /* Sources -> requesting levels */
+uint8 int_lvl_mbits = 0x7C;                             /* Masked levels, IRQ_LVL(n) bits */
 // These flags below belong in chan.c
-int8  CA1_DS_req_L3 = OFF;                              /* Chan Adap Data/Status request flag */
-int8  CA1_IS_req_L3 = OFF;                              /* Chan Adap Initial Sel request flag */
 int8  CA1_NSC_end_seq = OFF;                            /* NSC channel end xfer seq flag */
 int8  CA1_NSC_final_seq = OFF;                          /* NSC channel final xfer seq flag */
 int8  CA1_NSC_SB_clred = OFF;                           /* NSC status byte cleared flag */
@@ -219,9 +314,6 @@ int8  bypass_CCU_check = OFF;                           /* CCU check bypass */
 int8  FET_stor_diag = OFF;                              /* FET storage diagnostics */
 int8  wait_state = OFF;                                 /* Wait state flag */
 int8  pgm_stop   = OFF;                                 /* Program STOP flag */
-int8  OP_reg_chk = OFF;                                 /* Invalid instruction */
-int8  adr_ex_chk = OFF;                                 /* Address exception check */
-int8  IO_L5_chk  = OFF;                                 /* I/O instr in L5 */
 int32 lvl;                                              /* Active Program Level (1...5) */
 int32 Grp;                                              /* Active Register Group (0...3) */
 int32 PC;                                               /* Program Counter */
@@ -240,6 +332,11 @@ t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat cpu_boot (int32 unitno, DEVICE *dptr);
 
 int32 RegGrp(int32 level);
+void lvl_switch(int32 level);
+void debug_open(void);
+int32 mem_rearm(void);
+void ccu_wake(void);
+t_uint64 ccu_idle(void);
 int32 GetMem(int32 addr);
 int32 PutMem(int32 addr, int32 data);
 
@@ -254,7 +351,7 @@ int16 reason;
 
 unsigned short old_crc;
 unsigned char crc_data;
-UNIT cpu_unit = { UDATA (NULL, UNIT_FIX + UNIT_BINK, MAXMEMSIZE) };
+UNIT cpu_unit = { UDATA (&tmr_svc, UNIT_FIX + UNIT_BINK, DFLTMEMSIZE) };  /* Event: virtual timer tick */
 
 REG cpu_reg[] = {
     { HRDATA (IAR, PC, 20), REG_RO },
@@ -271,49 +368,49 @@ REG cpu_reg[] = {
 
     /* Group 0 registers */
     { HRDATA (GR0G0, GR[0][0], 18) },
-    { HRDATA (GR1G0, GR[1][0], 18) },
-    { HRDATA (GR2G0, GR[2][0], 18) },
-    { HRDATA (GR3G0, GR[3][0], 18) },
-    { HRDATA (GR4G0, GR[4][0], 18) },
-    { HRDATA (GR5G0, GR[5][0], 18) },
-    { HRDATA (GR6G0, GR[6][0], 18) },
-    { HRDATA (GR7G0, GR[7][0], 18) },
+    { HRDATA (GR1G0, GR[0][1], 18) },
+    { HRDATA (GR2G0, GR[0][2], 18) },
+    { HRDATA (GR3G0, GR[0][3], 18) },
+    { HRDATA (GR4G0, GR[0][4], 18) },
+    { HRDATA (GR5G0, GR[0][5], 18) },
+    { HRDATA (GR6G0, GR[0][6], 18) },
+    { HRDATA (GR7G0, GR[0][7], 18) },
     { FLDATA (CLCG0, CL_C[0],   8) },
     { FLDATA (CLZG0, CL_Z[0],   8) },
 
     /* Group 1 registers */
-    { HRDATA (GR0G1, GR[0][1], 18) },
+    { HRDATA (GR0G1, GR[1][0], 18) },
     { HRDATA (GR1G1, GR[1][1], 18) },
-    { HRDATA (GR2G1, GR[2][1], 18) },
-    { HRDATA (GR3G1, GR[3][1], 18) },
-    { HRDATA (GR4G1, GR[4][1], 18) },
-    { HRDATA (GR5G1, GR[5][1], 18) },
-    { HRDATA (GR6G1, GR[6][1], 18) },
-    { HRDATA (GR7G1, GR[7][1], 18) },
+    { HRDATA (GR2G1, GR[1][2], 18) },
+    { HRDATA (GR3G1, GR[1][3], 18) },
+    { HRDATA (GR4G1, GR[1][4], 18) },
+    { HRDATA (GR5G1, GR[1][5], 18) },
+    { HRDATA (GR6G1, GR[1][6], 18) },
+    { HRDATA (GR7G1, GR[1][7], 18) },
     { FLDATA (CLCG1, CL_C[1],   8) },
     { FLDATA (CLZG1, CL_Z[1],   8) },
 
     /* Group 2 registers */
-    { HRDATA (GR0G2, GR[0][2], 18) },
-    { HRDATA (GR1G2, GR[1][2], 18) },
+    { HRDATA (GR0G2, GR[2][0], 18) },
+    { HRDATA (GR1G2, GR[2][1], 18) },
     { HRDATA (GR2G2, GR[2][2], 18) },
-    { HRDATA (GR3G2, GR[3][2], 18) },
-    { HRDATA (GR4G2, GR[4][2], 18) },
-    { HRDATA (GR5G2, GR[5][2], 18) },
-    { HRDATA (GR6G2, GR[6][2], 18) },
-    { HRDATA (GR7G2, GR[7][2], 18) },
+    { HRDATA (GR3G2, GR[2][3], 18) },
+    { HRDATA (GR4G2, GR[2][4], 18) },
+    { HRDATA (GR5G2, GR[2][5], 18) },
+    { HRDATA (GR6G2, GR[2][6], 18) },
+    { HRDATA (GR7G2, GR[2][7], 18) },
     { FLDATA (CLCG2, CL_C[2],   8) },
     { FLDATA (CLZG2, CL_Z[2],   8) },
 
     /* Group 3 registers */
-    { HRDATA (GR0G3, GR[0][3], 18) },
-    { HRDATA (GR1G3, GR[1][3], 18) },
-    { HRDATA (GR2G3, GR[2][3], 18) },
+    { HRDATA (GR0G3, GR[3][0], 18) },
+    { HRDATA (GR1G3, GR[3][1], 18) },
+    { HRDATA (GR2G3, GR[3][2], 18) },
     { HRDATA (GR3G3, GR[3][3], 18) },
-    { HRDATA (GR4G3, GR[4][3], 18) },
-    { HRDATA (GR5G3, GR[5][3], 18) },
-    { HRDATA (GR6G3, GR[6][3], 18) },
-    { HRDATA (GR7G3, GR[7][3], 18) },
+    { HRDATA (GR4G3, GR[3][4], 18) },
+    { HRDATA (GR5G3, GR[3][5], 18) },
+    { HRDATA (GR6G3, GR[3][6], 18) },
+    { HRDATA (GR7G3, GR[3][7], 18) },
     { FLDATA (CLCG3, CL_C[3],   8) },
     { FLDATA (CLZG3, CL_Z[3],   8) },
 
@@ -405,6 +502,21 @@ REG cpu_reg[] = {
     { NULL }
 };
 
+/* CCU state kept by SAVE beyond the registers above, see i3705_snap.c */
+
+struct snapent cpu_snap[] = {
+    SNAP (GR), SNAP (CL_C), SNAP (CL_Z), SNAP (PC), SNAP (LAR), SNAP (saved_PC),
+    SNAP (lvl), SNAP (Grp), SNAP (Eregs_Inp), SNAP (Eregs_Out),
+    SNAP (int_lvl_req), SNAP (int_lvl_ent), SNAP (int_lvl_mask),
+    SNAP (int_src), SNAP (int_lvl_mbits),
+    SNAP (CA1_NSC_end_seq), SNAP (CA1_NSC_final_seq), SNAP (CA1_NSC_SB_clred),
+    SNAP (last_P_Ns), SNAP (last_S_Ns), SNAP (last_lu),
+    SNAP (cycle_eight), SNAP (load_state), SNAP (test_mode), SNAP (bypass_CCU_check),
+    SNAP (FET_stor_diag), SNAP (wait_state), SNAP (pgm_stop), SNAP (old_crc),
+    SNAP (msize),
+    { NULL }
+};
+
 MTAB cpu_mod[] = {    // <=== for future 3705 model selection
     { UNIT_MSIZE, 32768,  NULL, "32K",  &cpu_set_size },
     { UNIT_MSIZE, 65536,  NULL, "64K",  &cpu_set_size },
@@ -414,10 +526,38 @@ MTAB cpu_mod[] = {    // <=== for future 3705 model selection
     { UNIT_MSIZE, 196608, NULL, "192K", &cpu_set_size },
     { UNIT_MSIZE, 229376, NULL, "224K", &cpu_set_size },
     { UNIT_MSIZE, 262144, NULL, "256K", &cpu_set_size },
-    { UNIT_MSIZE, 327680, NULL, "320K", &cpu_set_size },
-    { UNIT_MSIZE, 393216, NULL, "384K", &cpu_set_size },
-    { UNIT_MSIZE, 458752, NULL, "448K", &cpu_set_size },
-    { UNIT_MSIZE, 524288, NULL, "512K", &cpu_set_size },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "PDCACHE", NULL, NULL, &pdc_show },
+    { MTAB_XTD|MTAB_VDV, JIT_ON,    NULL, "JIT",      &jit_set, NULL },
+    { MTAB_XTD|MTAB_VDV, JIT_CHECK, NULL, "JITCHECK", &jit_set, NULL },
+    { MTAB_XTD|MTAB_VDV, JIT_OFF,   NULL, "NOJIT",    &jit_set, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "JIT", NULL, NULL, &jit_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "WAIT", NULL, NULL, &ccu_wait_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "TIMER", "TIMER", &tmr_set, &tmr_show },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "TICK", &tmr_set, NULL },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "IDLE",      &idle_set, NULL },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOIDLE",    &idle_set, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IDLE", NULL, NULL, &idle_show },
+    { MTAB_XTD|MTAB_VDV, 1, "THROTTLE", "THROTTLE", &gov_set, &gov_show },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOTHROTTLE", &gov_set, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "UTIL", NULL, NULL, &cu_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 1, "UTILCNT", NULL, NULL, &cu_show },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "UTILZERO",  &cu_zero, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "CKPT", NULL, NULL, &ckpt_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "RR", NULL, NULL, &rr_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "CTL", NULL, NULL, &ctl_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "LEVELS", NULL, NULL, &lvl_show },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "PROFILE",   &prof_set, NULL },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOPROFILE", &prof_set, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "PROFILE", NULL, NULL, &prof_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "COVERAGE", NULL, NULL, &cov_show },
+    { MTAB_XTD|MTAB_VDV, 1, NULL, "TRACE",     &trc_set, NULL },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "NOTRACE",   &trc_set, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "TRACE", NULL, NULL, &trc_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "BTRACE", NULL, NULL, &btr_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "WATCH", NULL, NULL, &wp_show },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "BREAKS", NULL, NULL, &brk_show },
+    { MTAB_XTD|MTAB_VDV, 0, NULL, "BRKZERO",   &brk_zero, NULL },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "EREGS", NULL, NULL, &ereg_show },
     { 0 }
 };
 
@@ -428,18 +568,91 @@ DEVICE cpu_dev = {
     NULL, NULL
 };
 
+/* EVT device, the clock queue events of the CCU services.  It has no
+   registers or storage, it only makes SHOW and SAVE see the units. */
+
+UNIT evt_unit[EVT_NUNITS] = {
+    { UDATA (&gov_svc,  0, 0), 0, 0, 0, 0, 0, NULL, NULL },   /* i3705_throt.c */
+    { UDATA (&ckpt_svc, 0, 0), 0, 0, 0, 0, 0, NULL, NULL },   /* i3705_ckpt.c */
+    { UDATA (&rr_svc,   0, 0), 0, 0, 0, 0, 0, NULL, NULL },   /* i3705_rr.c */
+    { UDATA (&run_svc,  0, 0), 0, 0, 0, 0, 0, NULL, NULL },   /* cpu_run() */
+    { UDATA (&brk_svc,  0, 0), 0, 0, 0, 0, 0, NULL, NULL }    /* i3705_brk.c */
+};
+
+DEVICE evt_dev = {
+    "EVT", evt_unit, NULL, NULL,
+    EVT_NUNITS, 10, 31, 1, 8, 8,
+    NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, 0, 0, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+//********************************************************
+// Threaded build (make i3705t, -DI3705_THREADED)
+//
+// Each handler ends with NEXT_INSTR.  In the normal build
+// that is a plain break back to the top of the loop.  In
+// the threaded build the handler fetches the next predecoded
+// instr itself and jumps to its handler through thr_op[].
+// The full loop (events, breakpoints, trace, interrupt
+// level selection, wait state) then only runs every
+// THR_BATCH instrs, on a predecode miss, after IN, OUT and
+// EXIT, or when any of those facilities is active.
+//********************************************************
+
+#ifdef I3705_THREADED
+#ifndef THR_BATCH
+#define THR_BATCH       256                    /* Instrs between full loop passes */
+#endif
+#define OPCASE(x)       case x: thr_##x:
+#define NEXT_INSTR                                                         \
+   if ((--thr_cnt > 0) && (sim_interval > 0) && (reason == 0) &&          \
+       (debug_reg == 0) && (mem_pend == 0) &&                              \
+       (int_src == int_src_seen) && (pdc_posted == 0) &&                   \
+       (jit_mode != JIT_CHECK) && (prof_on == 0) && (trc_on == 0)) {       \
+      thr_pc = GRb[0];                                                    \
+      if (((thr_pc & 1) == 0) && ((uint32) thr_pc + 3 < MEMSIZE) &&      \
+          !BRK_TEST(thr_pc) &&                                            \
+          pdc[thr_pc >> 1].valid &&                                       \
+          ((pdc[thr_pc >> 1].xcode != OP_INV) || (test_mode == ON))) {    \
+         sim_interval = sim_interval - 1;                                 \
+         if (lvl != 1) LAR = saved_PC;                                    \
+         saved_PC = thr_pc;                                               \
+         pd = &pdc[thr_pc >> 1];                                          \
+         COV_MARK(thr_pc);                                                \
+         if (btr_on) BTR_STEP(thr_pc, pd->len);                           \
+         pdc_hits++;                                                      \
+         val[0] = opcode0 = pd->byte[0];                                  \
+         val[1] = opcode1 = pd->byte[1];                                  \
+         val[2] = pd->byte[2];                                            \
+         val[3] = pd->byte[3];                                            \
+         opcode = (opcode0 << 8) | (opcode1);                             \
+         PC = (thr_pc + 2) & AMASK;                                       \
+         GRb[0] = PC;                                                     \
+         CU_COUNT(cu_cost[pd->xcode]);                                    \
+         goto *thr_op[pd->xcode];                                         \
+      }                                                                   \
+   }                                                                      \
+   break
+#else
+#define OPCASE(x)       case x:
+#define NEXT_INSTR      break
+#endif
+
 //********************************************************
 // Instruction simulator starts here...
 //********************************************************
 
 t_stat sim_instr (void) {
 
-// Assign thread to a core
+// Assign thread to a core, once: SCP always runs us on its thread
 // core_id = 1 (CPU), 2 (SCAN), 3 (SDLC)
+static int pinned = 0;
 int core_id = 1;
 int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
 
-if ((core_id > 0) && (core_id <= num_cores)) {
+if (!pinned && (core_id > 0) && (core_id <= num_cores)) {
+   pinned = 1;
    cpu_set_t cpuset;
    CPU_ZERO(&cpuset);
    CPU_SET(core_id, &cpuset);
@@ -449,30 +662,51 @@ if ((core_id > 0) && (core_id <= num_cores)) {
 }
 
 
-// BSC CRC calculation
-
-unsigned short calculateBSCCrcChar (unsigned short crc, unsigned char data_p) {
-   unsigned char i;
-   unsigned int data;
-   for (int i=0, data=(unsigned int)0xff & data_p;
-      i < 8;
-      i++, data >>= 1)
-      {
-      if ((crc & 0x0001) ^ (data & 0x0001))
-         crc = (crc >> 1) ^ 0xa001;
-      else crc >>= 1;
-   }
-   return crc;
-}
-
 int32 i, j, w_byte, addr;
+int32 lvl_req;                                 /* Requesting levels, IRQ_LVL bits */
 int32 R1fld, R2fld, Rfld;
 int32 N1fld, N2fld, Nfld;
 int32 Afld, Bfld, Dfld, Efld, Ifld, Mfld, Tfld;
-
-Grp = RegGrp(lvl);
+struct pdent *pd, pd_tmp;                      /* Current predecoded instr */
+struct trcent *trc = NULL;                     /* Trace record of this instr */
+int32 trc_gr[8];                               /* GRs before this instr */
+t_uint64 sw_t0 = 0;                            /* Start of a timed level scan */
+int32 sw_from = 0;                             /* Level before the timed scan */
+#ifdef I3705_THREADED
+int32 thr_pc, thr_cnt;                         /* Next IAR, instrs left in batch */
+static void *thr_op[OP_MAX] = {                /* Handler per execution class */
+   [OP_NOP]  = &&thr_OP_NOP,  [OP_INV]  = &&thr_OP_NOP,
+   [OP_B]    = &&thr_OP_B,    [OP_BCL]  = &&thr_OP_BCL,  [OP_BZL]  = &&thr_OP_BZL,
+   [OP_BCT]  = &&thr_OP_BCT,  [OP_BB]   = &&thr_OP_BB,   [OP_LRI]  = &&thr_OP_LRI,
+   [OP_ARI]  = &&thr_OP_ARI,  [OP_SRI]  = &&thr_OP_SRI,  [OP_CRI]  = &&thr_OP_CRI,
+   [OP_XRI]  = &&thr_OP_XRI,  [OP_ORI]  = &&thr_OP_ORI,  [OP_NRI]  = &&thr_OP_NRI,
+   [OP_TRM]  = &&thr_OP_TRM,  [OP_LCR]  = &&thr_OP_LCR,  [OP_ACR]  = &&thr_OP_ACR,
+   [OP_SCR]  = &&thr_OP_SCR,  [OP_CCR]  = &&thr_OP_CCR,  [OP_XCR]  = &&thr_OP_XCR,
+   [OP_OCR]  = &&thr_OP_OCR,  [OP_NCR]  = &&thr_OP_NCR,  [OP_LCOR] = &&thr_OP_LCOR,
+   [OP_ICT]  = &&thr_OP_ICT,  [OP_STCT] = &&thr_OP_STCT, [OP_IC]   = &&thr_OP_IC,
+   [OP_STC]  = &&thr_OP_STC,  [OP_LH]   = &&thr_OP_LH,   [OP_STH]  = &&thr_OP_STH,
+   [OP_L]    = &&thr_OP_L,    [OP_ST]   = &&thr_OP_ST,   [OP_LHR]  = &&thr_OP_LHR,
+   [OP_AHR]  = &&thr_OP_AHR,  [OP_SHR]  = &&thr_OP_SHR,  [OP_CHR]  = &&thr_OP_CHR,
+   [OP_XHR]  = &&thr_OP_XHR,  [OP_OHR]  = &&thr_OP_OHR,  [OP_NHR]  = &&thr_OP_NHR,
+   [OP_LHOR] = &&thr_OP_LHOR, [OP_LR]   = &&thr_OP_LR,   [OP_AR]   = &&thr_OP_AR,
+   [OP_SR]   = &&thr_OP_SR,   [OP_CR]   = &&thr_OP_CR,   [OP_XR]   = &&thr_OP_XR,
+   [OP_OR]   = &&thr_OP_OR,   [OP_NR]   = &&thr_OP_NR,   [OP_LOR]  = &&thr_OP_LOR,
+   [OP_BALR] = &&thr_OP_BALR, [OP_IN]   = &&thr_OP_IN,   [OP_OUT]  = &&thr_OP_OUT,
+   [OP_BAL]  = &&thr_OP_BAL,  [OP_LA]   = &&thr_OP_LA,   [OP_EXIT] = &&thr_OP_EXIT };
+#endif
+
+if ((debug_reg != 0) && (debug_flag == OFF))
+   debug_open();                               /* Open trace.log */
+Grp = RegGrp(lvl);                             /* Level may have been deposited */
+GRb = GR[Grp];
+if (prof_on) prof_mark(lvl);                   /* Start charging host time */
+wp_arm();                                      /* Protect watched pages */
+brk_sync(1);                                   /* BREAK/NOBREAK given while stopped */
+gov_start();                                   /* Throttle from here */
+ckpt_start();                                  /* Checkpoint clock */
+cu_run(1);                                     /* Start the host time */
 saved_PC = PC;
-PC = GR[0][Grp];
+PC = GRb[0];
 reason = 0;
 
 //********************************************************
@@ -483,24 +717,22 @@ reason = 0;
 // Scroll down 1800 lines to find the end of this while loop
 
 while (reason == 0) {                          /* Loop until halted */
+   if (jit_mode == JIT_CHECK)
+      jit_check_pass();                        /* Compare with JIT block ? */
    if (sim_interval <= 0) {                    /* Check clock queue */
+      CL_LATCH();                              /* Services see real latches */
       if (reason = sim_process_event())
          break;                                /* Stop simulation */
    }
    sim_interval = sim_interval - 1;            /* Tick the clock */
 
-   if (sim_brk_summ && sim_brk_test(PC, SWMASK('E')) ) {  /* Any breakpoint ? */
-      reason = STOP_IBKPT;                     /* Stop simulation */
-      break;
-   }
-
 //********************************************************
 // Uncomment this code to start CCU execution trace
 // after NCP load completion.
 //********************************************************
 //   Update ----- vvvv
-//   if (ipl_req_L1 == OFF) debug_reg = 0x60;
-//   if (svc_req_L2 || lvl == 2) {
+//   if (!IRQ_ON(IRQ_IPL_L1)) debug_reg = 0x60;
+//   if (IRQ_ON(IRQ_SVC_L2) || lvl == 2) {
 //      debug_reg = 0x43;
 //   } else { debug_reg = 0x00; }
 
@@ -508,35 +740,15 @@ while (reason == 0) {                          /* Loop until halted */
 //      fclose(trace);
 //      debug_flag = OFF;
 //   }
-
-//********************************************************
-//  Debug trace facility
-//********************************************************
-   if (debug_flag == OFF) {
-      trace = fopen("trace.log", "w");
-      fprintf(trace, "     ****** 3705 Executed instructions log file ****** \n\n"
-                     "     sim> d debug 01 - trace IAR, mnem, C & Z & lvl \n"
-                     "                  02 - trace all enter/leave/wait interrupts \n"
-                     "                  04 - trace scanner ext input regs \n"
-                     "                  08 - trace channel adap ext input regs \n"
-                     "                  10 - trace CCU ext input regs \n"
-                     "                  20 - trace PIU's \n"
-                     "                  40 - trace ICW PCF \n"
-                     "                  80 - trace channel activity \n"
-                     "          AA55 = Unused external register \n\n");
-      debug_flag = ON;
-   }
+//   if ((debug_reg != 0x00) && (debug_flag == OFF))   /* Open log file ? */
+//      debug_open();
 
 //********************************************************
 //  IBM 3705 CCU trace print statements
+//  Executed instrs are recorded in the binary trace ring
+//  (SET CPU TRACE), not here.
 //********************************************************
    if (wait_state != ON) {
-      if (debug_reg & 0x01) {  /* Trace instruction + mnem. */
-         fprintf(trace, "\n[%06d] exec IAR=%05X - %04X        ", cc++,
-            saved_PC, opcode );
-         fprint_sym(trace, PC, (uint32 *) val, &cpu_unit, SWMASK('M') );
-         fprintf(trace, "\n");
-      }
       if (debug_reg & 0x08) {  /* Trace external scanner registers */
          fprintf(trace, "         CS2: %05X %05X %05X %05X  %05X %05X %05X %05X (X'40-47') ",
             Eregs_Inp[CMBARIN], NOTUSED, NOTUSED, Eregs_Inp[CMERREG],
@@ -565,25 +777,23 @@ while (reason == 0) {                          /* Loop until halted */
 //  Check for any program level requests ?
 //********************************************************
 
-   /* Check for any L1 requests ? */
-   if (ipl_req_L1 || OP_reg_chk || IO_L5_chk || adr_ex_chk)
-      int_lvl_req[1] = ON;                     // Set L1 interrupt request
-   else int_lvl_req[1] = OFF;
-
-   /* Check for any L2 requests ? */
-   if (diag_req_L2 || svc_req_L2)
-      int_lvl_req[2] = ON;                     // Set L2 interrupt request
-   else int_lvl_req[2] = OFF;
-
-   /* Check for any L3 requests ? */
-   if (inter_req_L3 || timer_req_L3 || pci_req_L3 || CA1_DS_req_L3 || CA1_IS_req_L3)
-      int_lvl_req[3] = ON;                     // Set L3 interrupt request
-   else int_lvl_req[3] = OFF;
-
-   /* Check for any L4 requests ? */
-   if (pci_req_L4 || svc_req_L4)
-      int_lvl_req[4] = ON;                     // Set L4 interrupt request
-   else int_lvl_req[4] = OFF;
+   /* Sample the pending sources once and map them to L1-L4 requests */
+   int_src_seen = int_src;
+   pdc_sync();                                 /* Drop code the adapters stored over */
+   if (rr_mode)                                /* Log it or check it against the log */
+      rr_sample();
+   lvl_req = int_src_lvl[int_src_seen & IRQ_ALL];
+   if (mem_pend) {                             /* Storage fault to service ? */
+      mem_pend = 0;
+      if (mem_fault_addr >= 0)                 /* Access beyond MEMSIZE caught */
+         printf("Addr %d  MEMSIZE %d ... \n\r", mem_rearm(), MEMSIZE);
+      if ((reason = wp_service()) != SCPE_OK)  /* Watched bytes changed */
+         break;
+   }
+   int_lvl_req[1] = (lvl_req & IRQ_LVL(1)) ? ON : OFF;
+   int_lvl_req[2] = (lvl_req & IRQ_LVL(2)) ? ON : OFF;
+   int_lvl_req[3] = (lvl_req & IRQ_LVL(3)) ? ON : OFF;
+   int_lvl_req[4] = (lvl_req & IRQ_LVL(4)) ? ON : OFF;
 
    if (debug_reg & 0x02) {                     // Trace interrupt flags
       if (wait_state != ON) {
@@ -596,43 +806,50 @@ while (reason == 0) {                          /* Loop until halted */
 //********************************************************
 // Check all 5 program levels for any work...
 //********************************************************
+   /* Current level entered and no unmasked request above it: keep going */
+   if ((int_lvl_ent[lvl] == ON) &&
+       ((lvl_req & ~int_lvl_mbits & ~(0xFF >> lvl) & 0x7F) == 0))
+      goto lvl_done;
+   if ((++lvl_scan_n & (LVL_SAMPLE - 1)) == 0) {  /* Time this scan ? */
+      sw_from = lvl;
+      sw_t0 = prof_now();
+   }
    for (int i = 1; i < 6; i++) {               // 1, 2, 3, 4...5
       if (int_lvl_ent[i] == OFF) {             // Lvl already running ? => continue
          if ((int_lvl_req[i] == ON) || (i == 5)) {   // Lvl request pending ? => enter if not masked
             if (int_lvl_mask[i] == OFF) {      // Lvl mask on ? => skip this level
                /* Start higher prio pgm level ! */
                int_lvl_ent[i] = ON;
-               lvl = i;                        // Set new pgm level
-               Grp = RegGrp(lvl);              // Set new reg group
+               lvl_switch(i);                  // Set new pgm level and reg bank
                if (debug_reg & 0x02) {         // Trace CCU interrupt levels
                   if (lvl == 1)
                      fprintf(trace, "\n>>> Entering lvl=1 -- IPL=%d; OPchk=%d; IOchk=%d; AEchk=%d \n",
-                             ipl_req_L1, OP_reg_chk, IO_L5_chk, adr_ex_chk);
+                             IRQ_ON(IRQ_IPL_L1), IRQ_ON(IRQ_OPC_L1), IRQ_ON(IRQ_IOL5_L1), IRQ_ON(IRQ_ADR_L1));
                   if (lvl == 2)
                      fprintf(trace, "\n>>> Entering lvl=2 -- Diag=%d; SVCL2=%d \n",
-                             diag_req_L2, svc_req_L2);
+                             IRQ_ON(IRQ_DIAG_L2), IRQ_ON(IRQ_SVC_L2));
                   if (lvl == 3)
                      fprintf(trace, "\n>>> Entering lvl=3 -- Int=%d; Timer=%d; PCIL3=%d; CA1_IS=%d; CA1_D/S=%d \n",
-                             inter_req_L3, timer_req_L3, pci_req_L3, CA1_IS_req_L3, CA1_DS_req_L3);
+                             IRQ_ON(IRQ_INTER_L3), IRQ_ON(IRQ_TIMER_L3), IRQ_ON(IRQ_PCI_L3), IRQ_ON(IRQ_CAIS_L3), IRQ_ON(IRQ_CADS_L3));
                   if (lvl == 4)
                      fprintf(trace, "\n>>> Entering lvl=4 -- PCIL4=%d; SVCL4=%d \n",
-                             pci_req_L4, svc_req_L4);
+                             IRQ_ON(IRQ_PCI_L4), IRQ_ON(IRQ_SVC_L4));
                   if (lvl == 5)
                      fprintf(trace, "\n>>> Entering lvl=5 -- MSKL5=0 \n");
                }
                if (debug_reg & 0x02) {
                if (lvl == 1)                   // Display CCU interrupt levels
                   printf(">>> Entering lvl 1 -- IPL=%d; OPchk=%d; IOchk=%d; AEchk=%d \n\r",
-                          ipl_req_L1, OP_reg_chk, IO_L5_chk, adr_ex_chk);
+                          IRQ_ON(IRQ_IPL_L1), IRQ_ON(IRQ_OPC_L1), IRQ_ON(IRQ_IOL5_L1), IRQ_ON(IRQ_ADR_L1));
                if (lvl == 2)
                   printf(">>> Entering lvl 2 -- Diag=%d; SVCL2=%d \n\r",
-                          diag_req_L2, svc_req_L2);
+                          IRQ_ON(IRQ_DIAG_L2), IRQ_ON(IRQ_SVC_L2));
                if (lvl == 3)
                   printf(">>> Entering lvl 3 -- Int=%d; Timer=%d; PCIL3=%d; CA1_IS=%d; CA1_D/S=%d \n\r",
-                          inter_req_L3, timer_req_L3, pci_req_L3, CA1_IS_req_L3, CA1_DS_req_L3);
+                          IRQ_ON(IRQ_INTER_L3), IRQ_ON(IRQ_TIMER_L3), IRQ_ON(IRQ_PCI_L3), IRQ_ON(IRQ_CAIS_L3), IRQ_ON(IRQ_CADS_L3));
                if (lvl == 4)
                   printf(">>> Entering lvl 4 -- PCIL4=%d; SVCL4=%d \n\r",
-                          pci_req_L4, svc_req_L4);
+                          IRQ_ON(IRQ_PCI_L4), IRQ_ON(IRQ_SVC_L4));
                if (lvl == 5)
                   printf(">>> Entering lvl 5 -- MSKL5=0 \n\r");
                }
@@ -643,13 +860,13 @@ while (reason == 0) {                          /* Loop until halted */
                      GR[0][0]   = 0x0010;      // Start addr level 1
                      break;
                   case 2:
-                     GR[0][Grp] = 0x0080;      // Start addr level 2
+                     GRb[0] = 0x0080;          // Start addr level 2
                      break;
                   case 3:
-                     GR[0][Grp] = 0x0100;      // Start addr level 3
+                     GRb[0] = 0x0100;          // Start addr level 3
                      break;
                   case 4:
-                     GR[0][Grp] = 0x0180;      // Start addr level 4
+                     GRb[0] = 0x0180;          // Start addr level 4
                      break;
                   case 5:                      // Continue with GR0G3
                      break;
@@ -665,13 +882,13 @@ while (reason == 0) {                          /* Loop until halted */
                   /* Looks like we have nothing to do, so let's wait...  */
                   if ((debug_reg & 0x02) && (wait_state == OFF)) {
                      fprintf(trace, "\n>>> Entering wait state in lvl=5, GR0G3=%05X \n",
-                                    GR[0][RegGrp(i)]);
+                                    GR[RegGrp(i)][0]);
                      fprintf(trace, "\n>>> Waiting... \n");
                   }
                   wait_state = ON;             // Enter wait state
                }
-               lvl = i;                        // Set pgm level 5
-               Grp = RegGrp(lvl);              // Set reg group 3
+               if (lvl != i)
+                  lvl_switch(i);               // Set pgm level 5, reg group 3
                break;                          // Out of inner 'for' loop
             }
             continue;                          // Check next lower pgm lvl
@@ -679,13 +896,30 @@ while (reason == 0) {                          /* Loop until halted */
          continue;                             // Check next lower pgm lvl
       }
 
-      lvl = i;                                 // Set current pgm level
-      Grp = RegGrp(lvl);                       // Set reg group
+      if (lvl != i)
+         lvl_switch(i);                        // Set current pgm level and reg bank
       break;                                   // Continue with current pgm lvl
    }
+lvl_done:
+   if (sw_t0 != 0) {                           /* Timed scan switched level ? */
+      if (lvl != sw_from) {
+         lvl_sw_ns += prof_now() - sw_t0;
+         lvl_sw_smp++;
+      }
+      sw_t0 = 0;
+   }
 
+   if (idle_pend)                              /* Idle loop detected ? */
+      idle_park();
    if (wait_state == ON) {
-      usleep(1000);                            // Get some rest...
+      if (prof_on) prof_mark(0);               /* Charge the wait to wait state */
+      if (tmr_mode == TMR_VIRTUAL) {
+         if (sim_interval > 0)
+            cu_vwait += sim_interval;          // Instrs not run while waiting
+         sim_interval = 0;                     // Skip ahead to the next timer tick
+      } else
+         ccu_idle();                           // Get some rest until a request arrives
+      if (prof_on) prof_mark(lvl);
       continue;
    }
 
@@ -693,120 +927,140 @@ while (reason == 0) {                          /* Loop until halted */
 // Read instruction and execute it starts here...
 //=======================================================================================
 
+   if (BRK_TEST(GRb[0]) &&                     /* Breakpoint ? */
+       ((reason = brk_hit(GRb[0])) != SCPE_OK))
+      break;                                   /* Stop simulation */
    if (lvl != 1) LAR = saved_PC;               /* Update LAR if lvl 2, 3, 4 or 5 */
-   PC = GR[0][Grp];
+   PC = GRb[0];
    saved_PC = PC;
 
-   val[0] = opcode0 = GetMem(PC);              /* Instruction byte 0(H) */
-   PC = (PC + 1) & AMASK;
-   val[1] = opcode1 = GetMem(PC);              /* Instruction byte 1(L) */
-   PC = (PC + 1) & AMASK;
+   if ((jit_mode != JIT_OFF) && (debug_reg == 0) &&
+       (prof_on == 0) && (trc_on == 0) && (btr_on == 0) &&
+       (jit_step() > 0))                                         /* Translated block executed ? */
+      continue;
+
+#ifdef I3705_THREADED
+   thr_cnt = THR_BATCH;                        /* Start a new batch */
+#endif
+   if (((PC & 1) == 0) && ((uint32) PC + 3 < MEMSIZE)) {
+      pd = &pdc[PC >> 1];                      /* Predecoded instr ? */
+      if (pd->valid)
+         pdc_hits++;
+      else {
+         pdc_load(pd, PC);                     /* No, decode and keep it */
+         pdc_miss++;
+      }
+   } else {
+      pd = &pd_tmp;                            /* Odd or last address */
+      pdc_load(pd, PC);
+   }
+   val[0] = opcode0 = pd->byte[0];             /* Instruction byte 0(H) */
+   val[1] = opcode1 = pd->byte[1];             /* Instruction byte 1(L) */
+   PC = (PC + 2) & AMASK;
    opcode = (opcode0 << 8) | (opcode1);        /* Instr to be executed. */
-   val[2] = GetMem(PC);                        /* Needed for possible LA */
-   val[3] = GetMem(PC + 1);                    /* and BAL instructions. */
-
-   if (((opcode0 & 0x88) == 0x00) &&           /* Invalid instruction ? */
-       (test_mode == OFF) &&
-      ((opcode1 == 0x00) ||
-       (opcode1 == 0x20) ||
-       (opcode1 == 0x50) ||
-       (opcode1 == 0x60) ||
-       (opcode1 == 0x70))) {
-      OP_reg_chk = ON;
+   val[2] = pd->byte[2];                       /* Needed for possible LA */
+   val[3] = pd->byte[3];                       /* and BAL instructions. */
+   COV_MARK(saved_PC);                         /* Halfword executed */
+   if (btr_on)
+      BTR_STEP(saved_PC, pd->len);
+   if (prof_on)
+      PROF_COUNT(saved_PC, pd->xcode);
+
+   if ((pd->xcode == OP_INV) &&                /* Invalid instruction ? */
+       (test_mode == OFF)) {
+      IRQ_SET(IRQ_OPC_L1);
       if (lvl == 1)
          reason = STOP_INVOP;                  /* SIMH stop */
       continue;
    }
-   GR[0][Grp] = PC;                            /* Update IAR before execution */
+   GRb[0] = PC;                                /* Update IAR before execution */
+   if (trc_on) {                               /* Record it in the trace ring */
+      trc = &trc_buf[trc_pos++ & trc_mask];
+      trc->iar = saved_PC;
+      memcpy(trc->inst, pd->byte, 4);
+      trc->lvl = lvl;
+      trc->flags = 0;
+      memcpy(trc_gr, GRb, sizeof(trc_gr));
+   }
 
    // CCU Cycle Utilization counter
-   cycle_eight++;                              /* Count 8 cycles               */
-   if (cycle_eight == 8) {                     /* If eight cycles...           */
-      cycle_eight = 0;                         /* ...reset 8 cycle counter...  */
-      if ( Eregs_Inp[0x7A] == 0xFFFF)          /* ...If cycle counter at max...*/
-         Eregs_Inp[0x7A] = 0x8000;             /* ...reset cycle counter       */
-      else                                     /* ...else...                   */
-         Eregs_Inp[0x7A]++;                    /* ...Increment Cycle Utilization Register */
-   } // End if cycle_eight
-
-   switch (opcode & 0xF800) {
-      case (0xA800):
+   CU_COUNT(cu_cost[pd->xcode]);               /* Charge the cycles of the instr */
+
+   switch (pd->xcode) {
+      OPCASE(OP_B)
          /* B    T              [RT]  */
          /* 01234567 89012345
             10101T<- ------>#         */
-         Grp = RegGrp(lvl);
          Tfld = opcode & 0x07FE;
 
          if (opcode & 0x0001)                  /* Check displacement sign */
-            GR[0][Grp] = GR[0][Grp] - Tfld;
+            GRb[0] = GRb[0] - Tfld;
          else
-            GR[0][Grp] = GR[0][Grp] + Tfld;
-         PC = GR[0][Grp];                      /* Update PC with new IAR */
-         break;
+            GRb[0] = GRb[0] + Tfld;
+         PC = GRb[0];                          /* Update PC with new IAR */
+         IDLE_BRANCH();
+         NEXT_INSTR;
 
-      case (0x9800):
+      OPCASE(OP_BCL)
          /* BCL  T              [RT]  */
          /* 01234567 89012345
             10011T<- ------>#         */
-         Grp = RegGrp(lvl);
          Tfld = (opcode & 0x07FE);
 
+         CL_LATCH();                           /* Form the latches to test */
          if (CL_C[Grp] == ON) {
             if (opcode & 0x0001)
-               GR[0][Grp] = GR[0][Grp] - Tfld;
+               GRb[0] = GRb[0] - Tfld;
             else
-               GR[0][Grp] = GR[0][Grp] + Tfld;
-            PC = GR[0][Grp];                   /* Update PC with new IAR */
+               GRb[0] = GRb[0] + Tfld;
+            PC = GRb[0];                       /* Update PC with new IAR */
+            IDLE_BRANCH();
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x8800):
+      OPCASE(OP_BZL)
          /* BZL  T              [RT]  */
          /* 01234567 89012345
             10001T<- ------>#         */
-         Grp = RegGrp(lvl);
          Tfld = (opcode & 0x07FE);
 
+         CL_LATCH();                           /* Form the latches to test */
          if (CL_Z[Grp] == ON) {
             if (opcode & 0x0001)
-               GR[0][Grp] = GR[0][Grp] - Tfld;
+               GRb[0] = GRb[0] - Tfld;
             else
-               GR[0][Grp] = GR[0][Grp] + Tfld;
-            PC = GR[0][Grp];                   /* Update PC with new IAR */
+               GRb[0] = GRb[0] + Tfld;
+            PC = GRb[0];                       /* Update PC with new IAR */
+            IDLE_BRANCH();
          }
-         break;
+         NEXT_INSTR;
 
-      case (0xB800):
+      OPCASE(OP_BCT)
          /* BCT  R(N),T         [RT]  */
          /* 01234567 89012345
             10111RRN 1T<-->T#         */
-         if (opcode1 & 0x80) {                 /* Must be a 1, else it is BAL or LA instr */
-            Grp = RegGrp(lvl);
-            Rfld = (opcode0 & 0x06) + 1;       /* Extract odd register nr */
-            Nfld = (opcode0 & 0x01);
-            Tfld =  opcode1 & 0x7E;
-
-            if (Nfld == 0) {                   /* Count is contained in byte 0 only */
-               w_byte = (GR[Rfld][Grp] - 0x00100) & 0x0FF00;
-               GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | w_byte;
-            } else {                           /* Count is contained in byte 0 & 1 */
-               w_byte = (GR[Rfld][Grp] - 0x00001) & 0x0FFFF;
-               GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x30000) | w_byte;
-            }
-            if ((w_byte & 0xFFFF) == 0x0000)   /* Next instr if result = 0 */
-               break;
-            if (opcode1 & 0x01)                /* Check displacement sign */
-               GR[0][Grp] = GR[0][Grp] - Tfld;
-            else
-               GR[0][Grp] = GR[0][Grp] + Tfld;
-            PC = GR[0][Grp];                   /* Update PC with new IAR */
+         Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
+         Nfld = (opcode0 & 0x01);
+         Tfld =  opcode1 & 0x7E;
+
+         if (Nfld == 0) {                      /* Count is contained in byte 0 only */
+            w_byte = (GRb[Rfld] - 0x00100) & 0x0FF00;
+            GRb[Rfld] = (GRb[Rfld] & 0x300FF) | w_byte;
+         } else {                              /* Count is contained in byte 0 & 1 */
+            w_byte = (GRb[Rfld] - 0x00001) & 0x0FFFF;
+            GRb[Rfld] = (GRb[Rfld] & 0x30000) | w_byte;
          }
-         break;
+         if ((w_byte & 0xFFFF) == 0x0000)      /* Next instr if result = 0 */
+            break;
+         if (opcode1 & 0x01)                   /* Check displacement sign */
+            GRb[0] = GRb[0] - Tfld;
+         else
+            GRb[0] = GRb[0] + Tfld;
+         PC = GRb[0];                          /* Update PC with new IAR */
+         IDLE_BRANCH();
+         NEXT_INSTR;
 
-      case (0xC800):
-      case (0xD800):
-      case (0xE800):
-      case (0xF800):
+      OPCASE(OP_BB)
          /* BB   R(N),T         [RT]  */
          /* 01234567 89012345
             11MM1RRN MT<-->T#         */
@@ -820,590 +1074,438 @@ while (reason == 0) {                          /* Loop until halted */
          else
             Mfld = 0x0080 >> Mfld;             /* Create bit test mask */
 
-         if ((GR[Rfld][Grp] & Mfld) != 0x0000) {  /* Test with mask */
+         if ((GRb[Rfld] & Mfld) != 0x0000) {      /* Test with mask */
             /* Selected bit is ON, continue at branch addr. */
             if (opcode1 & 0x01)                /* Check displacement sign */
-               GR[0][Grp] = GR[0][Grp] - Tfld;
+               GRb[0] = GRb[0] - Tfld;
             else
-               GR[0][Grp] = GR[0][Grp] + Tfld;
-            PC = GR[0][Grp];                   /* Update PC with new IAR */
+               GRb[0] = GRb[0] + Tfld;
+            PC = GRb[0];                       /* Update PC with new IAR */
+            IDLE_BRANCH();
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x8000):
+      OPCASE(OP_LRI)
          /* LRI  R(N),I         [RI]  */
          /* 01234567 89012345
             10000RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (opcode1 << 8);
+            GRb[Rfld] = (GRb[Rfld] & 0x300FF) | (opcode1 << 8);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | opcode1;
+            GRb[Rfld] = (GRb[Rfld] & 0x3FF00) | opcode1;
          }
          /* Test selected byte for zero */
-         if (opcode1 == 0x00) {
-            CL_Z[Grp] = ON;
-         } else {
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, opcode1);
+         NEXT_INSTR;
 
-      case (0x9000):
+      OPCASE(OP_ARI)
          /* ARI  R(N),I         [RI]  */
          /* 01234567 89012345
             10010RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            w_byte = GR[Rfld][Grp] + (Ifld << 8);
-            if (((GR[Rfld][Grp] & 0xFFFF) +    /* Overflow from byte 0(H) ? */
-                 (Ifld << 8)) > 0xFFFF)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFF00) == 0x0000)   /* Result zero ? */
-               CL_Z[Grp] = ON;
+            w_byte = GRb[Rfld] + (Ifld << 8);
+            /* C: overflow from byte 0(H), Z: byte 0(H) zero */
+            LATCH(LZ_CY, ((GRb[Rfld] & 0xFFFF) + (Ifld << 8)) & 0x1FF00);
             w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
             /* Store result back in register */
-            GR[Rfld][Grp] = w_byte;
+            GRb[Rfld] = w_byte;
          } else {                              /* Byte X, 0(H) & 1(L) */
-            w_byte = GR[Rfld][Grp] + Ifld;
-            if (((GR[Rfld][Grp] & 0x0FFFF) +   /* Overflow from byte 1(L) ? */
-                 (Ifld)) > 0xFFFF)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFFFF) == 0x0000)   /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
+            w_byte = GRb[Rfld] + Ifld;
+            /* C: overflow from byte 1(L), Z: X-byte not included */
+            LATCH(LZ_CY, (GRb[Rfld] & 0x0FFFF) + Ifld);
             w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
             /* Store result back in register */
-            GR[Rfld][Grp] = w_byte;
+            GRb[Rfld] = w_byte;
          }
-         break;
+         NEXT_INSTR;
 
-      case (0xA000):
+      OPCASE(OP_SRI)
          /* SRI  R(N),I         [RI]  */
          /* 01234567 89012345
             10100RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          w_byte = Ifld;                        /* Get second operand */
 
          /* Perform SUB with operand 1 */
          if (Nfld == 0) {                      /* Byte 0(H) result */
-            w_byte = GR[Rfld][Grp] + (~(w_byte << 8)) + 1;
-            if (((GR[Rfld][Grp] & 0x0FF00) +   /* Overflow from byte 0(H) ? */
-                 (~(Ifld << 8) & 0x3FF00) + 0x0100) & 0x10000)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0x0FF00) == 0x0000)  /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
+            w_byte = GRb[Rfld] + (~(w_byte << 8)) + 1;
+            /* C: overflow from byte 0(H), Z: X-byte not included */
+            LATCH(LZ_CY, ((GRb[Rfld] & 0x0FF00) +
+                          (~(Ifld << 8) & 0x3FF00) + 0x0100) & 0x1FF00);
             w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
          } else {                              /* Byte 0 & 1 result */
-            w_byte = (GR[Rfld][Grp] + (~w_byte) + 1);
-            if (((GR[Rfld][Grp] & 0x0FFFF) +   /* Overflow from byte 0 & 1 ? */
-                 (~Ifld) + 1) & 0x10000)
-               CL_C[Grp] = ON;
-            if ((w_byte & 0xFFFF) == 0x0000)   /* Result zero ? (X-byte not include) */
-               CL_Z[Grp] = ON;
+            w_byte = (GRb[Rfld] + (~w_byte) + 1);
+            /* C: overflow from byte 0 & 1, Z: X-byte not included */
+            LATCH(LZ_CY, ((GRb[Rfld] & 0x0FFFF) + (~Ifld) + 1) & 0x1FFFF);
             w_byte &= 0x3FFFF;                 /* Remove possible overflow bit */
          }
          /* Store result back in register */
-         GR[Rfld][Grp] = w_byte;
-         break;
+         GRb[Rfld] = w_byte;
+         NEXT_INSTR;
 
-      case (0xB000):
+      OPCASE(OP_CRI)
          /* CRI  R(N),I         [RI]  */
          /* 01234567 89012345
             10110RRN I<---->I         */
-         Grp  = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld = opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0)                        /* Byte 0(H) */
-            w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[Rfld] >> 8) & 0x000FF;
          else                                  /* Byte 1(L) */
-            w_byte = GR[Rfld][Grp] & 0x000FF;
-         /* Update C&Z latches */
-         if (w_byte < Ifld)                    /* R < Ifld ? */
-            CL_C[Grp] = ON;
-         if (w_byte == Ifld)                   /* Equal ? */
-            CL_Z[Grp] = ON;
-         break;
+            w_byte = GRb[Rfld] & 0x000FF;
+         /* Update C&Z latches: R < Ifld, equal */
+         LATCH(LZ_CMP, w_byte - Ifld);
+         NEXT_INSTR;
 
-      case (0xC000):
+      OPCASE(OP_XRI)
          /* XRI  R(N),I         [RI]  */
          /* 01234567 89012345
             11000RRN I<---->I         */
-         Grp  = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = GR[Rfld][Grp] ^ (Ifld << 8);  /* XR */
+            GRb[Rfld] = GRb[Rfld] ^ (Ifld << 8);          /* XR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x0FF00);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = GR[Rfld][Grp] ^ (Ifld);   /* XR */
+            GRb[Rfld] = GRb[Rfld] ^ (Ifld);           /* XR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x000FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0xD000):
+      OPCASE(OP_ORI)
          /* ORI  R(N),I         [RI]  */
          /* 01234567 89012345
             11010RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = GR[Rfld][Grp] | (Ifld << 8);  /* OR */
+            GRb[Rfld] = GRb[Rfld] | (Ifld << 8);          /* OR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x0FF00);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = GR[Rfld][Grp] | (Ifld);   /* OR */
+            GRb[Rfld] = GRb[Rfld] | (Ifld);           /* OR */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x000FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0xE000):
+      OPCASE(OP_NRI)
          /* NRI  R(N),I         [RI]  */
          /* 01234567 89012345
             11100RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0) {                      /* Byte 0(H) */
             Ifld = (Ifld << 8) | 0x300FF;
-            GR[Rfld][Grp] = GR[Rfld][Grp] & Ifld;     /* AND */
+            GRb[Rfld] = GRb[Rfld] & Ifld;             /* AND */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x0FF00) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x0FF00);
          } else {                              /* Byte 1(L) */
             Ifld = Ifld | 0x3FF00;
-            GR[Rfld][Grp] = GR[Rfld][Grp] & Ifld;    /* AND */
+            GRb[Rfld] = GRb[Rfld] & Ifld;            /* AND */
             /* Update C&Z latches */
-            if ((GR[Rfld][Grp] & 0x000FF) == 0x00000)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            LATCH(LZ_NZ, GRb[Rfld] & 0x000FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0xF000):
+      OPCASE(OP_TRM)
          /* TRM  R(N),I         [RI]  */
          /* 01234567 89012345
             11110RRN I<---->I         */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
          Ifld =  opcode1;
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          if (Nfld == 0)                        /* Byte 0(H) */
-            w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[Rfld] >> 8) & 0x000FF;
          else                                  /* Byte 1(L) */
-            w_byte = GR[Rfld][Grp] & 0x000FF;
+            w_byte = GRb[Rfld] & 0x000FF;
          /* Update C&Z latches */
-         if ((w_byte & Ifld) == 0x00)
-            CL_Z[Grp] = ON;
-         else
-            CL_C[Grp] = ON;
-         break;
-   }
+         LATCH(LZ_NZ, w_byte & Ifld);
+         NEXT_INSTR;
 
-   switch (opcode & 0x88FF) {
-      case (0x0008):
+      OPCASE(OP_LCR)
          /* LCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 00001000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract reg 1 nr */
          N1fld = ( opcode0 & 0x01);
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
          /* Store it the selected byte of R1 */
          if (N1fld == 0)                       /* Byte 0(H) */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x000FF) | (w_byte << 8);
+            GRb[R1fld] = (GRb[R1fld] & 0x000FF) | (w_byte << 8);
          else                                  /* Byte 1(L) */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x0FF00) | w_byte;
-         /* Set Z Latch if selected byte == 0x00 */
-         if (w_byte == 0x00)
-            CL_Z[Grp] = ON;
-         /* Determine if nr of bits is odd or even and set C latch accordingly */
-         j = 0;
-         for (int i = 8; i != 0; i--) {
-            j += w_byte & 0x01;                /* Count the one bits */
-            w_byte >>= 1;
-         }
-         if (j == 0 | j == 2 | j == 4 | j == 6 | j == 8)
-            CL_C[Grp] = ON;                    /* Update C latch */
-         else
-            CL_C[Grp] = OFF;
-         break;
+            GRb[R1fld] = (GRb[R1fld] & 0x0FF00) | w_byte;
+         /* Z if selected byte == 0x00, C if nr of bits is even */
+         LATCH(LZ_PAR, w_byte);
+         NEXT_INSTR;
 
-      case (0x0018):
+      OPCASE(OP_ACR)
          /* ACR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 00011000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract reg 1 nr */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
          /* Perform ADD with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) result */
-            w_byte = GR[R1fld][Grp] + (w_byte << 8);
-            if ((w_byte & 0x0FF00) == 0x00)    /* Zero ? */
-               CL_Z[Grp] = ON;
+            w_byte = GRb[R1fld] + (w_byte << 8);
+            j = ((w_byte & 0x0FF00) == 0x00);  /* Zero ? */
          } else {                              /* Byte 0 & 1 result */
-            w_byte = GR[R1fld][Grp] + w_byte;
-            if ((w_byte & 0x0FFFF) == 0x00000) /* Zero ? */
-               CL_Z[Grp] = ON;
+            w_byte = GRb[R1fld] + w_byte;
+            j = ((w_byte & 0x0FFFF) == 0x00000);   /* Zero ? */
          }
          /* Byte 0 overflow ? */
-         if ((w_byte & 0x7F0000) > (GR[R1fld][Grp] & 0x7F0000))
-            CL_C[Grp] = ON;
+         if ((w_byte & 0x7F0000) > (GRb[R1fld] & 0x7F0000))
+            j |= 2;
+         LATCH(LZ_CZ, j);
          /* Remove possible X byte overflow bit and save the result */
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;
-         break;
+         GRb[R1fld] = w_byte & 0x3FFFF;
+         NEXT_INSTR;
 
-      case (0x0028):
+      OPCASE(OP_SCR)
          /* SCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 00101000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract reg 1 nr */
          N1fld = ( opcode0 & 0x01);
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          int32 R2H, R2L;
 
          if (N1fld == 0) {                     /* R1 = Byte 0(H) only */
             if (N2fld == 0) {                  /* R2 = Byte 0(H)  */
                                      /* SCR: R1(H.) = R1(H.) - R2(H.) */
-               w_byte = (GR[R2fld][Grp]) & 0x0FF00;
+               w_byte = (GRb[R2fld]) & 0x0FF00;
             } else {                           /* R2 = Byte 1(L) */
                                      /* SCR: R1(H.) = R1(H.) - R2(.L) */
-               w_byte = (GR[R2fld][Grp] << 8) & 0x0FF00;
+               w_byte = (GRb[R2fld] << 8) & 0x0FF00;
             }
-            if (w_byte > (GR[R1fld][Grp] & 0x0FF00))  /* Result < 0 ? */
-               CL_C[Grp] = ON;
+            j = (w_byte > (GRb[R1fld] & 0x0FF00)) << 1;   /* Result < 0 ? */
             R2H = ~(w_byte);
             R2H = (R2H + 0x00100) & 0x3FF00;   /* 2-complement */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2H) & 0x3FFFF;
-            if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)   /* Result zero ?*/
-               CL_Z[Grp] = ON;
+            GRb[R1fld] = (GRb[R1fld] + R2H) & 0x3FFFF;
+            j |= ((GRb[R1fld] & 0x0FF00) == 0x00);       /* Result zero ?*/
 
          } else {     /* N1fld == 1 */         /* R1 = Byte H & L */
 
             if (N2fld == 0) {                  /* R2 = Byte 0(H)  */
                                      /* SCR: R1(HL) = R1(HL) - R2(H.) */
-               w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+               w_byte = (GRb[R2fld] >> 8) & 0x000FF;
             } else {                           /* R2 = Byte 1(L)  */
                                      /* SCR: R1(HL) = R1(HL) - R2(.L) */
-               w_byte = (GR[R2fld][Grp]) & 0x000FF;
+               w_byte = (GRb[R2fld]) & 0x000FF;
             }
-            if (w_byte > (GR[R1fld][Grp] & 0x0FFFF))  /* Result < 0 ? */
-               CL_C[Grp] = ON;
+            j = (w_byte > (GRb[R1fld] & 0x0FFFF)) << 1;   /* Result < 0 ? */
             R2L = ~(w_byte);
             R2L = (R2L + 1) & 0x3FFFF;         /* 2-complement */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] + R2L) & 0x3FFFF;
-            if ((GR[R1fld][Grp] & 0x0FFFF) == 0x0000) /* Result zero ?*/
-               CL_Z[Grp] = ON;
+            GRb[R1fld] = (GRb[R1fld] + R2L) & 0x3FFFF;
+            j |= ((GRb[R1fld] & 0x0FFFF) == 0x0000);     /* Result zero ?*/
          }
-         break;
+         LATCH(LZ_CZ, j);
+         NEXT_INSTR;
 
-      case (0x0038):
+      OPCASE(OP_CCR)
          /* CCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 00111000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract reg 1 nr */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the required byte from R2 */
          if (N2fld == 0)
-            w_byte = (GR[R2fld][Grp] >> 8);    /* Byte 0(H) */
+            w_byte = (GRb[R2fld] >> 8);        /* Byte 0(H) */
          else
-            w_byte = GR[R2fld][Grp];           /* Byte 1(L) */
+            w_byte = GRb[R2fld];               /* Byte 1(L) */
          w_byte = w_byte & 0x000FF;
 
          /* Perform a compare between the selected regs */
-         if (N1fld == 0) {                     /* Byte 0(H) */
-            if ((( GR[R1fld][Grp] >> 8) & 0x000FF) < w_byte)
-               CL_C[Grp] = ON;
-            if ((( GR[R1fld][Grp] >> 8) & 0x000FF) == w_byte)
-               CL_Z[Grp] = ON;
-         } else {                              /* Byte 1(L) */
-            if (( GR[R1fld][Grp] & 0x000FF) < w_byte)
-               CL_C[Grp] = ON;
-            if (( GR[R1fld][Grp] & 0x000FF) == w_byte)
-               CL_Z[Grp] = ON;
-         }
-         break;
+         if (N1fld == 0)                       /* Byte 0(H) */
+            j = ( GRb[R1fld] >> 8) & 0x000FF;
+         else                                  /* Byte 1(L) */
+            j = GRb[R1fld] & 0x000FF;
+         LATCH(LZ_CMP, j - w_byte);
+         NEXT_INSTR;
 
-      case (0x0048):
+      OPCASE(OP_XCR)
          /* XCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 01001000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract odd reg 1 nr */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
          /* Perform XOR with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) */
-            GR[R1fld][Grp] ^= (w_byte << 8);
-            if ((GR[R1fld][Grp] & 0xFF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] ^= (w_byte << 8);
+            LATCH(LZ_NZ, GRb[R1fld] & 0xFF00);
          } else {                              /* Byte 1(L) */
-            GR[R1fld][Grp] ^= w_byte;
-            if ((GR[R1fld][Grp] & 0x00FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] ^= w_byte;
+            LATCH(LZ_NZ, GRb[R1fld] & 0x00FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x0058):
+      OPCASE(OP_OCR)
          /* OCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 01011000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract odd reg 1 nr */
          N1fld = ( opcode0 & 0x01);
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
          /* Perform OR with the selected byte from R1 */
          if (N1fld == 0) {                     /* Byte 0(H) */
-            GR[R1fld][Grp] |= (w_byte << 8);
-            if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] |= (w_byte << 8);
+            LATCH(LZ_NZ, GRb[R1fld] & 0x0FF00);
          } else {                              /* Byte 1(L) */
-            GR[R1fld][Grp] |= w_byte;
-            if ((GR[R1fld][Grp] & 0x000FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] |= w_byte;
+            LATCH(LZ_NZ, GRb[R1fld] & 0x000FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x0068):
+      OPCASE(OP_NCR)
          /* NCR  R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 01101000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract odd reg 1 nr */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
          /* Perform AND with the selected byte from R1 */
          if (N1fld == 0) {
-            GR[R1fld][Grp] &= ((w_byte << 8) | 0x300FF);
-            if ((GR[R1fld][Grp] & 0x0FF00) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] &= ((w_byte << 8) | 0x300FF);
+            LATCH(LZ_NZ, GRb[R1fld] & 0x0FF00);
          } else {
-            GR[R1fld][Grp] &= (w_byte | 0x3FF00);
-            if ((GR[R1fld][Grp] & 0x000FF) == 0x00)
-               CL_Z[Grp] = ON;
-            else
-               CL_C[Grp] = ON;
+            GRb[R1fld] &= (w_byte | 0x3FF00);
+            LATCH(LZ_NZ, GRb[R1fld] & 0x000FF);
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x0078):
+      OPCASE(OP_LCOR)
          /* LCOR R1(N1),R2(N2)  [RR]  */
          /* 01234567 89012345
             0R2N0R1N 01111000         */
-         Grp = RegGrp(lvl);
          R1fld = ( opcode0 & 0x06) + 1;        /* Extract odd reg 1 nr */
          R2fld = ((opcode0 & 0x60) >> 4) + 1;  /* Extract odd reg 2 nr */
          N1fld = ( opcode0 & 0x01);
          N2fld = ((opcode0 & 0x10) >> 4);
-         /* Reset Z&C latches */
-         CL_Z[Grp] = OFF;
-         CL_C[Grp] = OFF;
 
          /* Fetch the selected byte from R2 */
          if (N2fld == 0)                       /* Byte 0(H) */
-            w_byte = (GR[R2fld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[R2fld] >> 8) & 0x000FF;
          else
-            w_byte = GR[R2fld][Grp] & 0x000FF; /* Byte 1(L) */
+            w_byte = GRb[R2fld] & 0x000FF;     /* Byte 1(L) */
 
-         /* Determine C latch and Shift one byte to the right */
-         if ((w_byte & 0x00001) == 0x0001)     /* Will we loose a one bit? */
-            CL_C[Grp] = ON;
+         /* C if we loose a one bit, Z if the shifted byte is zero */
+         LATCH(LZ_CZ, ((w_byte & 0x00001) << 1) | ((w_byte >> 1) == 0x00));
          w_byte = w_byte >> 1;                 /* Shift 1 bit right */
 
          /* Store it the selected byte of R1 */
          if (N1fld == 0)                       /* Byte 0(H) */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x000FF) | (w_byte << 8);
+            GRb[R1fld] = (GRb[R1fld] & 0x000FF) | (w_byte << 8);
          else                                  /* Byte 1(L) */
-            GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x0FF00) | w_byte;
-         /* Set Z Latch */
-         if (w_byte == 0x00)
-            CL_Z[Grp] = ON;
-         break;
+            GRb[R1fld] = (GRb[R1fld] & 0x0FF00) | w_byte;
+         NEXT_INSTR;
 
-      case (0x0010):
+      OPCASE(OP_ICT)
          /* ICT  R(N),B         [RSA] */
          /* 01234567 89012345
             0BBB0RRN 00010000         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x007;
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
 
-         addr = GR[Bfld][Grp];                 /* See PoO 4-9 */
+         addr = GRb[Bfld];                     /* See PoO 4-9 */
          w_byte = GetMem(addr);
-         GR[Bfld][Grp] = GR[Bfld][Grp] + 1;
+         GRb[Bfld] = GRb[Bfld] + 1;
          if (Nfld == 0) {                      /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (w_byte << 8);
+            GRb[Rfld] = (GRb[Rfld] & 0x300FF) | (w_byte << 8);
          } else {                              /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | w_byte;
+            GRb[Rfld] = (GRb[Rfld] & 0x3FF00) | w_byte;
          }
-         break;
+         NEXT_INSTR;
 
-      case (0x0030):
+      OPCASE(OP_STCT)
          /* STCT R(N),B         [RSA] */
          /* 01234567 89012345
             0BBB0RRN 00110000         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x007;
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
 
-         addr = GR[Bfld][Grp];                 /* See PoO 4-13 */
-         GR[Bfld][Grp] = GR[Bfld][Grp] + 1;
+         addr = GRb[Bfld];                     /* See PoO 4-13 */
+         GRb[Bfld] = GRb[Bfld] + 1;
          if (Nfld == 0)                        /* Byte 0(H) */
-            w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[Rfld] >> 8) & 0x000FF;
          else
-            w_byte = GR[Rfld][Grp] & 0x000FF;  /* Byte 1(L) */
+            w_byte = GRb[Rfld] & 0x000FF;      /* Byte 1(L) */
          PutMem(addr, w_byte);
-         break;
-   }
+         NEXT_INSTR;
 
-   switch (opcode & 0x8880) {
-      case (0x0800):
+      OPCASE(OP_IC)
          /* IC   R(N),D(B)      [RS]  */
          /* 01234567 89012345
             0BBB1RRN 0D<--->D         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x007;
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
          Nfld = (opcode0 & 0x01);
@@ -1412,36 +1514,22 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00680 + Dfld;             /* See PoO 4-9 */
          else
-            addr = GR[Bfld][Grp] + Dfld;
+            addr = GRb[Bfld] + Dfld;
          w_byte = GetMem(addr);
 
          if (Nfld == 0)                        /* Byte 0(H) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x300FF) | (w_byte << 8);
+            GRb[Rfld] = (GRb[Rfld] & 0x300FF) | (w_byte << 8);
          else                                  /* Byte 1(L) */
-            GR[Rfld][Grp] = (GR[Rfld][Grp] & 0x3FF00) | w_byte;
+            GRb[Rfld] = (GRb[Rfld] & 0x3FF00) | w_byte;
 
-         /* Test the selected byte (w_byte) */
-         if (w_byte == 0x00)
-            CL_Z[Grp] = ON;
-         else
-            CL_Z[Grp] = OFF;
-         /* Determine if nr of bits is odd or even and set C latch accordingly */
-         j = 0;
-         for (int i = 8; i != 0; i--) {
-            j += w_byte & 0x01;                /* Count the one bits */
-            w_byte >>= 1;
-         }
-         if (j == 0 | j == 2 | j == 4 | j == 6 | j == 8)
-            CL_C[Grp] = ON;
-         else
-            CL_C[Grp] = OFF;
-         break;
+         /* Z if the selected byte is zero, C if nr of bits is even */
+         LATCH(LZ_PAR, w_byte);
+         NEXT_INSTR;
 
-      case (0x0880):
+      OPCASE(OP_STC)
          /* STC  R(N),D(B)      [RS]  */
          /* 01234567 89012345
             0BBB1RRN 1D<--->D         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x07;
          Dfld = (opcode1) & 0x7F;
          Rfld = (opcode0 & 0x06) + 1;          /* Extract odd register nr */
@@ -1450,22 +1538,19 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00680 + Dfld;             /* See PoO 4-13 */
          else
-            addr = GR[Bfld][Grp] + Dfld;
+            addr = GRb[Bfld] + Dfld;
 
          if (Nfld == 0)
-            w_byte = (GR[Rfld][Grp] >> 8) & 0x000FF;
+            w_byte = (GRb[Rfld] >> 8) & 0x000FF;
          else
-            w_byte = (GR[Rfld][Grp] & 0x000FF);
+            w_byte = (GRb[Rfld] & 0x000FF);
          PutMem(addr, w_byte);
-         break;
-   }
+         NEXT_INSTR;
 
-   switch (opcode & 0x8881) {
-      case (0x0001):
+      OPCASE(OP_LH)
          /* LH   R,D(B)         [RS]  */
          /* 01234567 89012345
             0BBB0RRR 0D<-->D1         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x007;
          Dfld = (opcode1) & 0x7E;
          Rfld = (opcode0) & 0x007;             /* Extract register nr */
@@ -1473,31 +1558,24 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00700 + Dfld;             /* See PoO 4-10 */
          else
-            addr = (GR[Bfld][Grp] + Dfld);
+            addr = (GRb[Bfld] + Dfld);
          addr &= 0x3FFFE;                      /* Force HW boundary */
 
          w_byte = GetMem(addr) << 8;
          addr++;
          w_byte = w_byte | GetMem(addr);
          old_crc = w_byte;
-         GR[Rfld][Grp] = w_byte;               /* X-byte = 0 */
+         GRb[Rfld] = w_byte;                   /* X-byte = 0 */
          if (Rfld == 0) break;                 /* New IAR ! */
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, w_byte);
+         NEXT_INSTR;
 
-      case (0x0081):
+      OPCASE(OP_STH)
          /* STH  R,D(B)         [RS]  */
          /* 01234567 89012345
             0BBB0RRR 1D<-->D1         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x007;
          Rfld = (opcode0) & 0x007;             /* Extract register nr */
          Dfld = (opcode1) & 0x7E;
@@ -1505,26 +1583,23 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00700 + Dfld;             /* See PoO 4-4 */
          else
-            addr = (GR[Bfld][Grp] + Dfld);
+            addr = (GRb[Bfld] + Dfld);
          addr &= 0x3FFFE;                      /* Force HW boundary */
 
          if (Rfld > 0) {
-            PutMem(addr, (GR[Rfld][Grp] >> 8) & 0x000FF);
+            PutMem(addr, (GRb[Rfld] >> 8) & 0x000FF);
             addr++;
-            PutMem(addr, GR[Rfld][Grp] & 0x000FF);
+            PutMem(addr, GRb[Rfld] & 0x000FF);
          } else {
             PutMem(addr,   0x00);
             PutMem(addr+1, 0x00);
          }
-         break;
-   }
+         NEXT_INSTR;
 
-   switch (opcode & 0x8883) {
-      case (0x0002):
+      OPCASE(OP_L)
          /* L    R,D(B)         [RS]  */
          /* 01234567 89012345
             0BBB0RRR 0D<->D10         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x07;
          Dfld = (opcode1) & 0x7C;              /* Dfld at fullword boundary */
          Rfld = (opcode0) & 0x07;              /* Extract register nr */
@@ -1532,30 +1607,23 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00780 + Dfld;             /* See PoO 4-10 */
          else
-            addr = (GR[Bfld][Grp] + Dfld);
+            addr = (GRb[Bfld] + Dfld);
          addr &= 0x3FFFE;                      /* Force HW boundary */
 
          w_byte = (GetMem(addr+1) & 0x03) << 16; /* Load X-byte */
          w_byte |= GetMem(addr+2) << 8;        /* Byte 0(H) */
          w_byte |= GetMem(addr+3);             /* Byte 1(L) */
-         GR[Rfld][Grp] = w_byte;
+         GRb[Rfld] = w_byte;
          if (Rfld == 0) break;                 /* New IAR ! */
 
-         /* Update C&Z latches */
-         if (w_byte == 0x00000) {              /* Test includes X-byte */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         /* Update C&Z latches, test includes X-byte */
+         LATCH(LZ_NZ, w_byte);
+         NEXT_INSTR;
 
-      case (0x0082):
+      OPCASE(OP_ST)
          /* ST   R,D(B)         [RS]  */
          /* 01234567 89012345
             0BBB0RRR 1D<->D10         */
-         Grp = RegGrp(lvl);
          Bfld = (opcode0 >> 4) & 0x07;
          Dfld = (opcode1) & 0x7C;              /* Dfld at fullword boundary */
          Rfld = (opcode0) & 0x07;              /* Extract register nr */
@@ -1563,14 +1631,14 @@ while (reason == 0) {                          /* Loop until halted */
          if (Bfld == 0)
             addr = 0x00780 + Dfld;             /* See PoO 4-12 */
          else
-            addr = (GR[Bfld][Grp] + Dfld);
+            addr = (GRb[Bfld] + Dfld);
          addr &= 0x3FFFE;                      /* Force HW boundary */
 
          if (Rfld > 0) {
-            PutMem(addr+3,  GR[Rfld][Grp] & 0xFF);
-            PutMem(addr+2, (GR[Rfld][Grp] >> 8) & 0xFF);
+            PutMem(addr+3,  GRb[Rfld] & 0xFF);
+            PutMem(addr+2, (GRb[Rfld] >> 8) & 0xFF);
             w_byte = GetMem(addr+1) & 0xFC;    /* Keep the high 6 bits */
-            PutMem(addr+1, w_byte | ((GR[Rfld][Grp] >> 16) & 0x03));
+            PutMem(addr+1, w_byte | ((GRb[Rfld] >> 16) & 0x03));
          } else {
             PutMem(addr+3, 0x00);              /* Clear mem locations */
             PutMem(addr+2, 0x00);
@@ -1578,817 +1646,387 @@ while (reason == 0) {                          /* Loop until halted */
             PutMem(addr+1, w_byte);            /* Clear X-byte bits */
          }
          // NOTE: special condition ST inst at loc 0x0010 to be implemented !!
-         break;
-   }
+         NEXT_INSTR;
 
-   switch (opcode & 0x88FF) {
-      case (0x0080):
+      OPCASE(OP_LHR)
          /* LHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10000000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x07);            /* Extract register 1 */
 
-         w_byte = GR[R2fld][Grp] & 0x0FFFF;    /* Load R1 with contents of R2 */
-         GR[R1fld][Grp] = w_byte;
+         w_byte = GRb[R2fld] & 0x0FFFF;        /* Load R1 with contents of R2 */
+         GRb[R1fld] = w_byte;
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld]);
+         NEXT_INSTR;
 
-      case (0x0090):
+      OPCASE(OP_AHR)
          /* AHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10001000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = (GR[R1fld][Grp] & 0xFFFF) + (GR[R2fld][Grp] & 0xFFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | (w_byte & 0xFFFF);
+         w_byte = (GRb[R1fld] & 0xFFFF) + (GRb[R2fld] & 0xFFFF);
+         GRb[R1fld] = (GRb[R1fld] & 0x30000) | (w_byte & 0xFFFF);
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x10000)                 /* Overflow ? */
-            CL_C[Grp] = ON;
-         if ((w_byte & 0xFFFF) == 0x0000)      /* Result 0 ? */
-            CL_Z[Grp] = ON;
-         break;
+         /* Update C&Z latches: overflow, result 0 */
+         LATCH(LZ_CY, w_byte);
+         NEXT_INSTR;
 
-      case (0x00A0):
+      OPCASE(OP_SHR)
          /* SHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10011000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R1fld][Grp] + ~(GR[R2fld][Grp]) + 1;
-         GR[R1fld][Grp] = w_byte & 0xFFFF;     /* Remove possible overflow bit */
+         w_byte = GRb[R1fld] + ~(GRb[R2fld]) + 1;
+         GRb[R1fld] = w_byte & 0xFFFF;         /* Remove possible overflow bit */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x10000)                 /* Result < 0 ? */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x0000)         /* Result == 0 ? */
-            CL_Z[Grp] = ON;
-         break;
+         /* Update C&Z latches: result < 0, result == 0 */
+         LATCH(LZ_CY, w_byte & 0x1FFFF);
+         NEXT_INSTR;
 
-      case (0x00B0):
+      OPCASE(OP_CHR)
          /* CHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10110000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-
-         /* Test if R1 is < R2 */
-         if ((GR[R1fld][Grp] & 0xFFFF) ==      /* Compare for equal */
-             (GR[R2fld][Grp] & 0xFFFF))
-            CL_Z[Grp] = ON;
-         if ((GR[R1fld][Grp] & 0xFFFF) <       /* Compare for less */
-             (GR[R2fld][Grp] & 0xFFFF))
-            CL_C[Grp] = ON;
-         break;
 
-      case (0x00C0):
+         /* Compare R1 with R2 for equal and less */
+         LATCH(LZ_CMP, (GRb[R1fld] & 0xFFFF) - (GRb[R2fld] & 0xFFFF));
+         NEXT_INSTR;
+
+      OPCASE(OP_XHR)
          /* XHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11000000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = (GR[R1fld][Grp] & 0x0FFFF) ^ (GR[R2fld][Grp] & 0x0FFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0xF0000) | w_byte;  /* XHR */
+         w_byte = (GRb[R1fld] & 0x0FFFF) ^ (GRb[R2fld] & 0x0FFFF);
+         GRb[R1fld] = (GRb[R1fld] & 0xF0000) | w_byte;          /* XHR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, w_byte);
+         NEXT_INSTR;
 
-      case (0x00D0):
+      OPCASE(OP_OHR)
          /* OHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11010000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = (GR[R1fld][Grp] & 0x0FFFF) | (GR[R2fld][Grp] & 0x0FFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | w_byte;  /* OHR */
+         w_byte = (GRb[R1fld] & 0x0FFFF) | (GRb[R2fld] & 0x0FFFF);
+         GRb[R1fld] = (GRb[R1fld] & 0x30000) | w_byte;          /* OHR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if ((GR[R1fld][Grp] & 0xFFFF) == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld] & 0xFFFF);
+         NEXT_INSTR;
 
-      case (0x00E0):
+      OPCASE(OP_NHR)
          /* NHR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11100000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = (GR[R1fld][Grp] & 0x0FFFF) & (GR[R2fld][Grp] & 0x0FFFF);
-         GR[R1fld][Grp] = (GR[R1fld][Grp] & 0x30000) | w_byte;  /* NHR */
+         w_byte = (GRb[R1fld] & 0x0FFFF) & (GRb[R2fld] & 0x0FFFF);
+         GRb[R1fld] = (GRb[R1fld] & 0x30000) | w_byte;          /* NHR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (w_byte == 0x0000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, w_byte);
+         NEXT_INSTR;
 
-      case (0x00F0):
+      OPCASE(OP_LHOR)
          /* LHOR R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11110000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R2fld][Grp];
-         GR[R1fld][Grp] = (GR[R2fld][Grp] & 0x0FFFF) >> 1; /* Shift 1 bit to the right */
-         if (Rfld == 0) break;                 /* New IAR ! */
+         w_byte = GRb[R2fld];
+         GRb[R1fld] = (GRb[R2fld] & 0x0FFFF) >> 1;         /* Shift 1 bit to the right */
+         if (R1fld == 0) break;                /* New IAR ! */
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
          /* Update C&Z latches */
          /* If a 1 bit will be shifted out, set C latch */
-         if (w_byte & 0x00001)
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)
-            CL_Z[Grp] = ON;
-         break;
+         LATCH(LZ_CZ, ((w_byte & 0x00001) << 1) | (GRb[R1fld] == 0x00000));
+         NEXT_INSTR;
 
-      case (0x0088):
+      OPCASE(OP_LR)
          /* LR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10001000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         GR[R1fld][Grp] = GR[R2fld][Grp];      /* Load R1 with contents of R2 */
+         GRb[R1fld] = GRb[R2fld];              /* Load R1 with contents of R2 */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld]);
+         NEXT_INSTR;
 
-      case (0x0098):
+      OPCASE(OP_AR)
          /* AR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10011000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R1fld][Grp] + GR[R2fld][Grp];
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;    /* Remove possible overflow bit */
+         w_byte = GRb[R1fld] + GRb[R2fld];
+         GRb[R1fld] = w_byte & 0x3FFFF;        /* Remove possible overflow bit */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x40000)                 /* Bit 21 overflow ? */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)
-            CL_Z[Grp] = ON;
-         break;
+         /* Update C&Z latches: bit 21 overflow, result zero */
+         LATCH(LZ_CY18, w_byte & 0x7FFFF);
+         NEXT_INSTR;
 
-      case (0x00A8):
+      OPCASE(OP_SR)
          /* SR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10101000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R1fld][Grp] + ~(GR[R2fld][Grp]) + 1;   /* SR */
-         GR[R1fld][Grp] = w_byte & 0x3FFFF;    /* Remove possible overflow bit */
+         w_byte = GRb[R1fld] + ~(GRb[R2fld]) + 1;           /* SR */
+         GRb[R1fld] = w_byte & 0x3FFFF;        /* Remove possible overflow bit */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-         /* Update C&Z latches */
-         if (w_byte & 0x40000)                 /* X-byte included */
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)
-            CL_Z[Grp] = ON;
-         break;
+         /* Update C&Z latches, X-byte included */
+         LATCH(LZ_CY18, w_byte & 0x7FFFF);
+         NEXT_INSTR;
 
-      case (0x00B8):
+      OPCASE(OP_CR)
          /* CR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 10110000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
-
-         /* Test if R1 is < R2 */                           /* CR */
-         if (GR[R1fld][Grp] == GR[R2fld][Grp]) /* Compare for equal */
-            CL_Z[Grp] = ON;
-         if (GR[R1fld][Grp] < GR[R2fld][Grp])  /* Compare for less */
-            CL_C[Grp] = ON;
-         break;
 
-         if (GR[R1fld][Grp] < GR[R2fld][Grp])  /* Compare for less */
-            CL_C[Grp] = ON;
-         break;
+         /* Compare R1 with R2 for equal and less */       /* CR */
+         LATCH(LZ_CMP, GRb[R1fld] - GRb[R2fld]);
+         NEXT_INSTR;
 
-      case (0x00C8):
+      OPCASE(OP_XR)
          /* XR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11001000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         GR[R1fld][Grp] = GR[R1fld][Grp] ^ GR[R2fld][Grp];  /* XR */
+         GRb[R1fld] = GRb[R1fld] ^ GRb[R2fld];              /* XR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld]);             /* Result zero ? */
+         NEXT_INSTR;
 
-      case (0x00D8):
+      OPCASE(OP_OR)
          /* OR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11011000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         GR[R1fld][Grp] = GR[R1fld][Grp] | GR[R2fld][Grp];  /* OR */
+         GRb[R1fld] = GRb[R1fld] | GRb[R2fld];              /* OR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld]);             /* Result zero ? */
+         NEXT_INSTR;
 
-      case (0x00E8):
+      OPCASE(OP_NR)
          /* NR   R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11101000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         GR[R1fld][Grp] = GR[R1fld][Grp] & GR[R2fld][Grp];  /* NR */
+         GRb[R1fld] = GRb[R1fld] & GRb[R2fld];              /* NR */
          /* If R1 = Register 0, a branch to newly formed address occurs */
          if (R1fld == 0) break;
 
          /* Update C&Z latches */
-         if (GR[R1fld][Grp] == 0x00000) {      /* Result zero ? */
-            CL_Z[Grp] = ON;
-            CL_C[Grp] = OFF;
-         } else {
-            CL_Z[Grp] = OFF;
-            CL_C[Grp] = ON;
-         }
-         break;
+         LATCH(LZ_NZ, GRb[R1fld]);             /* Result zero ? */
+         NEXT_INSTR;
 
-      case (0x00F8):
+      OPCASE(OP_LOR)
          /* LOR  R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 11111000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R2fld][Grp];
-         GR[R1fld][Grp] = GR[R2fld][Grp] >> 1; /* Shift 1 bit to the right */
-         GR[R1fld][Grp] &= 0x1FFFF;            /* Make sure a 0 is inserted */
-         if (Rfld == 0) break;                 /* New IAR ! */
+         w_byte = GRb[R2fld];
+         GRb[R1fld] = GRb[R2fld] >> 1;         /* Shift 1 bit to the right */
+         GRb[R1fld] &= 0x1FFFF;                /* Make sure a 0 is inserted */
+         if (R1fld == 0) break;                /* New IAR ! */
 
-         /* Reset C&Z latches */
-         CL_C[Grp] = OFF;
-         CL_Z[Grp] = OFF;
          /* Update C&Z latches */
          /* If a 1 bit will be shifted out, set C latch */
-         if (w_byte & 0x00001)
-            CL_C[Grp] = ON;
-         if (GR[R1fld][Grp] == 0x00000)        /* Result zero ? */
-            CL_Z[Grp] = ON;
-         break;
+         LATCH(LZ_CZ, ((w_byte & 0x00001) << 1) | (GRb[R1fld] == 0x00000));
+         NEXT_INSTR;
 
-      case (0x0040):
+      OPCASE(OP_BALR)
          /* BALR R1,R2          [RR]  */
          /* 01234567 89012345
             0R2R0R1R 01000000         */
-         Grp = RegGrp(lvl);
          R2fld = ((opcode0 & 0x70) >> 4);      /* Extract register 2 */
          R1fld = ( opcode0 & 0x007);           /* Extract register 1 */
 
-         w_byte = GR[R2fld][Grp];              /* See PoO 4-7 */
+         w_byte = GRb[R2fld];                  /* See PoO 4-7 */
          if (R1fld > 0)
-            GR[R1fld][Grp] = GR[0][Grp];       /* Save addr next seq instr. */
+            GRb[R1fld] = GRb[0];               /* Save addr next seq instr. */
          if (R2fld > 0)
-            GR[0][Grp] = w_byte;               /* New IAR */
-         break;
-   }
+            GRb[0] = w_byte;                   /* New IAR */
+         NEXT_INSTR;
 
-   switch (opcode & 0x880F) {
-      case (0x000C):
+      OPCASE(OP_IN)
          /* IN   R,E            [RE]  */
          /* 01234567 89012345
             0EEE0RRR EEEE1100         */
-         Grp = RegGrp(lvl);
          Efld = (opcode0  & 0x70) | (opcode1 >> 4);
          Rfld = (opcode0) & 0x007;             /* Extract register nr */
 
          if (lvl == 5) {                       // && (test_mode == OFF)) {
-            IO_L5_chk = ON;                    /* Check: I/O instr in level 5 ! */
+            IRQ_SET(IRQ_IOL5_L1);              /* Check: I/O instr in level 5 ! */
             break;
          }
          if (Efld < 0x20) {                    /* Input from GR's ? */
-            GR[Rfld][Grp] = GR[Efld & 0x007][Efld >> 3];
+            ereg_nin[Efld]++;
+            GRb[Rfld] = GR[Efld >> 3][Efld & 0x007];
          } else {
-            // An Input x'40' will reset L2 req
-            if ((Efld == 0x40) && (lvl == 2)) {
-               abar = abar_int;                /* Get abar the of L2 line interrupt */
-               Eregs_Inp[0x40] = 0x0800 + (abar << 1);  /* Get vector @ of L2 interrupt */
-               pthread_mutex_lock(&r77_lock);
-               Eregs_Inp[0x77] &= ~0x4000;     /* Reset L2 flag */
-               // An Input x'40' will reset L2 req
-               svc_req_L2 = OFF;               /* Reset L2 request flag */
-               pthread_mutex_unlock(&r77_lock);
-            } else {
-               // Read ABAR when executing in L3 or L4.
-               Eregs_Inp[0x40] = 0x0800 + (abar << 1);  /* Echo abar */
-            }
-
-            if ((Efld >= 0x40) && Efld <= 0x47) {   // Addressing CS2 ICW regs ?
-               // ICW Input register ===> Eregs_Out 44, 45, 46, 47
-               Get_ICW(abar-0x020);                 // Update ICW input regs (0x44...0x47)
-            }
-
-            if (Efld == 0x44) {                     // NCP has read received byte
-               if (icw_pcf[abar-0x020] == 0x07)     // TEMP PDF is now empty for next rx
-                  icw_pdf_reg[abar-0x020] = EMPTY;
-            }
-
-            //********************************************************
-            //          Channel Adaptor Type 2 updates
-            //********************************************************
-            if (Efld == 0x50) {                     // Get INCWAR ?
-               Eregs_Inp[0x50] = Eregs_Out[0x50];   // Load INCWAR as used by CA
-            }
-            if (Efld == 0x51) {                     // Get OUTCWAR ?
-               Eregs_Inp[0x51] = Eregs_Out[0x51];   // Load OUTCWAR as used by CA
-            }
-            if (Efld == 0x59) {                     // Get Cycle Steal Address Register ?
-               if (Eregs_Inp[0x59] & 0x10000) {     // if X-bit 7 on ...
-                  Eregs_Inp[0x58] |= 0x0001;        // ... set this in Channel Bus Out Register
-               } else {                             // if X-bit 6 not on ...
-                  Eregs_Inp[0x58] &= ~0x0001;       // ... reset this in Channel Bus Out Register
-               }
-               if (Eregs_Inp[0x59] & 0x20000) {     // if X-bit 6 on ...
-                  Eregs_Inp[0x58] |= 0x0002;        // ... set this in Channel Bus Out Register
-               } else {                             // if X-bit 6 not on ...
-                  Eregs_Inp[0x58] &= ~0x0002;       // ... reset this in Channel Bus Out Register
-               }
-            }
-
-            Eregs_Inp[0x74]  = LAR;                 // Update LAR
-
-            Eregs_Inp[0x79]  = 0x0000;              // Reset all bits in reg 0x79
-            Eregs_Inp[0x79] |= 0x0008;              // Fet storage installed
-            Eregs_Inp[0x79] |= 0x0001;              // CE IPL escape jumper NOT installed
-            if (CL_C[3] == ON) Eregs_Inp[0x79] |= 0x0200;  // L5 C & Z flags
-            if (CL_Z[3] == ON) Eregs_Inp[0x79] |= 0x0100;
-
-            Eregs_Inp[0x7B] = calculateBSCCrcChar(old_crc, crc_data);
-            Eregs_Inp[0x7C] = 0xF0B8;               // Good SDLC CRC.
-
-            if (Efld == 0x7D)                       // if CCU Check Register
-               if (FET_stor_diag)                   // if FET storage diagnostics
-                  Eregs_Inp[0x7D] |= 0x0C00;        // ...set SAR and SDR storage parity checks
-               else
-                  Eregs_Inp[0x7D] &= ~0x0C00;       // ...Reset SAR and SDR storage parity checks
-
-            Eregs_Inp[0x7E] = 0x0000;               // Reset all bits in reg 0x7E
-            if (adr_ex_chk)  Eregs_Inp[0x7E]  |= 0x0040;   // Address exception check
-            if (IO_L5_chk)   Eregs_Inp[0x7E]  |= 0x0020;   // I/O instr in L5
-            if (OP_reg_chk)  Eregs_Inp[0x7E]  |= 0x0008;   // OPC check
-            if (ipl_req_L1)  Eregs_Inp[0x7E]  |= 0x0002;   // IPL L1 request
-
-            Eregs_Inp[0x7F] &= 0x0204;    // Reset bits in reg 0x7F
-            if (diag_req_L2) Eregs_Inp[0x7F]  |= 0x8000;   // Diagnostic L2 request
-            //if (inter_req_L3) Eregs_Inp[0x7F] |= 0x0200; // Panel Interrupt L3
-            if (pci_req_L4) Eregs_Inp[0x7F]   |= 0x0100;   // PCI L4 request
-            //if (timer_req_L3) Eregs_Inp[0x7F] |= 0x0004; // Interval timer L3 request
-            if (pci_req_L3) Eregs_Inp[0x7F]   |= 0x0002;   // PCI L3 request
-            if (svc_req_L4) Eregs_Inp[0x7F]   |= 0x0001;   // SVC L4 request
-
-            GR[Rfld][Grp] = Eregs_Inp[Efld];   // <<=== !!!
+            GRb[Rfld] = ereg_in(Efld);         // <<=== !!!
+         }
+         if (trc_on) {
+            trc->flags |= TRC_IN;
+            trc->ereg = Efld;
+            trc->val = GRb[Rfld];
          }
          break;
 
-      case (0x0004):
+      OPCASE(OP_OUT)
          /* OUT  R,E            [RE]  */
          /* 01234567 89012345
             0EEE0RRR EEEE0100         */
-         Grp = RegGrp(lvl);
          Efld = (opcode0  & 0x70) | (opcode1 >> 4);
          Rfld = (opcode0) & 0x07;              // Extract register nr
 
          if (lvl == 5) {
-            IO_L5_chk = ON;                    // I/O instr in L5
+            IRQ_SET(IRQ_IOL5_L1);              // I/O instr in L5
             break;
          }
          if ((lvl == 2) || (lvl == 3) || (lvl == 4)) {
-            crc_data = 0xFF & GR[Rfld][Grp];   // store crc data on all OUT with level 2,3,4
+            crc_data = 0xFF & GRb[Rfld];       // store crc data on all OUT with level 2,3,4
+         }
+         if (trc_on) {
+            trc->flags |= TRC_OUT;
+            trc->ereg = Efld;
+            trc->val = GRb[Rfld];
          }
          if (Efld < 0x20) {                    // Output to GR's ?
+            ereg_nout[Efld]++;
             if (Rfld == 0) break;              // Only regen of regs parity
-            GR[Efld & 0x007][Efld >> 3] = GR[Rfld][Grp];
+            GR[Efld >> 3][Efld & 0x007] = GRb[Rfld];
          } else {
-            Eregs_Out[Efld] = GR[Rfld][Grp];   // <<=== !!! Finally update I/O reg.
-
-            //********************************************************
-            //          Communication Scanner Type 2 ICW updates
-            //********************************************************
-            if ((Efld >= 0x40) && Efld <= 0x47) {  // Addressing CS2 ICW regs ?
-               // Obtain ICW update lock
-               if ((Efld == 0x40) && ((lvl == 3) || (lvl == 4))) {
-                  // Update ABAR CS2 (only when in L3 or L4).
-                  abar = (Eregs_Out[0x40] - 0x0800) >> 1;
-               }
-
-               if (Efld == 0x44) {                   // ICW SCF & PDF
-                  if (Eregs_Out[0x44] & 0x8000) {
-                     icw_scf[abar-0x020] &= 0x7F;    // Abort RESET
-                  }
-                  if (Eregs_Out[0x44] & 0x4000) {
-                     icw_scf[abar-0x020] &= 0xBF;    // Service Interlock RESET
-                  }
-                  if (Eregs_Out[0x44] & 0x2000) {
-                     icw_scf[abar-0x020] &= 0xDF;    // Char Overrrun/Underrun flag RESET
-                  }
-                  if (Eregs_Out[0x44] & 0x1000) {
-                     icw_scf[abar-0x020] &= 0xEF;    // Modem Check RESET
-                  }
-                  if (Eregs_Out[0x44] & 0x0800) {
-                     icw_scf[abar-0x020] &= 0xF7;    // Unknown flag RESET
-                  }
-                  if (Eregs_Out[0x44] & 0x0400) {
-                     icw_scf[abar-0x020] &= 0xFB;    // Zero-insert remembrance flag RESET
-                  }
-                  icw_scf[abar-0x020] |= (Eregs_Out[0x44] >> 8) & 0x03;   // Only Serv Req, DCD & Pgm Flag
-                  icw_pdf[abar-0x020]  =  Eregs_Out[0x44] & 0x00FF;       // Update PDF
-
-                  if (icw_pcf[abar-0x020] != 0x07)      // TEMP !!!
-                     icw_pdf_reg[abar-0x020] = FILLED;  // PDF is filled for tx
-               }
-               if (Efld == 0x45) {                   // ICW LCD & PCF
-                  icw_lcd[abar-0x020] = (Eregs_Out[0x45] >> 4) & 0x0F;
-                  icw_pcf_nxt[abar-0x020] = Eregs_Out[0x45] & 0x0F;
-               }
-                                                     // ICW SDF
-               if (Efld == 0x46) icw_sdf[abar-0x020]    = (Eregs_Out[0x46] >> 2) & 0xFF;
-                                                     // ICW 34 - 45
-               if (Efld == 0x47) icw_Rflags[abar-0x020] = (Eregs_Out[0x47] << 4) & 0x0070;
-               // Release ICW update lock.
-            }
-
-            //********************************************************
-            //          Channel Adaptor Type 2 updates
-            //********************************************************
-            if (Efld == 0x53) {                // Channel Adapter Sense
-               if (Eregs_Out[0x53] & 0xFFFF)   // If any bit set...
-                  Eregs_Out[0x54] |= 0x0100;   // ...set Unit Check
-            }
-            if (Efld == 0x56) {                // Channel Adapter Mode
-               if (Eregs_Out[0x56] & 0x2000) {
-                  Eregs_Inp[0x55] &= ~0x2000;  // Reset INCWAR valid
-                  Eregs_Out[0x55] &= ~0x2000;  // Reset INCWAR valid
-               }
-               if (Eregs_Out[0x56] & 0x1000) {
-                  Eregs_Inp[0x55] &= ~0x1000;  // Reset OUTCWAR valid
-                  Eregs_Out[0x55] &= ~0x1000;  // Reset OUTCWAR valid
-               }
-            }
-
-            if (Efld == 0x57) {                // Channel Adapter Mode
-               if (Eregs_Out[0x57] & 0x0010) { // Reset CA L3 interrupt
-                  pthread_mutex_lock(&r77_lock);
-                  Eregs_Inp[0x77] &= ~0x0028;  // Reset CA L3  interrupt
-                  pthread_mutex_unlock(&r77_lock);
-                  CA1_IS_req_L3 = OFF;
-                  CA1_DS_req_L3 = OFF;
-               }
-               if (Eregs_Out[0x57] & 0x0020) { // Reset CA L1 interrupt
-                  Eregs_Inp[0x76] &= ~0x0400;  // Reset CA L1  interrupt
-               }
-               if (Eregs_Out[0x57] & 0x0008) { // Test for CA select
-                  Eregs_Inp[0x55] |= 0x0001;   // Select CA1
-                  Eregs_Inp[0x55] &= ~0x0002;  // deselect CA2
-               } else {
-                  Eregs_Inp[0x55] |= 0x0002;   // Select CA2
-                  Eregs_Inp[0x55] &= ~0x0001;  // deselect CA1
-               }
-               if (Eregs_Out[0x57] & 0x0100) { // Test for IPL required
-                  Eregs_Inp[0x53] |= 0x0200;   // Set not initialized sense
-                  Eregs_Out[0x53] |= 0x0200;   // Set not initialized sense
-               }
-               if (Eregs_Out[0x57] & 0x0200) { // Test for IPL unit exception
-                  if (Eregs_Out[0x57] & 0x0008)
-                     iobs[0]->IPL_exception = ON;
-                  else
-                     iobs[1]->IPL_exception = ON;
-               }
-               if (!(Eregs_Out[0x57] & 0x0200)) {    // Test for reset IPL unit exception
-                  if (Eregs_Out[0x57] & 0x0008)
-                     iobs[0]->IPL_exception = OFF;
-                  else
-                     iobs[1]->IPL_exception = OFF;
-               }
-               if (Eregs_Out[0x57] & 0x0004) {
-                  Eregs_Inp[0x55] &= ~0x0010;        // Reset reset flag
-               }
-               if (Eregs_Out[0x57] & 0x0002) {
-                  Eregs_Inp[0x55] &= ~0x0020;        // Reset channel stop
-               }
-               if ((Eregs_Out[0x57] & 0x0800) &&     // If Unit Exception latch on and ...
-                  ((Eregs_Out[0x57] & 0x0100) ||     //  not initialized or...
-                   (Eregs_Out[0x57] & 0x0001))) {    // in diagnostic mode
-                  Eregs_Inp[0x54] |= 0x0200;         // Set Unit Check latch
-               }
-               if ((Eregs_Out[0x57] & 0x0001) &&
-                  !(Eregs_Inp[0x55] & 0x8000))  {
-                  Eregs_Inp[0x55] |= 0x8000;         // Diagnostic wrap mode on
-                  Eregs_Inp[0x55] &= ~0x0100;        // CA not active
-               }
-               if (!(Eregs_Out[0x57] & 0x0001) &&
-                  (Eregs_Inp[0x55] & 0x8000))  {
-                  Eregs_Inp[0x55] &= ~0x8000;        // Diagnostic wrap mode off
-                  Eregs_Inp[0x55] |= 0x0100;         // CA active
-               }
-            }
-
-            //********************************************************
-            //          Channel Adaptor Type 1 updates
-            //********************************************************
-            if (Efld == 0x62) {
-               Eregs_Inp[0x62] &= ~0x0100;     // Reset PCI interrupt
-
-               if (Eregs_Out[0x62] & 0x0400) { // Reset CA1 L3 interrupts
-                 pthread_mutex_lock(&r77_lock);
-                  Eregs_Inp[0x77] &= ~0x0008;  // Reset L3 initial selection
-                  pthread_mutex_unlock(&r77_lock);
-                  CA1_IS_req_L3 = OFF;
-                  Eregs_Inp[0x60] &= ~0x8200;  // Reset NSC status bits
-               }
-               if (Eregs_Out[0x62] & 0x0200) { // Reset CA1 L3 data service
-                  pthread_mutex_lock(&r77_lock);
-                  Eregs_Inp[0x77] &= ~0x0010;  // Reset L3 data service
-                  pthread_mutex_unlock(&r77_lock);
-                  CA1_DS_req_L3 = OFF;
-               }
-               if (Eregs_Out[0x62] & 0x1000)
-                  Eregs_Inp[0x62] |= 0x1000;   // Set NSC Channel end
-               else
-                  Eregs_Inp[0x62] &= ~0x1000;  // Reset NSC Channel end
-
-               if (Eregs_Out[0x62] & 0x0800)
-                  Eregs_Inp[0x62] |= 0x0800;   // Set NSC Final status
-               else
-                  Eregs_Inp[0x62] &= ~0x0800;  // Reset NSC Final status
-            }
-
-            //********************************************************
-            //          CCU updates
-            //********************************************************
-            if ((Efld == 0x70) && (bypass_CCU_check == OFF)) {      // HARD STOP
-               printf("\nDisplay Reg 1: %05X\n\r", Eregs_Out[0x71]);
-               printf(  "Display Reg 2: %05X\n\r", Eregs_Out[0x72]);
-               pgm_stop = ON;
-               reason = SCPE_STOP;
-               continue;
-            }
-            if (Efld == 0x77) {                // Miscellaneous Control
-               w_byte = Eregs_Out[Efld];
-               if (w_byte & 0x8000)  {         // Reset IPL L1 ?
-                  Eregs_Inp[0x53] &= ~0x0200;  // Reset not-initialized flag
-                  ipl_req_L1 = OFF;
-               }
-               if (w_byte & 0x0004)            // Reset all L1 prgm checks
-                  IO_L5_chk = OP_reg_chk = adr_ex_chk = OFF;
-               if (w_byte & 0x2000)  {         // Reset Panel Interrupt L3 ?
-                     pthread_mutex_lock(&r7f_lock);
-                     Eregs_Inp[0x7F] &= ~0x0200;  // Reset L3 Interval Timer
-                     pthread_mutex_unlock(&r7f_lock);
-                     timer_req_L3 = OFF;
-                  }
-                  inter_req_L3 = OFF;
-               if ((w_byte &0x0200) && (test_mode))  // Set Diagnostic mode L2 ?
-                  diag_req_L2 = ON;
-               if ((w_byte &0x0100) && (test_mode))  // Reset Diagnostic mode L2 ?
-                  diag_req_L2 = OFF;
-               if (w_byte & 0x0040)  {         // Reset Interval Timer L3 ?
-                     pthread_mutex_lock(&r7f_lock);
-                     Eregs_Inp[0x7F] &= ~0x0004;  // Reset L3 Interval Timer
-                     pthread_mutex_unlock(&r7f_lock);
-                     timer_req_L3 = OFF;
-                  }
-               if (w_byte & 0x0020)            // Reset PCI L3 ?
-                  pci_req_L3 = OFF;
-               if (w_byte & 0x0002)            // Reset PCI L4 ?
-                  pci_req_L4 = OFF;
-               if (w_byte & 0x0001)            // Reset SVC L4 ?
-                  svc_req_L4 = OFF;
-            }
-            if (Efld == 0x79) {                // Utility Control
-               if (!(Eregs_Out[Efld] & 0x0400)) { // Inhibit bit PL5 C&Z flag off ?
-                  if (Eregs_Out[Efld] & 0x0200)   // Prog L5 C flag
-                     CL_C[3] = ON;
-                  else
-                     CL_C[3] = OFF;
-                  if (Eregs_Out[Efld] & 0x0100)   // Prog L5 Z flag
-                     CL_Z[3] = ON;
-                  else
-                     CL_Z[3] = OFF;
-               }
-               if (Eregs_Out[Efld] & 0x0040)   // Reset load state
-                  load_state = OFF;
-               if (Eregs_Out[Efld] & 0x0020)   // Set test mode
-                  test_mode = ON;
-               if (Eregs_Out[Efld] & 0x0002)   // Set test mode
-                  test_mode = ON;
-               if (Eregs_Out[Efld] & 0x0010)   // Reset test mode
-                  test_mode = OFF;
-               if (Eregs_Out[Efld] & 0x0008) { // Set bypass CCU Check
-                  if (test_mode == ON)
-                     bypass_CCU_check = ON;
-               }
-               if (Eregs_Out[Efld] & 0x0004)   // Reset bypass CCU Check
-                  bypass_CCU_check = OFF;
-               if (Eregs_Out[Efld] & 0x1000)   // Set FET Storage Diagnostocs
-                  FET_stor_diag = ON;
-               else
-                  FET_stor_diag = OFF;         // Reset FET storage Diagnostics
-            }
-
-            if (Efld == 0x7A) {                // CUCR reset
-               Eregs_Inp[0x7A] = 0x8000;
-            }
-            if (Efld == 0x7C) {                // Program Call Interrupt L3
-               pci_req_L3     = ON;
-            }
-            if (Efld == 0x7D) {                // Program Call Interrupt L4
-               pci_req_L4     = ON;
-            }
-            if (Efld == 0x7E) {                // Set interrupt mask bits
-               w_byte = Eregs_Out[Efld];
-               if (w_byte & 0x0020)            // Level 2 ?
-                  int_lvl_mask[2] = ON;
-               if (w_byte & 0x0010)            // Level 3 ?
-                  int_lvl_mask[3] = ON;
-               if (w_byte & 0x0008)            // Level 4 ?
-                  int_lvl_mask[4] = ON;
-               if (w_byte & 0x0004)            // Level 5 ?
-                  int_lvl_mask[5] = ON;
-            }
-            if (Efld == 0x7F) {                // Reset interrupt mask bits
-               w_byte = Eregs_Out[Efld];
-               if (w_byte & 0x0020)            // Level 2 ?
-                  int_lvl_mask[2] = OFF;
-               if (w_byte & 0x0010)            // Level 3 ?
-                  int_lvl_mask[3] = OFF;
-               if (w_byte & 0x0008)            // Level 4 ?
-                  int_lvl_mask[4] = OFF;
-               if (w_byte & 0x0004)            // Level 5 ?
-                  int_lvl_mask[5] = OFF;
-            }
+            if ((reason = ereg_out(Efld, GRb[Rfld])) != SCPE_OK)
+               continue;                       // HARD STOP
          }
          break;
-   }
 
-   switch (opcode & 0xF8F0) {
-      case (0xB800):
+      OPCASE(OP_BAL)
          /* BAL  R,A            [RA]  */
          /* 01234567 89012345 ... 901
             10111RRR 0000A<-- // -->A */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0) & 0x07;              /* Extract register nr */
                                                /* Get branch addr from memory */
-         Afld = (opcode1 & 0x03) << 16;        /* Xbyte EA18 */
-         Afld = Afld | (GetMem(PC) << 8);      /* Read 3rd & 4th byte */
-         PC = (PC + 1) & AMASK;
-         Afld = Afld |  GetMem(PC);
-         PC = (PC + 1) & AMASK;
+         Afld = pd->afld;                      /* Xbyte EA18, 3rd & 4th byte */
+         PC = (PC + 2) & AMASK;
 
          if (Rfld > 0)                         /* No link addr if R=0 */
-            GR[Rfld][Grp] = PC;                /* Store link address */
-         GR[0][Grp] = Afld;                    /* Unconditional branch */
-         break;
+            GRb[Rfld] = PC;                    /* Store link address */
+         GRb[0] = Afld;                        /* Unconditional branch */
+         NEXT_INSTR;
 
-      case (0xB820):
+      OPCASE(OP_LA)
          /* LA   R,A            [RA]  */
          /* 01234567 89012345 ... 901
             10111RRR 0010A<-- // -->A */
-         Grp = RegGrp(lvl);
          Rfld = (opcode0) & 0x07;              /* Extract register nr */
                                                /* Get load address from memory */
-         Afld = (opcode1 & 0x03) << 16;        /* Xbyte EA18 */
-         Afld = Afld | (GetMem(PC) << 8);      /* Read 3rd & 4th byte */
-         PC = (PC + 1) & AMASK;
-         Afld = Afld |  GetMem(PC);
-         PC = (PC + 1) & AMASK;
-         GR[0][Grp] = PC;                      /* Update IAR */
-         GR[Rfld][Grp] = Afld;                 /* Load R with 16 bit address */
+         Afld = pd->afld;                      /* Xbyte EA18, 3rd & 4th byte */
+         PC = (PC + 2) & AMASK;
+         GRb[0] = PC;                          /* Update IAR */
+         GRb[Rfld] = Afld;                     /* Load R with 16 bit address */
+         NEXT_INSTR;
+
+      OPCASE(OP_EXIT)
+         /* EXIT                EXIT  */
+         /* 01234567 89012345
+            10111000 01000000         */
+
+         int_lvl_ent[lvl] = OFF;               /* Reset current active PGM level */
+         if (lvl == 5) {                       /* An EXIT while in L5 triggers SVC L4 */
+            IRQ_SET(IRQ_SVC_L4);
+         }
+         if (debug_reg & 0x02)
+            fprintf(trace, "\n>>> Leaving lvl=%d \n", lvl);
          break;
-   }
 
-   if (opcode == 0xB840) {
-      /* EXIT                EXIT  */
-      /* 01234567 89012345
-         10111000 01000000         */
+      default:                                 /* Unassigned or invalid in test mode */
+#ifdef I3705_THREADED
+      thr_OP_NOP:
+#endif
+         break;
+   }
 
-      int_lvl_ent[lvl] = OFF;                  /* Reset current active PGM level */
-      if (lvl == 5) {                          /* An EXIT while in L5 triggers SVC L4 */
-         svc_req_L4 = ON;
+   if (trc_on) {                               /* Complete the trace record */
+      CL_LATCH();
+      for (i = 1; (i < 8) && (GRb[i] == trc_gr[i]); i++) ;
+      if ((i < 8) && !(trc->flags & (TRC_IN | TRC_OUT))) {
+         trc->flags |= TRC_GR;
+         trc->gr = i;
+         trc->val = GRb[i];
       }
-      if (debug_reg & 0x02)
-         fprintf(trace, "\n>>> Leaving lvl=%d \n", lvl);
+      if (CL_C[Grp]) trc->flags |= TRC_C;
+      if (CL_Z[Grp]) trc->flags |= TRC_Z;
+      if ((trc->iar == trc_trig_iar) || (trc->lvl == trc_trig_lvl))
+         trc_fire(trc);                        /* Trigger: save the ring */
    }
 }  // end while (reason == 0)
 
 //###################### END OF SIMULATOR WHILE LOOP ######################
 
 PC = saved_PC;
+CL_LATCH();                                    /* SCP sees real latches */
+if ((wp_disarm() == STOP_WATCH) && (reason == SCPE_OK || reason == SCPE_STEP))
+   reason = STOP_WATCH;                        /* Hit by the last instrs run */
+if (prof_on) prof_mark(-1);                    /* Stop charging host time */
+cu_run(0);
 /* Simulation halted */
 return (reason);
 }
@@ -2397,7 +2035,73 @@ return (reason);
 // Sub-routines used by the simulator
 //********************************************************
 
-/*** Select register group ***/
+/*** Open trace.log for the debug_reg text trace ***/
+
+void debug_open(void)
+{
+   if ((trace = fopen("trace.log", "w")) == NULL)
+      return;
+   fprintf(trace, "     ****** 3705 Executed instructions log file ****** \n\n"
+                  "     sim> d debug 01 - (instrs: see SET CPU TRACE) \n"
+                  "                  02 - trace all enter/leave/wait interrupts \n"
+                  "                  04 - trace scanner ext input regs \n"
+                  "                  08 - trace channel adap ext input regs \n"
+                  "                  10 - trace CCU ext input regs \n"
+                  "                  20 - trace PIU's \n"
+                  "                  40 - trace ICW PCF \n"
+                  "                  80 - trace channel activity \n"
+                  "          AA55 = Unused external register \n\n");
+   debug_flag = ON;
+}
+
+/*** Make level the active program level and select its register bank ***/
+
+void lvl_switch(int32 level)
+{
+   if (prof_on)
+      prof_mark(level);
+   CL_LATCH();                                 /* Latches of the old group */
+   lvl_sw[lvl][level]++;
+   lvl = level;
+   Grp = RegGrp(level);
+   GRb = GR[Grp];
+}
+
+/* SHOW CPU LEVELS: switch counts and the sampled host cost of a switch */
+
+t_stat lvl_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   double t = sim_gtime() - lvl_sw_t0;
+   t_uint64 tot = 0;
+   int32 i, j;
+
+   fprintf(st, "level switches  to L1       L2       L3       L4       L5\n");
+   for (i = 1; i < 6; i++) {
+      fprintf(st, "   from L%d ", i);
+      for (j = 1; j < 6; j++) {
+         fprintf(st, " %8" LL_FMT "u", lvl_sw[i][j]);
+         tot += lvl_sw[i][j];
+      }
+      fprintf(st, "\n");
+   }
+   fprintf(st, "   total %" LL_FMT "u", tot);
+   if (tot != 0)
+      fprintf(st, ", one per %.1f instrs", t / tot);
+   fprintf(st, "\n");
+   if (lvl_sw_smp != 0) {
+      t_uint64 clk = ~(t_uint64) 0, t0, t1;
+      double ns = (double) lvl_sw_ns / lvl_sw_smp;
+
+      for (i = 0; i < 16; i++) {               /* Cost of reading the clock */
+         t0 = prof_now();
+         t1 = prof_now();
+         if (t1 - t0 < clk)
+            clk = t1 - t0;
+      }
+      fprintf(st, "   switch cost %.1f nsec host (%" LL_FMT "u switches timed)\n",
+              (ns > clk) ? ns - clk : 0.0, lvl_sw_smp);
+   }
+   return SCPE_OK;
+}
 
 int32 RegGrp(int32 level)
 {                            // Lvl 1 => Reg Grp 0
@@ -2407,35 +2111,269 @@ int32 RegGrp(int32 level)
       return(level - 2);     // Lvl 5 => Reg Grp 3
 }
 
+/*** Wait state ***/
+
+// The CCU sleeps on an eventfd while in wait state.  The CS2, CA and
+// panel threads and the interval timer call ccu_wake()
+// after raising a L1-L4 request, which makes the eventfd readable and
+// ends the sleep at once.  A request raised while the CCU is running
+// leaves the eventfd readable, so the next wait returns immediately and
+// no wakeup can get lost between the level scan and the sleep.  The
+// sleep is still limited to 1 msec so the SCP clock queue advances at
+// the same rate as with the former usleep(1000).  The throttle sleeps
+// the same way with its own limit through ccu_nap().
+
+static int ccu_efd = -1;                       /* Interrupt arrival eventfd */
+static volatile t_uint64 ccu_wake_ns = 0;      /* Time of first unserved wakeup */
+static t_uint64 wait_polls;                    /* Nr of sleeps */
+t_uint64 wait_ns;                              /* Total time asleep, also i3705_cucr.c */
+static t_uint64 wait_wakes, wait_lat_ns;       /* Sleeps ended by a request */
+static t_uint64 wait_lat_min, wait_lat_max;
+
+/* Host clock id in nsec, for every module */
+
+t_uint64 ccu_clock_ns(clockid_t id) {
+   struct timespec ts;
+
+   clock_gettime(id, &ts);
+   return ((t_uint64) ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+
+// Async signal safe, may be called from any thread.
+void ccu_wake(void) {
+   uint64_t one = 1;
+
+   __sync_bool_compare_and_swap(&ccu_wake_ns, 0, ccu_clock_ns(CLOCK_MONOTONIC));
+   if (ccu_efd >= 0)
+      write(ccu_efd, &one, sizeof(one));
+}
+
+// Sleep until a request arrives or ns have passed.  Returns the wake
+// latency of a request raised during the sleep, 0 if there was none.
+t_uint64 ccu_nap(t_uint64 ns) {
+   struct pollfd pfd;
+   struct timespec ts;
+   uint64_t cnt;
+   t_uint64 t0, tw;
+   int n;
+
+   if (ccu_efd < 0) {                          // No eventfd, old behaviour
+      usleep(ns / 1000);
+      return 0;
+   }
+   pfd.fd = ccu_efd;
+   pfd.events = POLLIN;
+   ts.tv_sec = ns / 1000000000;
+   ts.tv_nsec = ns % 1000000000;
+   t0 = ccu_clock_ns(CLOCK_MONOTONIC);
+   do                                          // Signals may land here
+      n = ppoll(&pfd, 1, &ts, NULL);
+   while ((n < 0) && (errno == EINTR));
+   if (n > 0) {
+      read(ccu_efd, &cnt, sizeof(cnt));
+      tw = __sync_lock_test_and_set(&ccu_wake_ns, 0);
+      if (tw >= t0)                            // Raised while asleep
+         return ccu_clock_ns(CLOCK_MONOTONIC) - tw;
+   }
+   return 0;
+}
+
+t_uint64 ccu_idle(void) {
+   t_uint64 t0, lat;
+
+   if (rr_mode == RR_REPLAY)                   /* Requests come from the log */
+      return 0;
+   t0 = ccu_clock_ns(CLOCK_MONOTONIC);
+   lat = ccu_nap(1000000);
+   if (lat) {                                  // Woken by a request
+      if ((wait_wakes == 0) || (lat < wait_lat_min))
+         wait_lat_min = lat;
+      if (lat > wait_lat_max)
+         wait_lat_max = lat;
+      wait_lat_ns += lat;
+      wait_wakes++;
+   }
+   pthread_mutex_lock(&cu_lock);               // cu_load() reads it on the panel thread
+   wait_ns += ccu_clock_ns(CLOCK_MONOTONIC) - t0;
+   pthread_mutex_unlock(&cu_lock);
+   wait_polls++;
+   return lat;
+}
+
+/* SHOW CPU WAIT */
+
+t_stat ccu_wait_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   fprintf(st, "wait state: %llu sleeps, %.3f sec asleep%s\n",
+           (unsigned long long) wait_polls, wait_ns / 1e9,
+           (ccu_efd < 0) ? " (no eventfd, fixed 1 msec sleeps)" : "");
+   fprintf(st, "   woken by request %llu times", (unsigned long long) wait_wakes);
+   if (wait_wakes)
+      fprintf(st, ", latency min %.1f avg %.1f max %.1f usec",
+              wait_lat_min / 1e3, (wait_lat_ns / 1e3) / wait_wakes, wait_lat_max / 1e3);
+   fprintf(st, "\n");
+   return SCPE_OK;
+}
+
+//********************************************************
+// 3705 storage
+//
+// M points to a MEMMAPSIZE mapping of which the first
+// MEMSIZE bytes are storage and the rest is PROT_NONE.
+// GetMem and PutMem do not check the address: an access
+// beyond MEMSIZE faults into mem_fault(), which raises the
+// addressing exception and lets the access complete on a
+// zero page.  At the next interrupt sample mem_rearm()
+// discards those pages and protects them again.  A write
+// fault inside storage is a store into a page holding a
+// watchpoint, see i3705_watch.c.
+//********************************************************
+
+static void mem_fault(int sig, siginfo_t *si, void *ctx)
+{
+   uint8 *a = (uint8 *) si->si_addr;
+   int32 pg;
+
+   if (M == NULL) {
+      signal(SIGSEGV, SIG_DFL);
+      return;
+   }
+   pg = (a - M) & ~(mem_pgsz - 1);
+   if ((a >= M) && (a < M + MEMSIZE)) {
+      wp_fault(a - M, ctx);                    /* Store into a watched page */
+      return;
+   }
+   if ((a >= M + MEMSIZE) && (a < M + MEMMAPSIZE)) {
+      mprotect(M + pg, mem_pgsz, PROT_READ | PROT_WRITE);
+      if ((mem_fault_addr < 0) || (pg < mem_open_lo)) mem_open_lo = pg;
+      if ((mem_fault_addr < 0) || (pg > mem_open_hi)) mem_open_hi = pg;
+      mem_fault_addr = a - M;
+      mem_faults++;
+      mem_pend = 1;
+      IRQ_SET(IRQ_ADR_L1);                     // Addressing Exception
+      return;
+   }
+   signal(SIGSEGV, SIG_DFL);                   /* Not ours: fault again and die */
+}
+
+void mem_init(void)
+{
+   struct sigaction sa;
+
+   mem_pgsz = sysconf(_SC_PAGESIZE);
+   M = mmap(NULL, MEMMAPSIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (M == MAP_FAILED) {
+      fprintf(stderr, "CPU: Cannot map %d bytes of storage\n", MEMMAPSIZE);
+      exit(1);
+   }
+   if (mprotect(M, MEMSIZE, PROT_READ | PROT_WRITE) != 0) {
+      fprintf(stderr, "CPU: Cannot open %dK of storage\n", MEMSIZE / 1024);
+      exit(1);
+   }
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_sigaction = &mem_fault;
+   sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGSEGV, &sa, NULL);
+}
+
+/* Drop the pages opened by mem_fault(), returns the faulting addr */
+
+int32 mem_rearm(void)
+{
+   int32 addr = mem_fault_addr;
+   int32 lo = mem_open_lo, len = mem_open_hi + mem_pgsz - mem_open_lo;
+
+   if (addr < 0)
+      return addr;
+   mem_fault_addr = -1;
+   mprotect(M + lo, len, PROT_NONE);
+   madvise(M + lo, len, MADV_DONTNEED);
+   return addr;
+}
+
 /*** Fetch a byte from memory ***/
 
 int32 GetMem(int32 addr)
 {
-   if (addr > MEMSIZE) {
-      adr_ex_chk = ON;      // Addressing Exception ?
-      printf("Addr %d  MEMSIZE %d ... \n\r", addr, MEMSIZE);
-   }
-   else
-      return(M[addr] & 0xFF);
+   return(M[addr & MEMMAPMASK]);
 }
 
 /*** Place a byte in memory ***/
 
 int32 PutMem(int32 addr, int32 data)
 {
-   if (addr > MEMSIZE) {
-      adr_ex_chk = ON;       // Addressing Exception ?
-      printf("Addr %d  MEMSIZE %d ... \n\r", addr, MEMSIZE);
-   }
-   else
+   addr &= MEMMAPMASK;
+   if (jit_logging)
+      jit_log_store(addr);
+   if (M[addr] != (data & 0xFF)) {             /* Drop decoded copies if changed */
       M[addr] = data & 0xFF;
+      PDC_INVAL(addr);
+      CKPT_DIRTY(addr);
+      mem_nchg++;
+   }
    return 0;
 }
 
+/* MEMTEST {count}: address past the end of storage through GetMem and
+   PutMem.  Each access must raise the addressing exception and read
+   zero, the last storage byte must not, and storage must be unchanged. */
+
+t_stat memtest_cmd(int32 flag, char *cptr)
+{
+   uint32 saved = int_src & IRQ_ADR_L1;
+   uint32 count = 10000, n, sum0 = 0, sum1 = 0, bad = 0;
+   t_uint64 f0 = mem_faults;
+   int32 addr, seed = 12345;
+   t_stat r;
+
+   if (*cptr != 0) {
+      count = (uint32) get_uint(cptr, 10, 0xFFFFFFFF, &r);
+      if ((r != SCPE_OK) || (count == 0))
+         return SCPE_ARG;
+   }
+   for (n = 0; n < MEMSIZE; n++)
+      sum0 = (sum0 * 31) + M[n];
+   for (n = 0; n < count; n++) {
+      seed = seed * 1103515245 + 12345;
+      switch (n & 7) {                         /* Edges first, then random */
+         case 0:  addr = MEMSIZE;  break;
+         case 1:  addr = MEMMAPSIZE - 1;  break;
+         case 2:  addr = -1;  break;
+         default: addr = MEMSIZE + (((uint32) seed >> 8) % (MEMMAPSIZE - MEMSIZE));  break;
+      }
+      IRQ_CLR(IRQ_ADR_L1);
+      PutMem(addr, 0x5A);
+      if (!IRQ_ON(IRQ_ADR_L1) || (mem_fault_addr < 0))
+         bad++;
+      mem_rearm();
+      IRQ_CLR(IRQ_ADR_L1);
+      if ((GetMem(addr) != 0) || !IRQ_ON(IRQ_ADR_L1))
+         bad++;                                /* Store must not have stuck */
+      mem_rearm();
+      IRQ_CLR(IRQ_ADR_L1);
+      GetMem(MEMSIZE - 1);
+      if (IRQ_ON(IRQ_ADR_L1))
+         bad++;
+   }
+   for (n = 0; n < MEMSIZE; n++)
+      sum1 = (sum1 * 31) + M[n];
+   if (sum1 != sum0)
+      bad++;
+   if (saved)
+      IRQ_SET(IRQ_ADR_L1);
+   printf("memtest: %u accesses beyond %uK, %" LL_FMT "u faults, %u errors\n",
+          2 * count, MEMSIZE / 1024, mem_faults - f0, bad);
+   return (bad == 0) ? SCPE_OK : SCPE_IERR;
+}
+
 /*** Memory examine ***/
 
 t_stat cpu_ex (t_value *vptr, t_addr addr, UNIT *uptr, int32 sw) {
    if (addr >= MEMSIZE) return SCPE_NXM;
+   if (sw & SIM_SW_REST) {                     /* SAVE: storage is in the 3705 image */
+      if (vptr != NULL) *vptr = 0;
+      return SCPE_OK;
+   }
    if (vptr != NULL) *vptr = M[addr] & 0xff;
    return SCPE_OK;
 }
@@ -2444,7 +2382,11 @@ t_stat cpu_ex (t_value *vptr, t_addr addr, UNIT *uptr, int32 sw) {
 
 t_stat cpu_dep (t_value val, t_addr addr, UNIT *uptr, int32 sw) {
    if (addr >= MEMSIZE) return SCPE_NXM;
+   if (sw & SIM_SW_REST)                       /* RESTORE: held until the image is read */
+      return snap_dep(addr, val & 0xFF);
    M[addr] = val & 0xFF;
+   PDC_INVAL(addr);
+   CKPT_DIRTY(addr);
    return SCPE_OK;
 }
 
@@ -2452,13 +2394,24 @@ t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc) {
    int32 mc = 0;
    uint32 i;
 
-   if ((val <= 0) || (val > MAXMEMSIZE) || ((val & 0x0FFF) != 0))
+   if ((val <= 0) || ((val % mem_pgsz) != 0)) {  /* Guard starts on a host page */
+      printf("CPU: Storage size must be a multiple of the %ldK host page\n", mem_pgsz / 1024);
       return SCPE_ARG;
+   }
    for (int i = val; i < MEMSIZE; i++) mc = mc | M[i];
    if ((mc != 0) && (!get_yn ("Really truncate memory [N]?", FALSE)))
       return SCPE_OK;
+   if ((mprotect(M, val, PROT_READ | PROT_WRITE) != 0) ||
+       (mprotect(M + val, MEMMAPSIZE - val, PROT_NONE) != 0) ||
+       (madvise(M + val, MEMMAPSIZE - val, MADV_DONTNEED) != 0)) {  /* Truncated part reads zero */
+      printf("CPU: Cannot protect storage beyond %dK: %s\n", val / 1024, strerror(errno));
+      mprotect(M, MEMSIZE, PROT_READ | PROT_WRITE);
+      mprotect(M + MEMSIZE, MEMMAPSIZE - MEMSIZE, PROT_NONE);
+      return SCPE_IERR;
+   }
    MEMSIZE = val;
-   for (int i = MEMSIZE; i < MAXMEMSIZE; i++) M[i] = 0x00;
+   mem_fault_addr = -1;
+   pdc_flush();
    return SCPE_OK;
 }
 
@@ -2569,11 +2522,118 @@ t_stat cpu_boot (int32 unitno, DEVICE *dptr) {    /* LOAD pressed */
    //******************************************************************
    printf("CPU: Booting... \n\r");
    int_lvl_mask[1] = OFF;                      /* Allow pgm level 1 */
-   ipl_req_L1 = ON;                            /* Request L1 for IPL */
+   int_lvl_mbits &= ~IRQ_LVL(1);
+   IRQ_SET(IRQ_IPL_L1);                        /* Request L1 for IPL */
+
+   return SCPE_OK;
+}
+
+/*** LOAD -I: leave the CCU as the IPL-phase program leaves it ***/
+
+void cpu_ipl_done(int32 entry) {
+   cpu_reset(&cpu_dev);
+   load_state = OFF;                           /* OUT X'77' X'0050' */
+   test_mode = OFF;
+   Eregs_Inp[0x53] &= ~0x0200;                 /* OUT X'7C' X'8004' */
+   IRQ_CLR(IRQ_IPL_L1 | IRQ_IOL5_L1 | IRQ_OPC_L1 | IRQ_ADR_L1);
+   int_lvl_mask[1] = OFF;                      /* Program checks */
+   int_lvl_mask[5] = OFF;                      /* NCP opens levels 2-4 itself */
+   int_lvl_mbits &= ~(IRQ_LVL(1) | IRQ_LVL(5));
+   lvl = 5;
+   Grp = RegGrp(lvl);
+   GRb = GR[Grp];
+   GRb[0] = entry;                             /* Level 5 continues there */
+   PC = entry;
+   int_src_seen = ~int_src;
+}
 
+/*** VM commands that run a test program (LATCH, BENCH) keep the CCU
+     state and the storage below len aside with cpu_hold(), set up the
+     CCU with cpu_prep(), run it with cpu_run() and give the state back
+     with cpu_unhold(). ***/
+
+static uint8 *hold_st = NULL, *hold_mem = NULL;
+static uint32 hold_stlen, hold_nitems, hold_len;
+
+t_stat cpu_hold(int32 len) {
+   hold_stlen = snap_put(NULL, &hold_nitems);
+   hold_st = malloc(hold_stlen + 1);
+   hold_mem = malloc(len);
+   if ((hold_st == NULL) || (hold_mem == NULL)) {
+      free(hold_st);
+      free(hold_mem);
+      hold_st = hold_mem = NULL;
+      return SCPE_MEM;
+   }
+   snap_put(hold_st, &hold_nitems);
+   memcpy(hold_mem, M, len);
+   hold_len = len;
    return SCPE_OK;
 }
 
+void cpu_unhold(void) {
+   if (hold_st == NULL)
+      return;
+   snap_get(hold_st, hold_stlen, hold_nitems, "CPU");
+   memcpy(M, hold_mem, hold_len);
+   free(hold_st);
+   free(hold_mem);
+   hold_st = hold_mem = NULL;
+   snap_fixup();
+}
+
+/* Level 5 at org, levels 1, 4 and 5 unmasked, no requests pending */
+
+void cpu_prep(int32 org) {
+   for (int i = 1; i < 6; i++) {
+      int_lvl_req[i] = OFF;
+      int_lvl_ent[i] = OFF;
+      int_lvl_mask[i] = ((i == 2) || (i == 3)) ? ON : OFF;
+   }
+   int_lvl_mbits = IRQ_LVL(2) | IRQ_LVL(3);
+   IRQ_CLR(IRQ_IPL_L1 | IRQ_IOL5_L1 | IRQ_OPC_L1 | IRQ_ADR_L1 | IRQ_SVC_L4);
+   load_state = test_mode = wait_state = pgm_stop = OFF;
+   lvl = 5;
+   Grp = RegGrp(lvl);
+   GRb = GR[Grp];
+   GRb[0] = PC = org;
+   int_src_seen = ~int_src;
+   pdc_flush();                                /* Storage was replaced */
+   jit_flush();
+}
+
+/* Run n instrs from the current state, as STEP n would */
+
+t_stat cpu_run(int32 n) {
+   t_stat r;
+
+   sim_activate(&evt_unit[EVT_STEP], n);
+   sim_is_running = 1;
+   r = sim_instr();
+   sim_is_running = 0;
+   sim_cancel(&evt_unit[EVT_STEP]);
+   return (r == SCPE_STEP) ? SCPE_OK : r;
+}
+
+t_stat run_svc(UNIT *uptr) {
+   return SCPE_STEP;
+}
+
+/*** Build the interrupt source to level map ***/
+
+static void int_src_map(void) {
+   static const uint8 src_lvl[IRQ_NSRC] = {    /* Level of each IRQ_xx bit */
+      1, 1, 1, 1,  2, 2,  3, 3, 3, 3, 3,  4, 4 };
+   int32 src, b;
+
+   for (src = 0; src <= IRQ_ALL; src++) {
+      int_src_lvl[src] = 0;
+      for (b = 0; b < IRQ_NSRC; b++)
+         if (src & (1 << b))
+            int_src_lvl[src] |= IRQ_LVL(src_lvl[b]);
+   }
+}
+
 /*** RESET pressed procedure ***/
 
 t_stat cpu_reset (DEVICE *dptr) {              /* RESET pressed */
@@ -2581,19 +2641,25 @@ t_stat cpu_reset (DEVICE *dptr) {              /* RESET pressed */
    // IPL phase 1 - CCU reset procedure
    //******************************************************************
    int32 i;
-   sim_brk_types = sim_brk_dflt = SWMASK ('E');  /* Clear all BP's */
+   sim_brk_types = SWMASK('E') | SWMASK('C') | SWMASK('L');  /* Stop, count, log */
+   sim_brk_dflt = SWMASK ('E');
+   tmr_reset();                                /* (Re)start virtual timer ticks */
+   if (ccu_efd < 0)                            /* Wait state wakeup */
+      ccu_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if (int_src_lvl[IRQ_ALL] == 0)              /* Source map not built yet */
+      int_src_map();
 
    /* Clear all level GP registers */
-   GR[0][0] = 0x00000;  GR[1][0] = 0x00000;  GR[2][0] = 0x00000;  GR[3][0] = 0x00000;
-   GR[4][0] = 0x00000;  GR[5][0] = 0x00000;  GR[6][0] = 0x00000;  GR[7][0] = 0x00000;
+   GR[0][0] = 0x00000;  GR[0][1] = 0x00000;  GR[0][2] = 0x00000;  GR[0][3] = 0x00000;
+   GR[0][4] = 0x00000;  GR[0][5] = 0x00000;  GR[0][6] = 0x00000;  GR[0][7] = 0x00000;
 
    /* Set/reset HARD STOP, PGM STOP, IPL LATCHES 1 & 2, TEST MODE */
    test_mode = ON;                             /* See PoO 5-11 */
    pgm_stop  = OFF;
    load_state = OFF;
    wait_state = OFF;
-   OP_reg_chk = OFF;
-   IO_L5_chk = OFF;
+   IRQ_CLR(IRQ_OPC_L1);
+   IRQ_CLR(IRQ_IOL5_L1);
 
    /* Reset all interrupt level flags */
    for (int i = 0; i < 6; i++) {
@@ -2601,7 +2667,14 @@ t_stat cpu_reset (DEVICE *dptr) {              /* RESET pressed */
       int_lvl_ent[i]  = OFF;                   /* Reset all "Interrupt Entered" */
       int_lvl_mask[i] = ON;                    /* Set all Pgm Level masks */
    }
+   int_lvl_mbits = 0x7C;
    lvl = 5;
+   Grp = RegGrp(lvl);
+   GRb = GR[Grp];
+   memset(lvl_sw, 0, sizeof(lvl_sw));          /* Clear level switch counts */
+   lvl_sw_t0 = sim_gtime();
+   lvl_sw_ns = lvl_sw_smp = 0;
+   ereg_reset();                               /* Clear IN/OUT counts */
    /* Set cycle count register */
    Eregs_Inp[0x7A] = 0x8000;                    /* CUCR RPQ install        */
    cycle_eight = 0;                             /* 8 cycle counter to zero */
@@ -2633,18 +2706,6 @@ t_stat cpu_reset (DEVICE *dptr) {              /* RESET pressed */
       case 256:
          Eregs_Inp[0x70]  = 0x1000;            // 256 kbyte storage size (3705-II)
       break;
-      case 320:
-         Eregs_Inp[0x70]  = 0x1400;            // 320 kbyte storage size (3705-II)
-      break;
-      case 384:
-         Eregs_Inp[0x70]  = 0x1800;            // 384 kbyte storage size (3705-II)
-      break;
-      case 448:
-         Eregs_Inp[0x70]  = 0x1C00;            // 448 kbyte storage size (3705-II)
-      break;
-      case 512:
-         Eregs_Inp[0x70]  = 0x2000;            // 512 kbyte storage size (3705-II)
-      break;
       default:
          Eregs_Inp[0x70]  = 0x1000;            // 256 kbyte storage size (3705-II)
       break;
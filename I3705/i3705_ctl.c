@@ -0,0 +1,131 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_ctl.c: IBM 3705 controller context
+
+        SHOW CPU CTL            storage, context size and threads
+
+   The controller context (struct i3705) holds the adapter side of the
+   3705: the channel adapter I/O blocks, the scanner ICWs and line
+   buffers and the SDLC lines.  main() makes it with ctl_new() and hands
+   it to the channel adapter, scanner, SDLC and BSC threads as their
+   argument; the CCU side (Eregs, panel, SAVE) finds it through ccu_ctl.
+   Each thread registers itself with ctl_thread(), with the context or
+   NULL when it serves the CCU, and ctl_report() lists what the 3705
+   costs once they have started.
+
+   A process runs one 3705.  A second one would need its own copy of
+   what is still global on the CCU side:
+        storage             M, the guard mapping and mem_fault()
+        registers           GR banks and GRb, the C/Z latches, lvl,
+                            Eregs_Inp and Eregs_Out
+        interrupts          int_src, int_src_seen and the wait eventfd
+        per storage maps    predecode, JIT pages, coverage, breakpoints,
+                            watchpoints and checkpoint dirty bits
+        channel adapter     ccw, csw and epoll_fd in i3705_chan_T2.c
+        BSC lines           the line blocks in i3705_bsc.c
+   and SCP itself has one sim_instr, one clock queue and one set of REG
+   tables.  ctl_new() refuses a second context until that is done.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+extern UNIT cpu_unit;
+extern uint32 snap_put(uint8 *buf, uint32 *nitems);
+
+struct i3705 *ccu_ctl = NULL;                  /* The controller context */
+
+static const char *ctl_shr[CTL_THREADS];       /* CCU side threads */
+static pid_t ctl_shr_tid[CTL_THREADS];
+static int32 ctl_nshr = 0;
+static pthread_mutex_t ctl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Register the calling thread, ctl NULL for a CCU side one */
+
+void ctl_thread(struct i3705 *ctl, const char *name) {
+   pid_t tid = syscall(SYS_gettid);
+
+   pthread_mutex_lock(&ctl_lock);
+   if (ctl == NULL) {
+      if (ctl_nshr < CTL_THREADS) {
+         ctl_shr[ctl_nshr] = name;
+         ctl_shr_tid[ctl_nshr++] = tid;
+      }
+   } else if (ctl->nthread < CTL_THREADS) {
+      ctl->thread[ctl->nthread] = name;
+      ctl->tid[ctl->nthread++] = tid;
+   }
+   pthread_mutex_unlock(&ctl_lock);
+}
+
+/* Make the controller context.  The caller runs the CCU. */
+
+void *ctl_new(void) {
+   struct i3705 *ctl;
+   int32 i;
+
+   if ((ccu_ctl != NULL) || ((ctl = calloc(1, sizeof(struct i3705))) == NULL)) {
+      fprintf(stderr, "\r\nCan't create 3705 controller context\n");
+      exit(1);
+   }
+   for (i = 0; i < MAXCHAN; i++)
+      ctl->iob[i] = &ctl->ca[i];
+   ccu_ctl = ctl;
+   ctl_thread(NULL, "CCU");
+   return ctl;
+}
+
+static void ctl_print(FILE *st) {
+   struct i3705 *ctl = ccu_ctl;
+   uint32 nitems, stlen = snap_put(NULL, &nitems);
+   int32 k;
+
+   if (ctl == NULL)
+      return;
+   fprintf(st, "3705: %uK storage, %uK context (scanner %uK, channel %uK), "
+           "%uK SDLC lines, %uK SAVE state\n", MEMSIZE / 1024,
+           (uint32) sizeof(struct i3705) / 1024, (uint32) sizeof(struct CS2) / 1024,
+           (uint32) sizeof(ctl->ca) / 1024, ctl->sdlc_bytes / 1024, stlen / 1024);
+   fprintf(st, "adapters: %d threads", ctl->nthread);
+   for (k = 0; k < ctl->nthread; k++)
+      fprintf(st, " %s(%d)", ctl->thread[k], (int) ctl->tid[k]);
+   fprintf(st, "\n");
+   fprintf(st, "CCU side: %d threads", ctl_nshr);
+   for (k = 0; k < ctl_nshr; k++)
+      fprintf(st, " %s(%d)", ctl_shr[k], (int) ctl_shr_tid[k]);
+   fprintf(st, "\n");
+}
+
+/* Called by main() once the threads have started */
+
+void ctl_report(void) {
+   ctl_print(stdout);
+}
+
+/* SHOW CPU CTL */
+
+t_stat ctl_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   ctl_print(st);
+   return SCPE_OK;
+}
@@ -0,0 +1,181 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_cucr.c: IBM 3705 CCU utilisation accounting
+
+   Every executed instr is charged the CCU cycles of its execution class
+   from cu_cost[], to the level it ran on.  The Cycle Utilization
+   Counter Register (CUCR, external register X'7A') advances once per 8
+   charged cycles: bit 0 is the RPQ installed bit, bits 1-15 count and
+   wrap back to X'8000', and OUT X'7A' resets it.  The CCU does not run
+   cycles in the wait state, so the CUCR delta over an interval gives
+   NCP the cycles a real 3705 would have been busy for the same work,
+   however fast the host runs it.
+
+   Busy and wait time are also kept in host time: the time sim_instr
+   ran less the time it slept in the wait state or in an idle loop.
+   With the virtual timer the wait state does not sleep but skips
+   instrs, and those are counted instead.
+
+        SHOW CPU UTIL           cycles and instrs per level, busy and wait
+        SHOW CPU UTILCNT        the same as name=value pairs for scripts
+        SET CPU UTILZERO        zero the counters (not the CUCR)
+
+   The operator panel shows the busy percentage of the last second.  It
+   runs on its own thread, so cu_run(), cu_zero() and cu_load() and the
+   wait_ns update in ccu_idle() hold cu_lock.
+*/
+
+#include "i3705_defs.h"
+#include <time.h>
+#include <pthread.h>
+
+extern int32 Eregs_Inp[];
+extern t_uint64 wait_ns;
+
+/* CCU cycles per instr.  Register and immediate instrs take one cycle,
+   storage, branch and link, and external register instrs one more per
+   storage or register bus access. */
+
+uint8 cu_cost[OP_MAX] = {
+   [OP_NOP]  = 1, [OP_INV]  = 1,
+   [OP_B]    = 1, [OP_BCL]  = 1, [OP_BZL]  = 1, [OP_BCT]  = 1, [OP_BB]   = 1,
+   [OP_LRI]  = 1, [OP_ARI]  = 1, [OP_SRI]  = 1, [OP_CRI]  = 1, [OP_XRI]  = 1,
+   [OP_ORI]  = 1, [OP_NRI]  = 1, [OP_TRM]  = 1,
+   [OP_LCR]  = 1, [OP_ACR]  = 1, [OP_SCR]  = 1, [OP_CCR]  = 1, [OP_XCR]  = 1,
+   [OP_OCR]  = 1, [OP_NCR]  = 1, [OP_LCOR] = 1,
+   [OP_ICT]  = 2, [OP_STCT] = 2, [OP_IC]   = 2, [OP_STC]  = 2,
+   [OP_LH]   = 2, [OP_STH]  = 2, [OP_L]    = 3, [OP_ST]   = 3,
+   [OP_LHR]  = 1, [OP_AHR]  = 1, [OP_SHR]  = 1, [OP_CHR]  = 1, [OP_XHR]  = 1,
+   [OP_OHR]  = 1, [OP_NHR]  = 1, [OP_LHOR] = 1,
+   [OP_LR]   = 1, [OP_AR]   = 1, [OP_SR]   = 1, [OP_CR]   = 1, [OP_XR]   = 1,
+   [OP_OR]   = 1, [OP_NR]   = 1, [OP_LOR]  = 1,
+   [OP_BALR] = 2, [OP_IN]   = 2, [OP_OUT]  = 2, [OP_BAL]  = 2, [OP_LA]   = 2,
+   [OP_EXIT] = 2,
+};
+
+t_uint64 cu_cyc[6], cu_ins[6];                 /* Per level 1-5 */
+t_uint64 cu_vwait;                             /* Instrs skipped in the wait state */
+
+static t_uint64 cu_run_ns, cu_start_ns;        /* sim_instr time, last entry */
+static int32 cu_running = 0;
+static t_uint64 cu_wait0_ns;                   /* wait_ns at the last zero */
+static t_uint64 cu_lt, cu_lb;                  /* Last cu_load() sample */
+static int32 cu_lpct = 0;
+pthread_mutex_t cu_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Called at sim_instr entry (1) and exit (0) */
+
+void cu_run(int32 on) {
+   t_uint64 now = ccu_clock_ns(CLOCK_MONOTONIC);
+
+   pthread_mutex_lock(&cu_lock);
+   if (on)
+      cu_start_ns = now;
+   else if (cu_running)
+      cu_run_ns += now - cu_start_ns;
+   cu_running = on;
+   pthread_mutex_unlock(&cu_lock);
+}
+
+static t_uint64 cu_ran_ns(void) {              /* Host time in sim_instr */
+   return cu_run_ns + (cu_running ? ccu_clock_ns(CLOCK_MONOTONIC) - cu_start_ns : 0);
+}
+
+static t_uint64 cu_busy_ns(t_uint64 ran) {     /* Less the sleeps */
+   t_uint64 w = wait_ns - cu_wait0_ns;
+
+   return (ran > w) ? ran - w : 0;
+}
+
+/* Busy percentage of the last second, for the panel thread */
+
+int32 cu_load(void) {
+   t_uint64 t, b;
+   int32 pct;
+
+   pthread_mutex_lock(&cu_lock);
+   t = cu_ran_ns();
+   b = cu_busy_ns(t);
+   if (t - cu_lt >= 1000000000) {
+      cu_lpct = (int32) ((b - cu_lb) * 100 / (t - cu_lt));
+      cu_lt = t;
+      cu_lb = b;
+   } else if (!cu_running)
+      cu_lpct = 0;
+   pct = cu_lpct;
+   pthread_mutex_unlock(&cu_lock);
+   return pct;
+}
+
+/* SET CPU UTILZERO */
+
+t_stat cu_zero(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   if (cptr != NULL)
+      return SCPE_ARG;
+   memset(cu_cyc, 0, sizeof(cu_cyc));
+   memset(cu_ins, 0, sizeof(cu_ins));
+   cu_vwait = 0;
+   pthread_mutex_lock(&cu_lock);
+   cu_run_ns = cu_lt = cu_lb = 0;
+   cu_start_ns = ccu_clock_ns(CLOCK_MONOTONIC);
+   cu_wait0_ns = wait_ns;
+   pthread_mutex_unlock(&cu_lock);
+   return SCPE_OK;
+}
+
+/* SHOW CPU UTIL (val 0), SHOW CPU UTILCNT (val 1) */
+
+t_stat cu_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   t_uint64 cyc = 0, ins = 0, ran = cu_ran_ns(), busy = cu_busy_ns(ran);
+   int32 i;
+
+   for (i = 1; i < 6; i++) {
+      cyc += cu_cyc[i];
+      ins += cu_ins[i];
+   }
+   if (val) {
+      for (i = 1; i < 6; i++)
+         fprintf(st, "cycles_l%d=%" LL_FMT "u instrs_l%d=%" LL_FMT "u\n",
+                 i, cu_cyc[i], i, cu_ins[i]);
+      fprintf(st, "cycles=%" LL_FMT "u instrs=%" LL_FMT "u cucr=%u\n",
+              cyc, ins, Eregs_Inp[0x7A] & 0x7FFF);
+      fprintf(st, "run_ns=%" LL_FMT "u busy_ns=%" LL_FMT "u wait_ns=%" LL_FMT "u "
+              "wait_instrs=%" LL_FMT "u\n", ran, busy, ran - busy, cu_vwait);
+      return SCPE_OK;
+   }
+   fprintf(st, "level        instrs         cycles  share  cycles/instr\n");
+   for (i = 1; i < 6; i++)
+      fprintf(st, "   L%d %14" LL_FMT "u %14" LL_FMT "u %5.1f%%  %5.2f\n", i,
+              cu_ins[i], cu_cyc[i], cyc ? cu_cyc[i] * 100.0 / cyc : 0.0,
+              cu_ins[i] ? (double) cu_cyc[i] / cu_ins[i] : 0.0);
+   fprintf(st, "   total %11" LL_FMT "u %14" LL_FMT "u, CUCR %04X\n",
+           ins, cyc, Eregs_Inp[0x7A]);
+   fprintf(st, "host time %.3f sec: busy %.3f sec", ran / 1e9, busy / 1e9);
+   if (ran)
+      fprintf(st, " (%.1f%%), wait %.3f sec (%.1f%%)", busy * 100.0 / ran,
+              (ran - busy) / 1e9, (ran - busy) * 100.0 / ran);
+   fprintf(st, "\n");
+   if (cu_vwait)
+      fprintf(st, "virtual timer: %" LL_FMT "u instrs skipped in the wait state "
+              "(%.1f%% of instr time)\n", cu_vwait, cu_vwait * 100.0 / (ins + cu_vwait));
+   return SCPE_OK;
+}
@@ -0,0 +1,369 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_decode.c: IBM 3705 CCU opcode decode table
+
+   All 65536 halfword encodings are classified once at startup from
+   optable[] (i3705_sys.c).  sim_instr then dispatches with a single
+   switch on op_dec[opcode].xcode and printf_sym finds the optable entry
+   via op_dec[opcode].idx, so executor and disassembler use the same data.
+
+   The predecode cache pdc[] keeps the fetched bytes, execution class,
+   length and RA address of the instruction at every even address that
+   has been executed.  Stores through PutMem, deposit and sim_load drop
+   the entries they touch.  A channel adapter thread stores its cycle
+   steal data into M and posts the range with pdc_post(); the CCU drops
+   the entries at its next interrupt sample (pdc_sync), before it can see
+   the request that reports the data, so pdc[] and the translated blocks
+   are only ever changed by the CCU.  SHOW CPU PDCACHE displays the hit
+   and miss counters.
+
+   The BENCH command runs sim_instr over a fixed loop twice: decoding
+   through the table and the predecode cache, and with pdc_bypass set,
+   which classifies every fetch with the original cascade of masked
+   switches.
+*/
+
+#include <time.h>
+#include <pthread.h>
+#include "i3705_defs.h"
+
+extern struct opdef optable[];
+extern int32 nopcode;
+extern uint8 *M;
+extern UNIT cpu_unit;
+
+struct opdec op_dec[65536];                    /* Decoded opcode table */
+struct pdent pdc[PDC_SIZE];                    /* Predecode cache */
+t_uint64 pdc_hits = 0;                         /* Fetches served from pdc */
+t_uint64 pdc_miss = 0;                         /* Fetches that filled pdc */
+t_uint64 pdc_invals = 0;                       /* Range invalidations */
+volatile int32 pdc_posted = 0;                 /* Range posted by an adapter */
+int32 pdc_bypass = 0;                          /* BENCH: no table, no cache */
+
+static pthread_mutex_t pdc_post_lock = PTHREAD_MUTEX_INITIALIZER;
+static int32 pdc_post_lo, pdc_post_hi;         /* Posted bytes, lo ... hi - 1 */
+
+extern int32 GetMem(int32 addr);
+extern uint8 jit_cmap[];
+extern uint32 jit_pgen[];
+extern uint8 ckpt_dirty[];
+extern int32 jit_mode;
+extern t_stat cpu_hold(int32 len);
+extern void cpu_unhold(void);
+extern void cpu_prep(int32 org);
+extern t_stat cpu_run(int32 n);
+
+/* Classify an encoding the way sim_instr did before the decode table:
+   eight masked switches plus the EXIT check, all of them evaluated.
+   Used to verify the table at startup and as the BENCH reference. */
+
+int32 opdec_cascade(int32 inst) {
+   int32 xcode = OP_NOP;
+
+   switch (inst & 0xF800) {
+      case (0xA800): xcode = OP_B;   break;
+      case (0x9800): xcode = OP_BCL; break;
+      case (0x8800): xcode = OP_BZL; break;
+      case (0xB800):
+         if (inst & 0x0080)                    /* Else it is BAL, LA or EXIT */
+            xcode = OP_BCT;
+         break;
+      case (0xC800):
+      case (0xD800):
+      case (0xE800):
+      case (0xF800): xcode = OP_BB;  break;
+      case (0x8000): xcode = OP_LRI; break;
+      case (0x9000): xcode = OP_ARI; break;
+      case (0xA000): xcode = OP_SRI; break;
+      case (0xB000): xcode = OP_CRI; break;
+      case (0xC000): xcode = OP_XRI; break;
+      case (0xD000): xcode = OP_ORI; break;
+      case (0xE000): xcode = OP_NRI; break;
+      case (0xF000): xcode = OP_TRM; break;
+   }
+   switch (inst & 0x88FF) {
+      case (0x0008): xcode = OP_LCR;  break;
+      case (0x0018): xcode = OP_ACR;  break;
+      case (0x0028): xcode = OP_SCR;  break;
+      case (0x0038): xcode = OP_CCR;  break;
+      case (0x0048): xcode = OP_XCR;  break;
+      case (0x0058): xcode = OP_OCR;  break;
+      case (0x0068): xcode = OP_NCR;  break;
+      case (0x0078): xcode = OP_LCOR; break;
+      case (0x0010): xcode = OP_ICT;  break;
+      case (0x0030): xcode = OP_STCT; break;
+   }
+   switch (inst & 0x8880) {
+      case (0x0800): xcode = OP_IC;   break;
+      case (0x0880): xcode = OP_STC;  break;
+   }
+   switch (inst & 0x8881) {
+      case (0x0001): xcode = OP_LH;   break;
+      case (0x0081): xcode = OP_STH;  break;
+   }
+   switch (inst & 0x8883) {
+      case (0x0002): xcode = OP_L;    break;
+      case (0x0082): xcode = OP_ST;   break;
+   }
+   switch (inst & 0x88FF) {
+      case (0x0080): xcode = OP_LHR;  break;
+      case (0x0090): xcode = OP_AHR;  break;
+      case (0x00A0): xcode = OP_SHR;  break;
+      case (0x00B0): xcode = OP_CHR;  break;
+      case (0x00C0): xcode = OP_XHR;  break;
+      case (0x00D0): xcode = OP_OHR;  break;
+      case (0x00E0): xcode = OP_NHR;  break;
+      case (0x00F0): xcode = OP_LHOR; break;
+      case (0x0088): xcode = OP_LR;   break;
+      case (0x0098): xcode = OP_AR;   break;
+      case (0x00A8): xcode = OP_SR;   break;
+      case (0x00B8): xcode = OP_CR;   break;
+      case (0x00C8): xcode = OP_XR;   break;
+      case (0x00D8): xcode = OP_OR;   break;
+      case (0x00E8): xcode = OP_NR;   break;
+      case (0x00F8): xcode = OP_LOR;  break;
+      case (0x0040): xcode = OP_BALR; break;
+   }
+   switch (inst & 0x880F) {
+      case (0x000C): xcode = OP_IN;   break;
+      case (0x0004): xcode = OP_OUT;  break;
+   }
+   switch (inst & 0xF8F0) {
+      case (0xB800): xcode = OP_BAL;  break;
+      case (0xB820): xcode = OP_LA;   break;
+   }
+   if (inst == 0xB840)
+      xcode = OP_EXIT;
+
+   if ((xcode == OP_NOP) && ((inst & 0x8800) == 0x0000) &&
+      (((inst & 0xFF) == 0x00) || ((inst & 0xFF) == 0x20) ||
+       ((inst & 0xFF) == 0x50) || ((inst & 0xFF) == 0x60) ||
+       ((inst & 0xFF) == 0x70)))
+      xcode = OP_INV;
+   return (xcode);
+}
+
+/* Build op_dec[] from optable[].  The first matching optable entry wins,
+   as it always did in printf_sym.  Encodings without an entry are invalid
+   when both opcode bits 0 and 4 are zero, otherwise they are ignored. */
+
+void build_opdec(void) {
+   int32 inst, i, bad = 0;
+
+   for (inst = 0; inst < 65536; inst++) {
+      for (i = 0; i < nopcode; i++) {
+         if ((inst & optable[i].opmask) == optable[i].opcode)
+            break;
+      }
+      if (i < nopcode) {
+         op_dec[inst].xcode = optable[i].xcode;
+         op_dec[inst].form  = optable[i].form;
+         op_dec[inst].idx   = i;
+      } else {
+         op_dec[inst].xcode = ((inst & 0x8800) == 0x0000) ? OP_INV : OP_NOP;
+         op_dec[inst].form  = 11;
+         op_dec[inst].idx   = -1;
+      }
+      op_dec[inst].len = (op_dec[inst].form == 4) ? 4 : 2;
+      if (op_dec[inst].xcode != opdec_cascade(inst))
+         bad++;
+   }
+   if (bad)
+      printf("Opcode table: %d encodings disagree with optable[]\n", bad);
+}
+
+/* BENCH [count]: instrs/sec of sim_instr over a fixed loop at X'800' in
+   level 5, with its operands at X'680', with and without the table */
+
+#define BENCH_ORG       0x0800
+#define BENCH_END       0x1000                 /* Storage used */
+
+static const uint16 bench_prog[] = {
+   0x8012, 0x8134,                             /* LRI  R1(H),X'12'; LRI R1(L),X'34' */
+   0x9301, 0x1588,                             /* ARI  R3(L),1;     LR  R5,R1 */
+   0x3598, 0x15B8,                             /* AR   R5,R3;       CR  R5,R1 */
+   0x9802, 0x57C8,                             /* BCL  *+4;         XR  R7,R5 */
+   0x0601, 0x0F05,                             /* LH   R6,0(0);     IC  R7(L),5(0) */
+   0x0591, 0x5280,                             /* STH  R5,X'10'(0); LHR R2,R5 */
+   0x32A0, 0x8802,                             /* SHR  R2,R3;       BZL *+4 */
+   0x76E8, 0x56D8                              /* NR   R6,R7;       OR  R6,R5 */
+};
+#define BENCH_LEN       (sizeof(bench_prog) / sizeof(bench_prog[0]))
+
+static double bench_secs(struct timespec *t0, struct timespec *t1) {
+   return (t1->tv_sec - t0->tv_sec) + (t1->tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static double bench_rate(int32 count) {        /* Best of three, Minstr/s */
+   struct timespec t0, t1;
+   double t, best = 0.0;
+   int32 i;
+
+   for (i = 0; i < 3; i++) {
+      cpu_prep(BENCH_ORG);
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      if (cpu_run(count) != SCPE_OK)
+         return 0.0;
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      t = bench_secs(&t0, &t1);
+      if (count / t / 1e6 > best)
+         best = count / t / 1e6;
+   }
+   return best;
+}
+
+t_stat bench_cmd(int32 flag, char *cptr) {
+   t_uint64 hits = pdc_hits, miss = pdc_miss;
+   double rt, rc;
+   t_stat r;
+   int32 i, a, jm = jit_mode;
+   uint32 count = 10000000;
+
+   if (*cptr != 0) {
+      count = (uint32) get_uint(cptr, 10, 0x7FFFFFFF, &r);
+      if ((r != SCPE_OK) || (count == 0))
+         return SCPE_ARG;
+   }
+   if ((r = cpu_hold(BENCH_END)) != SCPE_OK)
+      return r;
+   for (a = 0x0680; a < BENCH_ORG; a++)
+      M[a] = a & 0xFF;
+   for (i = 0, a = BENCH_ORG; i < BENCH_LEN; i++, a += 2) {
+      M[a] = bench_prog[i] >> 8;
+      M[a + 1] = bench_prog[i] & 0xFF;
+   }
+   M[a] = 0xA8 | (((a + 2 - BENCH_ORG) >> 8) & 0x07);   /* B back to the start */
+   M[a + 1] = ((a + 2 - BENCH_ORG) & 0xFE) | 0x01;
+   jit_mode = JIT_OFF;                         /* The interpreter only */
+   rt = bench_rate(count);
+   pdc_bypass = 1;
+   rc = bench_rate(count);
+   pdc_bypass = 0;
+   jit_mode = jm;
+   cpu_unhold();                               /* Flushes the cache */
+   pdc_hits = hits;
+   pdc_miss = miss;
+
+   printf("sim_instr over a %d instr loop, %u instrs\n", (int32) BENCH_LEN + 1, count);
+   printf("  table   : %8.2f Minstr/s\n", rt);
+   printf("  cascade : %8.2f Minstr/s  (table x%.2f)\n", rc, (rc > 0) ? rt / rc : 0.0);
+   return SCPE_OK;
+}
+
+/* Decode the instruction at addr into a cache entry */
+
+void pdc_load(struct pdent *pd, int32 addr) {
+   int32 inst;
+
+   pd->byte[0] = GetMem(addr);
+   pd->byte[1] = GetMem((addr + 1) & AMASK);
+   pd->byte[2] = GetMem((addr + 2) & AMASK);
+   pd->byte[3] = GetMem(((addr + 2) & AMASK) + 1);
+   inst = (pd->byte[0] << 8) | pd->byte[1];
+   if (pdc_bypass) {                           /* Decode as before the table */
+      pd->xcode = opdec_cascade(inst);
+      pd->len   = ((pd->xcode == OP_BAL) || (pd->xcode == OP_LA)) ? 4 : 2;
+   } else {
+      pd->xcode = op_dec[inst].xcode;
+      pd->len   = op_dec[inst].len;
+   }
+   pd->afld  = ((pd->byte[1] & 0x03) << 16) | (pd->byte[2] << 8) | pd->byte[3];
+   pd->valid = !pdc_bypass;                    /* Bypassed: decode every fetch */
+}
+
+/* Drop all entries covering bytes addr ... addr + len - 1.  Called after
+   the channel adapter or the loader stored there, so the pages are
+   dirty for the next checkpoint too. */
+
+void pdc_inval(int32 addr, int32 len) {
+   int32 h;
+
+   if (len <= 0)
+      return;
+   for (h = (addr >> 1) - 1; h <= ((addr + len - 1) >> 1); h++) {
+      pdc[h & (PDC_SIZE - 1)].valid = 0;
+      if (jit_cmap[h & (PDC_SIZE - 1)])
+         JIT_BUMP(((h << 1) >> JIT_PSHIFT) & (JIT_PAGES - 1));
+   }
+   for (h = addr >> CKPT_PSHIFT; h <= ((addr + len - 1) >> CKPT_PSHIFT); h++)
+      ckpt_dirty[h & (CKPT_PAGES - 1)] = 1;
+   pdc_invals++;
+}
+
+/* Channel adapter thread: the cycle steal stored len bytes at addr.
+   The data is in M before the range is posted, the range is posted
+   before the adapter raises its request. */
+
+void pdc_post(int32 addr, int32 len) {
+   if (len <= 0)
+      return;
+   pthread_mutex_lock(&pdc_post_lock);
+   if (!pdc_posted || (addr < pdc_post_lo))
+      pdc_post_lo = addr;
+   if (!pdc_posted || (addr + len > pdc_post_hi))
+      pdc_post_hi = addr + len;
+   __atomic_store_n(&pdc_posted, 1, __ATOMIC_RELEASE);
+   pthread_mutex_unlock(&pdc_post_lock);
+}
+
+/* CCU at the interrupt sample: drop what the adapters posted */
+
+void pdc_sync(void) {
+   int32 lo, hi;
+
+   if (!__atomic_load_n(&pdc_posted, __ATOMIC_ACQUIRE))
+      return;
+   pthread_mutex_lock(&pdc_post_lock);
+   lo = pdc_post_lo;
+   hi = pdc_post_hi;
+   pdc_posted = 0;
+   pthread_mutex_unlock(&pdc_post_lock);
+   pdc_inval(lo, hi - lo);
+}
+
+void pdc_flush(void) {
+   int32 p;
+
+   memset(pdc, 0, sizeof(pdc));
+   for (p = 0; p < JIT_PAGES; p++)             /* Drop all translated blocks */
+      JIT_BUMP(p);
+   pdc_invals++;
+}
+
+/* SHOW CPU PDCACHE */
+
+t_stat pdc_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   int32 h, used = 0;
+   t_uint64 total = pdc_hits + pdc_miss;
+
+   for (h = 0; h < PDC_SIZE; h++)
+      if (pdc[h].valid)
+         used++;
+   fprintf(st, "predecode cache: %d of %d entries valid\n", used, PDC_SIZE);
+   fprintf(st, "   hits %llu, misses %llu, invalidations %llu",
+           (unsigned long long) pdc_hits, (unsigned long long) pdc_miss,
+           (unsigned long long) pdc_invals);
+   if (total)
+      fprintf(st, ", hit ratio %.2f%%", (100.0 * pdc_hits) / total);
+   fprintf(st, "\n");
+   return SCPE_OK;
+}
@@ -23,6 +23,7 @@
 */
 
 #include "sim_defs.h"                                   /* simulator defns */
+#include <time.h>
 
 /* General */
 #define VERSION         "0.1"
@@ -38,6 +39,8 @@
 #define FILLED          1
 #define EMPTY           0
 
+extern t_uint64 ccu_clock_ns(clockid_t id);             /* Host clock in nsec, i3705_cpu.c */
+
 /* Simulator stop codes */
 
 #define STOP_RSRV       1                               /* must be 1 */
@@ -48,11 +51,16 @@
 #define STOP_INVADDR    6                               /* Prog check - invalid addr */
 #define STOP_INVDEV     7                               /* Prog check - invalid dev cmd */
 #define STOP_NOCD       8                               /* ATTN card reader */
+#define STOP_WATCH      9                               /* watched storage changed */
+#define STOP_RREND      10                              /* end of replayed events */
 #define RESET_INTERRUPT 77                              /* special return from SIO */
 
 /* Memory */
 
-#define MAXMEMSIZE      262144                          /* max memory size */
+#define MAXMEMSIZE      262144                          /* max memory size, 18 bit addr */
+#define DFLTMEMSIZE     262144                          /* default memory size */
+#define MEMMAPSIZE      (2 * MAXMEMSIZE)                /* storage + guard region */
+#define MEMMAPMASK      (MEMMAPSIZE - 1)                /* keeps addr inside the mapping */
 #define AMASK           (MAXMEMSIZE - 1)                /* logical addr mask */
 #define PAMASK          (MAXMEMSIZE - 1)                /* physical addr mask */
 #define MEMSIZE         (cpu_unit.capac)                /* actual memory size */
@@ -89,11 +97,249 @@ struct opdef {
                                                            6 - RTm
                                                            7 - RSA
                                                            8 - RE
-                                                           9 - EXIT */
+                                                           9 - EXIT
+                                                           10 - RT (BCT)
+                                                           11 - INVALID */
     int32   group;                                      /* Group Code:
                                                            0 - spare */
+    int32   xcode;                                      /* Execution class (OP_xxx) */
+};
+
+/* Execution classes.  Every 16 bit encoding is mapped onto exactly one
+   of these by build_opdec(), so sim_instr needs only a single switch. */
+
+#define OP_NOP          0                               /* unassigned, no operation */
+#define OP_INV          1                               /* invalid, OP reg check */
+#define OP_B            2
+#define OP_BCL          3
+#define OP_BZL          4
+#define OP_BCT          5
+#define OP_BB           6
+#define OP_LRI          7
+#define OP_ARI          8
+#define OP_SRI          9
+#define OP_CRI          10
+#define OP_XRI          11
+#define OP_ORI          12
+#define OP_NRI          13
+#define OP_TRM          14
+#define OP_LCR          15
+#define OP_ACR          16
+#define OP_SCR          17
+#define OP_CCR          18
+#define OP_XCR          19
+#define OP_OCR          20
+#define OP_NCR          21
+#define OP_LCOR         22
+#define OP_ICT          23
+#define OP_STCT         24
+#define OP_IC           25
+#define OP_STC          26
+#define OP_LH           27
+#define OP_STH          28
+#define OP_L            29
+#define OP_ST           30
+#define OP_LHR          31
+#define OP_AHR          32
+#define OP_SHR          33
+#define OP_CHR          34
+#define OP_XHR          35
+#define OP_OHR          36
+#define OP_NHR          37
+#define OP_LHOR         38
+#define OP_LR           39
+#define OP_AR           40
+#define OP_SR           41
+#define OP_CR           42
+#define OP_XR           43
+#define OP_OR           44
+#define OP_NR           45
+#define OP_LOR          46
+#define OP_BALR         47
+#define OP_IN           48
+#define OP_OUT          49
+#define OP_BAL          50
+#define OP_LA           51
+#define OP_EXIT         52
+#define OP_MAX          53
+
+/* Decoded opcode table entry, one per 16 bit encoding */
+
+struct opdec {
+    uint8   xcode;                                      /* Execution class */
+    uint8   form;                                       /* Format, see opdef */
+    uint8   len;                                        /* Instr length in bytes */
+    int8    idx;                                        /* optable index or -1 */
 };
 
+/* Predecode cache, one entry per storage halfword.  An entry covers the
+   four bytes fetched for the instruction at that (even) address, so a
+   store to byte a must drop the entries of halfwords a/2 and a/2 - 1. */
+
+struct pdent {
+    uint8   valid;                                      /* Entry is filled */
+    uint8   xcode;                                      /* Execution class */
+    uint8   len;                                        /* Instr length in bytes */
+    uint8   byte[4];                                    /* Instr bytes 0-3 */
+    int32   afld;                                       /* RA format address */
+};
+
+#define PDC_SIZE        (MAXMEMSIZE / 2)                /* entries, power of 2 */
+#define PDC_INVAL(a)    { pdc[((a) >> 1) & (PDC_SIZE - 1)].valid = 0; \
+                          pdc[(((a) >> 1) - 1) & (PDC_SIZE - 1)].valid = 0; \
+                          if (jit_cmap[((a) >> 1) & (PDC_SIZE - 1)]) \
+                             JIT_BUMP(((a) >> JIT_PSHIFT) & (JIT_PAGES - 1)); }
+
+/* Basic block translator (i3705_jit.c).  A store into a halfword that is
+   part of a translated block bumps the generation of its page.  Bumps
+   are atomic and release the stored bytes to whoever reads the
+   generation with JIT_GEN. */
+
+#define JIT_BUMP(p)     __atomic_fetch_add(&jit_pgen[p], 1, __ATOMIC_RELEASE)
+#define JIT_GEN(p)      __atomic_load_n(&jit_pgen[p], __ATOMIC_ACQUIRE)
+
+#define JIT_OFF         0
+#define JIT_ON          1
+#define JIT_CHECK       2                               /* lockstep with interpreter */
+
+/* Event units of the CCU services on the EVT device (i3705_cpu.c) */
+
+#define EVT_GOV         0                               /* Throttle check */
+#define EVT_CKPT        1                               /* Checkpoint interval */
+#define EVT_RR          2                               /* Next replayed event */
+#define EVT_STEP        3                               /* End of cpu_run() */
+#define EVT_BRK         4                               /* Breakpoint armed again */
+#define EVT_NUNITS      5
+
+/* Interval timer timebase (i3705_timer.c) */
+
+#define TMR_WALL        0                               /* host clock thread */
+#define TMR_VIRTUAL     1                               /* executed instr count */
+#define TMR_HYBRID      2                               /* instrs, 100 msec at most */
+
+/* Record and replay of external events (i3705_rr.c) */
+
+#define RR_OFF          0
+#define RR_RECORD       1                               /* log thread input */
+#define RR_REPLAY       2                               /* input from the log */
+
+#define JIT_PSHIFT      8                               /* 256 byte pages */
+#define JIT_PAGES       (MAXMEMSIZE >> JIT_PSHIFT)
+
+/* Dirty storage pages for incremental checkpoints (i3705_ckpt.c), marked
+   after the store so that a page cleared meanwhile is marked again. */
+
+#define CKPT_PSHIFT     10                              /* 1K pages */
+#define CKPT_PAGES      (MAXMEMSIZE >> CKPT_PSHIFT)
+#define CKPT_DIRTY(a)   ckpt_dirty[((a) >> CKPT_PSHIFT) & (CKPT_PAGES - 1)] = 1
+
+/* Execution profiler (i3705_prof.c).  Counts one instr by execution
+   class, halfword IAR and level. */
+
+#define PROF_COUNT(pc, x) { prof_op[x]++; prof_pc[((pc) >> 1) & (PDC_SIZE - 1)]++; \
+                            prof_lvl_n[lvl]++; }
+
+/* Coverage bitmap (i3705_cov.c), one bit per storage halfword, set on instr fetch */
+
+#define COV_BYTES       (MAXMEMSIZE / 16)
+#define COV_MARK(pc)    cov_map[((pc) >> 4) & (COV_BYTES - 1)] |= 1 << (((pc) >> 1) & 7)
+
+/* Breakpoint bitmap (i3705_brk.c), same layout, set by BREAK */
+
+#define BRK_TEST(pc)    (brk_map[((pc) >> 4) & (COV_BYTES - 1)] & (1 << (((pc) >> 1) & 7)))
+
+/* Idle loop detection (i3705_idle.c), after a taken branch at saved_PC.
+   Only a branch back can close a loop. */
+
+#define IDLE_BRANCH()   { if (idle_on && (GRb[0] <= saved_PC)) idle_branch(); }
+
+/* Lazy condition latches (i3705_latch.c).  An instr records the kind of
+   its result and one value in lz_k/lz_v; CL_LATCH() forms CL_C and CL_Z
+   of the active group from them before anything reads the latches.
+   Build with -DI3705_EAGER_LATCH to form them in every instr. */
+
+#define LZ_NONE         0                               /* CL_C, CL_Z are current */
+#define LZ_NZ           1                               /* Z = v == 0, C = !Z */
+#define LZ_CY           2                               /* Z = v<15:0> == 0, C = v<16> */
+#define LZ_CY18         3                               /* Z = v<17:0> == 0, C = v<18> */
+#define LZ_CMP          4                               /* v = a - b: Z = a == b, C = a < b */
+#define LZ_PAR          5                               /* Z = v == 0, C = even parity */
+#define LZ_CZ           6                               /* v = C << 1 | Z */
+
+#ifdef I3705_EAGER_LATCH
+#define LATCH(k, v)     { lz_k = (k); lz_v = (v); cl_latch(); }
+#else
+#define LATCH(k, v)     { lz_k = (k); lz_v = (v); }
+#endif
+#define CL_LATCH()      { if (lz_k != LZ_NONE) cl_latch(); }
+
+/* Utilisation accounting (i3705_cucr.c), charge an instr of c cycles
+   to the level and advance the CUCR once per 8 cycles. */
+
+#define CU_COUNT(c)     { cu_cyc[lvl] += (c); cu_ins[lvl]++;                  \
+                          if ((cycle_eight += (c)) >= 8) {                    \
+                             cycle_eight -= 8;                                \
+                             if (Eregs_Inp[0x7A] == 0xFFFF)                   \
+                                Eregs_Inp[0x7A] = 0x8000;                     \
+                             else                                             \
+                                Eregs_Inp[0x7A]++;                            \
+                          } }
+
+/* Binary instruction trace (i3705_trace.c), one record per executed
+   instr in a power of 2 ring.  gr/val hold the one GR (1-7) changed by
+   the instr, or the E field and operand of an IN or OUT. */
+
+#define TRC_GR          0x01                            /* gr/val valid */
+#define TRC_IN          0x02                            /* ereg/val: IN */
+#define TRC_OUT         0x04                            /* ereg/val: OUT */
+#define TRC_C           0x08                            /* C latch after */
+#define TRC_Z           0x10                            /* Z latch after */
+
+struct trcent {
+    uint32  iar;                                        /* Instr address */
+    uint8   inst[4];                                    /* Instr bytes 0-3 */
+    uint8   lvl;                                        /* Program level */
+    uint8   flags;                                      /* TRC_xx */
+    uint8   gr;                                         /* Changed GR */
+    uint8   ereg;                                       /* IN/OUT E field */
+    int32   val;                                        /* New GR or I/O value */
+};
+
+/* Branch trace (i3705_trace.c).  Counts one instr of length len at pc
+   and writes a record when pc does not follow the previous instr or
+   the level changed: taken branches, EXITs and interrupt entries. */
+
+#define BTR_STEP(pc, len) { if (((pc) != btr_next) || (lvl != btr_lvl)) \
+                               btr_rec(pc);                            \
+                            btr_n++; btr_last = (pc); btr_next = (pc) + (len); }
+
+/* Interrupt sources, one bit each in the pending summary word int_src.
+   Producers (CCU, channel adapter and scanner threads, timer signal) set
+   and reset bits with atomic ops; the CCU samples the word once per pass
+   and int_src_lvl[] maps it to the requesting levels.  Level bits use
+   the layout of the OUT X'7E'/X'7F' mask operand: L1 = 0x40 ... L5 = 0x04. */
+
+#define IRQ_IPL_L1      0x0001                          /* IPL */
+#define IRQ_OPC_L1      0x0002                          /* Invalid op code */
+#define IRQ_IOL5_L1     0x0004                          /* I/O instr in L5 */
+#define IRQ_ADR_L1      0x0008                          /* Addressing exception */
+#define IRQ_DIAG_L2     0x0010                          /* Diagnostic (test mode) */
+#define IRQ_SVC_L2      0x0020                          /* Scanner SVC */
+#define IRQ_INTER_L3    0x0040                          /* Panel interrupt */
+#define IRQ_TIMER_L3    0x0080                          /* Interval timer */
+#define IRQ_PCI_L3      0x0100                          /* PCI L3, OUT X'7C' */
+#define IRQ_CADS_L3     0x0200                          /* Chan Adap data/status */
+#define IRQ_CAIS_L3     0x0400                          /* Chan Adap initial sel */
+#define IRQ_PCI_L4      0x0800                          /* PCI L4, OUT X'7D' */
+#define IRQ_SVC_L4      0x1000                          /* SVC L4, EXIT in L5 */
+#define IRQ_NSRC        13
+#define IRQ_ALL         ((1 << IRQ_NSRC) - 1)
+#define IRQ_LVL(n)      (0x80 >> (n))                   /* Level n bit */
+
+#define IRQ_SET(b)      __sync_fetch_and_or(&int_src, (b))
+#define IRQ_CLR(b)      __sync_fetch_and_and(&int_src, ~(uint32) (b))
+#define IRQ_ON(b)       ((int_src & (b)) ? ON : OFF)
+
 
 #define MAXHOSTS 2
 #define MAXCHAN  2                                      /* Max channels */
@@ -119,3 +365,82 @@ struct IO3705 {
    struct sockaddr_in address[2];
    pthread_t CA_tid;
 };
+
+/* Communication scanner type 2 (i3705_scan_T2.c).  ICW local store and
+   the line buffers shared with the SDLC thread. */
+
+#define CS2_LINES       4                               /* ICW table size */
+#define CS2_BUFLEN      16384                           /* Line send/receive buffer */
+
+struct CS2 {
+   int8     Eflg_rvcd;                                  /* Eflag received */
+   int8     CS2_req_L2_int;
+   int      abar;                                       /* Attach Buffer Addr Reg (020-1FF) to CS2 */
+   int      abar_int;                                   /* ABAR of line interrupt from CS2 */
+   /* ICW Local Store Registers */
+   uint8_t  icw_scf[CS2_LINES];                         /* ICW[ 0- 7] SCF - Secondary Control Field */
+   uint8_t  icw_pdf[CS2_LINES];                         /* ICW[ 8-15] PDF - Parallel Data Field */
+   uint8_t  icw_lcd[CS2_LINES];                         /* ICW[16-19] LCD - Line Code Definer */
+   uint8_t  icw_pcf[CS2_LINES];                         /* ICW[20-23] PCF - Primary Control Field */
+   uint8_t  icw_sdf[CS2_LINES];                         /* ICW[24-31] SDF - Serial Data Field */
+   uint16_t icw_Rflags[CS2_LINES];                      /* ICW[34-47] flags */
+   /* Additional icw fields for emulator */
+   uint8_t  icw_pcf_prev[CS2_LINES];                    /* Previous icw_pcf */
+   uint8_t  icw_lne_stat[CS2_LINES];                    /* Line state: RESET, TX or RX */
+   uint8_t  icw_pcf_nxt[CS2_LINES];                     /* What will be the next pcf value */
+   uint8_t  icw_pdf_reg[CS2_LINES];                     /* Status ICW PDF reg: FILLED or EMPTY */
+   int8     line_smd_addr[48];                          /* SMD area address of each line */
+   /* Host ---> PU request buffer */
+   uint8    BLU_req_buf[CS2_LINES][CS2_BUFLEN];         /* DLC header + TH + RH + RU + DLC trailer */
+   int      BLU_req_ptr[CS2_LINES];                     /* Offset pointer to BLU */
+   int      BLU_req_len[CS2_LINES];                     /* Length of BLU request */
+   int      BLU_req_stat[CS2_LINES];                    /* State of BLU Tx buffer: FILLED or EMPTY */
+   /* PU ---> Host response buffer */
+   uint8    BLU_rsp_buf[CS2_LINES][CS2_BUFLEN];
+   int      BLU_rsp_ptr[CS2_LINES];
+   int      BLU_rsp_len[CS2_LINES];
+   int      BLU_rsp_stat[CS2_LINES];                    /* State of BLU Rx buffer: FILLED or EMPTY */
+   int      PIU_rsp_ptr[CS2_LINES];                     /* Offset pointer to PIU */
+   int      PIU_rsp_len[CS2_LINES];                     /* Length of PIU response */
+   uint8    saved_FD2_RH_0[CS2_LINES];                  /* RH of the 1st or only segment, */
+   uint8    saved_FD2_RH_1[CS2_LINES];                  /* for a response to a segmented PIU */
+};
+
+/* Controller context (i3705_ctl.c).  Holds the adapter side of the
+   3705: the channel adapter I/O blocks, the scanner and the lines, and
+   the list of threads serving them.  The adapter and line threads get
+   it as thread argument, the CCU finds it in ccu_ctl.  Storage and the
+   CCU registers are globals, so there is one context per process. */
+
+#define CTL_THREADS     8
+
+struct SDLCLine;
+
+struct i3705 {
+   struct IO3705 ca[MAXCHAN];                           /* Channel adapters */
+   struct IO3705 *iob[MAXCHAN];                         /* Pointers to ca[] */
+   struct CS2 cs2;                                      /* Scanner */
+   struct SDLCLine *sdlc[CS2_LINES];                    /* SDLC lines, i3705_sdlc.c */
+   int32    sdlc_bytes;                                 /* Their size */
+   int32    nthread;                                    /* Threads of this controller */
+   const char *thread[CTL_THREADS];
+   pid_t    tid[CTL_THREADS];
+};
+
+extern struct i3705 *ccu_ctl;
+extern void ctl_thread(struct i3705 *ctl, const char *name);
+
+/* Snapshot state (i3705_snap.c).  Like a REG list, cpu.c and the
+   adapters each list the variables SAVE keeps beyond SIMH registers.
+   With ind set, addr points to a pointer to a block holding the
+   variable at off. */
+
+struct snapent {
+   const char *name;
+   void  *addr;
+   int32 off;
+   int32 size;
+   int32 ind;
+};
+
+#define SNAP(x)         { #x, (void *) &(x), 0, sizeof(x), 0 }
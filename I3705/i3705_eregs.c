@@ -0,0 +1,545 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_eregs.c: IBM 3705 CCU external register access (IN and OUT)
+
+   IN and OUT of external registers X'20'-X'7F' go through a read and a
+   write handler table indexed by the E field.  A register without a read
+   handler is returned from Eregs_Inp[] as is; one without a write handler
+   only gets Eregs_Out[] updated.  The derived CCU input registers (LAR,
+   utility, BSC CRC, SDLC CRC, CCU check and the L1 and L2-L4 interrupt
+   request registers) are formed by their own read handler when they are
+   read, and the BSC CRC is only recalculated when its inputs changed
+   since the last IN X'7B'.  Eregs_Inp[] of a derived register therefore
+   holds the value of its last IN.
+
+   Every IN and OUT, including those of the general registers X'00'-X'1F',
+   is counted per register.
+
+        SHOW CPU EREGS          IN/OUT counts per external register
+*/
+
+#include "i3705_defs.h"
+#include "i3705_Eregs.h"                               /* Exernal regs defs */
+#include <pthread.h>
+
+extern int32 Eregs_Inp[128];
+extern int32 Eregs_Out[128];
+extern int8  CL_C[4], CL_Z[4];
+extern int32 lvl, LAR;
+extern int8  int_lvl_mask[];
+extern uint8 int_lvl_mbits;
+extern volatile uint32 int_src;
+extern int8  test_mode, load_state, bypass_CCU_check, FET_stor_diag, pgm_stop;
+extern unsigned short old_crc;
+extern unsigned char crc_data;
+extern pthread_mutex_t r77_lock;
+extern pthread_mutex_t r7f_lock;
+extern void Get_ICW(struct CS2 *cs, int abar);        /* CS2: ICW ===> Inp_Eregs 44, 45, 46, 47 rtn */
+extern int32 rr_mode;                                  /* Record and replay */
+extern int32 rr_in(int32 e, int32 v);
+
+t_uint64 ereg_nin[128], ereg_nout[128];                /* IN, OUT count per register */
+uint32 ereg_nio = 0;                                   /* IN and OUT instrs */
+static t_uint64 ereg_ncrc;                             /* BSC CRC recalculations */
+static int32 crc_key = -1;                             /* old_crc, crc_data of Eregs_Inp[0x7B] */
+
+// BSC CRC calculation
+
+static unsigned short calculateBSCCrcChar (unsigned short crc, unsigned char data_p) {
+   unsigned int data;
+   for (int i=0, data=(unsigned int)0xff & data_p;
+      i < 8;
+      i++, data >>= 1)
+      {
+      if ((crc & 0x0001) ^ (data & 0x0001))
+         crc = (crc >> 1) ^ 0xa001;
+      else crc >>= 1;
+   }
+   return crc;
+}
+
+//********************************************************
+// Read handlers.  Called with the E field of the IN,
+// they update Eregs_Inp[] of that register.
+//********************************************************
+
+//***   Type 2 Scanner ***
+
+static void ein_abar(int32 e) {
+   struct CS2 *cs = &ccu_ctl->cs2;
+
+   if (lvl == 2) {
+      cs->abar = cs->abar_int;                 /* Get abar the of L2 line interrupt */
+      Eregs_Inp[0x40] = 0x0800 + (cs->abar << 1); /* Get vector @ of L2 interrupt */
+      pthread_mutex_lock(&r77_lock);
+      Eregs_Inp[0x77] &= ~0x4000;              /* Reset L2 flag */
+      // An Input x'40' will reset L2 req
+      IRQ_CLR(IRQ_SVC_L2);                     /* Reset L2 request flag */
+      pthread_mutex_unlock(&r77_lock);
+   } else {
+      // Read ABAR when executing in L3 or L4.
+      Eregs_Inp[0x40] = 0x0800 + (cs->abar << 1); /* Echo abar */
+   }
+   Get_ICW(cs, cs->abar-0x020);                // Update ICW input regs (0x44...0x47)
+}
+
+static void ein_icw(int32 e) {
+   struct CS2 *cs = &ccu_ctl->cs2;
+
+   // ICW Input register ===> Eregs_Out 44, 45, 46, 47
+   Get_ICW(cs, cs->abar-0x020);                // Update ICW input regs (0x44...0x47)
+   if (e == 0x44) {                            // NCP has read received byte
+      if (cs->icw_pcf[cs->abar-0x020] == 0x07) // TEMP PDF is now empty for next rx
+         cs->icw_pdf_reg[cs->abar-0x020] = EMPTY;
+   }
+}
+
+//***   Channel Adaptor Type 2 ***
+
+static void ein_cwar(int32 e) {                // Get INCWAR or OUTCWAR
+   Eregs_Inp[e] = Eregs_Out[e];                // Load CWAR as used by CA
+}
+
+static void ein_csar(int32 e) {                // Get Cycle Steal Address Register
+   if (Eregs_Inp[0x59] & 0x10000) {            // if X-bit 7 on ...
+      Eregs_Inp[0x58] |= 0x0001;               // ... set this in Channel Bus Out Register
+   } else {                                    // if X-bit 6 not on ...
+      Eregs_Inp[0x58] &= ~0x0001;              // ... reset this in Channel Bus Out Register
+   }
+   if (Eregs_Inp[0x59] & 0x20000) {            // if X-bit 6 on ...
+      Eregs_Inp[0x58] |= 0x0002;               // ... set this in Channel Bus Out Register
+   } else {                                    // if X-bit 6 not on ...
+      Eregs_Inp[0x58] &= ~0x0002;              // ... reset this in Channel Bus Out Register
+   }
+}
+
+//***   C C U  ***
+
+static void ein_lar(int32 e) {
+   Eregs_Inp[0x74]  = LAR;                     // Update LAR
+}
+
+static void ein_util(int32 e) {
+   Eregs_Inp[0x79]  = 0x0000;                  // Reset all bits in reg 0x79
+   Eregs_Inp[0x79] |= 0x0008;                  // Fet storage installed
+   Eregs_Inp[0x79] |= 0x0001;                  // CE IPL escape jumper NOT installed
+   if (CL_C[3] == ON) Eregs_Inp[0x79] |= 0x0200;  // L5 C & Z flags
+   if (CL_Z[3] == ON) Eregs_Inp[0x79] |= 0x0100;
+}
+
+static void ein_bsccrc(int32 e) {
+   int32 key = (old_crc << 8) | crc_data;
+
+   if (key != crc_key) {                       // Inputs changed since last IN ?
+      Eregs_Inp[0x7B] = calculateBSCCrcChar(old_crc, crc_data);
+      crc_key = key;
+      ereg_ncrc++;
+   }
+}
+
+static void ein_sdlccrc(int32 e) {
+   Eregs_Inp[0x7C] = 0xF0B8;                   // Good SDLC CRC.
+}
+
+static void ein_check(int32 e) {               // CCU Check Register
+   if (FET_stor_diag)                          // if FET storage diagnostics
+      Eregs_Inp[0x7D] |= 0x0C00;               // ...set SAR and SDR storage parity checks
+   else
+      Eregs_Inp[0x7D] &= ~0x0C00;              // ...Reset SAR and SDR storage parity checks
+}
+
+static void ein_ccug1(int32 e) {
+   Eregs_Inp[0x7E] = 0x0000;                   // Reset all bits in reg 0x7E
+   if (IRQ_ON(IRQ_ADR_L1))  Eregs_Inp[0x7E]  |= 0x0040;   // Address exception check
+   if (IRQ_ON(IRQ_IOL5_L1)) Eregs_Inp[0x7E]  |= 0x0020;   // I/O instr in L5
+   if (IRQ_ON(IRQ_OPC_L1))  Eregs_Inp[0x7E]  |= 0x0008;   // OPC check
+   if (IRQ_ON(IRQ_IPL_L1))  Eregs_Inp[0x7E]  |= 0x0002;   // IPL L1 request
+}
+
+static void ein_ccug2(int32 e) {
+   pthread_mutex_lock(&r7f_lock);              // Timer and panel set bits too
+   Eregs_Inp[0x7F] &= 0x0204;    // Reset bits in reg 0x7F
+   if (IRQ_ON(IRQ_DIAG_L2)) Eregs_Inp[0x7F]  |= 0x8000;   // Diagnostic L2 request
+   //if (IRQ_ON(IRQ_INTER_L3)) Eregs_Inp[0x7F] |= 0x0200; // Panel Interrupt L3
+   if (IRQ_ON(IRQ_PCI_L4))  Eregs_Inp[0x7F]  |= 0x0100;   // PCI L4 request
+   //if (IRQ_ON(IRQ_TIMER_L3)) Eregs_Inp[0x7F] |= 0x0004; // Interval timer L3 request
+   if (IRQ_ON(IRQ_PCI_L3))  Eregs_Inp[0x7F]  |= 0x0002;   // PCI L3 request
+   if (IRQ_ON(IRQ_SVC_L4))  Eregs_Inp[0x7F]  |= 0x0001;   // SVC L4 request
+   pthread_mutex_unlock(&r7f_lock);
+}
+
+//********************************************************
+// Write handlers.  Called after Eregs_Out[] of the
+// register has been updated.  A non zero return stops
+// the simulation.
+//********************************************************
+
+//***   Type 2 Scanner ***
+
+static t_stat eout_icw(int32 e) {
+   struct CS2 *cs = &ccu_ctl->cs2;
+
+   // Obtain ICW update lock
+   if ((e == 0x40) && ((lvl == 3) || (lvl == 4))) {
+      // Update ABAR CS2 (only when in L3 or L4).
+      cs->abar = (Eregs_Out[0x40] - 0x0800) >> 1;
+   }
+
+   if (e == 0x44) {                            // ICW SCF & PDF
+      if (Eregs_Out[0x44] & 0x8000) {
+         cs->icw_scf[cs->abar-0x020] &= 0x7F;  // Abort RESET
+      }
+      if (Eregs_Out[0x44] & 0x4000) {
+         cs->icw_scf[cs->abar-0x020] &= 0xBF;  // Service Interlock RESET
+      }
+      if (Eregs_Out[0x44] & 0x2000) {
+         cs->icw_scf[cs->abar-0x020] &= 0xDF;  // Char Overrrun/Underrun flag RESET
+      }
+      if (Eregs_Out[0x44] & 0x1000) {
+         cs->icw_scf[cs->abar-0x020] &= 0xEF;  // Modem Check RESET
+      }
+      if (Eregs_Out[0x44] & 0x0800) {
+         cs->icw_scf[cs->abar-0x020] &= 0xF7;  // Unknown flag RESET
+      }
+      if (Eregs_Out[0x44] & 0x0400) {
+         cs->icw_scf[cs->abar-0x020] &= 0xFB;  // Zero-insert remembrance flag RESET
+      }
+      cs->icw_scf[cs->abar-0x020] |= (Eregs_Out[0x44] >> 8) & 0x03; // Only Serv Req, DCD & Pgm Flag
+      cs->icw_pdf[cs->abar-0x020]  =  Eregs_Out[0x44] & 0x00FF; // Update PDF
+
+      if (cs->icw_pcf[cs->abar-0x020] != 0x07) // TEMP !!!
+         cs->icw_pdf_reg[cs->abar-0x020] = FILLED; // PDF is filled for tx
+   }
+   if (e == 0x45) {                            // ICW LCD & PCF
+      cs->icw_lcd[cs->abar-0x020] = (Eregs_Out[0x45] >> 4) & 0x0F;
+      cs->icw_pcf_nxt[cs->abar-0x020] = Eregs_Out[0x45] & 0x0F;
+   }
+                                               // ICW SDF
+   if (e == 0x46) cs->icw_sdf[cs->abar-0x020]    = (Eregs_Out[0x46] >> 2) & 0xFF;
+                                               // ICW 34 - 45
+   if (e == 0x47) cs->icw_Rflags[cs->abar-0x020] = (Eregs_Out[0x47] << 4) & 0x0070;
+   // Release ICW update lock.
+   return SCPE_OK;
+}
+
+//***   Channel Adaptor Type 2 ***
+
+static t_stat eout_casense(int32 e) {          // Channel Adapter Sense
+   if (Eregs_Out[0x53] & 0xFFFF)               // If any bit set...
+      Eregs_Out[0x54] |= 0x0100;               // ...set Unit Check
+   return SCPE_OK;
+}
+
+static t_stat eout_camode(int32 e) {           // Channel Adapter Mode
+   if (Eregs_Out[0x56] & 0x2000) {
+      Eregs_Inp[0x55] &= ~0x2000;              // Reset INCWAR valid
+      Eregs_Out[0x55] &= ~0x2000;              // Reset INCWAR valid
+   }
+   if (Eregs_Out[0x56] & 0x1000) {
+      Eregs_Inp[0x55] &= ~0x1000;              // Reset OUTCWAR valid
+      Eregs_Out[0x55] &= ~0x1000;              // Reset OUTCWAR valid
+   }
+   return SCPE_OK;
+}
+
+static t_stat eout_cactl(int32 e) {            // Channel Adapter Mode
+   if (Eregs_Out[0x57] & 0x0010) {             // Reset CA L3 interrupt
+      pthread_mutex_lock(&r77_lock);
+      Eregs_Inp[0x77] &= ~0x0028;              // Reset CA L3  interrupt
+      pthread_mutex_unlock(&r77_lock);
+      IRQ_CLR(IRQ_CAIS_L3);
+      IRQ_CLR(IRQ_CADS_L3);
+   }
+   if (Eregs_Out[0x57] & 0x0020) {             // Reset CA L1 interrupt
+      Eregs_Inp[0x76] &= ~0x0400;              // Reset CA L1  interrupt
+   }
+   if (Eregs_Out[0x57] & 0x0008) {             // Test for CA select
+      Eregs_Inp[0x55] |= 0x0001;               // Select CA1
+      Eregs_Inp[0x55] &= ~0x0002;              // deselect CA2
+   } else {
+      Eregs_Inp[0x55] |= 0x0002;               // Select CA2
+      Eregs_Inp[0x55] &= ~0x0001;              // deselect CA1
+   }
+   if (Eregs_Out[0x57] & 0x0100) {             // Test for IPL required
+      Eregs_Inp[0x53] |= 0x0200;               // Set not initialized sense
+      Eregs_Out[0x53] |= 0x0200;               // Set not initialized sense
+   }
+   if (Eregs_Out[0x57] & 0x0200) {             // Test for IPL unit exception
+      if (Eregs_Out[0x57] & 0x0008)
+         ccu_ctl->iob[0]->IPL_exception = ON;
+      else
+         ccu_ctl->iob[1]->IPL_exception = ON;
+   }
+   if (!(Eregs_Out[0x57] & 0x0200)) {          // Test for reset IPL unit exception
+      if (Eregs_Out[0x57] & 0x0008)
+         ccu_ctl->iob[0]->IPL_exception = OFF;
+      else
+         ccu_ctl->iob[1]->IPL_exception = OFF;
+   }
+   if (Eregs_Out[0x57] & 0x0004) {
+      Eregs_Inp[0x55] &= ~0x0010;              // Reset reset flag
+   }
+   if (Eregs_Out[0x57] & 0x0002) {
+      Eregs_Inp[0x55] &= ~0x0020;              // Reset channel stop
+   }
+   if ((Eregs_Out[0x57] & 0x0800) &&           // If Unit Exception latch on and ...
+      ((Eregs_Out[0x57] & 0x0100) ||           //  not initialized or...
+       (Eregs_Out[0x57] & 0x0001))) {          // in diagnostic mode
+      Eregs_Inp[0x54] |= 0x0200;               // Set Unit Check latch
+   }
+   if ((Eregs_Out[0x57] & 0x0001) &&
+      !(Eregs_Inp[0x55] & 0x8000))  {
+      Eregs_Inp[0x55] |= 0x8000;               // Diagnostic wrap mode on
+      Eregs_Inp[0x55] &= ~0x0100;              // CA not active
+   }
+   if (!(Eregs_Out[0x57] & 0x0001) &&
+      (Eregs_Inp[0x55] & 0x8000))  {
+      Eregs_Inp[0x55] &= ~0x8000;              // Diagnostic wrap mode off
+      Eregs_Inp[0x55] |= 0x0100;               // CA active
+   }
+   return SCPE_OK;
+}
+
+//***   Channel Adaptor Type 1 ***
+
+static t_stat eout_ca1ssc(int32 e) {
+   Eregs_Inp[0x62] &= ~0x0100;                 // Reset PCI interrupt
+
+   if (Eregs_Out[0x62] & 0x0400) {             // Reset CA1 L3 interrupts
+      pthread_mutex_lock(&r77_lock);
+      Eregs_Inp[0x77] &= ~0x0008;              // Reset L3 initial selection
+      pthread_mutex_unlock(&r77_lock);
+      IRQ_CLR(IRQ_CAIS_L3);
+      Eregs_Inp[0x60] &= ~0x8200;              // Reset NSC status bits
+   }
+   if (Eregs_Out[0x62] & 0x0200) {             // Reset CA1 L3 data service
+      pthread_mutex_lock(&r77_lock);
+      Eregs_Inp[0x77] &= ~0x0010;              // Reset L3 data service
+      pthread_mutex_unlock(&r77_lock);
+      IRQ_CLR(IRQ_CADS_L3);
+   }
+   if (Eregs_Out[0x62] & 0x1000)
+      Eregs_Inp[0x62] |= 0x1000;               // Set NSC Channel end
+   else
+      Eregs_Inp[0x62] &= ~0x1000;              // Reset NSC Channel end
+
+   if (Eregs_Out[0x62] & 0x0800)
+      Eregs_Inp[0x62] |= 0x0800;               // Set NSC Final status
+   else
+      Eregs_Inp[0x62] &= ~0x0800;              // Reset NSC Final status
+   return SCPE_OK;
+}
+
+//***   C C U  ***
+
+static t_stat eout_hardstop(int32 e) {         // HARD STOP
+   if (bypass_CCU_check == OFF) {
+      printf("\nDisplay Reg 1: %05X\n\r", Eregs_Out[0x71]);
+      printf(  "Display Reg 2: %05X\n\r", Eregs_Out[0x72]);
+      pgm_stop = ON;
+      return SCPE_STOP;
+   }
+   return SCPE_OK;
+}
+
+static t_stat eout_misc(int32 e) {             // Miscellaneous Control
+   int32 w_byte = Eregs_Out[e];
+
+   if (w_byte & 0x8000)  {                     // Reset IPL L1 ?
+      Eregs_Inp[0x53] &= ~0x0200;              // Reset not-initialized flag
+      IRQ_CLR(IRQ_IPL_L1);
+   }
+   if (w_byte & 0x0004)                        // Reset all L1 prgm checks
+      IRQ_CLR(IRQ_IOL5_L1 | IRQ_OPC_L1 | IRQ_ADR_L1);
+   if (w_byte & 0x2000)  {                     // Reset Panel Interrupt L3 ?
+         pthread_mutex_lock(&r7f_lock);
+         Eregs_Inp[0x7F] &= ~0x0200;           // Reset L3 Interval Timer
+         pthread_mutex_unlock(&r7f_lock);
+         IRQ_CLR(IRQ_TIMER_L3);
+      }
+      IRQ_CLR(IRQ_INTER_L3);
+   if ((w_byte &0x0200) && (test_mode))        // Set Diagnostic mode L2 ?
+      IRQ_SET(IRQ_DIAG_L2);
+   if ((w_byte &0x0100) && (test_mode))        // Reset Diagnostic mode L2 ?
+      IRQ_CLR(IRQ_DIAG_L2);
+   if (w_byte & 0x0040)  {                     // Reset Interval Timer L3 ?
+         pthread_mutex_lock(&r7f_lock);
+         Eregs_Inp[0x7F] &= ~0x0004;           // Reset L3 Interval Timer
+         pthread_mutex_unlock(&r7f_lock);
+         IRQ_CLR(IRQ_TIMER_L3);
+      }
+   if (w_byte & 0x0020)                        // Reset PCI L3 ?
+      IRQ_CLR(IRQ_PCI_L3);
+   if (w_byte & 0x0002)                        // Reset PCI L4 ?
+      IRQ_CLR(IRQ_PCI_L4);
+   if (w_byte & 0x0001)                        // Reset SVC L4 ?
+      IRQ_CLR(IRQ_SVC_L4);
+   return SCPE_OK;
+}
+
+static t_stat eout_util(int32 e) {             // Utility Control
+   if (!(Eregs_Out[e] & 0x0400)) {             // Inhibit bit PL5 C&Z flag off ?
+      if (Eregs_Out[e] & 0x0200)               // Prog L5 C flag
+         CL_C[3] = ON;
+      else
+         CL_C[3] = OFF;
+      if (Eregs_Out[e] & 0x0100)               // Prog L5 Z flag
+         CL_Z[3] = ON;
+      else
+         CL_Z[3] = OFF;
+   }
+   if (Eregs_Out[e] & 0x0040)                  // Reset load state
+      load_state = OFF;
+   if (Eregs_Out[e] & 0x0020)                  // Set test mode
+      test_mode = ON;
+   if (Eregs_Out[e] & 0x0002)                  // Set test mode
+      test_mode = ON;
+   if (Eregs_Out[e] & 0x0010)                  // Reset test mode
+      test_mode = OFF;
+   if (Eregs_Out[e] & 0x0008) {                // Set bypass CCU Check
+      if (test_mode == ON)
+         bypass_CCU_check = ON;
+   }
+   if (Eregs_Out[e] & 0x0004)                  // Reset bypass CCU Check
+      bypass_CCU_check = OFF;
+   if (Eregs_Out[e] & 0x1000)                  // Set FET Storage Diagnostocs
+      FET_stor_diag = ON;
+   else
+      FET_stor_diag = OFF;                     // Reset FET storage Diagnostics
+   return SCPE_OK;
+}
+
+static t_stat eout_cucr(int32 e) {             // CUCR reset
+   Eregs_Inp[0x7A] = 0x8000;
+   return SCPE_OK;
+}
+
+static t_stat eout_pci(int32 e) {              // Program Call Interrupt L3, L4
+   if (e == 0x7C)
+      IRQ_SET(IRQ_PCI_L3);
+   else
+      IRQ_SET(IRQ_PCI_L4);
+   return SCPE_OK;
+}
+
+static t_stat eout_setmask(int32 e) {          // Set interrupt mask bits
+   int32 w_byte = Eregs_Out[e];
+
+   int_lvl_mbits |= w_byte & 0x3C;
+   if (w_byte & 0x0020)                        // Level 2 ?
+      int_lvl_mask[2] = ON;
+   if (w_byte & 0x0010)                        // Level 3 ?
+      int_lvl_mask[3] = ON;
+   if (w_byte & 0x0008)                        // Level 4 ?
+      int_lvl_mask[4] = ON;
+   if (w_byte & 0x0004)                        // Level 5 ?
+      int_lvl_mask[5] = ON;
+   return SCPE_OK;
+}
+
+static t_stat eout_resetmask(int32 e) {        // Reset interrupt mask bits
+   int32 w_byte = Eregs_Out[e];
+
+   int_lvl_mbits &= ~(w_byte & 0x3C);
+   if (w_byte & 0x0020)                        // Level 2 ?
+      int_lvl_mask[2] = OFF;
+   if (w_byte & 0x0010)                        // Level 3 ?
+      int_lvl_mask[3] = OFF;
+   if (w_byte & 0x0008)                        // Level 4 ?
+      int_lvl_mask[4] = OFF;
+   if (w_byte & 0x0004)                        // Level 5 ?
+      int_lvl_mask[5] = OFF;
+   return SCPE_OK;
+}
+
+/* Handler tables, NULL = plain register */
+
+static void (*ereg_rd[128])(int32 e) = {
+   [0x40] = &ein_abar,
+   [0x41] = &ein_icw,    [0x42] = &ein_icw,    [0x43] = &ein_icw,
+   [0x44] = &ein_icw,    [0x45] = &ein_icw,    [0x46] = &ein_icw,    [0x47] = &ein_icw,
+   [0x50] = &ein_cwar,   [0x51] = &ein_cwar,   [0x59] = &ein_csar,
+   [0x74] = &ein_lar,    [0x79] = &ein_util,   [0x7B] = &ein_bsccrc,
+   [0x7C] = &ein_sdlccrc, [0x7D] = &ein_check, [0x7E] = &ein_ccug1,  [0x7F] = &ein_ccug2 };
+
+static t_stat (*ereg_wr[128])(int32 e) = {
+   [0x40] = &eout_icw,   [0x41] = &eout_icw,   [0x42] = &eout_icw,   [0x43] = &eout_icw,
+   [0x44] = &eout_icw,   [0x45] = &eout_icw,   [0x46] = &eout_icw,   [0x47] = &eout_icw,
+   [0x53] = &eout_casense, [0x56] = &eout_camode, [0x57] = &eout_cactl,
+   [0x62] = &eout_ca1ssc,
+   [0x70] = &eout_hardstop, [0x77] = &eout_misc, [0x79] = &eout_util, [0x7A] = &eout_cucr,
+   [0x7C] = &eout_pci,   [0x7D] = &eout_pci,   [0x7E] = &eout_setmask, [0x7F] = &eout_resetmask };
+
+/* IN of external register e (X'20'-X'7F') */
+
+int32 ereg_in(int32 e) {
+   ereg_nin[e]++;
+   ereg_nio++;
+   if (ereg_rd[e] != NULL)
+      (*ereg_rd[e])(e);
+   if (rr_mode)                                /* Log the value or take it from the log */
+      return rr_in(e, Eregs_Inp[e]);
+   return Eregs_Inp[e];
+}
+
+/* OUT of data to external register e (X'20'-X'7F') */
+
+t_stat ereg_out(int32 e, int32 data) {
+   ereg_nout[e]++;
+   ereg_nio++;
+   Eregs_Out[e] = data;                        // <<=== !!! Finally update I/O reg.
+   if (ereg_wr[e] != NULL)
+      return (*ereg_wr[e])(e);
+   return SCPE_OK;
+}
+
+void ereg_reset(void) {
+   memset(ereg_nin, 0, sizeof(ereg_nin));
+   memset(ereg_nout, 0, sizeof(ereg_nout));
+   ereg_ncrc = 0;
+   crc_key = -1;
+}
+
+/* After RESTORE, CKPT LOAD or RR REPLAY replaced old_crc and X'7B' */
+
+void ereg_fixup(void) {
+   crc_key = -1;
+}
+
+/* SHOW CPU EREGS */
+
+t_stat ereg_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   t_uint64 tin = 0, tout = 0;
+   int32 e;
+
+   fprintf(st, "external registers:   IN          OUT\n");
+   for (e = 0; e < 128; e++) {
+      if ((ereg_nin[e] == 0) && (ereg_nout[e] == 0))
+         continue;
+      fprintf(st, "   X'%02X' %12" LL_FMT "u %12" LL_FMT "u\n", e, ereg_nin[e], ereg_nout[e]);
+      tin += ereg_nin[e];
+      tout += ereg_nout[e];
+   }
+   fprintf(st, "   total %12" LL_FMT "u %12" LL_FMT "u, BSC CRC recalculated %" LL_FMT "u times\n",
+           tin, tout, ereg_ncrc);
+   return SCPE_OK;
+}
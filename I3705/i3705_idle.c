@@ -0,0 +1,236 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_idle.c: IBM 3705 idle loop detection
+
+   Every taken backward branch calls idle_branch() while detection is on.
+   The loop it closes is idle when, from one pass to the next, no storage
+   byte changed, no IN or OUT was done and the level, the IAR, GR1-7 and
+   the C and Z latches of the level are the same: the CCU can only repeat
+   the same pass until an interrupt source or another thread changes
+   something.  Inside a configured window the registers may change, so
+   that polling loops which count can be declared idle too.
+
+   An idle loop parks the CCU like the wait state does: it sleeps until
+   a request arrives or for at most 1 msec, or with the virtual timer
+   skips ahead to the next event (the sleeps also count in SHOW CPU
+   WAIT).  The loop is then resumed and parks again on its next pass if
+   nothing changed.
+
+        SET CPU IDLE            detect idle loops anywhere
+        SET CPU IDLE=lo-hi      also treat a loop inside lo-hi as idle
+        SET CPU NOIDLE          stop detection, forget the windows
+        SHOW CPU IDLE           learned loops, time parked, wakeup
+                                latency and host CPU use
+*/
+
+#include "i3705_defs.h"
+#include <time.h>
+#include <sys/resource.h>
+
+#define IDLE_WIN        8                      /* Configured windows */
+#define IDLE_LOOPS      16                     /* Learned loops shown */
+
+extern int32 *GRb;
+extern int32 lvl, Grp, saved_PC, tmr_mode;
+extern int8 CL_C[], CL_Z[];
+extern int32 lz_k;                             /* Lazy latches */
+extern void cl_latch(void);
+extern volatile uint32 int_src, int_src_seen;
+extern uint32 mem_nchg, ereg_nio;
+extern t_uint64 ccu_idle(void);
+extern t_uint64 cu_vwait;
+
+int32 idle_on = 0;                             /* Detection active */
+volatile int32 idle_pend = 0;                  /* Park at the next pass */
+
+static int32 idle_lo[IDLE_WIN], idle_hi[IDLE_WIN];
+static int32 idle_nwin = 0;
+
+/* State at the previous backward branch */
+static int32 s_head, s_from, s_lvl, s_c, s_z, s_gr[8];
+static uint32 s_chg, s_io;
+
+struct idleloop {
+   int32    head, from, lvl;
+   t_uint64 parks;
+};
+
+static struct idleloop idle_loop[IDLE_LOOPS];
+static int32 idle_nloop = 0, idle_cur = -1;
+static t_uint64 idle_parks, idle_ns, idle_wakes, idle_lat_ns;
+static t_uint64 idle_lat_min, idle_lat_max, idle_skips;
+static t_uint64 idle_t0_ns;                    /* Start of the statistics */
+static t_uint64 idle_cpu0_us[2];               /* CCU thread, process */
+
+static t_uint64 idle_cpu_us(int who) {         /* Host CPU used so far */
+   struct rusage ru;
+
+   getrusage(who, &ru);
+   return ((t_uint64) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 +
+           ru.ru_utime.tv_usec + ru.ru_stime.tv_usec);
+}
+
+/* A taken branch from saved_PC back to GRb[0] */
+
+void idle_branch(void) {
+   int32 i, win = 0, same;
+
+   CL_LATCH();                                 /* Compare real latches */
+   for (i = 0; i < idle_nwin; i++)
+      if ((GRb[0] >= idle_lo[i]) && (saved_PC <= idle_hi[i]))
+         win = 1;
+   same = (GRb[0] == s_head) && (saved_PC == s_from) && (lvl == s_lvl) &&
+          (mem_nchg == s_chg) && (ereg_nio == s_io);
+   if (same && !win)
+      same = (memcmp(&GRb[1], &s_gr[1], 7 * sizeof(int32)) == 0) &&
+             (CL_C[Grp] == s_c) && (CL_Z[Grp] == s_z);
+   if (same) {
+      if ((idle_cur < 0) || (idle_loop[idle_cur].head != s_head) ||
+          (idle_loop[idle_cur].lvl != lvl)) {
+         for (idle_cur = 0; idle_cur < idle_nloop; idle_cur++)
+            if ((idle_loop[idle_cur].head == s_head) && (idle_loop[idle_cur].lvl == lvl))
+               break;
+         if (idle_cur == IDLE_LOOPS)
+            idle_cur = -1;                     /* Table full, count only */
+         else if (idle_cur == idle_nloop) {
+            idle_loop[idle_cur].head = s_head;
+            idle_loop[idle_cur].from = s_from;
+            idle_loop[idle_cur].lvl = lvl;
+            idle_loop[idle_cur].parks = 0;
+            idle_nloop++;
+         }
+      }
+      idle_pend = 1;
+      int_src_seen = ~int_src;                 /* End the batch or block */
+      return;
+   }
+   s_head = GRb[0];
+   s_from = saved_PC;
+   s_lvl = lvl;
+   s_chg = mem_nchg;
+   s_io = ereg_nio;
+   memcpy(&s_gr[1], &GRb[1], 7 * sizeof(int32));
+   s_c = CL_C[Grp];
+   s_z = CL_Z[Grp];
+}
+
+/* Called by sim_instr after the level selection when idle_pend is set */
+
+void idle_park(void) {
+   t_uint64 t0, tw;
+
+   idle_pend = 0;
+   if ((lvl != s_lvl) || (int_src != int_src_seen))
+      return;                                  /* Interrupt taken meanwhile */
+   idle_parks++;
+   if (idle_cur >= 0)
+      idle_loop[idle_cur].parks++;
+   if (tmr_mode == TMR_VIRTUAL) {
+      if (sim_interval > 0)
+         cu_vwait += sim_interval;             /* Not run, see i3705_cucr.c */
+      sim_interval = 0;                        /* Skip ahead to the next event */
+      idle_skips++;
+      return;
+   }
+   t0 = ccu_clock_ns(CLOCK_MONOTONIC);
+   tw = ccu_idle();
+   idle_ns += ccu_clock_ns(CLOCK_MONOTONIC) - t0;
+   if (tw) {                                   /* Woken by a request */
+      if ((idle_wakes == 0) || (tw < idle_lat_min))
+         idle_lat_min = tw;
+      if (tw > idle_lat_max)
+         idle_lat_max = tw;
+      idle_lat_ns += tw;
+      idle_wakes++;
+   }
+}
+
+/* SET CPU IDLE{=lo-hi}, SET CPU NOIDLE */
+
+t_stat idle_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   t_addr lo, hi;
+   char *tptr;
+
+   if (val == 0) {
+      if (cptr != NULL)
+         return SCPE_ARG;
+      idle_on = 0;
+      idle_pend = 0;
+      idle_nwin = 0;
+      return SCPE_OK;
+   }
+   if (cptr != NULL) {
+      tptr = get_range(NULL, cptr, &lo, &hi, 16, AMASK, 0);
+      if ((tptr == NULL) || (*tptr != 0) || (hi < lo))
+         return SCPE_ARG;
+      if (idle_nwin == IDLE_WIN)
+         return SCPE_MEM;
+      idle_lo[idle_nwin] = lo;
+      idle_hi[idle_nwin] = hi;
+      idle_nwin++;
+   }
+   if (!idle_on) {                             /* Start the statistics */
+      idle_nloop = 0;
+      idle_cur = -1;
+      idle_parks = idle_ns = idle_wakes = idle_lat_ns = idle_skips = 0;
+      idle_lat_min = idle_lat_max = 0;
+      idle_t0_ns = ccu_clock_ns(CLOCK_MONOTONIC);
+      idle_cpu0_us[0] = idle_cpu_us(RUSAGE_THREAD);   /* SCP runs sim_instr */
+      idle_cpu0_us[1] = idle_cpu_us(RUSAGE_SELF);
+      s_head = -1;
+   }
+   idle_on = 1;
+   return SCPE_OK;
+}
+
+/* SHOW CPU IDLE */
+
+t_stat idle_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   double wall;
+   int32 i;
+
+   if (!idle_on) {
+      fprintf(st, "idle detection off\n");
+      return SCPE_OK;
+   }
+   wall = (ccu_clock_ns(CLOCK_MONOTONIC) - idle_t0_ns) / 1e9;
+   fprintf(st, "idle detection on");
+   for (i = 0; i < idle_nwin; i++)
+      fprintf(st, "%s%05X-%05X", i ? ", " : ", windows ", idle_lo[i], idle_hi[i]);
+   fprintf(st, "\n");
+   for (i = 0; i < idle_nloop; i++)
+      fprintf(st, "   loop %05X-%05X L%d  %10" LL_FMT "u parks\n", idle_loop[i].head,
+              idle_loop[i].from, idle_loop[i].lvl, idle_loop[i].parks);
+   fprintf(st, "   %" LL_FMT "u parks, %.3f sec asleep", idle_parks, idle_ns / 1e9);
+   if (idle_skips)
+      fprintf(st, ", %" LL_FMT "u skipped to the next event", idle_skips);
+   fprintf(st, "\n   woken by request %" LL_FMT "u times", idle_wakes);
+   if (idle_wakes)
+      fprintf(st, ", latency min %.1f avg %.1f max %.1f usec", idle_lat_min / 1e3,
+              (idle_lat_ns / 1e3) / idle_wakes, idle_lat_max / 1e3);
+   fprintf(st, "\n");
+   if (wall > 0)
+      fprintf(st, "   host CPU over %.1f sec: CCU %.1f%%, all threads %.1f%% of one core\n",
+              wall, (idle_cpu_us(RUSAGE_THREAD) - idle_cpu0_us[0]) / (wall * 1e4),
+              (idle_cpu_us(RUSAGE_SELF) - idle_cpu0_us[1]) / (wall * 1e4));
+   return SCPE_OK;
+}
@@ -0,0 +1,1088 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_jit.c: IBM 3705 CCU basic block translator
+
+   Code that is entered often (jit_hot_limit times) is translated into a
+   block of host routines, one per 3705 instruction, with the register
+   numbers, byte selectors, immediates and displacements resolved once at
+   translation time.  A block ends at the first branch, at a 256 byte page
+   boundary, after JIT_MAXOPS instrs or at an instr that is left to the
+   interpreter: IN, OUT, EXIT, LHOR, LOR and invalid or unassigned
+   encodings.  A block never raises an addressing exception; when an
+   operand would be outside storage the block stops in front of that
+   instr and the interpreter executes it.
+
+   jit_cmap[] marks every halfword that is part of a translated block.  A
+   store into a marked halfword bumps the generation of its page
+   (PDC_INVAL, pdc_inval and pdc_flush) and every block in that page is
+   dropped on its next entry, or right after the store when the block
+   modified itself.  The generation is read before the code bytes and
+   again after them: a block whose page was stored into while it was
+   being translated is left to the interpreter and dropped on its next
+   entry.  A block also stops when a channel adapter posted a cycle
+   steal range that the CCU has not dropped yet (pdc_sync).
+
+   sim_instr calls jit_step() after interrupt level selection, so events,
+   breakpoints, tracing and level changes all stay with the interpreter.
+   Between two instrs of a block jit_run() does what the top of the
+   interpreter loop would do for a straight line of code: tick
+   sim_interval, update LAR, IAR and the CUCR cycle counter.
+
+        SET CPU JIT             enable translation
+        SET CPU JIT=n           enable, translate after n entries (1-255)
+        SET CPU JITCHECK        enable with lockstep check
+        SET CPU NOJIT           disable (default)
+        SHOW CPU JIT            statistics
+
+   In check mode each block is run, its result (registers, latches, CUCR,
+   LAR and stored bytes) is saved and the machine state and storage are
+   rolled back.  The interpreter then executes the same instrs and the
+   two results are compared at the top of the following pass.  A
+   difference is reported and the block is replaced by an empty one so
+   the interpreter keeps that code from then on.
+
+   Condition latches are formed lazily, as in the interpreter: a handler
+   records its result with LATCH() and BCL, BZL form them (i3705_latch.c).
+   The record is left for the interpreter when a block ends.
+*/
+
+#include "i3705_defs.h"
+
+extern int32 GR[4][8];
+extern int32 *GRb;                                       /* Register bank of active level */
+extern uint8 cov_map[];                                  /* Executed halfwords */
+extern uint8 brk_map[];                                  /* Breakpoint halfwords */
+extern int32 idle_on;                                    /* Idle loop detection */
+extern void idle_branch(void);
+extern int8  CL_C[4], CL_Z[4];
+extern int32 Eregs_Inp[128];
+extern int32 lvl, Grp, PC, LAR, saved_PC;
+extern int32 opcode, opcode0, opcode1;
+extern int32 val[4];
+extern int8  cycle_eight;
+extern uint8 cu_cost[];
+extern t_uint64 cu_cyc[], cu_ins[];
+extern volatile uint32 int_src, int_src_seen;
+extern int8  wait_state;
+extern unsigned short old_crc;
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern struct opdec op_dec[];
+extern struct pdent pdc[];
+extern volatile int32 pdc_posted, mem_pend;
+extern int32 GetMem(int32 addr);
+extern int32 PutMem(int32 addr, int32 data);
+extern int32 lz_k, lz_v;                                 /* Lazy latches */
+extern int32 cl_form(void);
+extern void cl_latch(void);
+
+#define JIT_MAXOPS      32                     /* Max instrs per block */
+#define JIT_BLOCKS      4096                   /* Block pool size */
+#define JIT_LOGSIZE     256                    /* Check mode store log */
+
+#define JM_NONE         0                      /* No storage operand */
+#define JM_CT           1                      /* ICT, STCT: addr in base reg */
+#define JM_D            2                      /* D(B) operand */
+
+struct jop {
+   int32  (*fn)(struct jop *op);               /* Host routine */
+   int32  addr;                                /* Address of instr */
+   uint8  byte[4];                             /* Instr bytes, as in pdent */
+   uint8  r1, r2;                              /* Register numbers */
+   uint8  n1, n2;                              /* Byte select N fields */
+   uint8  b;                                   /* Base register */
+   uint8  mem;                                 /* Storage operand, JM_xx */
+   uint8  span;                                /* Operand length - 1 */
+   uint8  hw;                                  /* Force HW boundary */
+   uint8  cyc;                                 /* CCU cycles, cu_cost[] */
+   uint16 mask;                                /* BB bit test mask */
+   int32  imm;                                 /* I, D, signed T or A field */
+};
+
+struct jblock {
+   int32  page;                                /* Storage page */
+   uint32 gen;                                 /* Page generation at translation */
+   int32  n;                                   /* Nr of instrs, 0 = not translated */
+   struct jop op[JIT_MAXOPS];
+};
+
+int32 jit_mode = JIT_OFF;                      /* JIT_OFF, JIT_ON or JIT_CHECK */
+int32 jit_hot_limit = 16;                      /* Entries before translation */
+uint32 jit_pgen[JIT_PAGES];                    /* Page code store generations */
+uint8 jit_cmap[PDC_SIZE];                      /* Halfwords holding translated code */
+
+static struct jblock *jit_map[PDC_SIZE];       /* Block starting at halfword */
+static uint8 jit_hot[PDC_SIZE];                /* Entry counters */
+static struct jblock jit_pool[JIT_BLOCKS];
+static int32 jit_used = 0;                     /* Blocks allocated from pool */
+
+static t_uint64 jit_blocks, jit_execs, jit_instrs, jit_inval, jit_flushes;
+static t_uint64 jit_chk_ok, jit_chk_bad, jit_chk_skip;
+
+/* Check mode state */
+
+struct jlog {
+   int32 addr;
+   uint8 data;
+};
+
+int32 jit_logging = OFF;                       /* PutMem calls jit_log_store when ON */
+static struct jlog jit_log[JIT_LOGSIZE];       /* Old contents of stored bytes */
+static int32 jit_nlog;
+static int32 chk_left = -1;                    /* Interp passes still to run, -1 = idle */
+static int32 chk_lvl, chk_n;
+static struct jblock *chk_blk;
+static int32 chk_GR[4][8];
+static int8  chk_C[4], chk_Z[4];
+static int32 chk_7A, chk_LAR;
+static int8  chk_c8;
+static struct jlog chk_mem[JIT_LOGSIZE];       /* Bytes as stored by the block */
+static int32 chk_nmem;
+static uint8 chk_cz[JIT_MAXOPS];               /* C << 1 | Z after each instr */
+static int32 chk_czbad, chk_czint;             /* First instr with other latches */
+
+void jit_log_store(int32 addr) {
+   if (jit_nlog < JIT_LOGSIZE) {
+      jit_log[jit_nlog].addr = addr;
+      jit_log[jit_nlog].data = M[addr];
+      jit_nlog++;
+   }
+}
+
+//********************************************************
+// Translated instructions.  Each routine mirrors the
+// matching handler in sim_instr.  GR0 has already been
+// advanced past the instr when it is called.  A non zero
+// return ends the block.
+//********************************************************
+
+#define G Grp
+
+#define J_IDLE()        { if (idle_on && (GRb[0] <= saved_PC)) idle_branch(); }
+
+static int32 j_b(struct jop *op) {
+   GRb[0] = GRb[0] + op->imm;
+   PC = GRb[0];
+   J_IDLE();
+   return 1;
+}
+
+static int32 j_bcl(struct jop *op) {
+   CL_LATCH();
+   if (CL_C[G] == ON) {
+      GRb[0] = GRb[0] + op->imm;
+      PC = GRb[0];
+      J_IDLE();
+   }
+   return 1;
+}
+
+static int32 j_bzl(struct jop *op) {
+   CL_LATCH();
+   if (CL_Z[G] == ON) {
+      GRb[0] = GRb[0] + op->imm;
+      PC = GRb[0];
+      J_IDLE();
+   }
+   return 1;
+}
+
+static int32 j_bct(struct jop *op) {
+   int32 w_byte;
+
+   if (op->n1 == 0) {
+      w_byte = (GRb[op->r1] - 0x00100) & 0x0FF00;
+      GRb[op->r1] = (GRb[op->r1] & 0x300FF) | w_byte;
+   } else {
+      w_byte = (GRb[op->r1] - 0x00001) & 0x0FFFF;
+      GRb[op->r1] = (GRb[op->r1] & 0x30000) | w_byte;
+   }
+   if ((w_byte & 0xFFFF) != 0x0000) {
+      GRb[0] = GRb[0] + op->imm;
+      PC = GRb[0];
+      J_IDLE();
+   }
+   return 1;
+}
+
+static int32 j_bb(struct jop *op) {
+   if ((GRb[op->r1] & op->mask) != 0x0000) {
+      GRb[0] = GRb[0] + op->imm;
+      PC = GRb[0];
+      J_IDLE();
+   }
+   return 1;
+}
+
+static int32 j_bal(struct jop *op) {
+   PC = (PC + 2) & AMASK;
+   if (op->r1 > 0)
+      GRb[op->r1] = PC;
+   GRb[0] = op->imm;
+   return 1;
+}
+
+static int32 j_balr(struct jop *op) {
+   int32 w_byte = GRb[op->r2];
+
+   if (op->r1 > 0)
+      GRb[op->r1] = GRb[0];
+   if (op->r2 > 0)
+      GRb[0] = w_byte;
+   return 1;
+}
+
+static int32 j_la(struct jop *op) {
+   PC = (PC + 2) & AMASK;
+   GRb[0] = PC;
+   GRb[op->r1] = op->imm;
+   return 0;
+}
+
+/* RI format */
+
+static int32 j_lri(struct jop *op) {
+   if (op->n1 == 0)
+      GRb[op->r1] = (GRb[op->r1] & 0x300FF) | (op->imm << 8);
+   else
+      GRb[op->r1] = (GRb[op->r1] & 0x3FF00) | op->imm;
+   LATCH(LZ_NZ, op->imm);
+   return 0;
+}
+
+static int32 j_ari(struct jop *op) {
+   int32 w_byte, r = GRb[op->r1];
+
+   if (op->n1 == 0) {                          /* Byte 1(L) takes no part in Z */
+      w_byte = r + (op->imm << 8);
+      LATCH(LZ_CY, ((r & 0xFFFF) + (op->imm << 8)) & 0x1FF00);
+   } else {
+      w_byte = r + op->imm;
+      LATCH(LZ_CY, (r & 0xFFFF) + op->imm);
+   }
+   GRb[op->r1] = w_byte & 0x3FFFF;
+   return 0;
+}
+
+static int32 j_sri(struct jop *op) {
+   int32 w_byte, r = GRb[op->r1], Ifld = op->imm;
+
+   if (op->n1 == 0) {
+      w_byte = r + (~(Ifld << 8)) + 1;
+      LATCH(LZ_CY, ((r & 0x0FF00) + (~(Ifld << 8) & 0x3FF00) + 0x0100) & 0x1FF00);
+   } else {
+      w_byte = r + (~Ifld) + 1;
+      LATCH(LZ_CY, ((r & 0x0FFFF) + (~Ifld) + 1) & 0x1FFFF);
+   }
+   GRb[op->r1] = w_byte & 0x3FFFF;
+   return 0;
+}
+
+static int32 j_cri(struct jop *op) {
+   int32 w_byte;
+
+   if (op->n1 == 0)
+      w_byte = (GRb[op->r1] >> 8) & 0x000FF;
+   else
+      w_byte = GRb[op->r1] & 0x000FF;
+   LATCH(LZ_CMP, w_byte - op->imm);
+   return 0;
+}
+
+static int32 j_xri(struct jop *op) {
+   int32 m = op->n1 ? 0x000FF : 0x0FF00;
+
+   GRb[op->r1] ^= op->n1 ? op->imm : (op->imm << 8);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_ori(struct jop *op) {
+   int32 m = op->n1 ? 0x000FF : 0x0FF00;
+
+   GRb[op->r1] |= op->n1 ? op->imm : (op->imm << 8);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_nri(struct jop *op) {
+   int32 m = op->n1 ? 0x000FF : 0x0FF00;
+
+   GRb[op->r1] &= op->n1 ? (op->imm | 0x3FF00) : ((op->imm << 8) | 0x300FF);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_trm(struct jop *op) {
+   int32 w_byte;
+
+   if (op->n1 == 0)
+      w_byte = (GRb[op->r1] >> 8) & 0x000FF;
+   else
+      w_byte = GRb[op->r1] & 0x000FF;
+   LATCH(LZ_NZ, w_byte & op->imm);
+   return 0;
+}
+
+/* RR character format */
+
+static int32 r2_byte(struct jop *op) {
+   if (op->n2 == 0)
+      return (GRb[op->r2] >> 8) & 0x000FF;
+   return GRb[op->r2] & 0x000FF;
+}
+
+static int32 j_lcr(struct jop *op) {
+   int32 w_byte = r2_byte(op);
+
+   if (op->n1 == 0)
+      GRb[op->r1] = (GRb[op->r1] & 0x000FF) | (w_byte << 8);
+   else
+      GRb[op->r1] = (GRb[op->r1] & 0x0FF00) | w_byte;
+   LATCH(LZ_PAR, w_byte);
+   return 0;
+}
+
+static int32 j_acr(struct jop *op) {
+   int32 w_byte = r2_byte(op), cz;
+
+   if (op->n1 == 0) {
+      w_byte = GRb[op->r1] + (w_byte << 8);
+      cz = ((w_byte & 0x0FF00) == 0x00);
+   } else {
+      w_byte = GRb[op->r1] + w_byte;
+      cz = ((w_byte & 0x0FFFF) == 0x00000);
+   }
+   if ((w_byte & 0x7F0000) > (GRb[op->r1] & 0x7F0000))
+      cz |= 2;
+   LATCH(LZ_CZ, cz);
+   GRb[op->r1] = w_byte & 0x3FFFF;
+   return 0;
+}
+
+static int32 j_scr(struct jop *op) {
+   int32 w_byte, R2x, cz;
+
+   if (op->n1 == 0) {
+      if (op->n2 == 0)
+         w_byte = GRb[op->r2] & 0x0FF00;
+      else
+         w_byte = (GRb[op->r2] << 8) & 0x0FF00;
+      cz = (w_byte > (GRb[op->r1] & 0x0FF00)) << 1;
+      R2x = (~w_byte + 0x00100) & 0x3FF00;
+      GRb[op->r1] = (GRb[op->r1] + R2x) & 0x3FFFF;
+      cz |= ((GRb[op->r1] & 0x0FF00) == 0x00);
+   } else {
+      w_byte = r2_byte(op);
+      cz = (w_byte > (GRb[op->r1] & 0x0FFFF)) << 1;
+      R2x = (~w_byte + 1) & 0x3FFFF;
+      GRb[op->r1] = (GRb[op->r1] + R2x) & 0x3FFFF;
+      cz |= ((GRb[op->r1] & 0x0FFFF) == 0x0000);
+   }
+   LATCH(LZ_CZ, cz);
+   return 0;
+}
+
+static int32 j_ccr(struct jop *op) {
+   int32 w_byte = r2_byte(op), r1b;
+
+   if (op->n1 == 0)
+      r1b = (GRb[op->r1] >> 8) & 0x000FF;
+   else
+      r1b = GRb[op->r1] & 0x000FF;
+   LATCH(LZ_CMP, r1b - w_byte);
+   return 0;
+}
+
+static int32 j_xcr(struct jop *op) {
+   int32 w_byte = r2_byte(op), m = op->n1 ? 0x00FF : 0xFF00;
+
+   GRb[op->r1] ^= op->n1 ? w_byte : (w_byte << 8);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_ocr(struct jop *op) {
+   int32 w_byte = r2_byte(op), m = op->n1 ? 0x000FF : 0x0FF00;
+
+   GRb[op->r1] |= op->n1 ? w_byte : (w_byte << 8);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_ncr(struct jop *op) {
+   int32 w_byte = r2_byte(op), m = op->n1 ? 0x000FF : 0x0FF00;
+
+   GRb[op->r1] &= op->n1 ? (w_byte | 0x3FF00) : ((w_byte << 8) | 0x300FF);
+   LATCH(LZ_NZ, GRb[op->r1] & m);
+   return 0;
+}
+
+static int32 j_lcor(struct jop *op) {
+   int32 w_byte = r2_byte(op);
+
+   LATCH(LZ_CZ, ((w_byte & 0x00001) << 1) | ((w_byte >> 1) == 0x00));
+   w_byte = w_byte >> 1;
+   if (op->n1 == 0)
+      GRb[op->r1] = (GRb[op->r1] & 0x000FF) | (w_byte << 8);
+   else
+      GRb[op->r1] = (GRb[op->r1] & 0x0FF00) | w_byte;
+   return 0;
+}
+
+/* Storage references.  jit_opnd() has set j_ea and checked that all
+   operand bytes are inside storage before the instr is started. */
+
+static int32 j_ea;                             /* Operand address */
+
+static int32 j_ict(struct jop *op) {
+   int32 w_byte;
+
+   w_byte = GetMem(j_ea);
+   GRb[op->b] = GRb[op->b] + 1;
+   if (op->n1 == 0)
+      GRb[op->r1] = (GRb[op->r1] & 0x300FF) | (w_byte << 8);
+   else
+      GRb[op->r1] = (GRb[op->r1] & 0x3FF00) | w_byte;
+   return 0;
+}
+
+static int32 j_stct(struct jop *op) {
+   int32 w_byte;
+
+   GRb[op->b] = GRb[op->b] + 1;
+   if (op->n1 == 0)
+      w_byte = (GRb[op->r1] >> 8) & 0x000FF;
+   else
+      w_byte = GRb[op->r1] & 0x000FF;
+   PutMem(j_ea, w_byte);
+   return 0;
+}
+
+static int32 j_ic(struct jop *op) {
+   int32 w_byte = GetMem(j_ea);
+
+   if (op->n1 == 0)
+      GRb[op->r1] = (GRb[op->r1] & 0x300FF) | (w_byte << 8);
+   else
+      GRb[op->r1] = (GRb[op->r1] & 0x3FF00) | w_byte;
+   LATCH(LZ_PAR, w_byte);
+   return 0;
+}
+
+static int32 j_stc(struct jop *op) {
+   if (op->n1 == 0)
+      PutMem(j_ea, (GRb[op->r1] >> 8) & 0x000FF);
+   else
+      PutMem(j_ea, GRb[op->r1] & 0x000FF);
+   return 0;
+}
+
+static int32 j_lh(struct jop *op) {
+   int32 w_byte;
+
+   w_byte = (GetMem(j_ea) << 8) | GetMem(j_ea + 1);
+   old_crc = w_byte;
+   GRb[op->r1] = w_byte;
+   if (op->r1 == 0)
+      return 1;                                /* New IAR */
+   LATCH(LZ_NZ, w_byte);
+   return 0;
+}
+
+static int32 j_sth(struct jop *op) {
+   if (op->r1 > 0) {
+      PutMem(j_ea, (GRb[op->r1] >> 8) & 0x000FF);
+      PutMem(j_ea + 1, GRb[op->r1] & 0x000FF);
+   } else {
+      PutMem(j_ea, 0x00);
+      PutMem(j_ea + 1, 0x00);
+   }
+   return 0;
+}
+
+static int32 j_l(struct jop *op) {
+   int32 w_byte;
+
+   w_byte  = (GetMem(j_ea + 1) & 0x03) << 16;
+   w_byte |= GetMem(j_ea + 2) << 8;
+   w_byte |= GetMem(j_ea + 3);
+   GRb[op->r1] = w_byte;
+   if (op->r1 == 0)
+      return 1;                                /* New IAR */
+   LATCH(LZ_NZ, w_byte);
+   return 0;
+}
+
+static int32 j_st(struct jop *op) {
+   int32 r = (op->r1 > 0) ? GRb[op->r1] : 0;
+
+   PutMem(j_ea + 3, r & 0xFF);
+   PutMem(j_ea + 2, (r >> 8) & 0xFF);
+   PutMem(j_ea + 1, (GetMem(j_ea + 1) & 0xFC) | ((r >> 16) & 0x03));
+   return 0;
+}
+
+/* RR halfword and fullword format.  R1 = 0 forms a new IAR, which ends
+   the block through the fall-through test in jit_run(). */
+
+#define latch_nz(v)     LATCH(LZ_NZ, (v))
+
+static int32 j_lhr(struct jop *op) {
+   GRb[op->r1] = GRb[op->r2] & 0x0FFFF;
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1]);
+   return 0;
+}
+
+static int32 j_ahr(struct jop *op) {
+   int32 w_byte = (GRb[op->r1] & 0xFFFF) + (GRb[op->r2] & 0xFFFF);
+
+   GRb[op->r1] = (GRb[op->r1] & 0x30000) | (w_byte & 0xFFFF);
+   if (op->r1 != 0)
+      LATCH(LZ_CY, w_byte);
+   return 0;
+}
+
+static int32 j_shr(struct jop *op) {
+   int32 w_byte = GRb[op->r1] + ~(GRb[op->r2]) + 1;
+
+   GRb[op->r1] = w_byte & 0xFFFF;
+   if (op->r1 != 0)
+      LATCH(LZ_CY, w_byte & 0x1FFFF);
+   return 0;
+}
+
+static int32 j_chr(struct jop *op) {
+   int32 a = GRb[op->r1] & 0xFFFF, b = GRb[op->r2] & 0xFFFF;
+
+   LATCH(LZ_CMP, a - b);
+   return 0;
+}
+
+static int32 j_xhr(struct jop *op) {
+   int32 w_byte = (GRb[op->r1] & 0x0FFFF) ^ (GRb[op->r2] & 0x0FFFF);
+
+   GRb[op->r1] = (GRb[op->r1] & 0xF0000) | w_byte;
+   if (op->r1 != 0)
+      latch_nz(w_byte);
+   return 0;
+}
+
+static int32 j_ohr(struct jop *op) {
+   int32 w_byte = (GRb[op->r1] & 0x0FFFF) | (GRb[op->r2] & 0x0FFFF);
+
+   GRb[op->r1] = (GRb[op->r1] & 0x30000) | w_byte;
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1] & 0xFFFF);
+   return 0;
+}
+
+static int32 j_nhr(struct jop *op) {
+   int32 w_byte = (GRb[op->r1] & 0x0FFFF) & (GRb[op->r2] & 0x0FFFF);
+
+   GRb[op->r1] = (GRb[op->r1] & 0x30000) | w_byte;
+   if (op->r1 != 0)
+      latch_nz(w_byte);
+   return 0;
+}
+
+static int32 j_lr(struct jop *op) {
+   GRb[op->r1] = GRb[op->r2];
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1]);
+   return 0;
+}
+
+static int32 j_ar(struct jop *op) {
+   int32 w_byte = GRb[op->r1] + GRb[op->r2];
+
+   GRb[op->r1] = w_byte & 0x3FFFF;
+   if (op->r1 != 0)
+      LATCH(LZ_CY18, w_byte & 0x7FFFF);
+   return 0;
+}
+
+static int32 j_sr(struct jop *op) {
+   int32 w_byte = GRb[op->r1] + ~(GRb[op->r2]) + 1;
+
+   GRb[op->r1] = w_byte & 0x3FFFF;
+   if (op->r1 != 0)
+      LATCH(LZ_CY18, w_byte & 0x7FFFF);
+   return 0;
+}
+
+static int32 j_cr(struct jop *op) {
+   LATCH(LZ_CMP, GRb[op->r1] - GRb[op->r2]);
+   return 0;
+}
+
+static int32 j_xr(struct jop *op) {
+   GRb[op->r1] = GRb[op->r1] ^ GRb[op->r2];
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1]);
+   return 0;
+}
+
+static int32 j_or(struct jop *op) {
+   GRb[op->r1] = GRb[op->r1] | GRb[op->r2];
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1]);
+   return 0;
+}
+
+static int32 j_nr(struct jop *op) {
+   GRb[op->r1] = GRb[op->r1] & GRb[op->r2];
+   if (op->r1 != 0)
+      latch_nz(GRb[op->r1]);
+   return 0;
+}
+
+#undef G
+
+/* Handler and field layout per execution class, NULL = interpreter only */
+
+static int32 (*jit_fn[OP_MAX])(struct jop *op) = {
+   [OP_B]    = &j_b,    [OP_BCL]  = &j_bcl,  [OP_BZL]  = &j_bzl,  [OP_BCT]  = &j_bct,
+   [OP_BB]   = &j_bb,   [OP_LRI]  = &j_lri,  [OP_ARI]  = &j_ari,  [OP_SRI]  = &j_sri,
+   [OP_CRI]  = &j_cri,  [OP_XRI]  = &j_xri,  [OP_ORI]  = &j_ori,  [OP_NRI]  = &j_nri,
+   [OP_TRM]  = &j_trm,  [OP_LCR]  = &j_lcr,  [OP_ACR]  = &j_acr,  [OP_SCR]  = &j_scr,
+   [OP_CCR]  = &j_ccr,  [OP_XCR]  = &j_xcr,  [OP_OCR]  = &j_ocr,  [OP_NCR]  = &j_ncr,
+   [OP_LCOR] = &j_lcor, [OP_ICT]  = &j_ict,  [OP_STCT] = &j_stct, [OP_IC]   = &j_ic,
+   [OP_STC]  = &j_stc,  [OP_LH]   = &j_lh,   [OP_STH]  = &j_sth,  [OP_L]    = &j_l,
+   [OP_ST]   = &j_st,   [OP_LHR]  = &j_lhr,  [OP_AHR]  = &j_ahr,  [OP_SHR]  = &j_shr,
+   [OP_CHR]  = &j_chr,  [OP_XHR]  = &j_xhr,  [OP_OHR]  = &j_ohr,  [OP_NHR]  = &j_nhr,
+   [OP_LR]   = &j_lr,   [OP_AR]   = &j_ar,   [OP_SR]   = &j_sr,   [OP_CR]   = &j_cr,
+   [OP_XR]   = &j_xr,   [OP_OR]   = &j_or,   [OP_NR]   = &j_nr,   [OP_BALR] = &j_balr,
+   [OP_BAL]  = &j_bal,  [OP_LA]   = &j_la };
+
+/* Resolve the fields of one instr.  Returns 0 if it is not translated. */
+
+static int32 jit_decode(struct jop *op, int32 xcode) {
+   int32 b0 = op->byte[0], b1 = op->byte[1];
+
+   if ((op->fn = jit_fn[xcode]) == NULL)
+      return 0;
+   op->cyc = cu_cost[xcode];
+   switch (xcode) {
+      case OP_B:
+      case OP_BCL:
+      case OP_BZL:
+         op->imm = ((b0 << 8) | b1) & 0x07FE;
+         if (b1 & 0x01)                        /* Negative displacement */
+            op->imm = -op->imm;
+         break;
+      case OP_BCT:
+      case OP_BB:
+         op->r1 = (b0 & 0x06) + 1;
+         op->n1 = b0 & 0x01;
+         op->imm = b1 & 0x7E;
+         if (b1 & 0x01)
+            op->imm = -op->imm;
+         op->mask = (op->n1 ? 0x0080 : 0x8000) >>
+                    (((b0 & 0x30) >> 3) + ((b1 & 0x80) >> 7));
+         break;
+      case OP_ICT:
+      case OP_STCT:
+         op->mem = JM_CT;
+         /* Fall through */
+      case OP_IC:
+      case OP_STC:
+         op->b = (b0 >> 4) & 0x07;
+         op->r1 = (b0 & 0x06) + 1;
+         op->n1 = b0 & 0x01;
+         if (op->mem == JM_NONE) {
+            op->mem = JM_D;
+            op->imm = (b1 & 0x7F) + ((op->b == 0) ? 0x00680 : 0);
+         }
+         break;
+      case OP_LH:
+      case OP_STH:
+      case OP_L:
+      case OP_ST:
+         op->b = (b0 >> 4) & 0x07;
+         op->r1 = b0 & 0x07;
+         op->mem = JM_D;
+         op->hw = 1;
+         if ((xcode == OP_LH) || (xcode == OP_STH)) {
+            op->span = 1;
+            op->imm = (b1 & 0x7E) + ((op->b == 0) ? 0x00700 : 0);
+         } else {
+            op->span = 3;
+            op->imm = (b1 & 0x7C) + ((op->b == 0) ? 0x00780 : 0);
+         }
+         break;
+      case OP_BAL:
+      case OP_LA:
+         op->r1 = b0 & 0x07;
+         op->imm = ((b1 & 0x03) << 16) | (op->byte[2] << 8) | op->byte[3];
+         break;
+      default:
+         if (xcode <= OP_TRM) {                /* RI */
+            op->r1 = (b0 & 0x06) + 1;
+            op->n1 = b0 & 0x01;
+            op->imm = b1;
+         } else if (xcode <= OP_LCOR) {        /* RR character */
+            op->r1 = (b0 & 0x06) + 1;
+            op->n1 = b0 & 0x01;
+            op->r2 = ((b0 & 0x60) >> 4) + 1;
+            op->n2 = (b0 & 0x10) >> 4;
+         } else {                              /* RR halfword, fullword, BALR */
+            op->r1 = b0 & 0x07;
+            op->r2 = (b0 & 0x70) >> 4;
+         }
+         break;
+   }
+   return 1;
+}
+
+static int32 jit_ends_block(int32 xcode) {
+   switch (xcode) {
+      case OP_B:  case OP_BCL: case OP_BZL: case OP_BCT:
+      case OP_BB: case OP_BAL: case OP_BALR:
+         return 1;
+   }
+   return 0;
+}
+
+void jit_flush(void) {
+   memset(jit_map, 0, sizeof(jit_map));
+   memset(jit_hot, 0, sizeof(jit_hot));
+   memset(jit_cmap, 0, sizeof(jit_cmap));
+   jit_used = 0;
+}
+
+/* Translate the code at pc.  A block with n = 0 marks code that must be
+   left to the interpreter until it is modified. */
+
+static struct jblock *jit_translate(int32 pc) {
+   struct jblock *bp;
+   struct jop *op;
+   int32 a = pc, xcode, len, i;
+
+   if (jit_used == JIT_BLOCKS) {               /* Pool exhausted, start over */
+      jit_flush();
+      jit_flushes++;
+   }
+   bp = &jit_pool[jit_used++];
+   bp->page = pc >> JIT_PSHIFT;
+   bp->gen = JIT_GEN(bp->page);
+   bp->n = 0;
+   jit_cmap[pc >> 1] = 1;
+   while (bp->n < JIT_MAXOPS) {
+      if (((a >> JIT_PSHIFT) != bp->page) || ((uint32) a + 3 >= MEMSIZE))
+         break;
+      op = &bp->op[bp->n];
+      memset(op, 0, sizeof(struct jop));
+      op->addr = a;
+      for (i = 0; i < 4; i++)
+         op->byte[i] = M[a + i];
+      xcode = op_dec[(op->byte[0] << 8) | op->byte[1]].xcode;
+      len   = op_dec[(op->byte[0] << 8) | op->byte[1]].len;
+      if ((((a + len - 1) >> JIT_PSHIFT) != bp->page) || !jit_decode(op, xcode))
+         break;
+      for (i = 0; i < len; i += 2)
+         jit_cmap[(a + i) >> 1] = 1;
+      bp->n++;
+      a += len;
+      if (jit_ends_block(xcode))
+         break;
+   }
+   __atomic_thread_fence(__ATOMIC_ACQUIRE);    /* Code bytes read before gen */
+   if (JIT_GEN(bp->page) != bp->gen)           /* Stored into meanwhile */
+      bp->n = 0;
+   jit_blocks++;
+   return bp;
+}
+
+/* Operand address of a storage reference, 0 if not inside storage */
+
+static int32 jit_opnd(struct jop *op) {
+   if (op->mem == JM_CT)                       /* GR0 will be IAR + 2 */
+      j_ea = (op->b == 0) ? ((op->addr + 2) & AMASK) : GRb[op->b];
+   else {
+      j_ea = (op->b == 0) ? op->imm : GRb[op->b] + op->imm;
+      if (op->hw)
+         j_ea &= 0x3FFFE;                      /* Force HW boundary */
+   }
+   return ((j_ea >= 0) && ((uint32) j_ea + op->span < MEMSIZE));
+}
+
+/* Run a block.  sim_instr has done the loop top for the first instr.
+   Returns the nr of instrs executed. */
+
+static int32 jit_run(struct jblock *bp) {
+   struct jop *op = bp->op;
+   int32 k, r;
+
+   for (k = 0; k < bp->n; k++, op++) {
+      if ((k > 0) &&
+          ((GRb[0] != op->addr) ||         /* Branch taken, new IAR */
+           (sim_interval <= 0) ||              /* Event due */
+           (int_src != int_src_seen) ||        /* New interrupt source */
+           pdc_posted ||                       /* Cycle steal to drop */
+           mem_pend ||                         /* Watched page stored into */
+           BRK_TEST(op->addr) ||               /* Breakpoint */
+           (bp->gen != JIT_GEN(bp->page))))    /* Block modified itself */
+         break;
+      if ((op->mem != JM_NONE) && !jit_opnd(op))
+         break;
+      if (k > 0) {
+         sim_interval = sim_interval - 1;
+         if (lvl != 1) LAR = saved_PC;
+         saved_PC = op->addr;
+      }
+      val[0] = opcode0 = op->byte[0];
+      val[1] = opcode1 = op->byte[1];
+      val[2] = op->byte[2];
+      val[3] = op->byte[3];
+      opcode = (opcode0 << 8) | opcode1;
+      PC = (op->addr + 2) & AMASK;
+      GRb[0] = PC;
+      COV_MARK(op->addr);
+      CU_COUNT(op->cyc);                       /* CCU Cycle Utilization counter */
+      r = (*op->fn)(op);
+      if (jit_mode == JIT_CHECK)               /* Lazy latches of this instr */
+         chk_cz[k] = cl_form();
+      if (r) {
+         k++;
+         break;
+      }
+   }
+   jit_execs++;
+   jit_instrs += k;
+   return k;
+}
+
+/* Check mode: run the block, keep its result and roll everything back */
+
+static int32 jit_check(struct jblock *bp) {
+   int32 sGR[4][8], sval[4], s7A, sint, sPC, ssPC, sLAR, sop, sop0, sop1, k, i;
+   int32 slz_k = lz_k, slz_v = lz_v;
+   int8  sC[4], sZ[4], sc8;
+   t_uint64 scyc, sins;
+   unsigned short scrc;
+
+   memcpy(sGR, GR, sizeof(GR));
+   memcpy(sC, CL_C, sizeof(CL_C));
+   memcpy(sZ, CL_Z, sizeof(CL_Z));
+   memcpy(sval, val, sizeof(sval));
+   s7A = Eregs_Inp[0x7A];  sc8 = cycle_eight;  sint = sim_interval;
+   scyc = cu_cyc[lvl];  sins = cu_ins[lvl];
+   sPC = PC;  ssPC = saved_PC;  sLAR = LAR;  scrc = old_crc;
+   sop = opcode;  sop0 = opcode0;  sop1 = opcode1;
+
+   jit_nlog = 0;
+   jit_logging = ON;
+   k = jit_run(bp);
+   jit_logging = OFF;
+   if (k == 0)
+      return 0;
+
+   CL_LATCH();
+   memcpy(chk_GR, GR, sizeof(GR));
+   memcpy(chk_C, CL_C, sizeof(CL_C));
+   memcpy(chk_Z, CL_Z, sizeof(CL_Z));
+   chk_7A = Eregs_Inp[0x7A];  chk_c8 = cycle_eight;  chk_LAR = LAR;
+   for (i = 0; i < jit_nlog; i++) {
+      chk_mem[i].addr = jit_log[i].addr;
+      chk_mem[i].data = M[jit_log[i].addr];
+   }
+   chk_nmem = jit_nlog;
+   for (i = jit_nlog - 1; i >= 0; i--) {       /* Undo stores, newest first */
+      M[jit_log[i].addr] = jit_log[i].data;
+      PDC_INVAL(jit_log[i].addr);
+   }
+
+   memcpy(GR, sGR, sizeof(GR));
+   memcpy(CL_C, sC, sizeof(CL_C));
+   memcpy(CL_Z, sZ, sizeof(CL_Z));
+   lz_k = slz_k;  lz_v = slz_v;
+   memcpy(val, sval, sizeof(sval));
+   Eregs_Inp[0x7A] = s7A;  cycle_eight = sc8;  sim_interval = sint;
+   cu_cyc[lvl] = scyc;  cu_ins[lvl] = sins;
+   PC = sPC;  saved_PC = ssPC;  LAR = sLAR;  old_crc = scrc;
+   opcode = sop;  opcode0 = sop0;  opcode1 = sop1;
+
+   jit_nlog = 0;                               /* Now log the interpreter */
+   jit_logging = ON;
+   chk_left = chk_n = k;
+   chk_lvl = lvl;
+   chk_blk = bp;
+   chk_czbad = -1;
+   return 0;
+}
+
+/* Called at the top of every interpreter pass in check mode.  The
+   latches are compared after every instr, so the lazy ones of each
+   handler meet the interpreter's; the rest is compared once the
+   interpreter has executed the instrs of the block. */
+
+void jit_check_pass(void) {
+   int32 r, g, i, j, bad = 0, data;
+
+   if (chk_left < 0)
+      return;
+   if ((lvl != chk_lvl) || (wait_state == ON)) {   /* Interrupted, no compare */
+      jit_logging = OFF;
+      chk_left = -1;
+      jit_chk_skip++;
+      return;
+   }
+   i = cl_form();
+   if ((chk_czbad < 0) && (i != chk_cz[chk_n - chk_left])) {
+      chk_czbad = chk_n - chk_left;
+      chk_czint = i;
+   }
+   if (--chk_left > 0)
+      return;
+   jit_logging = OFF;
+   chk_left = -1;
+   CL_LATCH();
+
+   if (chk_czbad >= 0) {
+      bad++;
+      printf("\nJIT check: C,Z after instr at %05X interp %d,%d block %d,%d\n",
+             chk_blk->op[chk_czbad].addr, chk_czint >> 1, chk_czint & 1,
+             chk_cz[chk_czbad] >> 1, chk_cz[chk_czbad] & 1);
+   }
+
+   for (g = 0; g < 4; g++) {
+      for (r = 0; r < 8; r++)
+         if (GR[g][r] != chk_GR[g][r]) {
+            if (bad++ == 0) printf("\n");
+            printf("JIT check: GR%d grp %d interp %05X block %05X\n",
+                   r, g, GR[g][r], chk_GR[g][r]);
+         }
+      if ((CL_C[g] != chk_C[g]) || (CL_Z[g] != chk_Z[g])) {
+         if (bad++ == 0) printf("\n");
+         printf("JIT check: C,Z grp %d interp %d,%d block %d,%d\n",
+                g, CL_C[g], CL_Z[g], chk_C[g], chk_Z[g]);
+      }
+   }
+   if ((Eregs_Inp[0x7A] != chk_7A) || (cycle_eight != chk_c8) || (LAR != chk_LAR)) {
+      if (bad++ == 0) printf("\n");
+      printf("JIT check: CUCR/LAR interp %04X.%d %05X block %04X.%d %05X\n",
+             Eregs_Inp[0x7A], cycle_eight, LAR, chk_7A, chk_c8, chk_LAR);
+   }
+   for (i = 0; i < chk_nmem; i++) {            /* Bytes stored by the block */
+      if (M[chk_mem[i].addr] != chk_mem[i].data) {
+         if (bad++ == 0) printf("\n");
+         printf("JIT check: storage %05X interp %02X block %02X\n",
+                chk_mem[i].addr, M[chk_mem[i].addr], chk_mem[i].data);
+      }
+   }
+   for (i = 0; i < jit_nlog; i++) {            /* Bytes stored by the interp */
+      for (j = 0; j < i; j++)                  /* First store only */
+         if (jit_log[j].addr == jit_log[i].addr)
+            break;
+      if (j < i)
+         continue;
+      data = jit_log[i].data;                  /* Unchanged, unless the block */
+      for (j = 0; j < chk_nmem; j++)           /* stored there too */
+         if (chk_mem[j].addr == jit_log[i].addr)
+            data = chk_mem[j].data;
+      if (M[jit_log[i].addr] != data) {
+         if (bad++ == 0) printf("\n");
+         printf("JIT check: storage %05X interp %02X block %02X\n",
+                jit_log[i].addr, M[jit_log[i].addr], data);
+      }
+   }
+   if (bad) {
+      printf("JIT check: block at %05X (%d instrs) differs, left to interpreter\n",
+             chk_blk->op[0].addr, chk_n);
+      chk_blk->n = 0;
+      jit_chk_bad++;
+   } else
+      jit_chk_ok++;
+}
+
+/* Called by sim_instr with PC = IAR of the next instr.  Returns the nr of
+   instrs executed, 0 if the interpreter must execute it. */
+
+int32 jit_step(void) {
+   struct jblock *bp;
+   int32 h;
+
+   if ((chk_left >= 0) || (PC & 1) || ((uint32) PC + 3 >= MEMSIZE))
+      return 0;
+   h = PC >> 1;
+   bp = jit_map[h];
+   if ((bp != NULL) && (bp->gen != JIT_GEN(bp->page))) {
+      jit_map[h] = bp = NULL;                  /* Code has been modified */
+      jit_inval++;
+   }
+   if (bp == NULL) {
+      if (++jit_hot[h] < jit_hot_limit)
+         return 0;
+      jit_hot[h] = 0;
+      bp = jit_translate(PC);
+      jit_map[h] = bp;
+   }
+   if (bp->n == 0)
+      return 0;
+   if (jit_mode == JIT_CHECK)
+      return jit_check(bp);
+   return jit_run(bp);
+}
+
+/* SET CPU JIT{=n}, JITCHECK, NOJIT */
+
+t_stat jit_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   t_stat r;
+   int32 n;
+
+   if (cptr != NULL) {
+      if (val == JIT_OFF)
+         return SCPE_ARG;
+      n = (int32) get_uint(cptr, 10, 255, &r);
+      if ((r != SCPE_OK) || (n == 0))
+         return SCPE_ARG;
+      jit_hot_limit = n;
+   }
+   jit_logging = OFF;
+   chk_left = -1;
+   jit_flush();
+   jit_mode = val;
+   return SCPE_OK;
+}
+
+/* SHOW CPU JIT */
+
+t_stat jit_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   fprintf(st, "block translator: %s, translate after %d entries\n",
+           (jit_mode == JIT_OFF) ? "off" : (jit_mode == JIT_CHECK) ? "check" : "on",
+           jit_hot_limit);
+   fprintf(st, "   blocks %llu (%d in pool), invalidated %llu, pool flushes %llu\n",
+           (unsigned long long) jit_blocks, jit_used,
+           (unsigned long long) jit_inval, (unsigned long long) jit_flushes);
+   fprintf(st, "   block runs %llu, instrs %llu",
+           (unsigned long long) jit_execs, (unsigned long long) jit_instrs);
+   if (jit_execs)
+      fprintf(st, ", %.2f instrs/run", (double) jit_instrs / jit_execs);
+   fprintf(st, "\n");
+   if (jit_mode == JIT_CHECK)
+      fprintf(st, "   checks passed %llu, failed %llu, interrupted %llu\n",
+              (unsigned long long) jit_chk_ok, (unsigned long long) jit_chk_bad,
+              (unsigned long long) jit_chk_skip);
+   return SCPE_OK;
+}
@@ -0,0 +1,520 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_latch.c: IBM 3705 CCU condition latches
+
+   Nearly every arithmetic, logical and load instr sets the C and Z
+   latches of the active register group, few instrs test them.  The
+   setting instr only records the kind of its result and one value in
+   lz_k/lz_v (LATCH() in i3705_defs.h); CL_LATCH() forms CL_C and CL_Z
+   from that record where they are looked at: BCL, BZL, the level
+   switch, the end of sim_instr, service routines, the instr trace, idle
+   detection and the JIT.  A level switch forms the latches of the group
+   it leaves, so one record serves all groups.  Build with
+   -DI3705_EAGER_LATCH to form them in every instr instead.
+
+   The LATCH command checks and measures the lazy latches:
+
+        LATCH CHECK {n {seed}}  run n random instr streams a step at a
+                                time and check the latches after every
+                                latch setting instr against lz_ref(),
+                                then run them again in one go and
+                                compare registers, latches, IAR and level
+                                with the stepped run
+        LATCH BENCH {count}     instrs/sec of each latch setting instr
+                                and of a BCL after each of them
+
+   lz_ref() does not use LATCH() or cl_form(): it works out C and Z
+   from the operands of each instr the way the 3705 sets them, so a
+   handler recording the wrong kind or value shows as a mismatch.  The
+   one-go run catches a record that is lost or formed for the wrong
+   group across a level switch or an event.  Both commands run their
+   program below X'1000' and give storage and the CCU state back when
+   done.
+*/
+
+#include "i3705_defs.h"
+#include <time.h>
+
+#define LZ_ORG          0x0800                 /* Test stream */
+#define LZ_DATA         0x0680                 /* Base 0 operands, up to X'7FF' */
+#define LZ_END          0x1000                 /* Storage used */
+#define LZ_INSTRS       256                    /* Instrs in a CHECK stream */
+#define LZ_STEPS        2000                   /* Instrs run of a CHECK stream */
+#define LZ_LOOP         24                     /* Copies in a BENCH loop */
+
+extern uint8 *M;
+extern int32 GR[4][8];
+extern int32 lvl, Grp, PC;
+extern int8 CL_C[], CL_Z[];
+extern struct opdef optable[];
+extern struct opdec op_dec[];
+extern int32 nopcode;
+extern t_stat cpu_hold(int32 len);
+extern void cpu_unhold(void);
+extern void cpu_prep(int32 org);
+extern t_stat cpu_run(int32 n);
+
+int32 lz_k = LZ_NONE, lz_v;                    /* Lazy latch record */
+
+/* Latch setting instrs, run by CHECK and BENCH */
+static const int32 lz_ops[] = {
+   OP_LRI, OP_ARI, OP_SRI, OP_CRI, OP_XRI, OP_ORI, OP_NRI, OP_TRM,
+   OP_LCR, OP_ACR, OP_SCR, OP_CCR, OP_XCR, OP_OCR, OP_NCR, OP_LCOR,
+   OP_IC,  OP_LH,  OP_L,
+   OP_LHR, OP_AHR, OP_SHR, OP_CHR, OP_XHR, OP_OHR, OP_NHR, OP_LHOR,
+   OP_LR,  OP_AR,  OP_SR,  OP_CR,  OP_XR,  OP_OR,  OP_NR,  OP_LOR
+};
+#define LZ_NOPS         (sizeof(lz_ops) / sizeof(lz_ops[0]))
+
+static int32 cl_parity(int32 w) {              /* C latch rule of LCR and IC */
+   int32 j = 0;
+
+   for (int i = 8; i != 0; i--) {
+      j += w & 0x01;
+      w >>= 1;
+   }
+   return ((j & 1) == 0);
+}
+
+/* Latches from the lazy record, as C << 1 | Z */
+
+int32 cl_form(void) {
+   switch (lz_k) {
+      case LZ_NZ:
+         return (lz_v == 0) ? 1 : 2;
+      case LZ_CY:
+         return ((lz_v >> 15) & 2) | ((lz_v & 0x0FFFF) == 0);
+      case LZ_CY18:
+         return ((lz_v >> 17) & 2) | ((lz_v & 0x3FFFF) == 0);
+      case LZ_CMP:
+         return ((lz_v < 0) << 1) | (lz_v == 0);
+      case LZ_PAR:
+         return (cl_parity(lz_v) << 1) | (lz_v == 0);
+      case LZ_CZ:
+         return lz_v;
+   }
+   return (CL_C[Grp] << 1) | CL_Z[Grp];        /* LZ_NONE */
+}
+
+/* Form CL_C and CL_Z of the active group, called by CL_LATCH() */
+
+void cl_latch(void) {
+   int32 cz = cl_form();
+
+   CL_C[Grp] = (cz >> 1) & 1;
+   CL_Z[Grp] = cz & 1;
+   lz_k = LZ_NONE;
+}
+
+/* LATCH command */
+
+static uint32 lz_seed;
+
+static uint32 lz_rand(void) {                  /* xorshift32, the same on every host */
+   lz_seed ^= lz_seed << 13;
+   lz_seed ^= lz_seed >> 17;
+   lz_seed ^= lz_seed << 5;
+   return lz_seed;
+}
+
+static int32 lz_entry(int32 xcode) {           /* optable[] index of xcode */
+   int32 i;
+
+   for (i = 0; i < nopcode; i++)
+      if (optable[i].xcode == xcode)
+         break;
+   return i;
+}
+
+/* Encoding of optable[e] with operand bits b.  Base 0 for the storage
+   operands, so they stay in X'680'-X'7FF', and no halfword or fullword
+   result in R0, which would branch.  -1 when b does not qualify. */
+
+static int32 lz_encode(int32 e, int32 b) {
+   int32 w = optable[e].opcode | (b & ~optable[e].opmask & 0xFFFF);
+
+   if ((optable[e].form == 5) || (optable[e].form == 7))
+      w &= ~0x7000;
+   if (((optable[e].form == 0) || (optable[e].form == 7)) && ((w & 0x0700) == 0))
+      return -1;
+   return w;
+}
+
+static int32 lz_rand_op(void) {
+   int32 w;
+
+   do
+      w = lz_encode(lz_entry(lz_ops[lz_rand() % LZ_NOPS]), lz_rand());
+   while (w < 0);
+   return w;
+}
+
+static void lz_put(int32 addr, int32 w) {
+   M[addr] = (w >> 8) & 0xFF;
+   M[addr + 1] = w & 0xFF;
+}
+
+/* Handlers the streams need: L1 resets its check, L4 resets SVC L4 and
+   sets the latches of group 2 before it returns to level 5 */
+
+static void lz_handlers(void) {
+   static const int32 l1[] = { 0x8000, 0x8104, 0x7174, 0xB840 };
+   static const int32 l4[] = { 0x8000, 0x8101, 0x7174 };
+   int32 i, a;
+
+   for (i = 0; i < 4; i++)
+      lz_put(0x0010 + 2 * i, l1[i]);
+   for (i = 0, a = 0x0180; i < 3; i++, a += 2)
+      lz_put(a, l4[i]);
+   lz_put(a, lz_rand_op());
+   lz_put(a + 2, lz_rand_op());
+   lz_put(a + 4, 0xB840);                      /* EXIT */
+}
+
+/* C << 1 | Z that instr w at pc sets in group g, from the registers
+   and storage before it runs, or -1 when it leaves the latches alone */
+
+#define LZ_SET(c, z)    ((((c) != 0) << 1) | ((z) != 0))
+#define LZ_BYTE(v, n)   (((n) == 0) ? (((v) >> 8) & 0xFF) : ((v) & 0xFF))
+
+static int32 lz_ref(int32 w, int32 pc, int32 g) {
+   int32 b0 = (w >> 8) & 0xFF, b1 = w & 0xFF;
+   int32 r[8], ri, n, v, x, r1, r2, a;
+
+   memcpy(r, GR[g], sizeof(r));
+   r[0] = (pc + 2) & AMASK;                    /* IAR as the instr sees it */
+
+   switch (op_dec[w].xcode) {                  /* RI: 1xxxxRRN I */
+      case OP_LRI: case OP_ARI: case OP_SRI: case OP_CRI:
+      case OP_XRI: case OP_ORI: case OP_NRI: case OP_TRM:
+         ri = r[(b0 & 0x06) + 1];
+         n = b0 & 0x01;
+         v = LZ_BYTE(ri, n);
+         switch (op_dec[w].xcode) {
+            case OP_LRI:
+               return LZ_SET(b1 != 0, b1 == 0);
+            case OP_ARI:
+               x = (n == 0) ? (ri & 0xFFFF) + (b1 << 8) : (ri & 0xFFFF) + b1;
+               return LZ_SET(x > 0xFFFF, (x & ((n == 0) ? 0xFF00 : 0xFFFF)) == 0);
+            case OP_SRI:
+               x = (n == 0) ? (ri & 0xFF00) - (b1 << 8) : (ri & 0xFFFF) - b1;
+               return LZ_SET(x < 0, (x & ((n == 0) ? 0xFF00 : 0xFFFF)) == 0);
+            case OP_CRI:
+               return LZ_SET(v < b1, v == b1);
+            case OP_XRI:
+               return LZ_SET((v ^ b1) != 0, (v ^ b1) == 0);
+            case OP_ORI:
+               return LZ_SET((v | b1) != 0, (v | b1) == 0);
+            default:                           /* NRI, TRM */
+               return LZ_SET((v & b1) != 0, (v & b1) == 0);
+         }
+
+      case OP_LCR: case OP_ACR: case OP_SCR: case OP_CCR:
+      case OP_XCR: case OP_OCR: case OP_NCR: case OP_LCOR:
+         r1 = r[(b0 & 0x06) + 1];              /* RRn: 0R2N0R1N */
+         n = b0 & 0x01;
+         v = LZ_BYTE(r[((b0 & 0x60) >> 4) + 1], (b0 & 0x10) >> 4);
+         x = LZ_BYTE(r1, n);
+         switch (op_dec[w].xcode) {
+            case OP_LCR:
+               return LZ_SET(cl_parity(v), v == 0);
+            case OP_ACR:
+               a = (n == 0) ? r1 + (v << 8) : r1 + v;
+               return LZ_SET((a & 0x7F0000) > (r1 & 0x7F0000),
+                            (a & ((n == 0) ? 0xFF00 : 0xFFFF)) == 0);
+            case OP_SCR:
+               if (n == 0)
+                  return LZ_SET(v > x, v == x);
+               return LZ_SET(v > (r1 & 0xFFFF), v == (r1 & 0xFFFF));
+            case OP_CCR:
+               return LZ_SET(x < v, x == v);
+            case OP_XCR:
+               return LZ_SET((x ^ v) != 0, (x ^ v) == 0);
+            case OP_OCR:
+               return LZ_SET((x | v) != 0, (x | v) == 0);
+            case OP_NCR:
+               return LZ_SET((x & v) != 0, (x & v) == 0);
+            default:                           /* LCOR */
+               return LZ_SET(v & 1, (v >> 1) == 0);
+         }
+
+      case OP_IC:                              /* Base 0: X'680' + D */
+         v = M[0x0680 + (b1 & 0x7F)];
+         return LZ_SET(cl_parity(v), v == 0);
+      case OP_LH:                              /* Base 0: X'700' + D */
+         a = 0x0700 + (b1 & 0x7E);
+         v = (M[a] << 8) | M[a + 1];
+         return ((b0 & 0x07) == 0) ? -1 : LZ_SET(v != 0, v == 0);
+      case OP_L:                               /* Base 0: X'780' + D */
+         a = 0x0780 + (b1 & 0x7C);
+         v = ((M[a + 1] & 0x03) << 16) | (M[a + 2] << 8) | M[a + 3];
+         return ((b0 & 0x07) == 0) ? -1 : LZ_SET(v != 0, v == 0);
+   }
+
+   if ((b0 & 0x07) == 0)                       /* RR into R0 branches */
+      return -1;
+   r1 = r[b0 & 0x07];                          /* RR: 0R2R0R1R */
+   r2 = r[(b0 & 0x70) >> 4];
+   switch (op_dec[w].xcode) {
+      case OP_LHR:
+         return LZ_SET((r2 & 0xFFFF) != 0, (r2 & 0xFFFF) == 0);
+      case OP_AHR:
+         x = (r1 & 0xFFFF) + (r2 & 0xFFFF);
+         return LZ_SET(x > 0xFFFF, (x & 0xFFFF) == 0);
+      case OP_SHR:
+         x = r1 - r2;
+         return LZ_SET(x & 0x10000, (x & 0xFFFF) == 0);
+      case OP_CHR:
+         return LZ_SET((r1 & 0xFFFF) < (r2 & 0xFFFF), (r1 & 0xFFFF) == (r2 & 0xFFFF));
+      case OP_XHR:
+         x = (r1 ^ r2) & 0xFFFF;
+         return LZ_SET(x != 0, x == 0);
+      case OP_OHR:
+         x = (r1 | r2) & 0xFFFF;
+         return LZ_SET(x != 0, x == 0);
+      case OP_NHR:
+         x = (r1 & r2) & 0xFFFF;
+         return LZ_SET(x != 0, x == 0);
+      case OP_LHOR:
+         return LZ_SET(r2 & 1, ((r2 & 0xFFFF) >> 1) == 0);
+      case OP_LR:
+         return LZ_SET(r2 != 0, r2 == 0);
+      case OP_AR:
+         x = r1 + r2;
+         return LZ_SET(x & 0x40000, (x & 0x3FFFF) == 0);
+      case OP_SR:
+         x = r1 - r2;
+         return LZ_SET(x & 0x40000, (x & 0x3FFFF) == 0);
+      case OP_CR:
+         return LZ_SET(r1 < r2, r1 == r2);
+      case OP_XR:
+         return LZ_SET((r1 ^ r2) != 0, (r1 ^ r2) == 0);
+      case OP_OR:
+         return LZ_SET((r1 | r2) != 0, (r1 | r2) == 0);
+      case OP_NR:
+         return LZ_SET((r1 & r2) != 0, (r1 & r2) == 0);
+      case OP_LOR:
+         return LZ_SET(r2 & 1, ((r2 >> 1) & 0x1FFFF) == 0);
+   }
+   return -1;                                  /* Branch, EXIT, ... */
+}
+
+/* State compared by CHECK */
+
+struct lz_state {
+   int32 gr[4][8];
+   int8  c[4], z[4];
+   int32 pc, lvl;
+};
+
+static void lz_get(struct lz_state *s) {
+   memcpy(s->gr, GR, sizeof(s->gr));
+   memcpy(s->c, CL_C, sizeof(s->c));
+   memcpy(s->z, CL_Z, sizeof(s->z));
+   s->pc = PC;
+   s->lvl = lvl;
+}
+
+/* Storage and registers of the stream, then the CCU ready at LZ_ORG */
+
+static void lz_set(uint8 *img, struct lz_state *s0) {
+   memcpy(M, img, LZ_END);
+   cpu_prep(LZ_ORG);
+   memcpy(GR, s0->gr, sizeof(GR));
+   memcpy(CL_C, s0->c, sizeof(s0->c));
+   memcpy(CL_Z, s0->z, sizeof(s0->z));
+   GR[Grp][0] = PC = LZ_ORG;
+   lz_k = LZ_NONE;
+}
+
+static void lz_diff(const char *what, int32 a, int32 b, uint32 seed, int32 *shown) {
+   if (a != b) {
+      if (*shown < 10)
+         printf("  seed %u: %s in one go %05X, stepped %05X\n", seed, what, a, b);
+      (*shown)++;
+   }
+}
+
+static t_stat lz_check(int32 n, uint32 seed) {
+   static uint8 img[LZ_END];
+   struct lz_state s0, s1, s2;
+   char what[16];
+   int32 i, g, a, k, w, s, cz, pc, l, bad = 0, shown = 0, nref = 0, badref = 0;
+   t_stat r;
+
+   for (s = 0; s < n; s++, seed++) {
+      lz_seed = seed ? seed : 1;
+      lz_handlers();
+      for (a = LZ_DATA; a < LZ_ORG; a++)
+         M[a] = lz_rand() & 0xFF;
+      for (i = 0, a = LZ_ORG; i < LZ_INSTRS; i++, a += 2) {
+         k = lz_rand() % 16;
+         if ((k < 2) && (i + 3 < LZ_INSTRS))   /* BCL or BZL, 1 to 3 instrs ahead */
+            w = ((lz_rand() & 1) ? 0x9800 : 0x8800) | (2 * (1 + lz_rand() % 3));
+         else if (k == 2)                      /* EXIT: SVC L4 and back */
+            w = 0xB840;
+         else
+            w = lz_rand_op();
+         lz_put(a, w);
+      }
+      lz_put(a, 0xA800 | (a + 2 - LZ_ORG) | 0x0001);   /* B back to the start */
+      memcpy(img, M, LZ_END);
+      for (g = 0; g < 4; g++) {
+         for (i = 1; i < 8; i++)
+            s0.gr[g][i] = lz_rand() & 0x3FFFF;
+         s0.gr[g][0] = 0x0010;
+         s0.c[g] = lz_rand() & 1;
+         s0.z[g] = lz_rand() & 1;
+      }
+
+      lz_set(img, &s0);                        /* A step at a time */
+      for (i = 0; i < LZ_STEPS; i++) {
+         g = Grp;
+         l = lvl;
+         pc = GR[g][0];
+         w = (M[pc] << 8) | M[pc + 1];
+         cz = lz_ref(w, pc, g);
+         if ((r = cpu_run(1)) != SCPE_OK)
+            return r;
+         if ((cz < 0) || (lvl != l) || (PC != pc))
+            continue;                          /* No latches, or interrupted */
+         nref++;
+         if (((CL_C[g] << 1) | CL_Z[g]) != cz) {
+            if (badref++ < 10)
+               printf("  seed %u: %04X at %05X set C=%d Z=%d, expected C=%d Z=%d\n",
+                      seed, w, pc, CL_C[g], CL_Z[g], cz >> 1, cz & 1);
+         }
+      }
+      lz_get(&s2);
+      lz_set(img, &s0);                        /* In one go */
+      if ((r = cpu_run(LZ_STEPS)) != SCPE_OK)
+         return r;
+      lz_get(&s1);
+
+      if (memcmp(&s1, &s2, sizeof(s1)) != 0) {
+         bad++;
+         for (g = 0; g < 4; g++) {
+            for (i = 0; i < 8; i++) {
+               sprintf(what, "GR%dG%d", i, g);
+               lz_diff(what, s1.gr[g][i], s2.gr[g][i], seed, &shown);
+            }
+            sprintf(what, "C G%d", g);
+            lz_diff(what, s1.c[g], s2.c[g], seed, &shown);
+            sprintf(what, "Z G%d", g);
+            lz_diff(what, s1.z[g], s2.z[g], seed, &shown);
+         }
+         lz_diff("IAR", s1.pc, s2.pc, seed, &shown);
+         lz_diff("level", s1.lvl, s2.lvl, seed, &shown);
+      }
+   }
+   printf("LATCH CHECK: %d streams of %d instrs, %d instrs each, %d differ\n",
+          n, LZ_INSTRS, LZ_STEPS, bad);
+   printf("LATCH CHECK: %d latch setting instrs, %d against the reference\n",
+          nref, badref);
+   return SCPE_OK;
+}
+
+/* Rate of a loop of LZ_LOOP instrs w, or of pairs w, BCL +0, the best
+   of three runs */
+
+static double lz_rate(int32 w, int32 bcl, int32 count) {
+   struct timespec t0, t1;
+   double t, best = 0.0;
+   int32 i, a;
+
+   for (i = 0, a = LZ_ORG; i < LZ_LOOP; i++, a += 2)
+      lz_put(a, (bcl && (i & 1)) ? 0x9800 : w);
+   lz_put(a, 0xA800 | (a + 2 - LZ_ORG) | 0x0001);
+   for (i = 0; i < 3; i++) {
+      cpu_prep(LZ_ORG);
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      if (cpu_run(count) != SCPE_OK)
+         return 0.0;
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      t = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+      if (count / t / 1e6 > best)
+         best = count / t / 1e6;
+   }
+   return best;
+}
+
+static t_stat lz_bench(int32 count) {
+   int32 k, e, w;
+
+   for (k = LZ_DATA; k < LZ_ORG; k++)
+      M[k] = k & 0xFF;
+#ifdef I3705_EAGER_LATCH
+   printf("Latches formed by every instr, %d instrs per class\n", count);
+#else
+   printf("Latches formed lazily, %d instrs per class\n", count);
+#endif
+   printf("          alone  with BCL  Minstr/s\n");
+   for (k = 0; k < LZ_NOPS; k++) {
+      e = lz_entry(lz_ops[k]);
+      w = lz_encode(e, 0x1301);                /* R3, R2 = R1, I = 1, D = 0 */
+      printf("  %-4.4s %9.2f %9.2f\n", optable[e].mnem,
+             lz_rate(w, 0, count), lz_rate(w, 1, count));
+   }
+   return SCPE_OK;
+}
+
+t_stat latch_cmd(int32 flag, char *cptr) {
+   char gbuf[CBUFSIZE];
+   int32 n;
+   uint32 seed;
+   t_stat r;
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "CHECK") == 0) {
+      cptr = get_glyph(cptr, gbuf, 0);
+      n = 100;
+      seed = (uint32) time(NULL);
+      if (gbuf[0] != 0) {
+         n = (int32) get_uint(gbuf, 10, 1000000, &r);
+         if ((r != SCPE_OK) || (n == 0))
+            return SCPE_ARG;
+         cptr = get_glyph(cptr, gbuf, 0);
+         if (gbuf[0] != 0) {
+            seed = (uint32) get_uint(gbuf, 10, 0xFFFFFFFF, &r);
+            if (r != SCPE_OK)
+               return SCPE_ARG;
+         }
+      }
+      printf("LATCH CHECK: seed %u\n", seed);
+      if ((r = cpu_hold(LZ_END)) != SCPE_OK)
+         return r;
+      r = lz_check(n, seed);
+   } else if (strcmp(gbuf, "BENCH") == 0) {
+      n = 5000000;
+      if (*cptr != 0) {
+         n = (int32) get_uint(cptr, 10, 0x7FFFFFFF, &r);
+         if ((r != SCPE_OK) || (n == 0))
+            return SCPE_ARG;
+      }
+      if ((r = cpu_hold(LZ_END)) != SCPE_OK)
+         return r;
+      r = lz_bench(n);
+   } else
+      return SCPE_ARG;
+   cpu_unhold();
+   return r;
+}
@@ -24,7 +24,7 @@
    This module emulates several founctions of the 3705 front panel.
    To access the panel connect access port 37050 with a TN3270 emulator
 
-   This module includes an interval timer that tiggers every 100msec a L3 interrupt.
+   The 100msec interval timer that used to live here is in i3705_timer.c.
 */
 
 #include <stdio.h>
@@ -57,8 +57,10 @@ extern int32 saved_PC;
 extern int32 opcode;
 extern int32 Eregs_Out[];
 extern int32 Eregs_Inp[];
-extern int8  timer_req_L3;
-extern int8  inter_req_L3;
+extern volatile uint32 int_src;
+extern void  ccu_wake(void);
+extern int32 rr_mode;
+extern int32 cu_load(void);
 
 // CCU status flags
 extern int8  test_mode;
@@ -66,9 +68,6 @@ extern int8  load_state;
 extern int8  wait_state;
 extern int8  pgm_stop;
 
-void sig_handler (int signo);
-void timer_msec (long int msec);
-
 int rc, inp, i;
 int32 hex_sw, rot_sw;
 
@@ -81,7 +80,6 @@ uint8_t wrkbyte;                       /* Work byte */
 uint8_t mbyte;
 uint16_t freebuf;
 uint32_t maddr;
-uint32_t old_cucr;
 
 char *ipaddr;
 uint8_t buf[8192], ibuf[256];
@@ -96,9 +94,8 @@ char fssw[10][17] = {"TAR&OP REGISTER", "STATUS",
                      "FUNCTION 3", "FUNCTION 2"};
 
 
-extern uint8 M[MAXMEMSIZE];
+extern uint8 *M;
 extern pthread_mutex_t r7f_lock;
-extern struct IO3705* iobs[MAXCHAN];
 extern int Ireg_bit(int reg, int bit_mask);
 
 int row, col;
@@ -188,7 +185,7 @@ void FrontPanel() {
     stringAtXY(6, 1,  "|", GREEN_BLACK);
     stringAtXY(6, 3,  "ADDRESS EXCEPT", BLUE_BLACK);
     stringAtXY(6, 21, "|", GREEN_BLACK);
-    stringAtXY(6, 59, "CYCLCE COUNT:", BLUE_BLACK);
+    stringAtXY(6, 59, "CCU LOAD  % :", BLUE_BLACK);
     stringAtXY(7, 1,  "|", GREEN_BLACK);
     stringAtXY(7, 3,  "PROTECT CHECK", BLUE_BLACK);
     stringAtXY(7, 21, "|", GREEN_BLACK);
@@ -223,6 +220,7 @@ void FrontPanel() {
 
 void *PNL_thread(void *arg) {
    fprintf(stderr, "PNL: Thread %ld started succesfully... \n\r", syscall(SYS_gettid));
+   ctl_thread(NULL, "PNL");
 
    // We can set one or more bits here, each one representing a single CPU
    //cpu_set_t cpuset;
@@ -243,18 +241,12 @@ void *PNL_thread(void *arg) {
    //sched_setaffinity(0, sizeof(cpuset), &cpuset);
 
 
-   signal (SIGALRM, sig_handler);      // Interval timer //
-   timer_msec(100);                    // <=== sets the 3705 interval timer
-
    int disp_regA, disp_regB;
    int inp_h, inp_l, count, row, col;
    int five_lt = 0x00;
    int fdstdout;
    while(1) {
       if (shwpanel == 1) {
-         old_cucr = Eregs_Inp[0x7A];          // save current cycle counter
-         while (Eregs_Inp[0x7A] == old_cucr)  // wait until cycle counter changes
-            sleep(1);
          // *******************************************************
          // Build the main screen
          // *******************************************************
@@ -328,40 +320,41 @@ void *PNL_thread(void *arg) {
             /* Pick up free buffer count */
             freebuf = (M[0x0754] << 8) + M[0x0755];        /* get free buffer count... */
             integerAtXY(5, 73, freebuf, BLUE_BLACK);       /* ...and display it        */
-            /* Pick up cycle counter */
-            count = Eregs_Inp[0x7A] & 0x7FFF;              /* get cycle counter...     */
+            /* Pick up CCU load */
+            count = cu_load();                             /* busy % of the last sec... */
+            stringAtXY(6, 73, "   ", BLUE_BLACK);           /* ...clear the old one...  */
             integerAtXY(6, 73, count, BLUE_BLACK);         /* ...and display it        */
 
             /********************************/
             /* check channel adapter states  */
             /********************************/
             /* Channel Adapter 1 */
-            if (iobs[0]->abswitch == 0) {
+            if (ccu_ctl->iob[0]->abswitch == 0) {
                   stringAtXY(16, 6, "DISABLED", RED_BLACK);
-               if (iobs[0]->bus_socket[0] > 0) {
+               if (ccu_ctl->iob[0]->bus_socket[0] > 0) {
                   stringAtXY(15, 6, "ACTIVE  ", BLACK_YELLOW);
                } else {
                   stringAtXY(15, 6, "ENABLED ", GREEN_BLACK);
                }
             } else {
                stringAtXY(15, 6, "DISABLED", RED_BLACK);
-               if (iobs[0]->bus_socket[1] > 0) {
+               if (ccu_ctl->iob[0]->bus_socket[1] > 0) {
                   stringAtXY(16, 6, "ACTIVE  ", YELLOW_BLACK);
                } else {
                   stringAtXY(16, 6, "ENABLED ", GREEN_BLACK);
                }
             }
             /* Channel Adapter 2 */
-            if (iobs[1]->abswitch == 0) {
+            if (ccu_ctl->iob[1]->abswitch == 0) {
                   stringAtXY(19, 6, "DISABLED", RED_BLACK);
-               if (iobs[1]->bus_socket[0] > 0) {
+               if (ccu_ctl->iob[1]->bus_socket[0] > 0) {
                   stringAtXY(18, 6, "ACTIVE  ", BLACK_YELLOW);
                } else {
                   stringAtXY(18, 6, "ENABLED ", GREEN_BLACK);
                }
             } else {
                stringAtXY(18, 6, "DISABLED", RED_BLACK);
-               if (iobs[1]->bus_socket[1] > 0) {
+               if (ccu_ctl->iob[1]->bus_socket[1] > 0) {
                   stringAtXY(19, 6, "ACTIVE  ", BLACK_YELLOW);
                } else {
                   stringAtXY(19, 6, "ENABLED ", GREEN_BLACK);
@@ -374,14 +367,14 @@ void *PNL_thread(void *arg) {
             key = getch();
             switch (key) {
                case KEY_F(1):
-                  if (iobs[0]->abswitch == 0) iobs[0]->abswitch = 1;
-                  else iobs[0]->abswitch = 0;
+                  if (ccu_ctl->iob[0]->abswitch == 0) ccu_ctl->iob[0]->abswitch = 1;
+                  else ccu_ctl->iob[0]->abswitch = 0;
                   refresh();
                   break;
 
                case KEY_F(2):
-                  if (iobs[1]->abswitch == 0) iobs[1]->abswitch = 1;
-                  else iobs[1]->abswitch = 0;
+                  if (ccu_ctl->iob[1]->abswitch == 0) ccu_ctl->iob[1]->abswitch = 1;
+                  else ccu_ctl->iob[1]->abswitch = 0;
                   refresh();
                   break;
 
@@ -409,10 +402,13 @@ void *PNL_thread(void *arg) {
                   break;
 
                case KEY_F(7):
+                  if (rr_mode == RR_REPLAY)  /* Panel is not part of a replay */
+                     break;
                   pthread_mutex_lock(&r7f_lock);
                   Eregs_Inp[0x7F] |= 0x0200;
                   pthread_mutex_unlock(&r7f_lock);
-                  inter_req_L3 = ON;         /* Panel L3 request flag */
+                  IRQ_SET(IRQ_INTER_L3);     /* Panel L3 request flag */
+                  ccu_wake();                /* Wake CCU if in wait state */
                   while (Ireg_bit(0x7F, 0x0200) == ON)
                      wait();
                   break;
@@ -617,28 +613,3 @@ void *PNL_thread(void *arg) {
       usleep(1000);                   /* relax a bit                     */
    }  // End while(1)
 }
-
-// *****************************************************
-// Interval timer definition
-// *****************************************************
-void timer_msec (long int msec) {
-   struct itimerval timer1;
-
-   timer1.it_interval.tv_usec = (1000 * msec);
-   timer1.it_interval.tv_sec = 0;
-   timer1.it_value.tv_usec = (1000 * msec);
-   timer1.it_value.tv_sec = 0;
-
-   setitimer (ITIMER_REAL, &timer1, NULL);
-}
-
-// Kick the 3705 100msec timer...
-void sig_handler (int signo) {
-   if ((test_mode == OFF) && !(Eregs_Inp[0x7F] &= 0x0004)) {
-      pthread_mutex_lock(&r7f_lock);
-      Eregs_Inp[0x7F] |= 0x0004;
-      pthread_mutex_unlock(&r7f_lock);
-      timer_req_L3 = ON;
-   }
-}
-
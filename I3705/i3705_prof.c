@@ -0,0 +1,187 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_prof.c: IBM 3705 CCU execution profiler
+
+   While the profiler is on, sim_instr counts every executed instr by
+   execution class, by halfword IAR and by program level (PROF_COUNT),
+   and lvl_switch() and the wait state charge host time to the level
+   that was running.  Every instr then takes the full interpreter loop:
+   the threaded dispatch and the block translator are bypassed.  When
+   the profiler is off the only cost is one flag test per loop pass.
+
+        SET CPU PROFILE         start counting
+        SET CPU NOPROFILE       stop counting (default), counts are kept
+        SHOW CPU PROFILE        levels, execution classes, hottest IARs
+        RESET PROFILE           clear all counts
+        PROFDUMP file           write the counts to a binary file
+
+   The dump is in host byte order:
+
+        char     magic[8]       "I3705PRF"
+        uint32   version        2
+        uint32   nop            number of execution classes (OP_MAX)
+        uint32   nlvl           6 (index 0 = wait state, 1-5 = L1-L5)
+        uint32   npc            number of halfword IAR counts (MEMSIZE / 2)
+        uint64   op[nop]        instrs per execution class
+        uint64   lvl_n[nlvl]    instrs per level
+        uint64   lvl_ns[nlvl]   host nsec per level
+        uint64   pc[npc]        instrs per halfword IAR
+*/
+
+#include "i3705_defs.h"
+#include <time.h>
+
+#define PROF_TOP        16                     /* IARs listed by SHOW */
+
+extern int32 lvl;
+extern UNIT cpu_unit;
+extern struct opdef optable[];
+extern int32 nopcode;
+
+int32 prof_on = 0;                             /* Profiler counting */
+t_uint64 prof_op[OP_MAX];                      /* Instrs per execution class */
+t_uint64 prof_pc[PDC_SIZE];                    /* Instrs per halfword IAR */
+t_uint64 prof_lvl_n[1+5];                      /* Instrs per level */
+t_uint64 prof_lvl_ns[1+5];                     /* Host nsec per level, 0 = wait */
+static int32 prof_cur = -1;                    /* Level being charged, -1 none */
+static t_uint64 prof_t;                        /* Start of the current charge */
+
+t_uint64 prof_now(void) {
+   return ccu_clock_ns(CLOCK_MONOTONIC);
+}
+
+/* Charge host time since the last mark to the running level and
+   start charging bucket (0 = wait state, 1-5 = level, -1 = stopped) */
+
+void prof_mark(int32 bucket) {
+   t_uint64 now = prof_now();
+
+   if (prof_cur >= 0)
+      prof_lvl_ns[prof_cur] += now - prof_t;
+   prof_cur = bucket;
+   prof_t = now;
+}
+
+t_stat prof_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   if (cptr != NULL)
+      return SCPE_ARG;
+   prof_on = val;
+   return SCPE_OK;
+}
+
+/* RESET PROFILE, any other RESET goes to SCP */
+
+t_stat prof_reset_cmd(int32 flag, char *cptr) {
+   char gbuf[CBUFSIZE];
+
+   if (*get_glyph(cptr, gbuf, 0) == 0 && (strcmp(gbuf, "PROFILE") == 0)) {
+      memset(prof_op, 0, sizeof(prof_op));
+      memset(prof_pc, 0, sizeof(prof_pc));
+      memset(prof_lvl_n, 0, sizeof(prof_lvl_n));
+      memset(prof_lvl_ns, 0, sizeof(prof_lvl_ns));
+      return SCPE_OK;
+   }
+   return reset_cmd(flag, cptr);
+}
+
+static const char *prof_name(int32 x) {
+   int32 i;
+
+   if (x == OP_NOP) return "unassigned";
+   if (x == OP_INV) return "invalid";
+   for (i = 0; i < nopcode; i++)
+      if (optable[i].xcode == x)
+         return optable[i].mnem;
+   return "?";
+}
+
+/* SHOW CPU PROFILE */
+
+t_stat prof_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   int32 top[PROF_TOP];
+   t_uint64 tot = 0;
+   uint32 npc = MEMSIZE / 2;
+   int32 i, j, k, n;
+
+   for (i = 1; i < 6; i++)
+      tot += prof_lvl_n[i];
+   fprintf(st, "profiler %s, %" LL_FMT "u instrs\n", prof_on ? "on" : "off", tot);
+   if (tot == 0)
+      return SCPE_OK;
+
+   fprintf(st, "   level        instrs      %%   host msec\n");
+   for (i = 0; i < 6; i++) {
+      if (i == 0)
+         fprintf(st, "   wait  %14s %6s %11.1f\n", "", "", prof_lvl_ns[0] / 1e6);
+      else
+         fprintf(st, "   L%d    %14" LL_FMT "u %6.2f %11.1f\n", i, prof_lvl_n[i],
+                 100.0 * prof_lvl_n[i] / tot, prof_lvl_ns[i] / 1e6);
+   }
+
+   fprintf(st, "   class        instrs      %%\n");
+   for (i = 0; i < OP_MAX; i++) {
+      if (prof_op[i] == 0)
+         continue;
+      fprintf(st, "   %-10s %10" LL_FMT "u %6.2f\n", prof_name(i), prof_op[i],
+              100.0 * prof_op[i] / tot);
+   }
+
+   /* Hottest IARs, insertion into a short sorted list */
+   for (n = 0, i = 0; i < npc; i++) {
+      if (prof_pc[i] == 0)
+         continue;
+      if ((n == PROF_TOP) && (prof_pc[i] <= prof_pc[top[n - 1]]))
+         continue;
+      for (j = (n < PROF_TOP) ? n++ : n - 1; (j > 0) && (prof_pc[top[j - 1]] < prof_pc[i]); j--)
+         top[j] = top[j - 1];
+      top[j] = i;
+   }
+   fprintf(st, "   IAR          instrs      %%\n");
+   for (k = 0; k < n; k++)
+      fprintf(st, "   %05X  %14" LL_FMT "u %6.2f\n", top[k] << 1, prof_pc[top[k]],
+              100.0 * prof_pc[top[k]] / tot);
+   return SCPE_OK;
+}
+
+/* PROFDUMP file */
+
+t_stat prof_dump_cmd(int32 flag, char *cptr) {
+   static const char magic[8] = { 'I', '3', '7', '0', '5', 'P', 'R', 'F' };
+   uint32 hdr[4] = { 2, OP_MAX, 1+5, MEMSIZE / 2 };
+   char gbuf[CBUFSIZE];
+   FILE *f;
+
+   cptr = get_glyph_nc(cptr, gbuf, 0);
+   if ((gbuf[0] == 0) || (*cptr != 0))
+      return SCPE_ARG;
+   if ((f = fopen(gbuf, "wb")) == NULL)
+      return SCPE_OPENERR;
+   fwrite(magic, 1, sizeof(magic), f);
+   fwrite(hdr, sizeof(uint32), 4, f);
+   fwrite(prof_op, sizeof(t_uint64), OP_MAX, f);
+   fwrite(prof_lvl_n, sizeof(t_uint64), 1+5, f);
+   fwrite(prof_lvl_ns, sizeof(t_uint64), 1+5, f);
+   fwrite(prof_pc, sizeof(t_uint64), hdr[3], f);
+   if (fclose(f) != 0)
+      return SCPE_IOERR;
+   return SCPE_OK;
+}
@@ -0,0 +1,547 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_rr.c: IBM 3705 record and replay of external events
+
+        RR RECORD file          write the 3705 image now and log every
+                                external event from here on
+        RR REPLAY file          restore the image of file and feed its
+                                events back, no adapter or timer input
+        RR STOP                 end the recording or the replay
+        SHOW CPU RR             events by kind and source, replay speed
+
+   The channel adapter, the scanner, the panel and the interval timer
+   run in threads of their own and reach the CCU in three ways only: a
+   request bit in int_src, the value an IN instr reads, and channel
+   adapter cycle steal into storage.  The recorder logs each of them
+   with the SCP clock time relative to the start, which counts one per
+   instr and one per pass in the wait state:
+
+        INT     int_src as sampled by sim_instr, when it changed
+        IN      the value of an IN, when it differs from the last one
+                logged for that register
+        STORE   the data of a cycle steal.  While recording the adapter
+                queues it and waits; the CCU stores it at the next
+                interrupt sample, so it lands at a known time, and only
+                then does the adapter go on to raise its request or read
+                storage back.  The adapter behaves as without recording,
+                it just takes up to one instr longer per store.
+
+   A timer tick, a scanner character service or an SDLC frame is thus
+   an INT followed by the INs of the routine that serves it, a host CCW
+   an INT, INs and STOREs.  Replay puts the INT and STORE records back
+   by an event on the clock queue just before the sample they were
+   logged at and hands out the IN values as the same INs come by.  The
+   adapter and scanner threads, the panel interrupt and the timer are
+   ignored meanwhile and the wait state does not sleep, so the replay
+   runs the same instrs as the recording at full speed.  It stops with
+   "Replay ended" where RR STOP ended the recording.
+
+   The wait state runs a fixed number of passes only with the WALL or
+   HYBRID timer: with TIMER=VIRTUAL it skips ahead to the next event on
+   the clock queue, so both record and replay refuse it.  An IN that
+   comes at another time than it was logged counts as missed, a request
+   that differs from the log at a sample is forced to the logged value.
+   Neither should happen; they mean the replay went another way.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#define RR_MAGIC        "I3705RR"
+#define RR_VERSION      1
+#define RR_BUFSZ        (1 << 20)              /* Log file buffer */
+#define RR_MAXWAIT      0x10000000             /* Longest clock queue delay */
+
+#define RR_INT          1                      /* val = int_src */
+#define RR_IN           2                      /* reg = register, val = value */
+#define RR_STORE        3                      /* val = addr, len data bytes follow */
+#define RR_END          4                      /* RR STOP */
+
+struct rrhdr {
+   char     magic[8];
+   uint32   version;
+   uint32   memsize;                           /* Storage follows */
+   uint32   stlen;                             /* Then the state */
+   uint32   nitems;
+   uint32   intsrc;                            /* int_src at the start */
+   uint32   spare;
+   uint32   inval[128];                        /* Eregs_Inp at the start */
+};
+
+struct rrrec {
+   t_uint64 t;                                 /* Clock time since the start */
+   uint8    type;
+   uint8    reg;
+   uint16   len;
+   uint32   val;
+};
+
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern int32 Eregs_Inp[];
+extern volatile uint32 int_src, int_src_seen;
+extern int32 tmr_mode;
+extern void pdc_inval(int32 addr, int32 len);
+extern uint32 snap_put(uint8 *buf, uint32 *nitems);
+extern int32 snap_get(uint8 *buf, uint32 buflen, uint32 nitems, const char *who);
+extern void snap_fixup(void);
+extern void ccu_wake(void);
+
+extern UNIT evt_unit[];
+
+int32 rr_mode = RR_OFF;
+
+static FILE *rr_file = NULL;
+static char rr_fname[CBUFSIZE];
+static int32 rr_last = RR_OFF;                 /* Mode of the last file */
+static double rr_t0;                           /* sim_gtime() at the start */
+static uint32 rr_cur;                          /* int_src as logged */
+static uint32 rr_inval[128];                   /* IN values as logged */
+
+/* Replay: the next record */
+static struct rrrec rr_next;
+static int32 rr_have = 0;
+static uint8 rr_data[0x10000];
+
+/* Record: cycle steal queued by the adapter, [addr][len][data] */
+static pthread_mutex_t rr_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rr_stored = PTHREAD_COND_INITIALIZER;   /* Queue emptied */
+static uint8 *rr_q = NULL;
+static volatile uint32 rr_qlen = 0;
+static uint32 rr_qsz = 0;
+
+/* Statistics */
+static t_uint64 rr_n[RR_END + 1], rr_stbytes;
+static t_uint64 rr_edge[IRQ_NSRC];             /* Requests raised, per source */
+static t_uint64 rr_inrng[4];                   /* INs by register range */
+static t_uint64 rr_miss, rr_forced, rr_tend;
+static t_uint64 rr_ns0, rr_ns;                 /* Replay host time */
+
+static t_uint64 rr_now(void) {
+   return (t_uint64) (sim_gtime() - rr_t0);
+}
+
+static t_uint64 rr_edges(uint32 mask) {       /* Requests raised by mask */
+   t_uint64 n = 0;
+   int32 i;
+
+   for (i = 0; i < IRQ_NSRC; i++)
+      if (mask & (1 << i))
+         n += rr_edge[i];
+   return n;
+}
+
+static void rr_count(struct rrrec *r) {
+   uint32 up;
+   int32 i;
+
+   rr_n[r->type]++;
+   if (r->type == RR_STORE)
+      rr_stbytes += r->len;
+   else if (r->type == RR_IN)
+      rr_inrng[(r->reg >= 0x70) ? 2 : (r->reg >= 0x50) ? 1 : (r->reg >= 0x40) ? 0 : 3]++;
+   else if (r->type == RR_INT) {
+      up = r->val & ~rr_cur;
+      for (i = 0; i < IRQ_NSRC; i++)
+         if (up & (1 << i))
+            rr_edge[i]++;
+   }
+}
+
+static void rr_put(int32 type, int32 reg, uint32 val, uint8 *data, uint32 len) {
+   struct rrrec r;
+
+   r.t = rr_now();
+   r.type = type;
+   r.reg = reg;
+   r.len = len;
+   r.val = val;
+   rr_count(&r);
+   fwrite(&r, sizeof(r), 1, rr_file);
+   if (len)
+      fwrite(data, 1, len, rr_file);
+}
+
+/* Replay: read the next record, rr_have is 0 at the end of the file */
+
+static void rr_read(void) {
+   rr_have = (fread(&rr_next, sizeof(rr_next), 1, rr_file) == 1) &&
+             (rr_next.type >= RR_INT) && (rr_next.type <= RR_END) &&
+             ((rr_next.type != RR_STORE) ||
+              (fread(rr_data, 1, rr_next.len, rr_file) == rr_next.len));
+}
+
+/* Replay: schedule the next INT, STORE or END, an IN waits for rr_in() */
+
+static void rr_arm(void) {
+   t_uint64 now = rr_now(), due;
+
+   sim_cancel(&evt_unit[EVT_RR]);
+   if (!rr_have || (rr_next.type == RR_IN))
+      return;
+   due = (rr_next.type == RR_END) ? rr_next.t : rr_next.t - 1;
+   if (due <= now)
+      sim_activate(&evt_unit[EVT_RR], 0);
+   else
+      sim_activate(&evt_unit[EVT_RR], (int32) ((due - now < RR_MAXWAIT) ? due - now : RR_MAXWAIT));
+}
+
+/* Record: store the queued cycle steal, log it if log is set */
+
+static void rr_drain(int32 log) {
+   uint32 pos, addr, len;
+
+   pthread_mutex_lock(&rr_lock);
+   for (pos = 0; pos < rr_qlen; pos += 2 * sizeof(uint32) + len) {
+      memcpy(&addr, rr_q + pos, sizeof(uint32));
+      memcpy(&len, rr_q + pos + sizeof(uint32), sizeof(uint32));
+      if ((addr < (uint32) MEMSIZE) && (len <= (uint32) MEMSIZE - addr)) {
+         memcpy(M + addr, rr_q + pos + 2 * sizeof(uint32), len);
+         pdc_inval(addr, len);
+         if (log)
+            rr_put(RR_STORE, 0, addr, rr_q + pos + 2 * sizeof(uint32), len);
+      }
+   }
+   rr_qlen = 0;
+   pthread_cond_broadcast(&rr_stored);         /* Release the adapters */
+   pthread_mutex_unlock(&rr_lock);
+}
+
+static void rr_close(void) {
+   if (rr_mode == RR_RECORD) {
+      pthread_mutex_lock(&rr_lock);
+      rr_mode = RR_OFF;                        /* Adapters store directly again */
+      pthread_mutex_unlock(&rr_lock);
+      rr_drain(1);
+      rr_put(RR_END, 0, 0, NULL, 0);
+      rr_tend = rr_now();
+   }
+   if (rr_mode == RR_REPLAY) {
+      rr_ns = rr_ns0 ? ccu_clock_ns(CLOCK_MONOTONIC) - rr_ns0 : 0;
+      rr_tend = rr_now();
+   }
+   sim_cancel(&evt_unit[EVT_RR]);
+   rr_mode = RR_OFF;
+   if (rr_file != NULL)
+      fclose(rr_file);
+   rr_file = NULL;
+}
+
+static void rr_atexit(void) {
+   if (rr_mode == RR_RECORD)
+      rr_close();
+}
+
+/* Cycle steal of len bytes at addr by a channel adapter thread while
+   recording.  Returns once the CCU has stored and logged it, or 0 at
+   once when the adapter must store it itself (not recording). */
+
+int32 rr_store(int32 addr, uint8 *data, int32 len) {
+   uint32 need = 2 * sizeof(uint32) + len;
+   uint8 *q;
+
+   pthread_mutex_lock(&rr_lock);
+   if (rr_mode != RR_RECORD) {
+      pthread_mutex_unlock(&rr_lock);
+      return 0;
+   }
+   if (rr_qlen + need > rr_qsz) {
+      if ((q = realloc(rr_q, rr_qlen + need + 0x4000)) == NULL) {
+         pthread_mutex_unlock(&rr_lock);
+         return 0;
+      }
+      rr_q = q;
+      rr_qsz = rr_qlen + need + 0x4000;
+   }
+   memcpy(rr_q + rr_qlen, &addr, sizeof(uint32));
+   memcpy(rr_q + rr_qlen + sizeof(uint32), &len, sizeof(uint32));
+   memcpy(rr_q + rr_qlen + 2 * sizeof(uint32), data, len);
+   rr_qlen += need;
+   ccu_wake();                                 /* Sample soon, also in the wait state */
+   while (rr_qlen != 0)
+      pthread_cond_wait(&rr_stored, &rr_lock);
+   pthread_mutex_unlock(&rr_lock);
+   return 1;
+}
+
+/* Called by sim_instr after it sampled int_src into int_src_seen */
+
+void rr_sample(void) {
+   if (rr_mode == RR_REPLAY) {
+      if (int_src_seen != rr_cur) {            /* Not as logged */
+         rr_forced++;
+         int_src = int_src_seen = rr_cur;
+      }
+      return;
+   }
+   if (rr_qlen)
+      rr_drain(1);
+   if (int_src_seen != rr_cur) {
+      rr_put(RR_INT, 0, int_src_seen, NULL, 0);
+      rr_cur = int_src_seen;
+   }
+}
+
+/* Called by ereg_in() with the value v of register e */
+
+int32 rr_in(int32 e, int32 v) {
+   t_uint64 now = rr_now();
+   int32 took = 0;
+
+   if (rr_mode == RR_RECORD) {
+      if ((uint32) v != rr_inval[e]) {
+         rr_put(RR_IN, e, v, NULL, 0);
+         rr_inval[e] = v;
+      }
+      return v;
+   }
+   while (rr_have && (rr_next.type == RR_IN) && (rr_next.t < now)) {
+      rr_miss++;                               /* Logged IN not done */
+      rr_inval[rr_next.reg] = rr_next.val;
+      rr_read();
+      took = 1;
+   }
+   if (rr_have && (rr_next.type == RR_IN) && (rr_next.t == now) && (rr_next.reg == e)) {
+      rr_count(&rr_next);
+      rr_inval[e] = rr_next.val;
+      rr_read();
+      took = 1;
+   }
+   if (took)
+      rr_arm();
+   Eregs_Inp[e] = rr_inval[e];
+   return rr_inval[e];
+}
+
+/* Replay: apply the records due at the next sample */
+
+t_stat rr_svc(UNIT *uptr) {
+   t_uint64 now = rr_now();
+
+   if (rr_mode != RR_REPLAY)
+      return SCPE_OK;
+   if (rr_ns0 == 0)
+      rr_ns0 = ccu_clock_ns(CLOCK_MONOTONIC);                  /* First pass of sim_instr */
+   while (rr_have && (rr_next.type != RR_IN) && (rr_next.t <= now + 1)) {
+      if (rr_next.type == RR_END) {
+         if (rr_next.t > now)
+            break;
+         rr_close();
+         printf("RR: replay of %s ended, %" LL_FMT "u instrs in %.3f sec, %.2f MIPS\n",
+                rr_fname, rr_tend, rr_ns / 1e9, rr_ns ? rr_tend * 1e3 / rr_ns : 0.0);
+         return STOP_RREND;
+      }
+      rr_count(&rr_next);
+      if (rr_next.type == RR_INT) {
+         rr_cur = rr_next.val;
+         int_src = rr_cur;
+      } else if ((rr_next.val < (uint32) MEMSIZE) && (rr_next.len <= (uint32) MEMSIZE - rr_next.val)) {
+         memcpy(M + rr_next.val, rr_data, rr_next.len);
+         pdc_inval(rr_next.val, rr_next.len);
+      }
+      rr_read();
+   }
+   if (!rr_have) {
+      rr_close();
+      printf("RR: %s ends without RR STOP, replay ended\n", rr_fname);
+      return STOP_RREND;
+   }
+   rr_arm();
+   return SCPE_OK;
+}
+
+static void rr_zero(void) {
+   memset(rr_n, 0, sizeof(rr_n));
+   memset(rr_edge, 0, sizeof(rr_edge));
+   memset(rr_inrng, 0, sizeof(rr_inrng));
+   rr_stbytes = rr_miss = rr_forced = rr_tend = 0;
+   rr_ns0 = rr_ns = 0;
+}
+
+static t_stat rr_record(char *fname) {
+   struct rrhdr h;
+   uint8 *st;
+   uint32 len;
+   int32 e;
+
+   if ((rr_file = fopen(fname, "wb")) == NULL)
+      return SCPE_OPENERR;
+   setvbuf(rr_file, NULL, _IOFBF, RR_BUFSZ);
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, RR_MAGIC, sizeof(h.magic));
+   h.version = RR_VERSION;
+   h.memsize = MEMSIZE;
+   h.stlen = len = snap_put(NULL, &h.nitems);
+   if ((st = malloc(len + 1)) == NULL) {
+      rr_close();
+      return SCPE_MEM;
+   }
+   pthread_mutex_lock(&rr_lock);
+   rr_qlen = 0;
+   rr_mode = RR_RECORD;                        /* Cycle steal is queued from here */
+   pthread_mutex_unlock(&rr_lock);
+   rr_cur = h.intsrc = int_src;
+   for (e = 0; e < 128; e++)
+      rr_inval[e] = h.inval[e] = Eregs_Inp[e];
+   snap_put(st, &h.nitems);
+   fwrite(&h, sizeof(h), 1, rr_file);
+   fwrite(M, 1, MEMSIZE, rr_file);
+   fwrite(st, 1, len, rr_file);
+   free(st);
+   if (ferror(rr_file)) {
+      rr_mode = RR_OFF;
+      rr_close();
+      return SCPE_IOERR;
+   }
+   strcpy(rr_fname, fname);
+   rr_last = RR_RECORD;
+   rr_zero();
+   rr_t0 = sim_gtime();
+   return SCPE_OK;
+}
+
+static t_stat rr_replay(char *fname) {
+   struct rrhdr h;
+   uint8 *mem, *st;
+   int32 skip;
+
+   if ((rr_file = fopen(fname, "rb")) == NULL)
+      return SCPE_OPENERR;
+   setvbuf(rr_file, NULL, _IOFBF, RR_BUFSZ);
+   if ((fread(&h, sizeof(h), 1, rr_file) != 1) ||
+       (memcmp(h.magic, RR_MAGIC, sizeof(h.magic)) != 0) || (h.version > RR_VERSION)) {
+      printf("RR: %s is no 3705 event log\n", fname);
+      rr_close();
+      return SCPE_INCOMP;
+   }
+   if (h.memsize != MEMSIZE) {
+      printf("RR: %s was recorded with %uK storage, CPU has %uK\n",
+             fname, h.memsize / 1024, MEMSIZE / 1024);
+      rr_close();
+      return SCPE_INCOMP;
+   }
+   mem = malloc(MEMSIZE);                      /* Read it all before changing anything */
+   st = malloc(h.stlen + 1);
+   if ((mem == NULL) || (st == NULL)) {
+      free(mem);
+      free(st);
+      rr_close();
+      return SCPE_MEM;
+   }
+   if ((fread(mem, 1, MEMSIZE, rr_file) != MEMSIZE) ||
+       (fread(st, 1, h.stlen, rr_file) != h.stlen)) {
+      printf("RR: %s is truncated\n", fname);
+      free(mem);
+      free(st);
+      rr_close();
+      return SCPE_IOERR;
+   }
+   rr_mode = RR_REPLAY;                        /* Adapters and timer quiet from here */
+   if ((skip = snap_get(st, h.stlen, h.nitems, "RR")) < 0) {
+      printf("RR: state in %s is damaged, nothing restored\n", fname);
+      free(mem);
+      free(st);
+      rr_mode = RR_OFF;
+      rr_close();
+      return SCPE_IOERR;
+   }
+   memcpy(M, mem, MEMSIZE);
+   free(mem);
+   free(st);
+   snap_fixup();
+   int_src = rr_cur = h.intsrc;
+   memcpy(rr_inval, h.inval, sizeof(rr_inval));
+   strcpy(rr_fname, fname);
+   rr_last = RR_REPLAY;
+   rr_zero();
+   rr_t0 = sim_gtime();
+   rr_read();
+   sim_activate(&evt_unit[EVT_RR], 0);
+   if (skip)
+      printf("RR: %d state items not restored\n", skip);
+   return SCPE_OK;
+}
+
+/* RR RECORD file, RR REPLAY file, RR STOP */
+
+t_stat rr_cmd(int32 flag, char *cptr) {
+   static int32 registered = 0;
+   char gbuf[CBUFSIZE], fbuf[CBUFSIZE];
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "STOP") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      if (rr_mode == RR_OFF)
+         return SCPE_NOFNC;
+      rr_close();
+      return SCPE_OK;
+   }
+   cptr = get_glyph_nc(cptr, fbuf, 0);
+   if (fbuf[0] == 0)
+      return SCPE_ARG;
+   if (*cptr != 0)
+      return SCPE_2MARG;
+   if ((strcmp(gbuf, "RECORD") != 0) && (strcmp(gbuf, "REPLAY") != 0))
+      return SCPE_ARG;
+   if (tmr_mode == TMR_VIRTUAL) {
+      printf("RR: the wait state skips with TIMER=VIRTUAL, use WALL or HYBRID\n");
+      return SCPE_NOFNC;
+   }
+   rr_close();
+   if (!registered)
+      registered = (atexit(&rr_atexit) == 0);
+   if (strcmp(gbuf, "RECORD") == 0)
+      return rr_record(fbuf);
+   return rr_replay(fbuf);
+}
+
+/* SHOW CPU RR */
+
+t_stat rr_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   t_uint64 t = (rr_mode != RR_OFF) ? rr_now() : rr_tend;
+   t_uint64 ns = (rr_mode == RR_REPLAY) ? (rr_ns0 ? ccu_clock_ns(CLOCK_MONOTONIC) - rr_ns0 : 0) : rr_ns;
+
+   if (rr_last == RR_OFF) {
+      fprintf(st, "record/replay off\n");
+      return SCPE_OK;
+   }
+   fprintf(st, "%s %s %s, %" LL_FMT "u instrs\n",
+           (rr_mode == RR_OFF) ? "last" : "active",
+           (rr_last == RR_RECORD) ? "recording to" : "replay of", rr_fname, t);
+   fprintf(st, "   %" LL_FMT "u INT, %" LL_FMT "u IN, %" LL_FMT "u STORE of %" LL_FMT "u bytes\n",
+           rr_n[RR_INT], rr_n[RR_IN], rr_n[RR_STORE], rr_stbytes);
+   fprintf(st, "   requests: timer %" LL_FMT "u, channel %" LL_FMT "u, scanner %" LL_FMT "u, "
+           "panel %" LL_FMT "u\n", rr_edges(IRQ_TIMER_L3), rr_edges(IRQ_CADS_L3 | IRQ_CAIS_L3),
+           rr_edges(IRQ_SVC_L2), rr_edges(IRQ_INTER_L3));
+   fprintf(st, "   INs: scanner %" LL_FMT "u, channel %" LL_FMT "u, CCU %" LL_FMT "u, "
+           "other %" LL_FMT "u\n", rr_inrng[0], rr_inrng[1], rr_inrng[2], rr_inrng[3]);
+   if (rr_last == RR_REPLAY) {
+      fprintf(st, "   %" LL_FMT "u INs missed, %" LL_FMT "u requests forced", rr_miss, rr_forced);
+      if (ns)
+         fprintf(st, ", %.3f sec, %.2f MIPS", ns / 1e9, t * 1e3 / ns);
+      fprintf(st, "\n");
+   }
+   return SCPE_OK;
+}
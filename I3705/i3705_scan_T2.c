@@ -112,13 +112,15 @@
 #include <sys/types.h>
 #include <sys/syscall.h>
 
-#define MAX_LINE   4                   /* ICW table size (4 lines)  */
-#define BUFFER_SIZE   16384            /* Line Send/Receive buffer  */
+#define MAX_LINE   CS2_LINES           /* ICW table size (4 lines)  */
+#define BUFFER_SIZE   CS2_BUFLEN       /* Line Send/Receive buffer  */
                                        /* Make sure this matches the Buffer of the attached device */
 extern int32 debug_reg;
 extern int32 Eregs_Inp[];
 extern int32 Eregs_Out[];
-extern int8  svc_req_L2;               /* SVC L2 request flag */
+extern volatile uint32 int_src;         /* Interrupt sources pending */
+extern void  ccu_wake(void);           /* Interrupt request raised */
+extern int32 rr_mode;                  /* Record and replay */
 extern FILE *trace;
 extern int32 lvl;
 extern int32 cc;
@@ -126,63 +128,39 @@ extern int32 cc;
 extern int Ireg_bit(int reg, int bit_mask);
 extern void wait();
 
-int8 Eflg_rvcd;                        /* Eflag received */
-
-int abar;                              /* Attach Buffer Addr Reg (020-1FF) to CS2   */
-int abar_int;                          /* ABAR of line interrupt (020-1FF) from CS2 */
-
-/* ICW Local Store Registers */
-uint8_t icw_scf[MAX_LINE];             /* ICW[ 0- 7] SCF - Secondary Control Field  */
-uint8_t icw_pdf[MAX_LINE];             /* ICW[ 8-15] PDF - Parallel Data Field      */
-uint8_t icw_lcd[MAX_LINE];             /* ICW[16-19] LCD - Line Code Definer        */
-uint8_t icw_pcf[MAX_LINE];             /* ICW[20-23] PCF - Primary Control Field    */
-uint8_t icw_sdf[MAX_LINE];             /* ICW[24-31] SDF - Serial Data Field        */
-                                       /* ICW[32-33] Not implemented (OSC sel bits) */
-uint16_t icw_Rflags[MAX_LINE];         /* ICW[34-47] flags                          */
-/* Additional icw fields for emulator  */
-uint8_t icw_pcf_prev[MAX_LINE];        /* Previous icw_pcf                          */
-uint8_t icw_lne_stat[MAX_LINE];        /* Line state: RESET, TX or RX               */
-uint8_t icw_pcf_nxt[MAX_LINE];         /* What will be the next pcf value           */
-uint8_t icw_pdf_reg[MAX_LINE];         /* Status ICW PDF reg: FILLED or EMPTY       */
-
-int8 CS2_req_L2_int = OFF;
-// pthread_mutex_t icw_lock;              // ICW lock (0 - 45)
-// extern pthread_mutex_t r77_lock;       // I/O reg x'77' lock
-
 // Trace variables
 uint16_t Sdbg_reg = 0x00;              // Bit flags for debug/trace
 uint16_t Sdbg_flag = OFF;              // 1 when Strace.log open
 FILE  *S_trace;                        // Scanner trace file fd
 
-// This table contains the SMD area addresses of each scanner line.
-int8 line_smd_addr[48];
-
-// Host ---> PU request buffer
-uint8 BLU_req_buf[MAX_LINE][BUFFER_SIZE]; // DLC header + TH + RH + RU + DLC trailer
-int   BLU_req_ptr[MAX_LINE] = { 0 };      // Offset pointer to BLU
-int   BLU_req_len[MAX_LINE] = { 0 };      // Length of BLU request
-int   BLU_req_stat[MAX_LINE]= { 0 };      // State of BLU TX buffer: FILLED or EMPTY
-// PU ---> Host response buffer
-uint8 BLU_rsp_buf[MAX_LINE][BUFFER_SIZE]; // DLC header + TH + RH + RU + DLC trailer
-int   BLU_rsp_ptr[MAX_LINE] = { 0 };      // Offset pointer to BLU
-int   BLU_rsp_len[MAX_LINE] = { 0 };      // Length of BLU response
-int   BLU_rsp_stat[MAX_LINE]= { 0 };      // State of BLU Rx buffer: FILLED or EMPTY
-
-int   PIU_rsp_ptr[MAX_LINE] = { 0 };      // Offset pointer to PIU
-int   PIU_rsp_len[MAX_LINE] = { 0 };      // Length of PIU response
-// Saved RH from 1st or only segment
-uint8 saved_FD2_RH_0[MAX_LINE];        // Saved RH for building a response later
-uint8 saved_FD2_RH_1[MAX_LINE];        // after a segmented PIU
-
-int line;                              // ICW table index pointer
+// Scanner state kept by SAVE, see i3705_snap.c.  It lives in the
+// controller context, the names are those of the former globals.
+#define SNAP_CS2(f)     { #f, (void *) &ccu_ctl, offsetof(struct i3705, cs2.f), \
+                          sizeof(((struct CS2 *) 0)->f), 1 }
+
+struct snapent CS2_snap[] = {
+   SNAP_CS2 (Eflg_rvcd), SNAP_CS2 (abar), SNAP_CS2 (abar_int), SNAP_CS2 (CS2_req_L2_int),
+   SNAP_CS2 (icw_scf), SNAP_CS2 (icw_pdf), SNAP_CS2 (icw_lcd), SNAP_CS2 (icw_pcf),
+   SNAP_CS2 (icw_sdf), SNAP_CS2 (icw_Rflags), SNAP_CS2 (icw_pcf_prev),
+   SNAP_CS2 (icw_lne_stat), SNAP_CS2 (icw_pcf_nxt), SNAP_CS2 (icw_pdf_reg),
+   SNAP_CS2 (line_smd_addr),
+   SNAP_CS2 (BLU_req_buf), SNAP_CS2 (BLU_req_ptr), SNAP_CS2 (BLU_req_len), SNAP_CS2 (BLU_req_stat),
+   SNAP_CS2 (BLU_rsp_buf), SNAP_CS2 (BLU_rsp_ptr), SNAP_CS2 (BLU_rsp_len), SNAP_CS2 (BLU_rsp_stat),
+   SNAP_CS2 (PIU_rsp_ptr), SNAP_CS2 (PIU_rsp_len), SNAP_CS2 (saved_FD2_RH_0),
+   SNAP_CS2 (saved_FD2_RH_1),
+   { NULL }
+};
 
 void Put_ICW(int i);
-void Get_ICW(int i);
-void Init_ICW(int max);
-void prt_BLU_buf(int line, int reqorrsp);
+void Get_ICW(struct CS2 *cs, int i);
+void Init_ICW(struct CS2 *cs, int max);
+void prt_BLU_buf(struct CS2 *cs, int line, int reqorrsp);
 
 
 void *CS2_thread(void *arg) {
+   struct i3705 *ctl = arg;            // Controller this scanner belongs to
+   struct CS2 *cs = &ctl->cs2;
+   int line;                           // ICW table index pointer
    int Bptr = 0;                       // Tx/Rx buffer index pointer
    int i, c;
    register char *s;
@@ -190,6 +168,7 @@ void *CS2_thread(void *arg) {
    int ret;
 
    fprintf(stderr, "\rCS-T2: Thread %ld started succesfully...\n", syscall(SYS_gettid));
+   ctl_thread(ctl, "CS2");
    // core_id = 1 (CPU), 2 (SCAN), 3 (SDLC)
    int core_id = 2;
    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
@@ -203,7 +182,7 @@ void *CS2_thread(void *arg) {
       fprintf(stderr, "\rCS-T2: Thread assigned to core #%1d.\n", core_id);
    }
 
-   Init_ICW(MAX_LINE);                 // Initialize scanner & buffers
+   Init_ICW(cs, MAX_LINE);             // Initialize scanner & buffers
    fprintf(stderr, "\rCS-T2: Scanner initialized with %d lines...\n", MAX_LINE);
 
    // ********************************************************************
@@ -230,210 +209,214 @@ void *CS2_thread(void *arg) {
    // Scanner loop starts here...
    // ********************************************************************
    while(1) {
+      if (rr_mode == RR_REPLAY) {                    // Line events come from the log
+         usleep(1000);
+         continue;
+      }
       for (line = 0; line < MAX_LINE; line++) {      // Scan all lines
 
 
-         icw_scf[line] |= 0x08;                      // Turn DCD always on.
-         if (icw_pcf[line] != icw_pcf_nxt[line]) {   // pcf changed by NCP ?
+         cs->icw_scf[line] |= 0x08;                  // Turn DCD always on.
+         if (cs->icw_pcf[line] != cs->icw_pcf_nxt[line]) { // pcf changed by NCP ?
             if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))   // Trace scanner activities ?
                fprintf(S_trace, "\n\n\r#02L%1d> CS2[%1X]: NCP changed PCF to %1X ",
-                                 line, icw_pcf[line], icw_pcf_nxt[line]);
-            if (icw_pcf_nxt[line] == 0x0)            // NCP changed PCF to 0 ?
-               icw_lne_stat[line] = RESET;           // Line state = RESET
-            icw_pcf_prev[line] = icw_pcf[line];      // Save current pcf and
-            icw_pcf[line] = icw_pcf_nxt[line];       // Set new current pcf
+                                 line, cs->icw_pcf[line], cs->icw_pcf_nxt[line]);
+            if (cs->icw_pcf_nxt[line] == 0x0)        // NCP changed PCF to 0 ?
+               cs->icw_lne_stat[line] = RESET;       // Line state = RESET
+            cs->icw_pcf_prev[line] = cs->icw_pcf[line]; // Save current pcf and
+            cs->icw_pcf[line] = cs->icw_pcf_nxt[line]; // Set new current pcf
          }
 
-         switch (icw_pcf[line]) {
+         switch (cs->icw_pcf[line]) {
             case 0x0:                                // NO-OP
-               if (icw_pcf_prev[line] != icw_pcf[line]) {
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) {
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 0 entered, next PCF will be set by NCP ",
-                                       line, icw_pcf[line]);
+                                       line, cs->icw_pcf[line]);
                }
-               icw_scf[line] &= 0x4A;                // Reset all check cond. bits.
-               BLU_req_stat[line] = EMPTY;           // Clear buffers
-               BLU_rsp_stat[line] = EMPTY;           // Clear buffers
+               cs->icw_scf[line] &= 0x4A;            // Reset all check cond. bits.
+               cs->BLU_req_stat[line] = EMPTY;       // Clear buffers
+               cs->BLU_rsp_stat[line] = EMPTY;       // Clear buffers
                break;
 
             case 0x1:                                // Set mode
-               if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 1 entered, next PCF will be 0 ",
-                                       line, icw_pcf[line]);
-                  icw_scf[line] |= 0x40;             // Set norm char serv flag
-                  icw_pcf_nxt[line] = 0x0;           // Goto PCF = 0...
-                  CS2_req_L2_int = ON;               // ...and issue a L2 int
+                                       line, cs->icw_pcf[line]);
+                  cs->icw_scf[line] |= 0x40;         // Set norm char serv flag
+                  cs->icw_pcf_nxt[line] = 0x0;       // Goto PCF = 0...
+                  cs->CS2_req_L2_int = ON;           // ...and issue a L2 int
                }
                break;
 
             case 0x2:                                // Mon DSR on
-               if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 2 entered, next PCF will be set by NCP ",
-                                       line, icw_pcf[line]);
-                  icw_scf[line] |= 0x40;             // Set norm char serv flag
-                  icw_pcf_nxt[line] = 0x0;           // Goto PCF = 4... (Via PCF = 0)
-                  CS2_req_L2_int = ON;               // ...and issue a L2 int
+                                       line, cs->icw_pcf[line]);
+                  cs->icw_scf[line] |= 0x40;         // Set norm char serv flag
+                  cs->icw_pcf_nxt[line] = 0x0;       // Goto PCF = 4... (Via PCF = 0)
+                  cs->CS2_req_L2_int = ON;           // ...and issue a L2 int
                }
                break;
 
             case 0x3:                                // Mon RI or DSR on
-               if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 3 entered, next PCF will be 0 ",
-                                       line, icw_pcf[line]);
-                  icw_scf[line] |= 0x40;             // Set norm char serv flag
-                  icw_pcf_nxt[line] = 0x0;           // Goto PCF = 0...
-                  CS2_req_L2_int = ON;               // ...and issue a L2 int
+                                       line, cs->icw_pcf[line]);
+                  cs->icw_scf[line] |= 0x40;         // Set norm char serv flag
+                  cs->icw_pcf_nxt[line] = 0x0;       // Goto PCF = 0...
+                  cs->CS2_req_L2_int = ON;           // ...and issue a L2 int
                }
                break;
 
             case 0x4:                                // Mon 7E flag - block DSR error
             case 0x5:                                // Mon 7E flag - allow DSR error
-               if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = %d entered, next PCF will be 6 or 7",
-                                       line, icw_pcf[line], icw_pcf[line]);
+                                       line, cs->icw_pcf[line], cs->icw_pcf[line]);
                   }
                }
-               BLU_rsp_ptr[line] = Bptr = 0;         // Reset response buffer pointer
+               cs->BLU_rsp_ptr[line] = Bptr = 0;     // Reset response buffer pointer
 
-               if (icw_lne_stat[line] == RESET)      // Line is silent. Wait for NCP time out.
+               if (cs->icw_lne_stat[line] == RESET)  // Line is silent. Wait for NCP time out.
                   break;
-               if (icw_lne_stat[line] == TX)         // Line is silent. Wait for NCP action.
+               if (cs->icw_lne_stat[line] == TX)     // Line is silent. Wait for NCP action.
                   break;
 
-               if ((icw_lcd[line] == 0x8) || (icw_lcd[line] == 0x9)) {  // SDLC
-                  icw_scf[line] &= 0xFB;             // Reset 7E detected flag
+               if ((cs->icw_lcd[line] == 0x8) || (cs->icw_lcd[line] == 0x9)) { // SDLC
+                  cs->icw_scf[line] &= 0xFB;         // Reset 7E detected flag
 
                   // Line state is receiving, wait for BFlag...
                   // ******************************************************************
-                  if ((BLU_rsp_stat[line] == FILLED) && (BLU_rsp_buf[line][Bptr] == 0x7E)) {
+                  if ((cs->BLU_rsp_stat[line] == FILLED) && (cs->BLU_rsp_buf[line][Bptr] == 0x7E)) {
                   // ******************************************************************
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
-                        prt_BLU_buf(line, RSP);      // Trace it ?
+                        prt_BLU_buf(cs, line, RSP);      // Trace it ?
 
                      // x'7E' Bflag received...
-                     icw_scf[line] |= 0x04;          // Set 7E flag detected. (NO Serv bit)
-                     icw_lcd[line]  = 0x9;           // LCD = 9 (SDLC 8-bit)
-                     icw_pcf_nxt[line] = 0x6;        // Goto PCF = 6...
-                     CS2_req_L2_int = ON;            // ...and issue a L2 int
+                     cs->icw_scf[line] |= 0x04;      // Set 7E flag detected. (NO Serv bit)
+                     cs->icw_lcd[line]  = 0x9;       // LCD = 9 (SDLC 8-bit)
+                     cs->icw_pcf_nxt[line] = 0x6;    // Goto PCF = 6...
+                     cs->CS2_req_L2_int = ON;        // ...and issue a L2 int
                   }
                }  // End if (icw_lcd[line] == 0x8...
                break;
 
             case 0x6:                                // Receive info-inhibit data interrupt
-               Bptr = BLU_rsp_ptr[line];             // Get buffer pointer for this line.
+               Bptr = cs->BLU_rsp_ptr[line];         // Get buffer pointer for this line.
 
-               if ((svc_req_L2 == ON) || (lvl == 2)) {  // Is L2 interrupt active ?
+               if (IRQ_ON(IRQ_SVC_L2) || (lvl == 2)) {  // Is L2 interrupt active ?
                   break;                             // Loop till inactive...
                }
-               icw_pdf[line] = BLU_rsp_buf[line][Bptr++];     // Get data from Rx buffer
+               cs->icw_pdf[line] = cs->BLU_rsp_buf[line][Bptr++]; // Get data from Rx buffer
 
                if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
                   fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 6 entered, next PCF will be 7 ",
-                                    line, icw_pcf[line]);
+                                    line, cs->icw_pcf[line]);
                   fprintf(S_trace, "\n\r#02L%1d< CS2[%1X]: Receiving PDF = *** %02X ***, Bptr = %d ",
-                                    line, icw_pcf[line], icw_pdf[line], Bptr-1);
+                                    line, cs->icw_pcf[line], cs->icw_pdf[line], Bptr-1);
                }
-               BLU_rsp_ptr[line] = Bptr;             // Save response buffer pointer for this line.
+               cs->BLU_rsp_ptr[line] = Bptr;         // Save response buffer pointer for this line.
 
-               if (icw_pdf[line] == 0x7E)            // EFlag ? If yes: Skip it.
+               if (cs->icw_pdf[line] == 0x7E)        // EFlag ? If yes: Skip it.
                   break ;
-               icw_scf[line] |= 0x40;                // Set norm char serv flag
-               icw_scf[line] &= 0xFB;                // Reset 7E detected flag
-               icw_pdf_reg[line] = FILLED;
-               icw_pcf_nxt[line] = 0x7;              // Goto PCF = 7...
-               CS2_req_L2_int = ON;                  // ...and issue a L2 int
+               cs->icw_scf[line] |= 0x40;            // Set norm char serv flag
+               cs->icw_scf[line] &= 0xFB;            // Reset 7E detected flag
+               cs->icw_pdf_reg[line] = FILLED;
+               cs->icw_pcf_nxt[line] = 0x7;          // Goto PCF = 7...
+               cs->CS2_req_L2_int = ON;              // ...and issue a L2 int
                break;
 
             case 0x7:                                // Receive info-allow data interrupt
-               Bptr = BLU_rsp_ptr[line];             // Get buffer pointer for this line.
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
+               Bptr = cs->BLU_rsp_ptr[line];         // Get buffer pointer for this line.
+               if (IRQ_ON(IRQ_SVC_L2) || (lvl == 2)) // If L2 interrupt active ?
                   break;                             // Loop till inactive...
 
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pdf_reg[line] == EMPTY) {  // NCP has read pdf ?
+               if (cs->icw_lcd[line] == 0x9) {       // SDLC ?
+                  if (cs->icw_pdf_reg[line] == EMPTY) { // NCP has read pdf ?
                      // Check for Eflag (for transparency x'470F7E' CRC + EFlag)
-                     if ((BLU_rsp_buf[line][Bptr - 2] == 0x47) &&  // CRC high
-                         (BLU_rsp_buf[line][Bptr - 1] == 0x0F) &&  // CRC low
-                         (BLU_rsp_buf[line][Bptr - 0] == 0x7E))
-                          Eflg_rvcd = ON;
-                     else Eflg_rvcd = OFF;           // No Eflag
+                     if ((cs->BLU_rsp_buf[line][Bptr - 2] == 0x47) && // CRC high
+                         (cs->BLU_rsp_buf[line][Bptr - 1] == 0x0F) && // CRC low
+                         (cs->BLU_rsp_buf[line][Bptr - 0] == 0x7E))
+                          cs->Eflg_rvcd = ON;
+                     else cs->Eflg_rvcd = OFF;       // No Eflag
 
-                     icw_pdf[line] = BLU_rsp_buf[line][Bptr++];     // Get received byte
+                     cs->icw_pdf[line] = cs->BLU_rsp_buf[line][Bptr++]; // Get received byte
 
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
                         fprintf(S_trace, "\n#02L%1d< CS2[%1X]: PCF = 7 (re-)entered ",
-                                          line, icw_pcf[line]);
+                                          line, cs->icw_pcf[line]);
                         fprintf(S_trace, "\n#02L%1d< CS2[%1X]: Receiving PDF = *** %02X ***, Bptr = %d ",
-                                          line, icw_pcf[line], icw_pdf[line], Bptr-1);
+                                          line, cs->icw_pcf[line], cs->icw_pdf[line], Bptr-1);
                      }
-                     BLU_rsp_ptr[line] = Bptr;       // Save response buffer pointer for this line.
-
-                     if (Eflg_rvcd == ON) {          // EFlag received ?
-                        BLU_rsp_stat[line] = EMPTY;
-                        icw_lne_stat[line] = TX;     // Line turnaround to transmitting...
-                        icw_scf[line] |= 0x44;       // Set char serv and flag det bit
-                        icw_pcf_nxt[line] = 0x6;     // Go back to PCF = 6...
-                        CS2_req_L2_int = ON;         // Issue a L2 interrupt
+                     cs->BLU_rsp_ptr[line] = Bptr;   // Save response buffer pointer for this line.
+
+                     if (cs->Eflg_rvcd == ON) {      // EFlag received ?
+                        cs->BLU_rsp_stat[line] = EMPTY;
+                        cs->icw_lne_stat[line] = TX; // Line turnaround to transmitting...
+                        cs->icw_scf[line] |= 0x44;   // Set char serv and flag det bit
+                        cs->icw_pcf_nxt[line] = 0x6; // Go back to PCF = 6...
+                        cs->CS2_req_L2_int = ON;     // Issue a L2 interrupt
                      } else {
-                        icw_pdf_reg[line] = FILLED;  // Signal NCP to read pdf.
-                        icw_scf[line] |= 0x40;       // Set norm char serv flag
-                        icw_pcf_nxt[line] = 0x7;     // Stay in PCF = 7...
-                        CS2_req_L2_int = ON;         // Issue a L2 interrupt
+                        cs->icw_pdf_reg[line] = FILLED; // Signal NCP to read pdf.
+                        cs->icw_scf[line] |= 0x40;   // Set norm char serv flag
+                        cs->icw_pcf_nxt[line] = 0x7; // Stay in PCF = 7...
+                        cs->CS2_req_L2_int = ON;     // Issue a L2 interrupt
                      }
                   }
                }  // end SDLC
                break;
 
             case 0x8:                                // Transmit initial-turn RTS on
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
+               if (IRQ_ON(IRQ_SVC_L2) || (lvl == 2)) // If L2 interrupt active ?
                   break;
 
                if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))   // Trace scanner activities ?
                   fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = 8 entered, next PCF will be 9 ",
-                                      line, icw_pcf[line]);
+                                      line, cs->icw_pcf[line]);
 
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  icw_scf[line] &= 0xFB;             // Reset flag detected flag
+               if (cs->icw_lcd[line] == 0x9) {       // SDLC ?
+                  cs->icw_scf[line] &= 0xFB;         // Reset flag detected flag
                   // CTS is now on.
-                  icw_pcf_nxt[line] = 0x9;           // Goto PCF = 9
+                  cs->icw_pcf_nxt[line] = 0x9;       // Goto PCF = 9
                   // NO CS2_req_L2_int !
                }  // End SDLC
                break;
 
             case 0x9:                                // Transmit normal
-               Bptr = BLU_req_ptr[line];             // Get request buffer pointer
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
+               Bptr = cs->BLU_req_ptr[line];         // Get request buffer pointer
+               if (IRQ_ON(IRQ_SVC_L2) || (lvl == 2)) // If L2 interrupt active ?
                   break;
 
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pdf_reg[line] == FILLED) { // New char avail to xmit ?
+               if (cs->icw_lcd[line] == 0x9) {       // SDLC ?
+                  if (cs->icw_pdf_reg[line] == FILLED) { // New char avail to xmit ?
 
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02)) {  // Trace scanner activities ?
                         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = 9 (re-)entered ",
-                                          line, icw_pcf[line]);
+                                          line, cs->icw_pcf[line]);
                         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: Transmitting PDF = *** %02X ***, Bptr = %d ",
-                                          line, icw_pcf[line], icw_pdf[line], Bptr);
+                                          line, cs->icw_pcf[line], cs->icw_pdf[line], Bptr);
                      }
                      // ******************************************************************
                      // Move char to BLU request buffer.
-                     BLU_req_buf[line][Bptr++] = icw_pdf[line];
+                     cs->BLU_req_buf[line][Bptr++] = cs->icw_pdf[line];
                      // ******************************************************************
                      // Next char please...
-                     icw_pdf_reg[line] = EMPTY;      // Ask NCP for next byte
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x9;        // Stay in PCF = 9...
-                     CS2_req_L2_int = ON;            // Issue a L2 interrupt
+                     cs->icw_pdf_reg[line] = EMPTY;  // Ask NCP for next byte
+                     cs->icw_scf[line] |= 0x40;      // Set norm char serv flag
+                     cs->icw_pcf_nxt[line] = 0x9;    // Stay in PCF = 9...
+                     cs->CS2_req_L2_int = ON;        // Issue a L2 interrupt
                   }
-                  BLU_req_ptr[line] = Bptr;          // Save request buffer pointer
+                  cs->BLU_req_ptr[line] = Bptr;      // Save request buffer pointer
                }  // End SDLC
                break;
 
             case 0xA:                                // Transmit normal with new sync
-               if ((svc_req_L2 == ON) || (lvl == 2)) // If L2 interrupt active ?
+               if (IRQ_ON(IRQ_SVC_L2) || (lvl == 2)) // If L2 interrupt active ?
                   break;
                break;
 
@@ -441,38 +424,38 @@ void *CS2_thread(void *arg) {
                break;
 
             case 0xC:                                // Transmit turnaround-turn RTS off
-               if (icw_lcd[line] == 0x9) {           // SDLC ?
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
-                     Bptr = BLU_req_ptr[line];
+               if (cs->icw_lcd[line] == 0x9) {       // SDLC ?
+                  if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
+                     Bptr = cs->BLU_req_ptr[line];
 
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = C entered, next PCF will be set by NCP ",
-                                          line, icw_pcf[line]);
+                                          line, cs->icw_pcf[line]);
 
-                     BLU_req_len[line] = Bptr;       // Set final length of request buffer for SDLC
+                     cs->BLU_req_len[line] = Bptr;   // Set final length of request buffer for SDLC
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
-                        prt_BLU_buf(line, REQ);
+                        prt_BLU_buf(cs, line, REQ);
 
                      // ******************************************************************
                      // Signal SDLC that buffer is ready to be processed.
-                     BLU_req_stat[line] = FILLED;
+                     cs->BLU_req_stat[line] = FILLED;
                      // ******************************************************************
-                     BLU_req_ptr[line] = Bptr = 0;   // Reset request buffer pointer
+                     cs->BLU_req_ptr[line] = Bptr = 0; // Reset request buffer pointer
 
-                     icw_lne_stat[line] = RX;        // Line turnaround to receiving...
-                     icw_scf[line] |= 0x40;          // Set norm char serv flag
-                     icw_pcf_nxt[line] = 0x5;        // Goto PCF = 5...
-                     CS2_req_L2_int = ON;            // ...and issue a L2 int
+                     cs->icw_lne_stat[line] = RX;    // Line turnaround to receiving...
+                     cs->icw_scf[line] |= 0x40;      // Set norm char serv flag
+                     cs->icw_pcf_nxt[line] = 0x5;    // Goto PCF = 5...
+                     cs->CS2_req_L2_int = ON;        // ...and issue a L2 int
                   }
                }  // End SDLC
                break;
 
             case 0xD:                                // Transmit turnaround-keep RTS on
-               if (icw_lcd[line] == 0x9) {           // SDLC
-                  if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+               if (cs->icw_lcd[line] == 0x9) {       // SDLC
+                  if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
                      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                         fprintf(S_trace, "\n#02L%1d> CS2[%1X]: PCF = D entered, next PCF will be set by NCP ",
-                                          line, icw_pcf[line]);
+                                          line, cs->icw_pcf[line]);
                   }
                   // NO CS2_req_L2_int !
                }  // End SDLC
@@ -483,46 +466,47 @@ void *CS2_thread(void *arg) {
                break;
 
             case 0xF:                                // Disable line
-               if (icw_pcf_prev[line] != icw_pcf[line]) {
+               if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) {
                   if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                      fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: PCF = F entered, next PCF will be set by NCP ",
-                                       line, icw_pcf[line]);
+                                       line, cs->icw_pcf[line]);
                }
-               icw_scf[line] |= 0x40;                // Set norm char serv flag
-               icw_pcf_nxt[line] = 0x0;              // Goto PCF = 0...
-               CS2_req_L2_int = ON;                  // ...and issue a L2 int
+               cs->icw_scf[line] |= 0x40;            // Set norm char serv flag
+               cs->icw_pcf_nxt[line] = 0x0;          // Goto PCF = 0...
+               cs->CS2_req_L2_int = ON;              // ...and issue a L2 int
                break;
 
          }  // End of switch (icw_pcf[line])
 
          // ========  POST-PROCESSING SCAN A LINE CYCLE  ========
 
-         if (CS2_req_L2_int) {                       // CS2 L2 interrupt requested ?
+         if (cs->CS2_req_L2_int) {                   // CS2 L2 interrupt requested ?
             if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: SVCL2 interrupt issued for PCF = %1X ",
-                                 line, icw_pcf[line], icw_pcf[line]);
+                                 line, cs->icw_pcf[line], cs->icw_pcf[line]);
 
-            while (svc_req_L2 == ON) {               // Wait till CCU has finished L2 processing
+            while (IRQ_ON(IRQ_SVC_L2)) {             // Wait till CCU has finished L2 processing
                usleep(1000);                                // some time to finish L2.
             }
 
-            abar_int = line + 0x020;                 // Set ABAR with line # that caused the L2 int.
+            cs->abar_int = line + 0x020;             // Set ABAR with line # that caused the L2 int.
 
             if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: abar_int = %04X ",
-                                 line, icw_pcf[line], abar_int );
+                                 line, cs->icw_pcf[line], cs->abar_int );
 
-            svc_req_L2 = ON;                         // Issue a level 2 interrrupt
-            CS2_req_L2_int = OFF;                    // Reset int req flag
+            IRQ_SET(IRQ_SVC_L2);                     // Issue a level 2 interrrupt
+            ccu_wake();                              // Wake CCU if in wait state
+            cs->CS2_req_L2_int = OFF;                // Reset int req flag
          }
-         icw_pcf_prev[line] = icw_pcf[line];         // Save current pcf
-         if (icw_pcf[line] != icw_pcf_nxt[line]) {   // pcf state changed ?
-            icw_pcf[line]   = icw_pcf_nxt[line];     // Set new current pcf
+         cs->icw_pcf_prev[line] = cs->icw_pcf[line]; // Save current pcf
+         if (cs->icw_pcf[line] != cs->icw_pcf_nxt[line]) { // pcf state changed ?
+            cs->icw_pcf[line]   = cs->icw_pcf_nxt[line]; // Set new current pcf
          }
-         if (icw_pcf_prev[line] != icw_pcf[line]) {  // First entry ?
+         if (cs->icw_pcf_prev[line] != cs->icw_pcf[line]) { // First entry ?
             if ((Sdbg_flag == ON) && (Sdbg_reg & 0x02))  // Trace scanner activities ?
                fprintf(S_trace, "\n\r#02L%1d> CS2[%1X]: Next PCF = %1X ",
-                                 line, icw_pcf_prev[line], icw_pcf[line] );
+                                 line, cs->icw_pcf_prev[line], cs->icw_pcf[line] );
          }
          // Release the ICW line lock
 
@@ -537,12 +521,12 @@ void *CS2_thread(void *arg) {
 // *******************************************************************
 // Function to copy ICW[line] to input regs used in CCU coding.
 // *******************************************************************
-void Get_ICW(int line) {                  // See 3705 CE manauls for details.
+void Get_ICW(struct CS2 *cs, int line) {                  // See 3705 CE manauls for details.
 
-   Eregs_Inp[0x44] = (icw_scf[line] << 8)  | icw_pdf[line];
-   Eregs_Inp[0x45] = (icw_lcd[line] << 12) | (icw_pcf[line] << 8) | icw_sdf[line];
+   Eregs_Inp[0x44] = (cs->icw_scf[line] << 8)  | cs->icw_pdf[line];
+   Eregs_Inp[0x45] = (cs->icw_lcd[line] << 12) | (cs->icw_pcf[line] << 8) | cs->icw_sdf[line];
    Eregs_Inp[0x46] =  0xF0A5;             // Display reg (tbd)
-   Eregs_Inp[0x47] =  icw_Rflags[line];   // ICW 32 - 47
+   Eregs_Inp[0x47] =  cs->icw_Rflags[line]; // ICW 32 - 47
 
    return;
 }
@@ -550,33 +534,33 @@ void Get_ICW(int line) {                  // See 3705 CE manauls for details.
 // *******************************************************************
 // Function to initialize the ICW and buffer of the scanner
 // *******************************************************************
-void Init_ICW(int max) {
+void Init_ICW(struct CS2 *cs, int max) {
 
    for (int j = 0; j < max; j++) {        // Initialize all lines
    // ICW Local Store Registers
-      icw_scf[j] = 0;                     // ICW[ 0- 7] SCF - Secondary Control Field
-      icw_pdf[j] = 0;                     // ICW[ 8-15] PDF - Parallel Data Field
-      icw_lcd[j] = 0;                     // ICW[16-19] LCD - Line Code Definer
-      icw_pcf[j] = 0xE;                   // ICW[20-23] PCF - Primary Control Field
-      icw_sdf[j] = 0;                     // ICW[24-31] SDF - Serial Data Field
+      cs->icw_scf[j] = 0;                 // ICW[ 0- 7] SCF - Secondary Control Field
+      cs->icw_pdf[j] = 0;                 // ICW[ 8-15] PDF - Parallel Data Field
+      cs->icw_lcd[j] = 0;                 // ICW[16-19] LCD - Line Code Definer
+      cs->icw_pcf[j] = 0xE;               // ICW[20-23] PCF - Primary Control Field
+      cs->icw_sdf[j] = 0;                 // ICW[24-31] SDF - Serial Data Field
                                           // ICW[32-33] Not implemented (OSC sel bits)
-      icw_Rflags[j] = 0;                  // ICW[34-47] flags
+      cs->icw_Rflags[j] = 0;              // ICW[34-47] flags
    // Additional icw fields for emulator
-      icw_pcf_prev[j] = 0x0;              // Previous icw_pcf
-      icw_lne_stat[j] = RESET;            // Line state: RESET, TX, RX
-      icw_pcf_nxt[j] = 0x0;               // What will be the next pcf value
-      icw_pdf_reg[j] = EMPTY;             // Status ICW PDF reg: NCP FILLED pdf for Tx
+      cs->icw_pcf_prev[j] = 0x0;          // Previous icw_pcf
+      cs->icw_lne_stat[j] = RESET;        // Line state: RESET, TX, RX
+      cs->icw_pcf_nxt[j] = 0x0;           // What will be the next pcf value
+      cs->icw_pdf_reg[j] = EMPTY;         // Status ICW PDF reg: NCP FILLED pdf for Tx
                                           //                     NCP EMPTY pdf during Rx
    // Host ---> PU request buffer
-      BLU_req_ptr[j] = 0;                 // Offset pointer to BLU
-      BLU_req_len[j] = 0;                 // Length of BLU request
-      BLU_req_stat[j]= EMPTY;             // State of BLU Tx buffer
+      cs->BLU_req_ptr[j] = 0;             // Offset pointer to BLU
+      cs->BLU_req_len[j] = 0;             // Length of BLU request
+      cs->BLU_req_stat[j]= EMPTY;         // State of BLU Tx buffer
    // PU ---> Host response buffer
-      BLU_rsp_ptr[j] = 0;                 // Offset pointer to BLU
-      BLU_rsp_len[j] = 0;                 // Length of BLU response
-      BLU_rsp_stat[j]= EMPTY;             // State of BLU Rx buffer
-      PIU_rsp_ptr[j] = 0;                 // Offset pointer to PIU
-      PIU_rsp_len[j] = 0;                 // Length of PIU response
+      cs->BLU_rsp_ptr[j] = 0;             // Offset pointer to BLU
+      cs->BLU_rsp_len[j] = 0;             // Length of BLU response
+      cs->BLU_rsp_stat[j]= EMPTY;         // State of BLU Rx buffer
+      cs->PIU_rsp_ptr[j] = 0;             // Offset pointer to PIU
+      cs->PIU_rsp_len[j] = 0;             // Length of PIU response
    }
    return;
 }
@@ -584,23 +568,23 @@ void Init_ICW(int max) {
 // *******************************************************************
 // Function to print/log the BLU request or response buffer content.
 // *******************************************************************
-void prt_BLU_buf(int line, int reqorrsp) {
+void prt_BLU_buf(struct CS2 *cs, int line, int reqorrsp) {
    int i;
 
    if (reqorrsp == REQ) {
       fprintf(S_trace, "\n\r#02L%1d> SCAN: BLU Request buffer, length = %d \n\r#02L%1d> SCAN: ",
-                        line, BLU_req_len[line], line);
-      for (i = 0; i < BLU_req_len[line]; i++) {
-         fprintf(S_trace, "%02X ", BLU_req_buf[line][i] );
+                        line, cs->BLU_req_len[line], line);
+      for (i = 0; i < cs->BLU_req_len[line]; i++) {
+         fprintf(S_trace, "%02X ", cs->BLU_req_buf[line][i] );
          if ((i + 1) % 32 == 0)
             fprintf(S_trace, " \n#02L%1d> SCAN: ", line);
       }
    } else {
       fprintf(S_trace, "\n\r#02L%1d< SCAN: BLU Response buffer, length = %d \n\r#02L%1d< SCAN: ",
-                        line, BLU_rsp_len[line], line);
+                        line, cs->BLU_rsp_len[line], line);
 
-      for (i = 0; i < BLU_rsp_len[line]; i++) {
-         fprintf(S_trace, "%02X ", BLU_rsp_buf[line][i]);
+      for (i = 0; i < cs->BLU_rsp_len[line]; i++) {
+         fprintf(S_trace, "%02X ", cs->BLU_rsp_buf[line][i]);
          if ((i + 1) % 32 == 0)
             fprintf(S_trace, " \n#02L%1d< SCAN: ", line);
       }
@@ -42,8 +42,8 @@
 #include <arpa/inet.h>
 #include <errno.h>                     /* Added for debugging       */
 
-#define MAX_LINES       4              /* Maximum of lines          */
-#define BUFLEN_LINE     16384          /* Line Send/Receive buffer  */
+#define MAX_LINES       CS2_LINES      /* Maximum of lines          */
+#define BUFLEN_LINE     CS2_BUFLEN     /* Line Send/Receive buffer  */
 #define LINEBASE        20             /* SDLC lines start at 20    */
                                        /* Make sure this matches the Buffer of the attached device */
 #define TX              0              /* lines state definitions   */
@@ -59,33 +59,28 @@ struct SDLCLine {
    int      epoll_fd;
    uint8_t  SDLC_rbuf[BUFLEN_LINE];    // Received data buffer
    uint8_t  SDLC_tbuf[BUFLEN_LINE];    // Transmit data buffer
-} *sdlcline[MAX_LINES];
+};                                     // One per line in the controller context
 
 extern FILE *S_trace;                  // Externals for debugging
 extern uint16_t Sdbg_reg;
 extern uint16_t Sdbg_flag;
 
-// Host ---> PU request buffer
-extern uint8 BLU_req_buf[MAX_LINES][BUFLEN_LINE];  // DLC header + TH + RH + RU + DLC trailer
-extern int   BLU_req_ptr[MAX_LINES];   // Offset pointer to BLU
-extern int   BLU_req_len[MAX_LINES];   // Length of BLU request
-extern int   BLU_req_stat[MAX_LINES];  // BLU tx buffer state: FILLED or EMPTY
-// PU ---> Host response buffer
-extern uint8 BLU_rsp_buf[MAX_LINES][BUFLEN_LINE];  // DLC header + TH + RH + RU + DLC trailer
-extern int   BLU_rsp_ptr[MAX_LINES];   // Offset pointer to BLU
-extern int   BLU_rsp_len[MAX_LINES];   // Length of BLU response
-extern int   BLU_rsp_stat[MAX_LINES];  // BLU rx buffer state: FILLED or EMPTY
-
-int j;                                 // Line pointer
+// The BLU request (Host ---> PU) and response (PU ---> Host) buffers
+// are in the scanner state of the controller, see struct CS2.
+
 int rcv_cnt;                           // Number of bytes received
-int SendSDLC(int j);
-int ReadSDLC(int j);
+int SendSDLC(struct i3705 *ctl, int j);
+int ReadSDLC(struct i3705 *ctl, int j);
 
 
 //************************************************************************
 //   Thread to handle SDLC frames between scanner and the 3274 emulator  *
 //************************************************************************
 void *SDLC_thread(void *arg) {
+   struct i3705 *ctl = arg;        /* Controller these lines belong to  */
+   struct CS2 *cs = &ctl->cs2;
+   struct SDLCLine **sdlcline = ctl->sdlc;
+   int    j;                       /* Line pointer                      */
    int    devnum;                  /* device nr copy for convenience    */
    int    sockopt;                 /* Used for setsocketoption          */
    int    event_count;             /* # events received                 */
@@ -96,6 +91,7 @@ void *SDLC_thread(void *arg) {
    struct epoll_event event, events[MAX_LINES];
 
    fprintf(stderr, "\n\rSDLC: Thread %ld started succesfully...", syscall(SYS_gettid));
+   ctl_thread(ctl, "SDLC");
    // Assign thread to a core
    // core_id = 1 (CPU), 2 (SCAN), 3 (SDLC)
    int core_id = 3;
@@ -111,9 +107,10 @@ void *SDLC_thread(void *arg) {
 
    for (int j = 0; j < MAX_LINES; j++) {
       sdlcline[j] = malloc(sizeof(struct SDLCLine));
+      ctl->sdlc_bytes += sizeof(struct SDLCLine);
       sdlcline[j]->line_num  = j;
       sdlcline[j]->line_stat = CONN;
-      BLU_rsp_len[j] = 0;
+      cs->BLU_rsp_len[j] = 0;
    }  // End for j = 0
 
    getifaddrs(&nwaddr);      /* Get network address */
@@ -184,15 +181,15 @@ void *SDLC_thread(void *arg) {
          //   Transmitting (CCU ---> line) SDLC frame(s) in BLU buffer
          // ************************************************************************
          // Check if BLU_req_buf (Tx) is filled by scanner.
-         if ((sdlcline[j]->line_stat == CONN) && (BLU_req_stat[j] == FILLED)) {  // Any data from host ?
-            rc = SendSDLC( j );          // Transfer buffer content to 3274
+         if ((sdlcline[j]->line_stat == CONN) && (cs->BLU_req_stat[j] == FILLED)) { // Any data from host ?
+            rc = SendSDLC(ctl, j);        // Transfer buffer content to 3274
             if (rc <  0) {               // No connection ?
                sdlcline[j]->line_stat = DISC;
                continue;
             }
             if (rc == 0) {               // All data send to 3274 ?
-               BLU_req_len[j]  = 0;      // Reset Tx buffer length
-               BLU_req_stat[j] = EMPTY;  // Request is processed; set buffer is empty.
+               cs->BLU_req_len[j]  = 0;  // Reset Tx buffer length
+               cs->BLU_req_stat[j] = EMPTY; // Request is processed; set buffer is empty.
                sdlcline[j]->line_stat = CONN; // Line turnaround
                continue;
             }
@@ -205,19 +202,19 @@ void *SDLC_thread(void *arg) {
          //   Receiving (CCU <--- line) SDLC frame(s) in BLU buffer
          // ************************************************************************
          // Check for any response from 3274
-         if ((sdlcline[j]->line_stat == CONN) && (BLU_rsp_stat[j] == EMPTY)) {  // Any data from 3274
-            rc = ReadSDLC( j );          // Transfer 3274 response to BLU_rsp_buf
+         if ((sdlcline[j]->line_stat == CONN) && (cs->BLU_rsp_stat[j] == EMPTY)) { // Any data from 3274
+            rc = ReadSDLC(ctl, j);        // Transfer 3274 response to BLU_rsp_buf
             if (rc <  0) {               // No connection ?
                sdlcline[j]->line_stat = DISC;
                continue;
             }
             if (rc == 0) {               // No data received yet.
-               BLU_rsp_stat[j] = EMPTY;
+               cs->BLU_rsp_stat[j] = EMPTY;
                continue;
             }
             if (rc  > 0) {               // Data received from 3274 ?
-               BLU_rsp_len[j] = rc;
-               BLU_rsp_stat[j] = FILLED; // Indicate there is data in the response buffer
+               cs->BLU_rsp_len[j] = rc;
+               cs->BLU_rsp_stat[j] = FILLED; // Indicate there is data in the response buffer
                sdlcline[j]->line_stat = CONN;
                continue;
             }
@@ -252,7 +249,9 @@ void *SDLC_thread(void *arg) {
 // Send SDLC frame(s) in BLU_req_buf to the 3274                      *
 // If an error occurs, the TCPIP connection will be closed            *
 //*********************************************************************
-int SendSDLC(int j) {
+int SendSDLC(struct i3705 *ctl, int j) {
+   struct CS2 *cs = &ctl->cs2;
+   struct SDLCLine **sdlcline = ctl->sdlc;
    register char *s;
    int Pflag = FALSE;                    // SDLC Poll bit flag
    int Fptr, frame_len;                  // SDLC frame pointer & length
@@ -261,9 +260,9 @@ int SendSDLC(int j) {
    if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04)) {  // Trace BLU activities ?
       fprintf(S_trace, "\n\n\r#04L%1d> SDLC: Received %d bytes request from scanner."
                        "\n\r#04L%1d> SDLC: Request Buffer: "
-                       "\n\r#04L%1d> SDLC: ", j, BLU_req_len[j], j, j);
-      for (i = 0; i < BLU_req_len[j]; i++) {
-         fprintf(S_trace, "%02X ", (int) BLU_req_buf[j][i] & 0xFF);
+                       "\n\r#04L%1d> SDLC: ", j, cs->BLU_req_len[j], j, j);
+      for (i = 0; i < cs->BLU_req_len[j]; i++) {
+         fprintf(S_trace, "%02X ", (int) cs->BLU_req_buf[j][i] & 0xFF);
          if ((i + 1) % 32 == 0)
             fprintf(S_trace, " \n\r#04L%1d> SDLC: ", j);
       }
@@ -272,18 +271,18 @@ int SendSDLC(int j) {
    // Search for SDLC frames in BLU_req_buf, process it and when a Poll bit is found: Return.
    Pflag = FALSE;
    Fptr = 0;
-   if ((BLU_req_buf[j][Fptr] == 0x00) ||         // If modem clocking is used
-       (BLU_req_buf[j][Fptr] == 0xAA))           // skip 1st char (0xAA or 0x00)
+   if ((cs->BLU_req_buf[j][Fptr] == 0x00) ||     // If modem clocking is used
+       (cs->BLU_req_buf[j][Fptr] == 0xAA))       // skip 1st char (0xAA or 0x00)
       Fptr = 1;
 
    if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04))   // Trace BLU activities ?
       fprintf(S_trace, "\n\r#04L%1d> SDLC: Sending %d bytes to 3274.",
-                        j, BLU_req_len[j]-Fptr);
+                        j, cs->BLU_req_len[j]-Fptr);
 
    if (sdlcline[j]->d3274_fd < 1)        // PU connected ? No: return -1
       return (-1);
    // ******************************************************************
-   rc = send(sdlcline[j]->d3274_fd, &BLU_req_buf[j][Fptr], BLU_req_len[j]-Fptr, 0);
+   rc = send(sdlcline[j]->d3274_fd, &cs->BLU_req_buf[j][Fptr], cs->BLU_req_len[j]-Fptr, 0);
    // ******************************************************************
    if (rc < 0) {
       printf("\n\rSDLC-%d: [SendSDLC] Send failed with error %s",
@@ -304,7 +303,9 @@ int SendSDLC(int j) {
 // Read SDLC frame(s) from the 3274                                   *
 // If an error occurs, the connection will be closed                  *
 //*********************************************************************
-int ReadSDLC(int j) {
+int ReadSDLC(struct i3705 *ctl, int j) {
+   struct CS2 *cs = &ctl->cs2;
+   struct SDLCLine **sdlcline = ctl->sdlc;
    int rc, rcv_cnt;
    int Fptr = 0;
    rcv_cnt = 0;
@@ -320,23 +321,23 @@ int ReadSDLC(int j) {
 
    if (rcv_cnt > 0) {
       // ******************************************************************
-      BLU_rsp_len[j] = read(sdlcline[j]->d3274_fd, &BLU_rsp_buf[j][Fptr], BUFLEN_LINE);
+      cs->BLU_rsp_len[j] = read(sdlcline[j]->d3274_fd, &cs->BLU_rsp_buf[j][Fptr], BUFLEN_LINE);
       // ******************************************************************
 
-      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04) && (BLU_rsp_len[j] > 0)) {
+      if ((Sdbg_flag == ON) && (Sdbg_reg & 0x04) && (cs->BLU_rsp_len[j] > 0)) {
          fprintf(S_trace, "\n\r#04L%1d< SDLC: Received %d bytes response from 3274. "
                           "\n\r#04L%1d< SDLC: Response Buffer: "
-                          "\n\r#04L%1d< SDLC: ", j, BLU_rsp_len[j], j, j);
-         for (int i = 0; i < BLU_rsp_len[j]; i++) {
-            fprintf(S_trace, "%02X ", (int) BLU_rsp_buf[j][i] & 0xFF);
+                          "\n\r#04L%1d< SDLC: ", j, cs->BLU_rsp_len[j], j, j);
+         for (int i = 0; i < cs->BLU_rsp_len[j]; i++) {
+            fprintf(S_trace, "%02X ", (int) cs->BLU_rsp_buf[j][i] & 0xFF);
             if ((i + 1) % 32 == 0)
                fprintf(S_trace, "\n\r#04L%1d< SDLC: ", j);
          }
          fprintf(S_trace, "\n\r#04L%1d< SDLC: Sending %d bytes to scanner.",
-                           j, BLU_rsp_len[j]);
+                           j, cs->BLU_rsp_len[j]);
       }  // End if Sdbg_flag
 
-      return(BLU_rsp_len[j]);            // Received data present in BLU_rsp_buf
+      return(cs->BLU_rsp_len[j]);        // Received data present in BLU_rsp_buf
    } else {
       return(0);                         // No data received (yet)
    }  // End if (rcv_cnt > 0)
@@ -0,0 +1,334 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_snap.c: IBM 3705 machine snapshot
+
+        SAVE file               write the SIMH state and the 3705 image
+        RESTORE file            read both back, then CONT resumes NCP
+
+   SCP's sim_save() and sim_rest() call snap_save() and snap_rest()
+   through sim_vm_save and sim_vm_rest after the device registers.  The
+   3705 image follows the SIMH part of the file:
+
+        header                  magic, version, sizes, file offsets
+                                and the page size of the saving host
+        storage                 MEMSIZE bytes at a host page boundary
+        state                   name, size and bytes of every variable
+                                in cpu_snap, CS2_snap and CA_snap
+
+   Storage is kept in the image only: the SIMH part carries it as zero
+   blocks.  On restore the whole image is read and checked before
+   anything is changed; storage is then copied in one go from the file
+   mapping.  An image saved with a page size this host cannot map from
+   (or a version 1 image, which did not record it) is read instead.  State variables are matched by name and size, so a newer
+   image with items this build does not know still restores what it
+   can; items that do not match are listed.  A file without the image
+   (an old SAVE) restores the storage SIMH deposited instead, which
+   cpu_dep holds in snap_mem until then.  The TCP connections of the channel
+   adapters and lines are not part of the image: the host and the line
+   partners reconnect while NCP carries on where it was saved.
+
+   snap_put() and snap_get() serialize the state variables to and from
+   memory, the incremental checkpoints in i3705_ckpt.c use them too.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define SNAP_MAGIC      "I3705IMG"
+#define SNAP_VERSION    2
+#define SNAP_NAMELEN    64
+
+struct snaphdr {
+   char   magic[8];
+   uint32 version;
+   uint32 hdrlen;                              /* sizeof(struct snaphdr) */
+   uint32 memsize;
+   uint32 nitems;                              /* State variables */
+   t_uint64 memoff;                            /* Storage, page aligned */
+   t_uint64 stoff;                             /* State */
+   uint32 pgsize;                              /* Saving host page size, 0 in v1 */
+   uint32 spare;
+};
+
+#define SNAP_V1LEN      offsetof(struct snaphdr, pgsize)
+
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern int32 GR[4][8], *GRb, lvl, Grp;
+extern volatile uint32 int_src, int_src_seen;
+extern uint32 mem_nchg;
+extern struct snapent cpu_snap[], CS2_snap[], CA_snap[];
+extern int32 RegGrp(int32 level);
+extern void pdc_flush(void);
+extern void jit_flush(void);
+extern void ccu_wake(void);
+extern void ereg_fixup(void);
+extern uint8 ckpt_dirty[];
+
+static struct snapent *snap_tabs[] = { cpu_snap, CS2_snap, CA_snap, NULL };
+static uint8 *snap_mem = NULL;                 /* Storage of the SIMH part */
+
+static void *snap_addr(struct snapent *e) {   /* NULL if not allocated yet */
+   uint8 *b;
+
+   if (!e->ind)
+      return e->addr;
+   b = *(uint8 **) e->addr;
+   return (b == NULL) ? NULL : b + e->off;
+}
+
+/* Serialize the state variables into buf, or only size them when buf
+   is NULL.  Returns the length, *nitems gets the item count. */
+
+uint32 snap_put(uint8 *buf, uint32 *nitems) {
+   struct snapent *e;
+   uint32 pos = 0, len;
+   void *a;
+   int32 i;
+
+   *nitems = 0;
+   for (i = 0; snap_tabs[i] != NULL; i++) {
+      for (e = snap_tabs[i]; e->name != NULL; e++) {
+         if ((a = snap_addr(e)) == NULL)
+            continue;                          /* Adapter not started */
+         len = strlen(e->name);
+         if (buf != NULL) {
+            memcpy(buf + pos, &len, sizeof(len));
+            memcpy(buf + pos + sizeof(len), e->name, len);
+         }
+         pos += sizeof(len) + len;
+         len = e->size;
+         if (buf != NULL) {
+            memcpy(buf + pos, &len, sizeof(len));
+            memcpy(buf + pos + sizeof(len), a, len);
+         }
+         pos += sizeof(len) + len;
+         (*nitems)++;
+      }
+   }
+   return pos;
+}
+
+/* Walk nitems items in buf, set the state variables if set is on.
+   Returns the number of items not restored, -1 if buf ends early. */
+
+static int32 snap_walk(uint8 *buf, uint32 buflen, uint32 nitems, const char *who, int32 set) {
+   struct snapent *e;
+   char name[SNAP_NAMELEN + 1];
+   uint32 n, pos = 0, nl, len;
+   int32 i, k, skip = 0;
+   uint8 *a;
+
+   for (n = 0; n < nitems; n++) {
+      if (buflen - pos < sizeof(nl))
+         return -1;
+      memcpy(&nl, buf + pos, sizeof(nl));
+      pos += sizeof(nl);
+      if ((nl > SNAP_NAMELEN) || (buflen - pos < nl + sizeof(len)))
+         return -1;
+      memcpy(name, buf + pos, nl);
+      name[nl] = 0;
+      pos += nl;
+      memcpy(&len, buf + pos, sizeof(len));
+      pos += sizeof(len);
+      if (buflen - pos < len)
+         return -1;
+      e = NULL;
+      for (i = 0; (e == NULL) && (snap_tabs[i] != NULL); i++)
+         for (k = 0; snap_tabs[i][k].name != NULL; k++)
+            if (strcmp(snap_tabs[i][k].name, name) == 0) {
+               e = &snap_tabs[i][k];
+               break;
+            }
+      if ((e == NULL) || (e->size != (int32) len) || ((a = snap_addr(e)) == NULL)) {
+         if (set)
+            printf("%s: %s not restored\n", who, name);
+         skip++;
+      } else if (set)
+         memcpy(a, buf + pos, len);
+      pos += len;
+   }
+   return skip;
+}
+
+/* Set the state variables from nitems items in buf.  Nothing is set
+   unless all of buf is well formed.  Returns the number of items not
+   restored, -1 if buf ends early. */
+
+int32 snap_get(uint8 *buf, uint32 buflen, uint32 nitems, const char *who) {
+   if (snap_walk(buf, buflen, nitems, who, 0) < 0)
+      return -1;
+   return snap_walk(buf, buflen, nitems, who, 1);
+}
+
+/* Byte of storage deposited by sim_rest(), called by cpu_dep() */
+
+t_stat snap_dep(t_addr addr, int32 data) {
+   if ((snap_mem == NULL) && ((snap_mem = calloc(MAXMEMSIZE, 1)) == NULL))
+      return SCPE_MEM;
+   snap_mem[addr] = data;
+   return SCPE_OK;
+}
+
+/* After storage and state were replaced */
+
+void snap_fixup(void) {
+   Grp = RegGrp(lvl);                          /* Derived CCU state */
+   GRb = GR[Grp];
+   int_src_seen = ~int_src;
+   ereg_fixup();                               /* Cached BSC CRC is stale */
+   pdc_flush();                                /* Storage replaced */
+   jit_flush();
+   mem_nchg++;
+   memset(ckpt_dirty, 1, CKPT_PAGES);          /* Next checkpoint has it all */
+   ccu_wake();
+}
+
+/* Append the 3705 image, called by sim_save() */
+
+t_stat snap_save(FILE *sfile) {
+   struct snaphdr h;
+   long pgsz = sysconf(_SC_PAGESIZE);
+   t_uint64 pos;
+   uint32 len;
+   uint8 zero = 0, *st;
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, SNAP_MAGIC, sizeof(h.magic));
+   h.version = SNAP_VERSION;
+   h.hdrlen = sizeof(h);
+   h.memsize = MEMSIZE;
+   h.pgsize = pgsz;
+   len = snap_put(NULL, &h.nitems);
+   if ((st = malloc(len + 1)) == NULL)
+      return SCPE_MEM;
+   snap_put(st, &h.nitems);
+   pos = ftell(sfile);
+   h.memoff = (pos + sizeof(h) + pgsz - 1) & ~((t_uint64) pgsz - 1);
+   h.stoff = h.memoff + MEMSIZE;
+   fwrite(&h, sizeof(h), 1, sfile);
+   for (pos += sizeof(h); pos < h.memoff; pos++)
+      fwrite(&zero, 1, 1, sfile);
+   fwrite(M, 1, MEMSIZE, sfile);
+   fwrite(st, 1, len, sfile);
+   free(st);
+   return ferror(sfile) ? SCPE_IOERR : SCPE_OK;
+}
+
+/* Read the 3705 image, called by sim_rest() */
+
+t_stat snap_rest(FILE *rfile) {
+   struct snaphdr h;
+   long pgsz = sysconf(_SC_PAGESIZE);
+   t_uint64 t0 = ccu_clock_ns(CLOCK_MONOTONIC);
+   uint32 n, len;
+   int32 skip, mapok;
+   uint8 *map, *mem = NULL, *st;
+   t_stat r = SCPE_OK;
+
+   memset(&h, 0, sizeof(h));
+   n = fread(&h, 1, sizeof(h), rfile);
+   if (n == 0) {                               /* SIMH state only */
+      if (snap_mem != NULL) {
+         memcpy(M, snap_mem, MEMSIZE);
+         snap_fixup();
+      }
+      goto done;
+   }
+   if ((n < SNAP_V1LEN) || (h.hdrlen < SNAP_V1LEN) || (memcmp(h.magic, SNAP_MAGIC, sizeof(h.magic)) != 0)) {
+      printf("RESTORE: no valid 3705 image after the SIMH state\n");
+      r = SCPE_INCOMP;
+      goto done;
+   }
+   if (h.version > SNAP_VERSION) {
+      printf("RESTORE: 3705 image version %u, this build reads up to %u\n",
+             h.version, SNAP_VERSION);
+      r = SCPE_INCOMP;
+      goto done;
+   }
+   if (h.hdrlen < sizeof(h))                   /* Older header, the rest is padding */
+      memset((char *) &h + h.hdrlen, 0, sizeof(h) - h.hdrlen);
+   if (h.memsize != MEMSIZE) {
+      printf("RESTORE: 3705 image of %uK storage, CPU has %uK\n",
+             h.memsize / 1024, MEMSIZE / 1024);
+      r = SCPE_INCOMP;
+      goto done;
+   }
+   if (h.stoff != h.memoff + MEMSIZE) {
+      printf("RESTORE: 3705 image header is damaged, nothing restored\n");
+      r = SCPE_IOERR;
+      goto done;
+   }
+   mapok = (h.pgsize != 0) && ((h.pgsize % pgsz) == 0) && ((h.memoff & (pgsz - 1)) == 0);
+   if (h.pgsize == 0)
+      printf("RESTORE: 3705 image does not record its page size, storage is read\n");
+   else if (!mapok)
+      printf("RESTORE: 3705 image aligned for %u byte pages, host has %ld, storage is read\n",
+             h.pgsize, pgsz);
+
+   /* Read and check all of it, the machine is not touched yet */
+   if ((fseek(rfile, 0, SEEK_END) != 0) || (ftell(rfile) < (long) h.stoff)) {
+      r = SCPE_IOERR;
+      goto done;
+   }
+   len = ftell(rfile) - h.stoff;               /* State runs to the end */
+   map = mapok ? mmap(NULL, MEMSIZE, PROT_READ, MAP_PRIVATE, fileno(rfile), h.memoff) : MAP_FAILED;
+   if (map == MAP_FAILED) {
+      map = NULL;
+      if (((mem = malloc(MEMSIZE)) == NULL) ||
+          (fseek(rfile, h.memoff, SEEK_SET) != 0) ||
+          (fread(mem, 1, MEMSIZE, rfile) != MEMSIZE)) {
+         free(mem);
+         r = (mem == NULL) ? SCPE_MEM : SCPE_IOERR;
+         goto done;
+      }
+   }
+   if ((st = malloc(len + 1)) == NULL)
+      r = SCPE_MEM;
+   else if ((fseek(rfile, h.stoff, SEEK_SET) != 0) || (fread(st, 1, len, rfile) != len))
+      r = SCPE_IOERR;
+
+   /* Then apply it: snap_get sets nothing unless the state is well formed */
+   else if ((skip = snap_get(st, len, h.nitems, "RESTORE")) < 0) {
+      printf("RESTORE: 3705 image state is damaged, nothing restored\n");
+      r = SCPE_IOERR;
+   } else {
+      memcpy(M, (map != NULL) ? map : mem, MEMSIZE);
+      snap_fixup();
+      printf("RESTORE: 3705 image, %uK storage and %u items in %.1f msec",
+             MEMSIZE / 1024, h.nitems - skip, (ccu_clock_ns(CLOCK_MONOTONIC) - t0) / 1e6);
+      if (skip)
+         printf(", %d skipped", skip);
+      printf("\n");
+   }
+   free(st);
+   if (map != NULL)
+      munmap(map, MEMSIZE);
+   free(mem);
+done:
+   free(snap_mem);                             /* Not needed after this RESTORE */
+   snap_mem = NULL;
+   return r;
+}
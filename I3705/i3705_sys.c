@@ -23,27 +23,51 @@
 */
 
 #include <ctype.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "i3705_defs.h"
 
 extern DEVICE cpu_dev;
 extern UNIT cpu_unit;
+extern DEVICE evt_dev;
 extern REG cpu_reg[];
 extern FILE *trace;        // DEBUG HJS
 
 extern int32 lvl;
 extern int32 Grp;
-extern int32 GR[8][4];
+extern int32 GR[4][8];
 extern int8  CL_C[4], CL_Z[4];
 extern int8  test_mode;
 extern int32 Eregs_Inp[128];
 extern int32 Eregs_Out[128];
-extern unsigned char M[];
+extern uint8 *M;
 extern int32 saved_PC;
 char *parse_addr(char *cptr,  char *gbuf, t_addr *addr, int32 *addrtype);
 
 int32 printf_sym (FILE *of, char *strg, t_addr addr, uint32 *val,
     UNIT *uptr, int32 sw);
 
+extern struct opdec op_dec[];
+extern void build_opdec(void);
+extern void pdc_inval(int32 addr, int32 len);
+extern void cpu_ipl_done(int32 entry);
+extern t_stat bench_cmd(int32 flag, char *cptr);
+extern t_stat memtest_cmd(int32 flag, char *cptr);
+extern t_stat latch_cmd(int32 flag, char *cptr);
+extern t_stat brk_set_cmd(int32 flag, char *cptr);
+extern void mem_init(void);
+extern t_stat prof_reset_cmd(int32 flag, char *cptr);
+extern t_stat prof_dump_cmd(int32 flag, char *cptr);
+extern t_stat cov_cmd(int32 flag, char *cptr);
+extern t_stat trc_cmd(int32 flag, char *cptr);
+extern t_stat btr_cmd(int32 flag, char *cptr);
+extern t_stat watch_cmd(int32 flag, char *cptr);
+extern t_stat snap_save(FILE *sfile);
+extern t_stat snap_rest(FILE *rfile);
+extern t_stat ckpt_cmd(int32 flag, char *cptr);
+extern t_stat rr_cmd(int32 flag, char *cptr);
+
 int32 R1fld, R2fld, Rfld;
 int32 N1fld, N2fld, Nfld;
 int32 Afld, Bfld, Dfld, Efld, Ifld, Mfld, Tfld;
@@ -65,6 +89,7 @@ REG  *sim_PC = &cpu_reg[0];
 int32 sim_emax = 4;
 DEVICE *sim_devices[] = {
      &cpu_dev,
+     &evt_dev,
      NULL };
 const char *sim_stop_messages[] = {
     "Unknown error",
@@ -75,9 +100,58 @@ const char *sim_stop_messages[] = {
     "Invalid Qbyte",
     "Invalid Address",
     "Invalid Device Command",
-    "ATTN Card Reader"
+    "ATTN Card Reader",
+    "Watchpoint",
+    "Replay ended"
+};
+
+/* Simulator specific commands */
+
+CTAB i3705_cmd[] = {
+    { "BENCH", &bench_cmd, 0, "bench {count}            opcode decode benchmark\n" },
+    { "MEMTEST", &memtest_cmd, 0, "memtest {count}          addressing exception torture test\n" },
+    { "BREAK", &brk_set_cmd, 0, "br{eak} {-e|-c|-l} <addr>{[n]}{;action}  set an instr breakpoint\n" },
+    { "LATCH", &latch_cmd, 0, "latch check {n {seed}}   compare lazy and stepped C/Z latches\n"
+                              "latch bench {count}      latch setting instrs per second\n" },
+    { "RESET", &prof_reset_cmd, 0, "re{set} profile          clear the CPU profile\n" },
+    { "PROFDUMP", &prof_dump_cmd, 0, "profdump <file>          write the CPU profile to a binary file\n" },
+    { "COVERAGE", &cov_cmd, 0, "coverage save <file>     write the coverage bitmap\n"
+                               "coverage exit <file>     write the coverage bitmap at exit\n"
+                               "coverage clear           clear the coverage bitmap\n" },
+    { "TRACE", &trc_cmd, 0, "trace save <file>        write the instr trace ring\n"
+                            "trace list {n}           decode the last n trace records\n"
+                            "trace print <dump> {out} decode a saved trace dump\n"
+                            "trace trigger <iar>|L<n> <file>  save the ring on reaching iar or level n\n"
+                            "trace trigger off        remove the trigger\n"
+                            "trace clear              empty the trace ring\n" },
+    { "BTRACE", &btr_cmd, 0, "btrace start <file>      write a branch trace to file\n"
+                             "btrace stop              end the branch trace\n"
+                             "btrace print <file> {out}  rebuild the executed path\n" },
+    { "WATCH", &watch_cmd, 0, "watch <addr>{-<addr>} {stop}  watch storage for changes\n"
+                              "watch list               list watchpoints and hits\n"
+                              "watch clear {addr}       remove one or all watchpoints\n" },
+    { "CKPT", &ckpt_cmd, 0, "ckpt start <file> {sec}  base image now, changed pages every sec\n"
+                            "ckpt stop                write the last checkpoint and close\n"
+                            "ckpt load <file> {seq}   replay the base and deltas up to seq\n"
+                            "ckpt list <file>         list the checkpoints in file\n" },
+    { "RR", &rr_cmd, 0, "rr record <file>         write the image and log external events\n"
+                        "rr replay <file>         restore the image and replay the events\n"
+                        "rr stop                  end the recording or the replay\n" },
+    { NULL }
 };
 
+/* Once only VM initialization, called by SCP at startup */
+
+void i3705_init(void) {
+   build_opdec();                             /* Classify all encodings */
+   mem_init();                                /* Map storage and guard region */
+   sim_vm_cmd = i3705_cmd;
+   sim_vm_save = &snap_save;                  /* 3705 image in SAVE files */
+   sim_vm_rest = &snap_rest;
+}
+
+void (*sim_vm_init)(void) = &i3705_init;
+
 /* This is the opcode master defintion table.  Each possible instr mnemonic
    is defined here, with enough information to translate to and from
    symbolic to binary machine code.
@@ -87,100 +161,217 @@ const char *sim_stop_messages[] = {
 int32 nopcode = 55;
 
 struct opdef optable[55] = {
-//    Mnem   opcode  opmask frm grp
-    {"B  " , 0xA800, 0xF800, 3, 0},
-    {"BCL" , 0x9800, 0xF800, 3, 0},
-    {"BZL" , 0x8800, 0xF800, 3, 0},
-    {"BCT" , 0xB880, 0xF880,10, 0},
-    {"BB " , 0xC800, 0xF800, 6, 0},
-    {"BB " , 0xD800, 0xF800, 6, 0},
-    {"BB " , 0xE800, 0xF800, 6, 0},
-    {"BB " , 0xF800, 0xF800, 6, 0},
-
-    {"LRI" , 0x8000, 0xF800, 2, 0},
-    {"ARI" , 0x9000, 0xF800, 2, 0},
-    {"SRI" , 0xA000, 0xF800, 2, 0},
-    {"CRI" , 0xB000, 0xF800, 2, 0},
-    {"XRI" , 0xC000, 0xF800, 2, 0},
-    {"ORI" , 0xD000, 0xF800, 2, 0},
-    {"NRI" , 0xE000, 0xF800, 2, 0},
-    {"TRM" , 0xF000, 0xF800, 2, 0},
-
-    {"LCR" , 0x0008, 0x88FF, 1, 0},
-    {"ACR" , 0x0018, 0x88FF, 1, 0},
-    {"SCR" , 0x0028, 0x88FF, 1, 0},
-    {"CCR" , 0x0038, 0x88FF, 1, 0},
-    {"XCR" , 0x0048, 0x88FF, 1, 0},
-    {"OCR" , 0x0058, 0x88FF, 1, 0},
-    {"NCR" , 0x0068, 0x88FF, 1, 0},
-    {"LCOR", 0x0078, 0x88FF, 1, 0},
-
-    {"ICT" , 0x0010, 0x88FF, 5, 0},
-    {"STCT", 0x0030, 0x88FF, 5, 0},
-    {"IC " , 0x0800, 0x8880, 5, 1},
-    {"STC" , 0x0880, 0x8880, 5, 1},
-
-    {"LH " , 0x0001, 0x8881, 7, 0},
-    {"STH" , 0x0081, 0x8881, 7, 0},
-    {"L  " , 0x0002, 0x8883, 7, 1},
-    {"ST " , 0x0082, 0x8883, 7, 1},
-
-    {"LHR" , 0x0080, 0x88FF, 0, 0},
-    {"AHR" , 0x0090, 0x88FF, 0, 0},
-    {"SHR" , 0x00A0, 0x88FF, 0, 0},
-    {"CHR" , 0x00B0, 0x88FF, 0, 0},
-    {"XHR" , 0x00C0, 0x88FF, 0, 0},
-    {"OHR" , 0x00D0, 0x88FF, 0, 0},
-    {"NHR" , 0x00E0, 0x88FF, 0, 0},
-    {"LHOR", 0x00F0, 0x88FF, 0, 0},
-    {"LR " , 0x0088, 0x88FF, 0, 0},
-    {"AR " , 0x0098, 0x88FF, 0, 0},
-    {"SR " , 0x00A8, 0x88FF, 0, 0},
-    {"CR " , 0x00B8, 0x88FF, 0, 0},
-    {"XR " , 0x00C8, 0x88FF, 0, 0},
-    {"OR " , 0x00D8, 0x88FF, 0, 0},
-    {"NR " , 0x00E8, 0x88FF, 0, 0},
-    {"LOR" , 0x00F8, 0x88FF, 0, 0},
-    {"BALR", 0x0040, 0x88FF, 0, 0},
-
-    {"IN " , 0x000C, 0x880F, 8, 1},
-    {"OUT" , 0x0004, 0x880F, 8, 0},
-
-    {"BAL" , 0xB800, 0xF8F0, 4, 0},
-    {"LA " , 0xB820, 0xF8F0, 4, 0},
-
-    {"EXIT", 0xB840, 0xFFFF, 9, 0},
-
-    {"INV",  0x0000, 0xFFFF,11, 0}
+//    Mnem   opcode  opmask frm grp xcode
+    {"B  " , 0xA800, 0xF800, 3, 0, OP_B   },
+    {"BCL" , 0x9800, 0xF800, 3, 0, OP_BCL },
+    {"BZL" , 0x8800, 0xF800, 3, 0, OP_BZL },
+    {"BCT" , 0xB880, 0xF880,10, 0, OP_BCT },
+    {"BB " , 0xC800, 0xF800, 6, 0, OP_BB  },
+    {"BB " , 0xD800, 0xF800, 6, 0, OP_BB  },
+    {"BB " , 0xE800, 0xF800, 6, 0, OP_BB  },
+    {"BB " , 0xF800, 0xF800, 6, 0, OP_BB  },
+
+    {"LRI" , 0x8000, 0xF800, 2, 0, OP_LRI },
+    {"ARI" , 0x9000, 0xF800, 2, 0, OP_ARI },
+    {"SRI" , 0xA000, 0xF800, 2, 0, OP_SRI },
+    {"CRI" , 0xB000, 0xF800, 2, 0, OP_CRI },
+    {"XRI" , 0xC000, 0xF800, 2, 0, OP_XRI },
+    {"ORI" , 0xD000, 0xF800, 2, 0, OP_ORI },
+    {"NRI" , 0xE000, 0xF800, 2, 0, OP_NRI },
+    {"TRM" , 0xF000, 0xF800, 2, 0, OP_TRM },
+
+    {"LCR" , 0x0008, 0x88FF, 1, 0, OP_LCR },
+    {"ACR" , 0x0018, 0x88FF, 1, 0, OP_ACR },
+    {"SCR" , 0x0028, 0x88FF, 1, 0, OP_SCR },
+    {"CCR" , 0x0038, 0x88FF, 1, 0, OP_CCR },
+    {"XCR" , 0x0048, 0x88FF, 1, 0, OP_XCR },
+    {"OCR" , 0x0058, 0x88FF, 1, 0, OP_OCR },
+    {"NCR" , 0x0068, 0x88FF, 1, 0, OP_NCR },
+    {"LCOR", 0x0078, 0x88FF, 1, 0, OP_LCOR},
+
+    {"ICT" , 0x0010, 0x88FF, 5, 0, OP_ICT },
+    {"STCT", 0x0030, 0x88FF, 5, 0, OP_STCT},
+    {"IC " , 0x0800, 0x8880, 5, 1, OP_IC  },
+    {"STC" , 0x0880, 0x8880, 5, 1, OP_STC },
+
+    {"LH " , 0x0001, 0x8881, 7, 0, OP_LH  },
+    {"STH" , 0x0081, 0x8881, 7, 0, OP_STH },
+    {"L  " , 0x0002, 0x8883, 7, 1, OP_L   },
+    {"ST " , 0x0082, 0x8883, 7, 1, OP_ST  },
+
+    {"LHR" , 0x0080, 0x88FF, 0, 0, OP_LHR },
+    {"AHR" , 0x0090, 0x88FF, 0, 0, OP_AHR },
+    {"SHR" , 0x00A0, 0x88FF, 0, 0, OP_SHR },
+    {"CHR" , 0x00B0, 0x88FF, 0, 0, OP_CHR },
+    {"XHR" , 0x00C0, 0x88FF, 0, 0, OP_XHR },
+    {"OHR" , 0x00D0, 0x88FF, 0, 0, OP_OHR },
+    {"NHR" , 0x00E0, 0x88FF, 0, 0, OP_NHR },
+    {"LHOR", 0x00F0, 0x88FF, 0, 0, OP_LHOR},
+    {"LR " , 0x0088, 0x88FF, 0, 0, OP_LR  },
+    {"AR " , 0x0098, 0x88FF, 0, 0, OP_AR  },
+    {"SR " , 0x00A8, 0x88FF, 0, 0, OP_SR  },
+    {"CR " , 0x00B8, 0x88FF, 0, 0, OP_CR  },
+    {"XR " , 0x00C8, 0x88FF, 0, 0, OP_XR  },
+    {"OR " , 0x00D8, 0x88FF, 0, 0, OP_OR  },
+    {"NR " , 0x00E8, 0x88FF, 0, 0, OP_NR  },
+    {"LOR" , 0x00F8, 0x88FF, 0, 0, OP_LOR },
+    {"BALR", 0x0040, 0x88FF, 0, 0, OP_BALR},
+
+    {"IN " , 0x000C, 0x880F, 8, 1, OP_IN  },
+    {"OUT" , 0x0004, 0x880F, 8, 0, OP_OUT },
+
+    {"BAL" , 0xB800, 0xF8F0, 4, 0, OP_BAL },
+    {"LA " , 0xB820, 0xF8F0, 4, 0, OP_LA  },
+
+    {"EXIT", 0xB840, 0xFFFF, 9, 0, OP_EXIT},
+
+    {"INV",  0x0000, 0xFFFF,11, 0, OP_INV }
 };
 
-/* This is the binary loader.  The input file is considered to be
-   a string of literal bytes with no special format. The
-   load starts at the addr specified in the TXT record.
+/* This is the object deck loader.  The file is a deck of 80 byte
+   records as written by the assembler or the NCP generation: TXT
+   records hold up to 56 bytes for a 24 bit address, the END record may
+   hold the entry address.  ESD, RLD and SYM records are checked for
+   their type only, text is loaded at the address assembled.  Other
+   cards in the deck (REP, NAME, blank padding) are skipped, with a
+   warning unless blank.  The last record may be short, as long as the
+   text it holds is complete.
+
+   The deck is mapped and every record checked before storage changes,
+   then the text is moved per record and each run of adjacent records
+   is invalidated once.
+
+        LOAD file               load the text into storage
+        LOAD -I file {entry}    same, then leave the CCU as after the IPL
+                                of the channel: load state and test mode
+                                off, level 5 unmasked at the entry of the
+                                END record or at entry, no channel IPL
 */
 
+#define OBJ_RECL        80
+#define OBJ_TXTMAX      56
+#define OBJ_WARN        5                      /* Skipped cards reported */
+
+static int32 obj_type(uint8 *r) {              /* Record type, -1 if unknown */
+   static const uint8 types[][3] = {
+      { 0xE3, 0xE7, 0xE3 },                    /* TXT */
+      { 0xC5, 0xE2, 0xC4 },                    /* ESD */
+      { 0xC5, 0xD5, 0xC4 },                    /* END */
+      { 0xD9, 0xD3, 0xC4 },                    /* RLD */
+      { 0xE2, 0xE8, 0xD4 } };                  /* SYM */
+   int32 t;
+
+   if (r[0] != 0x02)
+      return -1;
+   for (t = 0; t < 5; t++)
+      if (memcmp(&r[1], types[t], 3) == 0)
+         return t;
+   return -1;
+}
+
+static int32 obj_blank(uint8 *r) {             /* Padding card ? */
+   int32 i;
+
+   for (i = 0; (i < OBJ_RECL) && ((r[i] == 0x40) || (r[i] == 0x00)); i++) ;
+   return (i == OBJ_RECL);
+}
+
 t_stat sim_load (FILE *fileref, char *cptr, char *fnam, int flag) {
-   int32 i, j, addr = 0x0000, cnt = 0;
-
-   if ((*cptr != 0) || (flag != 0)) return SCPE_ARG;
-   addr = 0x0000;
-   i = 0;
-
-   while (fread(&buff, 1, 80, fileref) == 80) {
-      if (buff[2] == 0xE7) {                          /* TXT record ? */
-         cnt = buff[11];                              /* Get byte count */
-         addr = (buff[6] << 8) | buff[7];             /* Get address to store */
-         for (j = cnt; j > 0; j--) {
-            M[addr] = buff[16 + (cnt - j) ];          /* Store it */
-            addr++;
-            i++;                                      /* Bump byte count */
-         }
-      } else {
-         continue;                                    /* Next record please */
+   struct stat st;
+   struct timespec t0, t1;
+   uint8 *deck, *r, tail[OBJ_RECL];
+   uint32 nrec, n, taill, ntxt = 0, nrun = 0, bytes = 0, nskip = 0, nwarn = 0;
+   int32 addr, cnt, run = -1, runl = 0, entry = -1, last = 0, ipl;
+   t_stat rc;
+
+   ipl = (sim_switches & SWMASK('I')) != 0;
+   if (flag != 0)
+      return SCPE_ARG;
+   if (*cptr != 0) {
+      if (!ipl)
+         return SCPE_ARG;
+      entry = (int32) get_uint(cptr, 16, AMASK, &rc);
+      if (rc != SCPE_OK)
+         return SCPE_ARG;
+   }
+   clock_gettime(CLOCK_MONOTONIC, &t0);
+   if ((fstat(fileno(fileref), &st) != 0) || (st.st_size == 0)) {
+      printf("LOAD: %s is empty\n", fnam);
+      return SCPE_FMT;
+   }
+   nrec = (st.st_size + OBJ_RECL - 1) / OBJ_RECL;
+   deck = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fileref), 0);
+   if (deck == MAP_FAILED)
+      return SCPE_IOERR;
+   taill = st.st_size - (nrec - 1) * OBJ_RECL; /* Short last record: pad it */
+   memset(tail, 0x40, OBJ_RECL);
+   memcpy(tail, deck + (nrec - 1) * OBJ_RECL, taill);
+   for (n = 0; n < nrec; n++) {                /* Check the whole deck first */
+      r = (n == nrec - 1) ? tail : deck + n * OBJ_RECL;
+      switch (obj_type(r)) {
+         case 0:                               /* TXT */
+            addr = (r[5] << 16) | (r[6] << 8) | r[7];
+            cnt = (r[10] << 8) | r[11];
+            if ((cnt == 0) || (cnt > OBJ_TXTMAX) || (addr + cnt > (int32) MEMSIZE)) {
+               printf("LOAD: record %u, %d bytes at %06X do not fit storage\n",
+                      n + 1, cnt, addr);
+               munmap(deck, st.st_size);
+               return SCPE_FMT;
+            }
+            if ((n == nrec - 1) && (16 + cnt > (int32) taill)) {
+               printf("LOAD: record %u is cut off in its text\n", n + 1);
+               munmap(deck, st.st_size);
+               return SCPE_FMT;
+            }
+            break;
+         case 2:                               /* END */
+            if ((entry < 0) && (r[5] != 0x40))
+               entry = (r[5] << 16) | (r[6] << 8) | r[7];
+            break;
+         case -1:                              /* REP, NAME, padding ... */
+            nskip++;
+            if (!obj_blank(r) && (nwarn++ < OBJ_WARN))
+               printf("LOAD: record %u skipped, not an object record\n", n + 1);
+            break;
       }
    }
+   if (ipl && ((entry < 0) || (entry >= (int32) MEMSIZE))) {
+      printf("LOAD: no entry address for -I\n");
+      munmap(deck, st.st_size);
+      return SCPE_ARG;
+   }
+   for (n = 0; n < nrec; n++) {
+      r = (n == nrec - 1) ? tail : deck + n * OBJ_RECL;
+      if (obj_type(r) != 0)
+         continue;
+      addr = (r[5] << 16) | (r[6] << 8) | r[7];
+      cnt = (r[10] << 8) | r[11];
+      memcpy(&M[addr], &r[16], cnt);
+      if (addr != run + runl) {                /* New run of text */
+         pdc_inval(run, runl);
+         run = addr;
+         runl = 0;
+         nrun++;
+      }
+      runl += cnt;
+      bytes += cnt;
+      last = addr + cnt - 1;
+      ntxt++;
+   }
+   pdc_inval(run, runl);                       /* Drop stale predecodes */
+   munmap(deck, st.st_size);
+   if (ipl)
+      cpu_ipl_done(entry);
+   clock_gettime(CLOCK_MONOTONIC, &t1);
    printf("\n\r");
-   printf ("%d Bytes loaded. Last byte stored at loc %05X.\n", i, addr-1);
+   printf("%u Bytes loaded. Last byte stored at loc %05X.\n", bytes, last);
+   printf("LOAD: %u records, %u TXT in %u runs, %.2f msec", nrec, ntxt, nrun,
+          ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6);
+   if (nskip)
+      printf(", %u skipped", nskip);
+   if (ipl)
+      printf(", CCU at %05X on level 5", entry);
+   printf("\n");
    return (SCPE_OK);
 }
 
@@ -218,6 +409,7 @@ t_stat printf_sym (FILE *of, char *strg, t_addr addr, uint32 *val,
 int32 c1, c2, group, inst;
 int32 oplen, i, j;
 char  bld[128], bldaddr[36], bldregs[80];
+char  *p;
 int32 blk[16], blt[16];
 int32 blkadd;
 
@@ -264,13 +456,10 @@ if (!(sw & SWMASK ('M'))) return SCPE_ARG;
 inst = ((val[0] << 8) | val[1]);
 
 /* Find the table entry */
-for (i = 0; i < nopcode; i++) {
-   if ((inst & optable[i].opmask) == optable[i].opcode)
-      break;
-}
+i = op_dec[inst & 0xFFFF].idx;
 
 /* Print the mnem opcode */
-if (i >= nopcode)
+if (i < 0)
    sprintf(bld, "'%04X' Invalid instruction! ", inst);
 else {
    sprintf(bld, " %s", optable[i].mnem);
@@ -331,11 +520,11 @@ switch (optable[i].form) {
       else
          Nfld = 'H';
       if (optable[i].group == 0) {     // No displacement instr.
-         sprintf(bldaddr, " R%01X(%1c),B=R%01X  [0x%04X] ", Rfld, Nfld, Bfld, GR[Bfld][Grp]);
+         sprintf(bldaddr, " R%01X(%1c),B=R%01X  [0x%04X] ", Rfld, Nfld, Bfld, GR[Grp][Bfld]);
       } else {
          if (Bfld > 0)
             sprintf(bldaddr, " R%01X(%1c),D=%02d(B=R%01X)  [0x%02X]+[0x%04X] ",
-                    Rfld, Nfld, Dfld, Bfld, Dfld, GR[Bfld][Grp] );
+                    Rfld, Nfld, Dfld, Bfld, Dfld, GR[Grp][Bfld] );
          else
             sprintf(bldaddr, " R%01X(%1c),D=%02d(B=R%01X)  [0x%02X]+[0x%04X] ",
                     Rfld, Nfld, Dfld, Bfld, Dfld, 0x0680 );
@@ -363,14 +552,14 @@ switch (optable[i].form) {
       if (optable[i].group == 0) {     // LH / STH with 6 bits displacement
          if (Bfld > 0)
             sprintf(bldaddr, " R%01X,(D=%02d)B=R%01X  [0x%02X]+[0x%04X] ",
-                    Rfld, Dfld, Bfld, Dfld & 0x7E, GR[Bfld][Grp]);
+                    Rfld, Dfld, Bfld, Dfld & 0x7E, GR[Grp][Bfld]);
          else
             sprintf(bldaddr, " R%01X,(D=%02d)B=R%01X  [0x%02X]+[0x%04X] ",
                     Rfld, Dfld, Bfld, Dfld & 0x7E, 0x0700);
       } else {                         // L / ST with 5 bits displacement
          if (Bfld > 0)
             sprintf(bldaddr, " R%01X,(D=%02d)B=R%01X  [0x%02X]+[0x%05X] ",
-                    Rfld, Dfld, Bfld, Dfld & 0x7C, GR[Bfld][Grp]);
+                    Rfld, Dfld, Bfld, Dfld & 0x7C, GR[Grp][Bfld]);
          else
             sprintf(bldaddr, " R%01X,(D=%02d)B=R%01X  [0x%02X]+[0x%05X] ",
                     Rfld, Dfld, Bfld, Dfld & 0x7C, 0x0780);
@@ -381,20 +570,23 @@ switch (optable[i].form) {
       Efld = (val[0] & 0x70) | (val[1] >> 4);
       Rfld = (val[0] & 0x07);
       if (Efld < 0x20)
-         sprintf(bldaddr, " R%01X,E=%02X --- [0x%04X]", Rfld, Efld, GR[Efld & 0x07][Efld >> 3]);
+         sprintf(bldaddr, " R%01X,E=%02X --- [0x%04X]", Rfld, Efld, GR[Efld >> 3][Efld & 0x07]);
       else {   // 0x20 - 0x7F
          if (optable[i].group == 1) {        // Input instruction ?
             sprintf(bldaddr, " R%01X,E=%02X <-  [0x%04X] ", Rfld, Efld, Eregs_Inp[Efld]);
          } else {                            // Output instruction ?
-            sprintf(bldaddr, " R%01X,E=%02X  -> [0x%04X] ", Rfld, Efld, GR[Rfld][Grp]);
-            if (Efld == 0x45)    // DEBUG HJS
-               fprintf(trace, ">>> OUT  R%01X,E=%02X  -> [0x%04X] ", Rfld, Efld, GR[Rfld][Grp]);
+            sprintf(bldaddr, " R%01X,E=%02X  -> [0x%04X] ", Rfld, Efld, GR[Grp][Rfld]);
+            if ((Efld == 0x45) && (trace != NULL) && !(sw & SWMASK ('T')))    // DEBUG HJS
+               fprintf(trace, ">>> OUT  R%01X,E=%02X  -> [0x%04X] ", Rfld, Efld, GR[Grp][Rfld]);
          }
       }
       break;
 
    case 9:  // EXIT
-      sprintf(bldaddr, " Leaving lvl %d", lvl );
+      if (sw & SWMASK ('T'))
+         bldaddr[0] = 0;
+      else
+         sprintf(bldaddr, " Leaving lvl %d", lvl );
       break;
 
    case 10: // RT format: R(N),T
@@ -417,11 +609,19 @@ switch (optable[i].form) {
 
 sprintf(bldregs, "Lvl=%d Grp=%d | %05X %05X %05X %05X  %05X %05X %05X %05X | C=%d Z=%d T=%d",
         lvl, Grp,
-        GR[0][Grp], GR[1][Grp], GR[2][Grp], GR[3][Grp],
-        GR[4][Grp], GR[5][Grp], GR[6][Grp], GR[7][Grp],
+        GR[Grp][0], GR[Grp][1], GR[Grp][2], GR[Grp][3],
+        GR[Grp][4], GR[Grp][5], GR[Grp][6], GR[Grp][7],
         CL_C[Grp], CL_Z[Grp], test_mode);
 
-   sprintf(strg, "%s%s\n%s", bld, bldaddr, bldregs);
+   if (sw & SWMASK ('T')) {   // Trace record: drop the live register values
+      if ((p = strchr(bldaddr, '[')) != NULL) {
+         while ((p > bldaddr) && strchr(" -<>", p[-1]))
+            p--;
+         *p = 0;
+      }
+      sprintf(strg, "%s%s", bld, bldaddr);
+   } else
+      sprintf(strg, "%s%s\n%s", bld, bldaddr, bldregs);
 }
    oplen = 22;
 
@@ -0,0 +1,210 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_throt.c: IBM 3705 CCU speed throttle
+
+        SET CPU THROTTLE=n{K|M}   run at most n instrs per second
+        SET CPU THROTTLE=n%       use at most n% of one host core
+        SET CPU NOTHROTTLE        run free
+        SHOW CPU THROTTLE         target, achieved rate and jitter
+
+   Like sim_throt in sim_timer.c the throttle is an event on the SCP
+   clock queue, but it does not calibrate once: every check compares
+   the instrs done since sim_instr started (sim_gtime) with the host
+   time at the target rate, or the CCU thread's CPU time with the host
+   time passed, and sleeps off the difference.  A check comes after about
+   1 msec of CCU work and sleeps in quanta of at most GOV_NAP through
+   ccu_nap(), so that an interrupt request ends the sleep at once; the
+   time still owed is slept at the next check.  A host that falls
+   behind the target is not made up for later.
+
+   The achieved rate is measured over 1 sec windows.  Jitter is the
+   standard deviation of those rates relative to their mean.
+*/
+
+#include "i3705_defs.h"
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#define GOV_OFF         0
+#define GOV_RATE        1                      /* Instrs per second */
+#define GOV_PCT         2                      /* Percent of a host core */
+#define GOV_NAP         2000000                /* Longest sleep, nsec */
+#define GOV_BEHIND      100000000              /* Give up catching up, nsec */
+#define GOV_WIN         1000000000             /* Rate window, nsec */
+
+extern t_uint64 ccu_nap(t_uint64 ns);
+
+extern UNIT evt_unit[];
+
+static int32 gov_mode = GOV_OFF;
+static double gov_val;                         /* Instrs/sec or percent */
+static int32 gov_slice = 1000;                 /* Instrs between checks */
+static t_uint64 gov_t0, gov_cpu0;              /* Base: host time, CPU time */
+static double gov_n0;                          /* Base: instrs */
+static t_uint64 gov_tw, gov_cpuw;              /* Current window start */
+static double gov_nw;
+static double gov_rate, gov_cpu;               /* Last window: instrs/sec, CPU % */
+static double gov_sum, gov_sq;                 /* Window rates for mean, jitter */
+static t_uint64 gov_nwin, gov_naps, gov_nap_ns, gov_over_ns, gov_cut;
+
+/* Called at sim_instr entry, time spent stopped does not count */
+
+void gov_start(void) {
+   sim_cancel(&evt_unit[EVT_GOV]);
+   if (gov_mode == GOV_OFF)
+      return;
+   gov_t0 = gov_tw = ccu_clock_ns(CLOCK_MONOTONIC);
+   gov_cpu0 = gov_cpuw = ccu_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+   gov_n0 = gov_nw = sim_gtime();
+   sim_activate(&evt_unit[EVT_GOV], gov_slice);
+}
+
+t_stat gov_svc(UNIT *uptr) {
+   t_uint64 now, cpu, want = 0, t, d;
+   double n = sim_gtime();
+
+   now = ccu_clock_ns(CLOCK_MONOTONIC);
+   cpu = ccu_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+   if (gov_mode == GOV_RATE) {
+      t = gov_t0 + (t_uint64) ((n - gov_n0) * 1e9 / gov_val);
+      if (t > now)
+         want = t - now;
+      else if (now - t > GOV_BEHIND) {         /* Host too slow, start over */
+         gov_t0 = now;
+         gov_n0 = n;
+      }
+      gov_slice = (int32) (gov_val / 1000);    /* 1 msec at the target */
+   } else {
+      t = (t_uint64) ((cpu - gov_cpu0) * 100.0 / gov_val);
+      if (t > now - gov_t0)                    /* Used more than its share */
+         want = t - (now - gov_t0);
+      else if (now - gov_t0 - t > GOV_BEHIND) { /* Starved by the host, start over */
+         gov_t0 = now;
+         gov_cpu0 = cpu;
+         gov_n0 = n;
+      }
+      if (cpu > gov_cpu0)                      /* 1 msec of CCU time */
+         gov_slice = (int32) ((n - gov_n0) * 1e6 / (cpu - gov_cpu0));
+   }
+   if (gov_slice < 100)
+      gov_slice = 100;
+   if (gov_slice > 10000000)
+      gov_slice = 10000000;
+   while (want > 0) {                          /* Sleep it off in quanta */
+      t = (want > GOV_NAP) ? GOV_NAP : want;
+      if (ccu_nap(t)) {                        /* A request came in, the rest */
+         gov_cut++;                            /* is slept at the next check */
+         want = 0;
+      }
+      d = ccu_clock_ns(CLOCK_MONOTONIC) - now;
+      gov_naps++;
+      gov_nap_ns += d;
+      if (d > t)
+         gov_over_ns += d - t;
+      want = (d >= want) ? 0 : want - d;
+      now += d;
+   }
+   if (now - gov_tw >= GOV_WIN) {              /* Close the window */
+      gov_rate = (n - gov_nw) * 1e9 / (now - gov_tw);
+      gov_cpu = (cpu - gov_cpuw) * 100.0 / (now - gov_tw);
+      gov_sum += gov_rate;
+      gov_sq += gov_rate * gov_rate;
+      gov_nwin++;
+      gov_tw = now;
+      gov_cpuw = cpu;
+      gov_nw = n;
+   }
+   if (gov_mode != GOV_OFF)
+      sim_activate(uptr, gov_slice);
+   return SCPE_OK;
+}
+
+/* SET CPU THROTTLE=n{K|M|%}, SET CPU NOTHROTTLE */
+
+t_stat gov_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   char *tptr;
+   t_value v;
+   int32 c;
+
+   if (val == 0) {
+      if (cptr != NULL)
+         return SCPE_ARG;
+      gov_mode = GOV_OFF;
+      sim_cancel(&evt_unit[EVT_GOV]);
+      return SCPE_OK;
+   }
+   if (cptr == NULL)
+      return SCPE_ARG;
+   v = strtotv(cptr, &tptr, 10);
+   if ((tptr == cptr) || (v == 0))
+      return SCPE_ARG;
+   c = toupper(*tptr);
+   if (c != 0)
+      tptr++;
+   if (*tptr != 0)
+      return SCPE_ARG;
+   if (c == '%') {
+      if (v >= 100)
+         return SCPE_ARG;
+      gov_mode = GOV_PCT;
+      gov_val = v;
+   } else {
+      if ((c != 0) && (c != 'K') && (c != 'M'))
+         return SCPE_ARG;
+      if ((c == 0) && (v < 1000))               /* Less than 1 msec of work */
+         return SCPE_ARG;
+      gov_mode = GOV_RATE;
+      gov_val = (c == 'M') ? v * 1e6 : (c == 'K') ? v * 1e3 : v;
+   }
+   gov_rate = gov_cpu = gov_sum = gov_sq = 0;
+   gov_nwin = gov_naps = gov_nap_ns = gov_over_ns = gov_cut = 0;
+   return SCPE_OK;
+}
+
+/* SHOW CPU, SHOW CPU THROTTLE */
+
+t_stat gov_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   double mean, sd;
+
+   if (gov_mode == GOV_OFF) {
+      fprintf(st, "no throttle");
+      return SCPE_OK;
+   }
+   if (gov_mode == GOV_RATE)
+      fprintf(st, "throttle %.3f MIPS", gov_val / 1e6);
+   else
+      fprintf(st, "throttle %.0f%%", gov_val);
+   if (gov_nwin == 0) {
+      fprintf(st, ", not measured yet");
+      return SCPE_OK;
+   }
+   mean = gov_sum / gov_nwin;
+   sd = gov_sq / gov_nwin - mean * mean;
+   sd = (sd > 0) ? sqrt(sd) : 0;
+   fprintf(st, ", achieved %.3f MIPS (mean %.3f) at %.1f%% CPU, jitter %.2f%%",
+           gov_rate / 1e6, mean / 1e6, gov_cpu, (mean > 0) ? sd * 100 / mean : 0.0);
+   if (gov_naps)
+      fprintf(st, ", %" LL_FMT "u sleeps avg %.0f usec (over %.0f), %" LL_FMT "u cut short",
+              gov_naps, gov_nap_ns / 1e3 / gov_naps, gov_over_ns / 1e3 / gov_naps, gov_cut);
+   return SCPE_OK;
+}
@@ -0,0 +1,166 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_timer.c: IBM 3705 100 msec interval timer
+
+   Each tick sets the timer bit in external register X'7F' and raises
+   the L3 interval timer request.  The timebase is selectable:
+
+        SET CPU TIMER=WALL      every 100 msec of host time (default)
+        SET CPU TIMER=VIRTUAL   every TICK executed instrs
+        SET CPU TIMER=HYBRID    every TICK instrs, or 100 msec after the
+                                last tick when the CCU ran fewer instrs
+        SET CPU TICK=n          instrs per virtual tick (default 100000)
+        SHOW CPU TIMER          timebase and tick counts
+
+   Wall clock ticks come from TMR_thread, started by main() like the
+   adapter threads.  Virtual ticks are a cpu_unit event on the SCP
+   clock queue, so they land between two instrs at a fixed instr count
+   and a run from the same state with the same input repeats exactly.
+   In virtual mode the wait state does not sleep but skips to the next
+   event, so an idle NCP sees its timers expire faster than real time.
+   Use HYBRID when a host or line expects real time responses.
+*/
+
+#include "i3705_defs.h"
+#include <time.h>
+#include <pthread.h>
+
+#define TMR_NSEC        100000000LL            /* Tick period, 100 msec */
+#define TMR_INSTR       100000                 /* Default instrs per tick */
+
+extern UNIT cpu_unit;
+extern int8 test_mode;
+extern int32 Eregs_Inp[];
+extern volatile uint32 int_src;
+extern pthread_mutex_t r7f_lock;
+extern void ccu_wake(void);
+extern int32 rr_mode;
+
+int32 tmr_mode = TMR_WALL;                     /* Timebase */
+static int32 tmr_instr = TMR_INSTR;            /* Instrs per virtual tick */
+static volatile t_uint64 tmr_last_ns = 0;      /* Host time of the last tick */
+static t_uint64 tmr_ticks[2];                  /* Ticks from the thread, the queue */
+static t_uint64 tmr_miss;                      /* Previous tick not yet reset */
+
+/* Kick the 3705 100msec timer, src 0 = thread, 1 = clock queue */
+
+static void tmr_tick(int32 src) {
+   tmr_last_ns = ccu_clock_ns(CLOCK_MONOTONIC);
+   if ((test_mode == ON) || (rr_mode == RR_REPLAY))
+      return;                                  /* Replayed ticks come from the log */
+   pthread_mutex_lock(&r7f_lock);
+   if (Eregs_Inp[0x7F] & 0x0004) {             /* Not reset since the last tick */
+      pthread_mutex_unlock(&r7f_lock);
+      tmr_miss++;
+      return;
+   }
+   Eregs_Inp[0x7F] |= 0x0004;
+   pthread_mutex_unlock(&r7f_lock);
+   IRQ_SET(IRQ_TIMER_L3);
+   ccu_wake();
+   tmr_ticks[src]++;
+}
+
+/* Wall clock ticks.  In hybrid mode the next one is due 100 msec after
+   the last tick of either source. */
+
+void *TMR_thread(void *arg) {
+   struct timespec ts;
+   t_uint64 due = ccu_clock_ns(CLOCK_MONOTONIC);
+
+   ctl_thread(NULL, "TMR");
+   while (1) {
+      if (tmr_mode == TMR_HYBRID)
+         due = tmr_last_ns + TMR_NSEC;
+      else
+         due = due + TMR_NSEC;
+      ts.tv_sec = due / 1000000000;
+      ts.tv_nsec = due % 1000000000;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) ;
+      if ((tmr_mode == TMR_HYBRID) && (ccu_clock_ns(CLOCK_MONOTONIC) < tmr_last_ns + TMR_NSEC))
+         continue;                             /* Virtual tick came first */
+      if (tmr_mode == TMR_VIRTUAL) {
+         due = ccu_clock_ns(CLOCK_MONOTONIC);
+         continue;
+      }
+      if (due + TMR_NSEC < ccu_clock_ns(CLOCK_MONOTONIC))     /* Host was stalled, do not catch up */
+         due = ccu_clock_ns(CLOCK_MONOTONIC);
+      tmr_tick(0);
+   }
+   return NULL;
+}
+
+/* Virtual ticks, cpu_unit service routine */
+
+t_stat tmr_svc(UNIT *uptr) {
+   tmr_tick(1);
+   sim_activate(uptr, tmr_instr);
+   return SCPE_OK;
+}
+
+/* Called by cpu_reset and when the timebase changes */
+
+void tmr_reset(void) {
+   sim_cancel(&cpu_unit);
+   if (tmr_mode != TMR_WALL)
+      sim_activate(&cpu_unit, tmr_instr);
+   tmr_last_ns = ccu_clock_ns(CLOCK_MONOTONIC);
+}
+
+/* SET CPU TIMER=WALL|VIRTUAL|HYBRID, SET CPU TICK=n */
+
+t_stat tmr_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   t_stat r;
+   int32 n;
+
+   if (cptr == NULL)
+      return SCPE_ARG;
+   if (val) {
+      n = (int32) get_uint(cptr, 10, 100000000, &r);
+      if ((r != SCPE_OK) || (n < 100))
+         return SCPE_ARG;
+      tmr_instr = n;
+   } else if (strcmp(cptr, "WALL") == 0)
+      tmr_mode = TMR_WALL;
+   else if (strcmp(cptr, "VIRTUAL") == 0)
+      tmr_mode = TMR_VIRTUAL;
+   else if (strcmp(cptr, "HYBRID") == 0)
+      tmr_mode = TMR_HYBRID;
+   else
+      return SCPE_ARG;
+   tmr_reset();
+   return SCPE_OK;
+}
+
+/* SHOW CPU TIMER */
+
+t_stat tmr_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   static const char *mode[] = { "wall clock", "virtual", "hybrid" };
+
+   fprintf(st, "interval timer: %s", mode[tmr_mode]);
+   if (tmr_mode != TMR_WALL)
+      fprintf(st, ", %d instrs per tick, next in %d", tmr_instr, sim_is_active(&cpu_unit) - 1);
+   fprintf(st, "\n   %" LL_FMT "u wall clock ticks, %" LL_FMT "u virtual ticks, "
+           "%" LL_FMT "u missed (previous not reset)\n",
+           tmr_ticks[0], tmr_ticks[1], tmr_miss);
+   return SCPE_OK;
+}
@@ -0,0 +1,570 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_trace.c: IBM 3705 binary instruction trace
+
+   While tracing is on, sim_instr writes one 16 byte record (struct
+   trcent) per executed instr into a power of 2 ring: IAR, instr bytes,
+   level, C and Z latches after execution, and either the one GR the
+   instr changed or the E field and operand of an IN or OUT.  Nothing
+   is formatted while the CCU runs; the records are decoded afterwards
+   with the printf_sym disassembler.  Like the profiler, tracing makes
+   every instr take the full interpreter loop.
+
+        SET CPU TRACE{=n}       record into a ring of n records (65536)
+        SET CPU NOTRACE         stop recording, the ring is kept
+        SHOW CPU TRACE          ring size, records, trigger
+        TRACE SAVE file         write the ring to a binary dump
+        TRACE LIST {n}          decode the last n records (20)
+        TRACE PRINT dump {out}  decode a dump, to out or the console
+        TRACE TRIGGER iar file  write the ring when the instr at iar
+        TRACE TRIGGER Ln file   or the first instr in level n executes
+        TRACE TRIGGER OFF       remove the trigger
+        TRACE CLEAR             empty the ring
+
+   A trigger fires once and recording goes on.  A dump is "I3705TRC",
+   uint32 version 1 and uint32 number of records (host byte order),
+   then the records, oldest first.
+
+   The branch trace records only where the IAR does not simply follow
+   the previous instr: taken branches, EXITs, interrupt entries and
+   other level switches.  It runs in the threaded dispatch, so long
+   captures cost little more than a run without it.
+
+        BTRACE START file       write a branch trace of this run to file
+        BTRACE STOP             end it and close the file
+        BTRACE PRINT file {out} rebuild the executed path
+        SHOW CPU BTRACE         records and bytes written
+
+   The file is "I3705BTR" and uint32 version 1, then one record per
+   discontinuity, all numbers as LEB128 varints:
+
+        n << 2 | c      instrs executed since the previous record, the
+                        last of them at address "from"; c = 1 if the
+                        level changed
+        lvl, dt         only if c: new level (one byte, 0 = end of
+                        trace) and SIMH time since the last level change
+        d               zigzag of "to" - "from", the next IAR
+
+   or, when records without a level change repeat (a loop):
+
+        k << 2 | 2      the previous record repeated k more times
+
+   BTRACE PRINT walks the n instrs between records through the storage
+   currently loaded, so load the NCP image the trace was taken with
+   first.  Code that was modified while the trace ran decodes as it is
+   now.
+*/
+
+#include "i3705_defs.h"
+#include <stdlib.h>
+
+#define TRC_DFLT        65536                  /* Default ring size */
+#define TRC_MAX         (1 << 24)              /* Largest ring */
+#define BTR_BUF         65536                  /* Branch trace write buffer */
+
+extern int32 lvl;
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern struct opdec op_dec[];
+extern t_stat printf_sym(FILE *of, char *strg, t_addr addr, uint32 *val,
+                         UNIT *uptr, int32 sw);
+
+int32 trc_on = 0;                              /* Recording */
+struct trcent *trc_buf = NULL;                 /* Trace ring */
+uint32 trc_mask = 0;                           /* Ring size - 1 */
+t_uint64 trc_pos = 0;                          /* Records written */
+int32 trc_trig_iar = -1;                       /* Trigger IAR, -1 none */
+int32 trc_trig_lvl = -1;                       /* Trigger level, -1 none */
+static char trc_trig_file[CBUFSIZE];           /* Trigger dump file */
+
+static const char trc_magic[8] = { 'I', '3', '7', '0', '5', 'T', 'R', 'C' };
+
+int32 btr_on = 0;                              /* Branch trace recording */
+int32 btr_next = -1;                           /* IAR that follows the last instr */
+int32 btr_last = 0;                            /* IAR of the last instr */
+int32 btr_lvl = 0;                             /* Level of the last instr */
+uint32 btr_n = 0;                              /* Instrs since the last record */
+static FILE *btr_file = NULL;                  /* Branch trace file */
+static char btr_fname[CBUFSIZE];
+static uint8 btr_buf[BTR_BUF];                 /* Encoded records not yet written */
+static uint32 btr_len = 0;
+static double btr_t;                           /* SIMH time of the last level change */
+static t_uint64 btr_nrec, btr_ninstr, btr_bytes;
+static int32 btr_pn = -1, btr_pd;              /* Previous record, -1 none */
+static t_uint64 btr_rep = 0;                   /* Repeats of it not yet written */
+
+static const char btr_magic[8] = { 'I', '3', '7', '0', '5', 'B', 'T', 'R' };
+
+/* SET CPU TRACE{=n} / NOTRACE */
+
+t_stat trc_set(UNIT *uptr, int32 val, char *cptr, void *desc) {
+   uint32 n = TRC_DFLT, size;
+   t_stat r;
+
+   if (val == 0) {
+      if (cptr != NULL)
+         return SCPE_ARG;
+      trc_on = 0;
+      return SCPE_OK;
+   }
+   if (cptr != NULL) {
+      n = (uint32) get_uint(cptr, 10, TRC_MAX, &r);
+      if ((r != SCPE_OK) || (n == 0))
+         return SCPE_ARG;
+   } else if (trc_buf != NULL)
+      n = trc_mask + 1;                        /* Keep the current ring */
+   for (size = 256; size < n; size <<= 1) ;
+   if ((trc_buf == NULL) || (size != trc_mask + 1)) {
+      free(trc_buf);
+      if ((trc_buf = (struct trcent *) calloc(size, sizeof(struct trcent))) == NULL) {
+         trc_on = 0;
+         return SCPE_MEM;
+      }
+      trc_mask = size - 1;
+      trc_pos = 0;
+   }
+   trc_on = 1;
+   return SCPE_OK;
+}
+
+/* Records in the ring and the oldest of them */
+
+static uint32 trc_count(struct trcent **first) {
+   uint32 n = (trc_pos > trc_mask) ? trc_mask + 1 : (uint32) trc_pos;
+
+   *first = &trc_buf[(trc_pos - n) & trc_mask];
+   return n;
+}
+
+static t_stat trc_save(char *fname) {
+   uint32 hdr[2] = { 1, 0 };
+   uint32 n, head;
+   struct trcent *first;
+   FILE *f;
+
+   if (trc_buf == NULL)
+      return SCPE_NOFNC;
+   n = trc_count(&first);
+   hdr[1] = n;
+   if ((f = fopen(fname, "wb")) == NULL)
+      return SCPE_OPENERR;
+   head = (uint32) (&trc_buf[trc_mask + 1] - first);  /* Up to the wrap */
+   if (head > n)
+      head = n;
+   fwrite(trc_magic, 1, sizeof(trc_magic), f);
+   fwrite(hdr, sizeof(uint32), 2, f);
+   fwrite(first, sizeof(struct trcent), head, f);
+   fwrite(trc_buf, sizeof(struct trcent), n - head, f);
+   if (fclose(f) != 0)
+      return SCPE_IOERR;
+   return SCPE_OK;
+}
+
+/* Trigger hit, called by sim_instr after completing record e */
+
+void trc_fire(struct trcent *e) {
+   trc_trig_iar = trc_trig_lvl = -1;           /* One shot */
+   if (trc_save(trc_trig_file) == SCPE_OK)
+      printf("TRACE: trigger at L%d IAR %05X, ring saved to %s\n\r",
+             e->lvl, e->iar, trc_trig_file);
+   else
+      printf("TRACE: trigger at L%d IAR %05X, cannot write %s\n\r",
+             e->lvl, e->iar, trc_trig_file);
+}
+
+/* Print sequence, level, IAR, instr bytes and mnemonic of one instr */
+
+void trc_sym(FILE *st, t_uint64 seq, int32 level, uint32 iar, uint8 *inst) {
+   struct opdec *od = &op_dec[(inst[0] << 8) | inst[1]];
+   uint32 v[4];
+   char strg[256], hex[12], *p = strg;
+
+   v[0] = inst[0]; v[1] = inst[1]; v[2] = inst[2]; v[3] = inst[3];
+   strg[0] = 0;
+   printf_sym(NULL, strg, iar, v, &cpu_unit, SWMASK('M') | SWMASK('T'));
+   if (od->idx < 0)
+      strcpy(strg, "invalid");
+   while (*p == ' ')
+      p++;
+   if (od->len == 4)
+      sprintf(hex, "%02X%02X%02X%02X", v[0], v[1], v[2], v[3]);
+   else
+      sprintf(hex, "%02X%02X", v[0], v[1]);
+   fprintf(st, "%10" LL_FMT "u L%d %05X  %-8s  %-30s", seq, level, iar, hex, p);
+}
+
+/* Decode one record: sequence, level, IAR, instr, effect */
+
+static void trc_print(FILE *st, t_uint64 seq, struct trcent *e) {
+   trc_sym(st, seq, e->lvl, e->iar, e->inst);
+   fprintf(st, " C=%d Z=%d", (e->flags & TRC_C) != 0, (e->flags & TRC_Z) != 0);
+   if (e->flags & TRC_GR)
+      fprintf(st, "  R%d=%05X", e->gr, e->val);
+   if (e->flags & TRC_IN)
+      fprintf(st, "  IN  E=%02X %05X", e->ereg, e->val);
+   if (e->flags & TRC_OUT)
+      fprintf(st, "  OUT E=%02X %05X", e->ereg, e->val);
+   fprintf(st, "\n");
+}
+
+/* TRACE PRINT dump {out} */
+
+static t_stat trc_print_file(char *fname, char *oname) {
+   struct trcent e;
+   uint32 hdr[2], i;
+   char m[8];
+   FILE *f, *st = stdout;
+
+   if ((f = fopen(fname, "rb")) == NULL)
+      return SCPE_OPENERR;
+   if ((fread(m, 1, 8, f) != 8) || (memcmp(m, trc_magic, 8) != 0) ||
+       (fread(hdr, sizeof(uint32), 2, f) != 2) || (hdr[0] != 1)) {
+      fclose(f);
+      return SCPE_FMT;
+   }
+   if ((oname[0] != 0) && ((st = fopen(oname, "w")) == NULL)) {
+      fclose(f);
+      return SCPE_OPENERR;
+   }
+   for (i = 0; (i < hdr[1]) && (fread(&e, sizeof(e), 1, f) == 1); i++)
+      trc_print(st, i, &e);
+   fclose(f);
+   if (st != stdout)
+      fclose(st);
+   return (i == hdr[1]) ? SCPE_OK : SCPE_IOERR;
+}
+
+/* TRACE SAVE | LIST | PRINT | TRIGGER | CLEAR */
+
+t_stat trc_cmd(int32 flag, char *cptr) {
+   char gbuf[CBUFSIZE], abuf[CBUFSIZE], fbuf[CBUFSIZE];
+   struct trcent *first;
+   uint32 n, k, i;
+   t_stat r;
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "CLEAR") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      trc_pos = 0;
+      return SCPE_OK;
+   }
+   if (strcmp(gbuf, "LIST") == 0) {
+      k = 20;
+      if (*cptr != 0) {
+         k = (uint32) get_uint(cptr, 10, TRC_MAX, &r);
+         if (r != SCPE_OK)
+            return SCPE_ARG;
+      }
+      if (trc_buf == NULL)
+         return SCPE_NOFNC;
+      n = trc_count(&first);
+      for (i = (k < n) ? n - k : 0; i < n; i++)
+         trc_print(stdout, trc_pos - n + i, &trc_buf[(trc_pos - n + i) & trc_mask]);
+      return SCPE_OK;
+   }
+   if (strcmp(gbuf, "TRIGGER") == 0) {
+      cptr = get_glyph(cptr, abuf, 0);
+      if (strcmp(abuf, "OFF") == 0) {
+         if (*cptr != 0)
+            return SCPE_2MARG;
+         trc_trig_iar = trc_trig_lvl = -1;
+         return SCPE_OK;
+      }
+      cptr = get_glyph_nc(cptr, fbuf, 0);
+      if ((abuf[0] == 0) || (fbuf[0] == 0) || (*cptr != 0))
+         return SCPE_ARG;
+      if ((abuf[0] == 'L') && (abuf[1] >= '1') && (abuf[1] <= '5') && (abuf[2] == 0)) {
+         trc_trig_iar = -1;
+         trc_trig_lvl = abuf[1] - '0';
+      } else {
+         trc_trig_iar = (int32) get_uint(abuf, 16, AMASK, &r);
+         if (r != SCPE_OK)
+            return SCPE_ARG;
+         trc_trig_lvl = -1;
+      }
+      strcpy(trc_trig_file, fbuf);
+      return SCPE_OK;
+   }
+   cptr = get_glyph_nc(cptr, fbuf, 0);
+   if (fbuf[0] == 0)
+      return SCPE_ARG;
+   if (strcmp(gbuf, "PRINT") == 0) {
+      cptr = get_glyph_nc(cptr, abuf, 0);
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      return trc_print_file(fbuf, abuf);
+   }
+   if (*cptr != 0)
+      return SCPE_2MARG;
+   if (strcmp(gbuf, "SAVE") == 0)
+      return trc_save(fbuf);
+   return SCPE_ARG;
+}
+
+/* SHOW CPU TRACE */
+
+t_stat trc_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   struct trcent *first;
+
+   if (trc_buf == NULL) {
+      fprintf(st, "trace off, no ring\n");
+      return SCPE_OK;
+   }
+   fprintf(st, "trace %s, ring of %u records (%u KB), %u held, %" LL_FMT "u recorded",
+           trc_on ? "on" : "off", trc_mask + 1,
+           (uint32) ((trc_mask + 1) * sizeof(struct trcent) / 1024),
+           trc_count(&first), trc_pos);
+   if (trc_trig_iar >= 0)
+      fprintf(st, "\n   trigger at IAR %05X to %s", trc_trig_iar, trc_trig_file);
+   if (trc_trig_lvl >= 0)
+      fprintf(st, "\n   trigger at L%d to %s", trc_trig_lvl, trc_trig_file);
+   fprintf(st, "\n");
+   return SCPE_OK;
+}
+
+/* Branch trace */
+
+static void btr_put(t_uint64 v) {
+   while (v >= 0x80) {
+      btr_buf[btr_len++] = (uint8) (v | 0x80);
+      v >>= 7;
+   }
+   btr_buf[btr_len++] = (uint8) v;
+}
+
+static void btr_flush(void) {
+   fwrite(btr_buf, 1, btr_len, btr_file);
+   btr_bytes += btr_len;
+   btr_len = 0;
+}
+
+/* Discontinuity before the instr at pc, called through BTR_STEP */
+
+void btr_rec(int32 pc) {
+   int32 d = pc - btr_last;
+   double now;
+
+   btr_ninstr += btr_n;
+   btr_nrec++;
+   if ((lvl == btr_lvl) && (btr_n == btr_pn) && (d == btr_pd)) {
+      btr_rep++;                               /* Same as the previous one */
+      btr_n = 0;
+      return;
+   }
+   if (btr_rep != 0) {
+      btr_put((btr_rep << 2) | 2);
+      btr_rep = 0;
+   }
+   btr_put(((t_uint64) btr_n << 2) | (lvl != btr_lvl));
+   if (lvl != btr_lvl) {
+      now = sim_gtime();
+      btr_buf[btr_len++] = (uint8) lvl;
+      btr_put((t_uint64) (now - btr_t));
+      btr_t = now;
+      btr_lvl = lvl;
+      btr_pn = -1;                             /* Not repeated */
+   } else {
+      btr_pn = btr_n;
+      btr_pd = d;
+   }
+   btr_put((uint32) ((d << 1) ^ (d >> 31)));
+   btr_n = 0;
+   if (btr_len > BTR_BUF - 32)
+      btr_flush();
+}
+
+/* End record, flush and close */
+
+static t_stat btr_stop(void) {
+   if (btr_file == NULL)
+      return SCPE_OK;
+   if (btr_rep != 0)
+      btr_put((btr_rep << 2) | 2);
+   btr_rep = 0;
+   btr_put(((t_uint64) btr_n << 2) | 1);
+   btr_buf[btr_len++] = 0;
+   btr_ninstr += btr_n;
+   btr_n = 0;
+   btr_flush();
+   btr_on = 0;
+   if (fclose(btr_file) != 0) {
+      btr_file = NULL;
+      return SCPE_IOERR;
+   }
+   btr_file = NULL;
+   return SCPE_OK;
+}
+
+static void btr_atexit(void) {
+   btr_stop();
+}
+
+static int32 btr_get(FILE *f, t_uint64 *v) {
+   int32 c, sh = 0;
+
+   *v = 0;
+   do {
+      if ((c = getc(f)) == EOF)
+         return 0;
+      *v |= (t_uint64) (c & 0x7F) << sh;
+      sh += 7;
+   } while (c & 0x80);
+   return 1;
+}
+
+/* Print the n instrs from *addr on, return the address of the last */
+
+static int32 btr_walk(FILE *st, t_uint64 n, int32 *addr, int32 level, t_uint64 *seq) {
+   int32 from = *addr;
+   uint8 inst[4];
+
+   for (; n > 0; n--, (*seq)++) {
+      from = *addr;
+      inst[0] = M[from & AMASK];
+      inst[1] = M[(from + 1) & AMASK];
+      inst[2] = M[(from + 2) & AMASK];
+      inst[3] = M[(from + 3) & AMASK];
+      trc_sym(st, *seq, level, from, inst);
+      fprintf(st, "\n");
+      *addr = (from + op_dec[(inst[0] << 8) | inst[1]].len) & AMASK;
+   }
+   return from;
+}
+
+/* BTRACE PRINT: walk the instrs between records through storage */
+
+static t_stat btr_print(char *fname, char *oname) {
+   t_uint64 v, k, dt, pn = 0, seq = 0;
+   int32 addr = 0, from = 0, level = 0, c, d, pd = 0;
+   uint32 hdr;
+   char m[8];
+   FILE *f, *st = stdout;
+   t_stat r = SCPE_OK;
+
+   if ((f = fopen(fname, "rb")) == NULL)
+      return SCPE_OPENERR;
+   if ((fread(m, 1, 8, f) != 8) || (memcmp(m, btr_magic, 8) != 0) ||
+       (fread(&hdr, sizeof(uint32), 1, f) != 1) || (hdr != 1)) {
+      fclose(f);
+      return SCPE_FMT;
+   }
+   if ((oname[0] != 0) && ((st = fopen(oname, "w")) == NULL)) {
+      fclose(f);
+      return SCPE_OPENERR;
+   }
+   for (;;) {
+      if (!btr_get(f, &v)) {                   /* Truncated, no end record */
+         r = SCPE_IOERR;
+         break;
+      }
+      if (v & 2) {                             /* Repeats of the previous */
+         for (k = v >> 2; k > 0; k--) {
+            from = btr_walk(st, pn, &addr, level, &seq);
+            addr = (from + pd) & AMASK;
+         }
+         continue;
+      }
+      from = btr_walk(st, pn = v >> 2, &addr, level, &seq);
+      if (v & 1) {
+         if ((c = getc(f)) == 0)               /* End of trace */
+            break;
+         if ((c == EOF) || !btr_get(f, &dt)) {
+            r = SCPE_IOERR;
+            break;
+         }
+         level = c;
+         fprintf(st, "           ---- L%d, %" LL_FMT "u later\n", level, dt);
+      }
+      if (!btr_get(f, &v)) {
+         r = SCPE_IOERR;
+         break;
+      }
+      pd = d = (int32) ((uint32) (v >> 1) ^ -(uint32) (v & 1));
+      addr = (from + d) & AMASK;
+   }
+   fclose(f);
+   if (st != stdout)
+      fclose(st);
+   return r;
+}
+
+/* BTRACE START file | STOP | PRINT file {out} */
+
+t_stat btr_cmd(int32 flag, char *cptr) {
+   static int32 registered = 0;
+   static const uint32 version = 1;
+   char gbuf[CBUFSIZE], fbuf[CBUFSIZE], obuf[CBUFSIZE];
+
+   cptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "STOP") == 0) {
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      return btr_stop();
+   }
+   cptr = get_glyph_nc(cptr, fbuf, 0);
+   if (fbuf[0] == 0)
+      return SCPE_ARG;
+   if (strcmp(gbuf, "PRINT") == 0) {
+      cptr = get_glyph_nc(cptr, obuf, 0);
+      if (*cptr != 0)
+         return SCPE_2MARG;
+      return btr_print(fbuf, obuf);
+   }
+   if ((strcmp(gbuf, "START") != 0) || (*cptr != 0))
+      return SCPE_ARG;
+   btr_stop();
+   if ((btr_file = fopen(fbuf, "wb")) == NULL)
+      return SCPE_OPENERR;
+   fwrite(btr_magic, 1, sizeof(btr_magic), btr_file);
+   fwrite(&version, sizeof(uint32), 1, btr_file);
+   strcpy(btr_fname, fbuf);
+   btr_next = -1;                              /* First instr writes a record */
+   btr_last = btr_lvl = 0;
+   btr_n = 0;
+   btr_pn = -1;
+   btr_rep = 0;
+   btr_t = sim_gtime();
+   btr_nrec = btr_ninstr = 0;
+   btr_bytes = 12;
+   if (!registered)
+      registered = (atexit(&btr_atexit) == 0);
+   btr_on = 1;
+   return SCPE_OK;
+}
+
+/* SHOW CPU BTRACE */
+
+t_stat btr_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   t_uint64 bytes = btr_bytes + btr_len;
+
+   if (btr_file == NULL) {
+      fprintf(st, "branch trace off\n");
+      return SCPE_OK;
+   }
+   fprintf(st, "branch trace to %s, %" LL_FMT "u records, %" LL_FMT "u instrs, %"
+           LL_FMT "u bytes", btr_fname, btr_nrec, btr_ninstr + btr_n, bytes);
+   if (btr_ninstr + btr_n != 0)
+      fprintf(st, " (%.2f bits per instr)", 8.0 * bytes / (btr_ninstr + btr_n));
+   fprintf(st, "\n");
+   return SCPE_OK;
+}
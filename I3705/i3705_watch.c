@@ -0,0 +1,325 @@
+/* Copyright (c) 2024, Henk Stegeman and Edwin Freekenhorst
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+   The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software
+
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+   IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+   FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+   HENK STEGEMAN AND EDWIN FREEKENHORST BE LIABLE FOR ANY CLAIM, DAMAGES OR
+   OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+   ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+   DEALINGS IN THE SOFTWARE.
+   ---------------------------------------------------------------------------
+
+   i3705_watch.c: IBM 3705 storage watchpoints
+
+   While sim_instr runs, the host pages holding watched storage are
+   read only.  A store into such a page faults into mem_fault(), and
+   wp_fault() only notes the faulting thread and address and sets
+   mem_pend, which makes the CCU leave its threaded batch or translated
+   block after the storing instr.  It then opens the page and sets the
+   x86 trap flag, so the store runs alone and wp_step() protects the
+   page again right behind it.  At the next interrupt sample
+   wp_service() compares the watched bytes with their last known
+   values: every changed byte is a hit, charged to the IAR and level
+   the CCU stopped at.  Stores elsewhere in a watched page cost two
+   signals and no hit; stores to other pages and all reads cost
+   nothing.  Stores by the channel adapter and scanner threads fault
+   too and are reported as such.  Without the trap flag the page stays
+   open until wp_service().
+
+        WATCH addr{-addr} {STOP}   watch a byte range, STOP halts the CCU
+        WATCH LIST                 watchpoints and the last hits
+        WATCH CLEAR {addr}         remove the watchpoint at addr, or all
+        SHOW CPU WATCH             same as WATCH LIST
+
+   The pages are writable while the simulator is stopped, so examine,
+   deposit and load do not hit; their changes become the new values.
+*/
+
+#include "i3705_defs.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#define WP_MAX          16                     /* Watchpoints */
+#define WP_OPEN         32                     /* Faults noted between services */
+#define WP_LOG          32                     /* Hits kept for WATCH LIST */
+
+#if defined(__x86_64__) && defined(REG_EFL)
+#define WP_STEP                                /* Single step the store */
+#define WP_TF           0x100                  /* EFLAGS trap flag */
+#endif
+
+extern uint8 *M;
+extern UNIT cpu_unit;
+extern int32 lvl, saved_PC;
+extern volatile int32 mem_pend;
+
+struct wpent {
+   int32    lo, hi;                            /* Watched bytes */
+   int32    stop;                              /* Halt the CCU on a hit */
+   uint8    *old;                              /* Last known values */
+   t_uint64 hits;
+};
+
+struct wphit {
+   int32    addr, old, new;
+   int32    iar, lvl;
+   int32    ext;                               /* Stored by another thread */
+};
+
+static struct wpent wp[WP_MAX];
+static int32 wp_n = 0;
+static struct wphit wp_log[WP_LOG];
+static t_uint64 wp_nlog = 0;                   /* Hits so far */
+static long wp_pgsz;
+
+static volatile int32 wp_armed = 0;
+static pthread_t wp_ccu;                       /* Thread running sim_instr */
+
+/* Written by the fault handler only, read and reset by wp_service() */
+static volatile int32 wp_flt_off[WP_OPEN];
+static pthread_t wp_flt_thr[WP_OPEN];
+static volatile int32 wp_nflt = 0;
+
+#ifdef WP_STEP
+static __thread int32 wp_step_pg = -1;         /* Page opened for this thread's store */
+#endif
+
+/* Protect or open every page holding a watched byte */
+
+static void wp_protect(int32 prot) {
+   int32 i, pg;
+
+   for (i = 0; i < wp_n; i++)
+      for (pg = wp[i].lo & ~(wp_pgsz - 1); pg <= wp[i].hi; pg += wp_pgsz)
+         mprotect(M + pg, wp_pgsz, prot);
+}
+
+/* Write fault at storage offset off, called by mem_fault() with the
+   signal context of the store.  Runs on any thread: it only notes the
+   fault, opens the page and arms the trap after the store. */
+
+void wp_fault(int32 off, void *ctx) {
+   int32 pg = off & ~(wp_pgsz - 1);
+   int32 k;
+
+   if (wp_armed) {
+      k = __sync_fetch_and_add(&wp_nflt, 1);
+      if (k < WP_OPEN) {
+         wp_flt_off[k] = off;
+         wp_flt_thr[k] = pthread_self();
+      }
+      mem_pend = 1;                            /* End the batch or block */
+   }
+   mprotect(M + pg, wp_pgsz, PROT_READ | PROT_WRITE);
+#ifdef WP_STEP
+   if (wp_armed && (ctx != NULL)) {
+      wp_step_pg = pg;
+      ((ucontext_t *) ctx)->uc_mcontext.gregs[REG_EFL] |= WP_TF;
+   }
+#endif
+}
+
+#ifdef WP_STEP
+/* Trap after the store: protect its page again */
+
+static void wp_step(int sig, siginfo_t *si, void *ctx) {
+   if (wp_step_pg < 0) {
+      signal(SIGTRAP, SIG_DFL);                /* Not ours: a debugger's */
+      raise(SIGTRAP);
+      return;
+   }
+   ((ucontext_t *) ctx)->uc_mcontext.gregs[REG_EFL] &= ~WP_TF;
+   if (wp_armed)
+      mprotect(M + wp_step_pg, wp_pgsz, PROT_READ);
+   wp_step_pg = -1;
+}
+#endif
+
+/* Report the changed bytes, charged to the instr the CCU stopped after */
+
+t_stat wp_service(void) {
+   struct wphit *h;
+   t_stat r = SCPE_OK;
+   int32 i, a, ext = 0, nflt = wp_nflt;
+   int32 n = (nflt > WP_OPEN) ? WP_OPEN : nflt;
+
+   if (nflt == 0)
+      return SCPE_OK;
+   for (i = 0; i < n; i++) {
+#ifndef WP_STEP
+      mprotect(M + (wp_flt_off[i] & ~(wp_pgsz - 1)), wp_pgsz, PROT_READ);
+#endif
+      if (!pthread_equal(wp_flt_thr[i], wp_ccu))
+         ext = 1;
+   }
+#ifndef WP_STEP
+   if (nflt > WP_OPEN)
+      wp_protect(PROT_READ);
+#endif
+   __sync_fetch_and_sub(&wp_nflt, nflt);       /* Keep faults noted meanwhile */
+   for (i = 0; i < wp_n; i++) {
+      for (a = wp[i].lo; a <= wp[i].hi; a++) {
+         if (M[a] == wp[i].old[a - wp[i].lo])
+            continue;
+         h = &wp_log[wp_nlog++ % WP_LOG];
+         h->addr = a;
+         h->old = wp[i].old[a - wp[i].lo];
+         h->new = M[a];
+         h->iar = saved_PC;
+         h->lvl = lvl;
+         h->ext = ext;
+         wp[i].old[a - wp[i].lo] = M[a];
+         wp[i].hits++;
+         if (h->ext)
+            printf("WATCH: %05X %02X -> %02X by an adapter thread (CCU at IAR %05X L%d)\n\r",
+                   a, h->old, h->new, h->iar, h->lvl);
+         else
+            printf("WATCH: %05X %02X -> %02X by IAR %05X L%d\n\r",
+                   a, h->old, h->new, h->iar, h->lvl);
+         if (wp[i].stop)
+            r = STOP_WATCH;
+      }
+   }
+   return r;
+}
+
+/* Called at sim_instr entry and exit */
+
+void wp_arm(void) {
+#ifdef WP_STEP
+   struct sigaction sa;
+#endif
+   int32 i;
+
+   if (wp_n == 0)
+      return;
+   if (wp_pgsz == 0) {
+      wp_pgsz = sysconf(_SC_PAGESIZE);
+#ifdef WP_STEP
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_sigaction = &wp_step;
+      sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+      sigemptyset(&sa.sa_mask);
+      sigaction(SIGTRAP, &sa, NULL);
+#endif
+   }
+   for (i = 0; i < wp_n; i++)                  /* Changes while stopped are no hits */
+      memcpy(wp[i].old, M + wp[i].lo, wp[i].hi - wp[i].lo + 1);
+   wp_ccu = pthread_self();
+   wp_nflt = 0;
+   wp_armed = 1;
+   wp_protect(PROT_READ);
+}
+
+/* Returns STOP_WATCH when a STOP watchpoint was hit by the last instrs */
+
+t_stat wp_disarm(void) {
+   t_stat r;
+
+   if (!wp_armed)
+      return SCPE_OK;
+   r = wp_service();
+   wp_armed = 0;
+   wp_protect(PROT_READ | PROT_WRITE);
+   return r;
+}
+
+/* WATCH LIST, SHOW CPU WATCH */
+
+static void wp_list(FILE *st) {
+   t_uint64 k;
+   struct wphit *h;
+   int32 i;
+
+   if (wp_n == 0)
+      fprintf(st, "no watchpoints\n");
+   for (i = 0; i < wp_n; i++)
+      fprintf(st, "   %05X-%05X %s %" LL_FMT "u hits\n", wp[i].lo, wp[i].hi,
+              wp[i].stop ? "STOP" : "    ", wp[i].hits);
+   k = (wp_nlog > WP_LOG) ? wp_nlog - WP_LOG : 0;
+   if (k < wp_nlog)
+      fprintf(st, "last hits:\n");
+   for (; k < wp_nlog; k++) {
+      h = &wp_log[k % WP_LOG];
+      fprintf(st, "   %05X %02X -> %02X  IAR %05X L%d%s\n", h->addr, h->old, h->new,
+              h->iar, h->lvl, h->ext ? "  adapter thread" : "");
+   }
+}
+
+t_stat wp_show(FILE *st, UNIT *uptr, int32 val, void *desc) {
+   wp_list(st);
+   return SCPE_OK;
+}
+
+/* WATCH addr{-addr} {STOP} | LIST | CLEAR {addr} */
+
+t_stat watch_cmd(int32 flag, char *cptr) {
+   char gbuf[CBUFSIZE];
+   t_addr lo, hi;
+   char *tptr;
+   int32 i, stop = 0;
+   t_stat r;
+
+   if (*cptr == 0)
+      return SCPE_2FARG;
+   tptr = get_glyph(cptr, gbuf, 0);
+   if (strcmp(gbuf, "LIST") == 0) {
+      if (*tptr != 0)
+         return SCPE_2MARG;
+      wp_list(stdout);
+      return SCPE_OK;
+   }
+   if (strcmp(gbuf, "CLEAR") == 0) {
+      if (*tptr == 0) {
+         for (i = 0; i < wp_n; i++)
+            free(wp[i].old);
+         wp_n = 0;
+         return SCPE_OK;
+      }
+      lo = get_uint(tptr, 16, AMASK, &r);
+      if (r != SCPE_OK)
+         return SCPE_ARG;
+      for (i = 0; (i < wp_n) && ((lo < wp[i].lo) || (lo > wp[i].hi)); i++) ;
+      if (i == wp_n)
+         return SCPE_ARG;
+      free(wp[i].old);
+      wp[i] = wp[--wp_n];
+      return SCPE_OK;
+   }
+   tptr = get_range(NULL, cptr, &lo, &hi, 16, AMASK, 0);
+   if (tptr == NULL)
+      return SCPE_ARG;
+   while (isspace(*tptr))
+      tptr++;
+   tptr = get_glyph(tptr, gbuf, 0);
+   if (strcmp(gbuf, "STOP") == 0)
+      stop = 1;
+   else if (gbuf[0] != 0)
+      return SCPE_ARG;
+   if ((*tptr != 0) || (hi < lo) || (hi >= MEMSIZE))
+      return SCPE_ARG;
+   if (wp_n == WP_MAX)
+      return SCPE_MEM;
+   if ((wp[wp_n].old = (uint8 *) malloc(hi - lo + 1)) == NULL)
+      return SCPE_MEM;
+   wp[wp_n].lo = lo;
+   wp[wp_n].hi = hi;
+   wp[wp_n].stop = stop;
+   wp[wp_n].hits = 0;
+   wp_n++;
+   return SCPE_OK;
+}
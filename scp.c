@@ -290,6 +290,8 @@ void (*sim_vm_fprint_addr) (FILE *st, DEVICE *dptr, t_addr addr) = NULL;
 t_addr (*sim_vm_parse_addr) (DEVICE *dptr, char *cptr, char **tptr) = NULL;
 t_bool (*sim_vm_fprint_stopped) (FILE *st, t_stat reason) = NULL;
 t_bool (*sim_vm_is_subroutine_call) (t_addr **ret_addrs) = NULL;
+t_stat (*sim_vm_save) (FILE *sfile) = NULL;
+t_stat (*sim_vm_rest) (FILE *rfile) = NULL;
 
 /* Prototypes */
 
@@ -386,6 +388,9 @@ void *CS2_thread(void *arg);
 void *PNL_thread(void *arg);
 void *SDLC_thread(void *arg);
 void *BSC_thread(void *arg);
+void *TMR_thread(void *arg);
+void *ctl_new(void);                                    /* i3705 controller context */
+void ctl_report(void);
 
 
 /* Global data */
@@ -705,9 +710,10 @@ argc = ccommand (&argv);
 //*** Multi thread support coding starts here  HJS
 
 pthread_t thread;
+void *ctl = ctl_new();                                  /* The 3705 these threads serve */
 
                                                         /* Start the type 2 channel adaptor execution thread */
-rc = pthread_create(&thread, NULL, CA_T2_thread, NULL);
+rc = pthread_create(&thread, NULL, CA_T2_thread, ctl);
 if (rc != 0) {                                          /* Any problems ? */
    fprintf (stderr,
            "\r\nCan't create execution thread: %s",
@@ -715,7 +721,7 @@ if (rc != 0) {                                          /* Any problems ? */
    exit(1);
 }                                                        /* Start the communication scanner thread */
 
-rc = pthread_create(&thread, NULL, CS2_thread, NULL);
+rc = pthread_create(&thread, NULL, CS2_thread, ctl);
 if (rc != 0) {                                          /* Any problems ? */
    fprintf (stderr,
            "\r\nCan't create execution thread: %s",
@@ -730,8 +736,16 @@ if (rc != 0) {                                          /* Any problems ? */
           strerror(errno));
    exit(1);
 }
+                                                        /* Start the 100 msec interval timer thread */
+rc = pthread_create(&thread, NULL, TMR_thread, NULL);
+if (rc != 0) {                                          /* Any problems ? */
+   fprintf (stderr,
+           "\r\nCan't create execution thread: %s",
+           strerror(errno));
+   exit(1);
+}
 
-rc = pthread_create(&thread, NULL, SDLC_thread, NULL);
+rc = pthread_create(&thread, NULL, SDLC_thread, ctl);
 if (rc != 0) {                                          /* Any problems ? */
    fprintf (stderr,
            "\r\nCan't create execution thread: %s",
@@ -739,7 +753,7 @@ if (rc != 0) {                                          /* Any problems ? */
    exit(1);
 }
 
-rc = pthread_create(&thread, NULL, BSC_thread, NULL);
+rc = pthread_create(&thread, NULL, BSC_thread, ctl);
 if (rc != 0) {                                          /* Any problems ? */
    fprintf (stderr,
            "\r\nCan't create execution thread: %s",
@@ -751,6 +765,7 @@ if (rc != 0) {                                          /* Any problems ? */
 
 
 sleep (1);
+ctl_report();                                           /* Memory and threads per 3705 */
 
 *cbuf = 0;                                              /* init arg buffer */
 sim_switches = 0;                                       /* init switches */
@@ -2547,6 +2562,11 @@ for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {     /* loop thru devices */
     fputc ('\n', sfile);                                /* end registers */
     }
 fputc ('\n', sfile);                                    /* end devices */
+if (sim_vm_save != NULL) {                              /* VM specific state? */
+    r = sim_vm_save (sfile);
+    if (r != SCPE_OK)
+        return r;
+    }
 return (ferror (sfile))? SCPE_IOERR: SCPE_OK;           /* error during save? */
 }
 
@@ -2760,6 +2780,8 @@ for ( ;; ) {                                            /* device loop */
             }
         }
     }                                                   /* end device loop */
+if (sim_vm_rest != NULL)                                /* VM specific state? */
+    return sim_vm_rest (rfile);
 return SCPE_OK;
 }
 
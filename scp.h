@@ -236,6 +236,8 @@ extern CTAB *sim_vm_cmd;
 extern void (*sim_vm_fprint_addr) (FILE *st, DEVICE *dptr, t_addr addr);
 extern t_addr (*sim_vm_parse_addr) (DEVICE *dptr, char *cptr, char **tptr);
 extern t_bool (*sim_vm_fprint_stopped) (FILE *st, t_stat reason);
+extern t_stat (*sim_vm_save) (FILE *sfile);
+extern t_stat (*sim_vm_rest) (FILE *rfile);
 
 /* vsnprintf hassles for various compilers - missing in old DEC C */
 